@@ -892,6 +892,8 @@ finch_create_conversation(PurpleConversation *conv)
 
 	ggc->tv = gnt_text_view_new();
 	gnt_widget_set_name(ggc->tv, "conversation-window-textview");
+	gnt_text_view_set_max_lines(GNT_TEXT_VIEW(ggc->tv),
+			purple_prefs_get_int(PREF_ROOT "/scrollback"));
 	gnt_widget_set_size(ggc->tv, purple_prefs_get_int(PREF_ROOT "/size/width"),
 			purple_prefs_get_int(PREF_ROOT "/size/height"));
 
@@ -1441,6 +1443,7 @@ void finch_conversation_init()
 	purple_prefs_add_none(PREF_ROOT "/size");
 	purple_prefs_add_int(PREF_ROOT "/size/width", 70);
 	purple_prefs_add_int(PREF_ROOT "/size/height", 20);
+	purple_prefs_add_int(PREF_ROOT "/scrollback", 5000);
 	purple_prefs_add_none(PREF_ROOT "/position");
 	purple_prefs_add_int(PREF_ROOT "/position/x", 0);
 	purple_prefs_add_int(PREF_ROOT "/position/y", 0);
@@ -319,6 +319,8 @@ void finch_debug_window_show()
 	gnt_box_set_alignment(GNT_BOX(debug.window), GNT_ALIGN_MID);
 
 	debug.tview = gnt_text_view_new();
+	gnt_text_view_set_max_lines(GNT_TEXT_VIEW(debug.tview),
+			purple_prefs_get_int(PREF_ROOT "/scrollback"));
 	gnt_box_add_widget(GNT_BOX(debug.window), debug.tview);
 	gnt_widget_set_size(debug.tview,
 			purple_prefs_get_int(PREF_ROOT "/size/width"),
@@ -414,6 +416,7 @@ finch_debug_ui_init(FinchDebugUi *self)
 	purple_prefs_add_none(PREF_ROOT "/size");
 	purple_prefs_add_int(PREF_ROOT "/size/width", 60);
 	purple_prefs_add_int(PREF_ROOT "/size/height", 15);
+	purple_prefs_add_int(PREF_ROOT "/scrollback", 5000);
 
 	if (purple_debug_is_enabled())
 		g_timeout_add(0, start_with_debugwin, NULL);
@@ -109,7 +109,7 @@ static gchar *log_get_date(PurpleLog *log)
 static void search_cb(GntWidget *button, FinchLogViewer *lv)
 {
 	const char *search_term = gnt_entry_get_text(GNT_ENTRY(lv->entry));
-	GList *logs;
+	GList *results, *l;
 
 	if (!(*search_term)) {
 		/* reset the tree */
@@ -130,20 +130,19 @@ static void search_cb(GntWidget *button, FinchLogViewer *lv)
 	gnt_tree_remove_all(GNT_TREE(lv->tree));
 	gnt_text_view_clear(GNT_TEXT_VIEW(lv->text));
 
-	for (logs = lv->logs; logs != NULL; logs = logs->next) {
-		char *read = purple_log_read((PurpleLog*)logs->data, NULL);
-		if (read && *read && purple_strcasestr(read, search_term)) {
-			PurpleLog *log = logs->data;
-			gchar *log_date = log_get_date(log);
+	results = purple_log_search(lv->logs, search_term);
+	for (l = results; l != NULL; l = l->next) {
+		PurpleLogSearchResult *result = l->data;
+		gchar *log_date = log_get_date(result->log);
 
-			gnt_tree_add_row_last(GNT_TREE(lv->tree),
-									log,
-									gnt_tree_create_row(GNT_TREE(lv->tree), log_date),
-									NULL);
-			g_free(log_date);
-		}
-		g_free(read);
+		gnt_tree_add_row_last(GNT_TREE(lv->tree),
+								result->log,
+								gnt_tree_create_row(GNT_TREE(lv->tree), log_date),
+								NULL);
+		g_free(log_date);
+		purple_log_search_result_free(result);
 	}
+	g_list_free(results);
 
 }
 
@@ -210,13 +210,22 @@ im_msg_sent_cb(PurpleAccount *account, PurpleMessage *msg,
 	play_conv_event(PURPLE_CONVERSATION(im), event);
 }
 
+/* One sound for the whole batch, however many joined. */
 static void
-chat_user_join_cb(PurpleChatConversation *chat, const char *name,
-				   PurpleChatUserFlags flags, gboolean new_arrival,
-				   PurpleSoundEventID event)
+chat_users_join_cb(PurpleChatConversation *chat, GList *users,
+				   gboolean new_arrivals, PurpleSoundEventID event)
 {
-	if (new_arrival && !chat_nick_matches_name(chat, name))
-		play_conv_event(PURPLE_CONVERSATION(chat), event);
+	if (!new_arrivals)
+		return;
+
+	for (; users != NULL; users = users->next) {
+		const char *name = purple_chat_user_get_name(users->data);
+
+		if (!chat_nick_matches_name(chat, name)) {
+			play_conv_event(PURPLE_CONVERSATION(chat), event);
+			return;
+		}
+	}
 }
 
 static void
@@ -390,8 +399,8 @@ finch_sound_init(void)
 	purple_signal_connect(conv_handle, "sent-im-msg",
 						gnt_sound_handle, PURPLE_CALLBACK(im_msg_sent_cb),
 						GINT_TO_POINTER(PURPLE_SOUND_SEND));
-	purple_signal_connect(conv_handle, "chat-user-joined",
-						gnt_sound_handle, PURPLE_CALLBACK(chat_user_join_cb),
+	purple_signal_connect(conv_handle, "chat-users-joined",
+						gnt_sound_handle, PURPLE_CALLBACK(chat_users_join_cb),
 						GINT_TO_POINTER(PURPLE_SOUND_CHAT_JOIN));
 	purple_signal_connect(conv_handle, "chat-user-left",
 						gnt_sound_handle, PURPLE_CALLBACK(chat_user_left_cb),
@@ -59,6 +59,17 @@ typedef struct
 	int end;
 } GntTextTag;
 
+typedef struct
+{
+	GList *head;             /* The newest line, ie. g_list_first(view->list) */
+	GList *tail;             /* The oldest line */
+	int lines;               /* Total number of GntTextLines */
+	int below;               /* Number of lines in front of view->list */
+	int max_lines;           /* Scrollback limit, 0 for no limit */
+} GntTextViewPrivate;
+
+#define GNT_TEXT_VIEW_GET_PRIVATE(o)   (G_TYPE_INSTANCE_GET_PRIVATE ((o), GNT_TYPE_TEXT_VIEW, GntTextViewPrivate))
+
 static GntWidgetClass *parent_class = NULL;
 
 static gchar *select_start;
@@ -66,6 +77,8 @@ static gchar *select_end;
 static gboolean double_click;
 
 static void reset_text_view(GntTextView *view);
+static void free_text_line(gpointer data, gpointer null);
+static void free_tag(gpointer data, gpointer null);
 
 static gboolean
 text_view_contains(GntTextView *view, const char *str)
@@ -73,10 +86,108 @@ text_view_contains(GntTextView *view, const char *str)
 	return (str >= view->string->str && str < view->string->str + view->string->len);
 }
 
+/* Recomputes the line index after the list was modified behind its back. */
+static void
+text_view_recount(GntTextView *view)
+{
+	GntTextViewPrivate *priv = GNT_TEXT_VIEW_GET_PRIVATE(view);
+	GList *iter;
+
+	priv->below = 0;
+	for (iter = view->list; iter->prev; iter = iter->prev)
+		priv->below++;
+	priv->head = iter;
+	priv->lines = priv->below;
+	for (iter = view->list; iter->next; iter = iter->next)
+		priv->lines++;
+	priv->tail = iter;
+	priv->lines++;
+}
+
+static GntTextLine *
+text_view_new_line(GntTextView *view, gboolean soft)
+{
+	GntTextViewPrivate *priv = GNT_TEXT_VIEW_GET_PRIVATE(view);
+	GntTextLine *line = g_new0(GntTextLine, 1);
+
+	line->soft = soft;
+	priv->head = g_list_prepend(priv->head, line);
+	priv->lines++;
+	priv->below++;
+	return line;
+}
+
+/* Drops the oldest lines once the scrollback limit is exceeded, and
+ * moves the remaining text to the front of the string. The limit is
+ * allowed to overshoot a little so the compaction is amortized. */
+static void
+text_view_trim(GntTextView *view)
+{
+	GntTextViewPrivate *priv = GNT_TEXT_VIEW_GET_PRIVATE(view);
+	GList *iter, *next;
+	GntTextLine *line;
+	int cut = -1;
+
+	if (priv->max_lines <= 0 ||
+			priv->lines <= priv->max_lines + MAX(priv->max_lines / 8, 16))
+		return;
+
+	while (priv->lines > 1 && (priv->lines > priv->max_lines ||
+				((GntTextLine *)priv->tail->data)->soft)) {
+		iter = priv->tail;
+		priv->tail = iter->prev;
+		priv->tail->next = NULL;
+		if (view->list == iter) {
+			view->list = priv->tail;
+			priv->below--;
+		}
+		free_text_line(iter->data, NULL);
+		g_list_free_1(iter);
+		priv->lines--;
+	}
+
+	for (iter = priv->tail; iter && cut < 0; iter = iter->prev) {
+		line = iter->data;
+		if (line->segments)
+			cut = ((GntTextSegment *)line->segments->data)->start;
+	}
+	if (cut < 0)
+		cut = view->string->len;
+	if (cut == 0)
+		return;
+
+	if (text_view_contains(view, select_start) || text_view_contains(view, select_end))
+		select_start = select_end = NULL;
+	g_string_erase(view->string, 0, cut);
+
+	for (iter = priv->head; iter; iter = iter->next) {
+		GList *segs;
+		line = iter->data;
+		for (segs = line->segments; segs; segs = segs->next) {
+			GntTextSegment *seg = segs->data;
+			seg->start -= cut;
+			seg->end -= cut;
+		}
+	}
+
+	for (iter = view->tags; iter; iter = next) {
+		GntTextTag *tag = iter->data;
+		next = iter->next;
+		if (tag->end <= cut) {
+			view->tags = g_list_delete_link(view->tags, iter);
+			free_tag(tag, NULL);
+			continue;
+		}
+		tag->start = MAX(tag->start - cut, 0);
+		tag->end -= cut;
+	}
+}
+
 static void
 gnt_text_view_draw(GntWidget *widget)
 {
 	GntTextView *view = GNT_TEXT_VIEW(widget);
+	GntTextViewPrivate *priv = GNT_TEXT_VIEW_GET_PRIVATE(view);
 	int n;
 	int i = 0;
 	GList *lines;
@@ -87,16 +198,17 @@ gnt_text_view_draw(GntWidget *widget)
 	wbkgd(widget->window, gnt_color_pair(GNT_COLOR_NORMAL));
 	werase(widget->window);
 
-	n = g_list_length(view->list);
+	n = priv->lines - priv->below;
 	if ((view->flags & GNT_TEXT_VIEW_TOP_ALIGN) &&
 			n < widget->priv.height) {
-		GList *now = view->list;
 		comp = widget->priv.height - n;
-		view->list = g_list_nth_prev(view->list, comp);
-		if (!view->list) {
-			view->list = g_list_first(now);
-			comp = widget->priv.height - g_list_length(view->list);
+		if (comp > priv->below) {
+			view->list = priv->head;
+			priv->below = 0;
+			comp = widget->priv.height - priv->lines;
 		} else {
+			view->list = g_list_nth_prev(view->list, comp);
+			priv->below -= comp;
 			comp = 0;
 		}
 	}
@@ -150,14 +262,14 @@ gnt_text_view_draw(GntWidget *widget)
 	rows = widget->priv.height - 2;
 	if (has_scroll && rows > 0)
 	{
-		int total = g_list_length(g_list_first(view->list));
+		int total = priv->lines;
 		int showing, position, up, down;
 
 		showing = rows * rows / total + 1;
 		showing = MIN(rows, showing);
 
 		total -= rows;
-		up = g_list_length(lines);
+		up = priv->lines - priv->below - i;
 		down = total - up;
 
 		position = (rows - showing) * up / MAX(1, up + down);
@@ -237,7 +349,7 @@ static void
 gnt_text_view_destroy(GntWidget *widget)
 {
 	GntTextView *view = GNT_TEXT_VIEW(widget);
-	view->list = g_list_first(view->list);
+	view->list = GNT_TEXT_VIEW_GET_PRIVATE(view)->head;
 	g_list_foreach(view->list, free_text_line, NULL);
 	g_list_free(view->list);
 	g_list_foreach(view->tags, free_tag, NULL);
@@ -251,13 +363,14 @@ gnt_text_view_get_p(GntTextView *view, int x, int y)
 	int n;
 	int i = 0;
 	GntWidget *wid = GNT_WIDGET(view);
+	GntTextViewPrivate *priv = GNT_TEXT_VIEW_GET_PRIVATE(view);
 	GntTextLine *line;
 	GList *lines;
 	GList *segs;
 	GntTextSegment *seg;
 	gchar *pos;
 
-	n = g_list_length(view->list);
+	n = priv->lines - priv->below;
 	y = wid->priv.height - y;
 	if (n < y) {
 		x = 0;
@@ -375,10 +488,12 @@ static void
 gnt_text_view_reflow(GntTextView *view)
 {
 	/* This is pretty ugly, and inefficient. Someone do something about it. */
+	GntTextViewPrivate *priv = GNT_TEXT_VIEW_GET_PRIVATE(view);
 	GntTextLine *line;
 	GList *back, *iter, *list;
 	GString *string;
 	int pos = 0;    /* no. of 'real' lines */
+	int max_lines = priv->max_lines;
 
 	list = view->list;
 	while (list->prev) {
@@ -388,8 +503,10 @@ gnt_text_view_reflow(GntTextView *view)
 		list = list->prev;
 	}
 
-	back = g_list_last(view->list);
-	view->list = NULL;
+	back = priv->tail;
+	view->list = priv->head = NULL;
+	/* Don't trim while the old lines are being replayed */
+	priv->max_lines = 0;
 
 	string = view->string;
 	view->string = NULL;
@@ -418,14 +535,22 @@ gnt_text_view_reflow(GntTextView *view)
 	}
 	g_list_free(list);
 
-	list = view->list = g_list_first(view->list);
+	list = view->list = priv->head;
+	priv->below = 0;
 	/* Go back to the line that was in view before resizing started */
-	while (pos--) {
-		while (((GntTextLine*)list->data)->soft)
+	while (pos-- && list->next) {
+		while (list->next && ((GntTextLine*)list->data)->soft) {
+			list = list->next;
+			priv->below++;
+		}
+		if (list->next) {
 			list = list->next;
-		list = list->next;
+			priv->below++;
+		}
 	}
 	view->list = list;
+	priv->max_lines = max_lines;
+	text_view_trim(view);
 	GNT_WIDGET_UNSET_FLAGS(GNT_WIDGET(view), GNT_WIDGET_DRAWING);
 	if (GNT_WIDGET(view)->window)
 		gnt_widget_draw(GNT_WIDGET(view));
@@ -452,6 +577,8 @@ gnt_text_view_class_init(GntTextViewClass *klass)
 	parent_class->clicked = gnt_text_view_clicked;
 	parent_class->size_changed = gnt_text_view_size_changed;
 
+	g_type_class_add_private(G_OBJECT_CLASS(klass), sizeof(GntTextViewPrivate));
+
 	GNTDEBUG;
 }
 
@@ -460,6 +587,7 @@ gnt_text_view_init(GTypeInstance *instance, gpointer class)
 {
 	GntWidget *widget = GNT_WIDGET(instance);
 	GntTextView *view = GNT_TEXT_VIEW(widget);
+	GntTextViewPrivate *priv = GNT_TEXT_VIEW_GET_PRIVATE(view);
 	GntTextLine *line = g_new0(GntTextLine, 1);
 
 	GNT_WIDGET_SET_FLAGS(widget, GNT_WIDGET_NO_BORDER | GNT_WIDGET_NO_SHADOW |
@@ -468,6 +596,8 @@ gnt_text_view_init(GTypeInstance *instance, gpointer class)
 	widget->priv.minh = 2;
 	view->string = g_string_new(NULL);
 	view->list = g_list_append(view->list, line);
+	priv->head = priv->tail = view->list;
+	priv->lines = 1;
 
 	GNTDEBUG;
 }
@@ -519,9 +649,9 @@ void gnt_text_view_append_text_with_tag(GntTextView *view, const char *text,
 			GntTextFormatFlags flags, const char *tagname)
 {
 	GntWidget *widget = GNT_WIDGET(view);
+	GntTextViewPrivate *priv = GNT_TEXT_VIEW_GET_PRIVATE(view);
 	chtype fl = 0;
 	const char *start, *end;
-	GList *list = view->list;
 	GntTextLine *line;
 	int len;
 	gboolean has_scroll = !(view->flags & GNT_TEXT_VIEW_NO_SCROLL);
@@ -543,8 +673,6 @@ void gnt_text_view_append_text_with_tag(GntTextView *view, const char *text,
 		view->tags = g_list_append(view->tags, tag);
 	}
 
-	view->list = g_list_first(view->list);
-
 	start = end = view->string->str + len;
 
 	while (*start) {
@@ -556,17 +684,14 @@ void gnt_text_view_append_text_with_tag(GntTextView *view, const char *text,
 				end++;
 			end++;
 			start = end;
-			gnt_text_view_next_line(view);
-			view->list = g_list_first(view->list);
+			text_view_new_line(view, FALSE);
 			continue;
 		}
 
-		line = view->list->data;
+		line = priv->head->data;
 		if (line->length == widget->priv.width - has_scroll) {
 			/* The last added line was exactly the same width as the widget */
-			line = g_new0(GntTextLine, 1);
-			line->soft = TRUE;
-			view->list = g_list_prepend(view->list, line);
+			line = text_view_new_line(view, TRUE);
 		}
 
 		if ((end = strchr(start, '\r')) != NULL ||
@@ -608,39 +733,41 @@ void gnt_text_view_append_text_with_tag(GntTextView *view, const char *text,
 			else
 				end++; /* Remove the space */
 
-			line = g_new0(GntTextLine, 1);
-			line->soft = TRUE;
-			view->list = g_list_prepend(view->list, line);
+			line = text_view_new_line(view, TRUE);
 		}
 		seg->end = end - view->string->str;
 		oldl->length += len;
 		start = end;
 	}
 
-	view->list = list;
+	text_view_trim(view);
 
 	gnt_widget_draw(widget);
 }
 
 void gnt_text_view_scroll(GntTextView *view, int scroll)
 {
-	if (scroll == 0)
+	GntTextViewPrivate *priv = GNT_TEXT_VIEW_GET_PRIVATE(view);
+
+	if (scroll == 0 || scroll >= priv->below)
 	{
-		view->list = g_list_first(view->list);
+		view->list = priv->head;
+		priv->below = 0;
 	}
 	else if (scroll > 0)
 	{
-		GList *list = g_list_nth_prev(view->list, scroll);
-		if (list == NULL)
-			list = g_list_first(view->list);
-		view->list = list;
+		view->list = g_list_nth_prev(view->list, scroll);
+		priv->below -= scroll;
+	}
+	else if (-scroll >= priv->lines - 1 - priv->below)
+	{
+		view->list = priv->tail;
+		priv->below = priv->lines - 1;
 	}
-	else if (scroll < 0)
+	else
 	{
-		GList *list = g_list_nth(view->list, -scroll);
-		if (list == NULL)
-			list = g_list_last(view->list);
-		view->list = list;
+		view->list = g_list_nth(view->list, -scroll);
+		priv->below -= scroll;
 	}
 
 	gnt_widget_draw(GNT_WIDGET(view));
@@ -648,11 +775,8 @@ void gnt_text_view_scroll(GntTextView *view, int scroll)
 
 void gnt_text_view_next_line(GntTextView *view)
 {
-	GntTextLine *line = g_new0(GntTextLine, 1);
-	GList *list = view->list;
-
-	view->list = g_list_prepend(g_list_first(view->list), line);
-	view->list = list;
+	text_view_new_line(view, FALSE);
+	text_view_trim(view);
 	gnt_widget_draw(GNT_WIDGET(view));
 }
 
@@ -681,14 +805,18 @@ chtype gnt_text_format_flag_to_chtype(GntTextFormatFlags flags)
 
 static void reset_text_view(GntTextView *view)
 {
+	GntTextViewPrivate *priv = GNT_TEXT_VIEW_GET_PRIVATE(view);
 	GntTextLine *line;
 
-	g_list_foreach(view->list, free_text_line, NULL);
-	g_list_free(view->list);
+	g_list_foreach(priv->head, free_text_line, NULL);
+	g_list_free(priv->head);
 	view->list = NULL;
 
 	line = g_new0(GntTextLine, 1);
 	view->list = g_list_append(view->list, line);
+	priv->head = priv->tail = view->list;
+	priv->lines = 1;
+	priv->below = 0;
 	if (view->string)
 		g_string_free(view->string, TRUE);
 	view->string = g_string_new(NULL);
@@ -707,23 +835,24 @@ void gnt_text_view_clear(GntTextView *view)
 
 int gnt_text_view_get_lines_below(GntTextView *view)
 {
-	int below = 0;
-	GList *list = view->list;
-	while ((list = list->prev))
-		++below;
-	return below;
+	return GNT_TEXT_VIEW_GET_PRIVATE(view)->below;
 }
 
 int gnt_text_view_get_lines_above(GntTextView *view)
 {
-	int above = 0;
-	GList *list;
-	list = g_list_nth(view->list, GNT_WIDGET(view)->priv.height);
-	if (!list)
-		return 0;
-	while ((list = list->next))
-		++above;
-	return above;
+	GntTextViewPrivate *priv = GNT_TEXT_VIEW_GET_PRIVATE(view);
+	int above = priv->lines - priv->below - GNT_WIDGET(view)->priv.height - 1;
+	return MAX(above, 0);
+}
+
+void gnt_text_view_set_max_lines(GntTextView *view, int max)
+{
+	g_return_if_fail(GNT_IS_TEXT_VIEW(view));
+
+	GNT_TEXT_VIEW_GET_PRIVATE(view)->max_lines = MAX(max, 0);
+	text_view_trim(view);
+	if (GNT_WIDGET(view)->window)
+		gnt_widget_draw(GNT_WIDGET(view));
 }
 
 /*
@@ -731,10 +860,11 @@ int gnt_text_view_get_lines_above(GntTextView *view)
  */
 int gnt_text_view_tag_change(GntTextView *view, const char *name, const char *text, gboolean all)
 {
-	GList *alllines = g_list_first(view->list);
+	GList *alllines = GNT_TEXT_VIEW_GET_PRIVATE(view)->head;
 	GList *list, *next, *iter, *inext;
 	const int text_length = text ? strlen(text) : 0;
 	int count = 0;
+	gboolean removed = FALSE;
 	for (list = view->tags; list; list = next) {
 		GntTextTag *tag = list->data;
 		next = list->next;
@@ -802,6 +932,7 @@ int gnt_text_view_tag_change(GntTextView *view, const char *name, const char *te
 										view->list = iter->prev;
 								}
 								alllines = g_list_delete_link(alllines, iter);
+								removed = TRUE;
 							}
 						} else {
 							/* XXX: (null) */
@@ -828,6 +959,11 @@ int gnt_text_view_tag_change(GntTextView *view, const char *name, const char *te
 				break;
 		}
 	}
+	if (removed) {
+		if (alllines == NULL)
+			view->list = g_list_append(NULL, g_new0(GntTextLine, 1));
+		text_view_recount(view);
+	}
 	gnt_widget_draw(GNT_WIDGET(view));
 	return count;
 }
@@ -183,6 +183,16 @@ int gnt_text_view_get_lines_below(GntTextView *view);
  */
 int gnt_text_view_get_lines_above(GntTextView *view);
 
+/**
+ * gnt_text_view_set_max_lines:
+ * @view:  The textview.
+ * @max:   The maximum number of lines to keep, or 0 for no limit.
+ *
+ * Limit the scrollback of the textview. When more lines are appended, the
+ * oldest lines are dropped along with their text (and any tags in it).
+ */
+void gnt_text_view_set_max_lines(GntTextView *view, int max);
+
 /**
  * gnt_text_view_tag_change:
  * @view:   The textview.
@@ -37,6 +37,18 @@
 #define PURPLE_ACCOUNT_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE((obj), PURPLE_TYPE_ACCOUNT, PurpleAccountPrivate))
 
+/*
+ * A permit or deny list.  The normalized names are kept in the order they
+ * were added, for purple_account_privacy_get_permitted() and friends, and
+ * in a set for lookups.
+ */
+typedef struct
+{
+	GSList *names;
+	GSList *last;
+	GHashTable *set;
+} PrivacyList;
+
 typedef struct
 {
 	char *username;             /* The username.                          */
@@ -64,16 +76,8 @@ typedef struct
 								/*   to NULL when the account inherits      */
 								/*   proxy settings from global prefs.      */
 
-	/*
-	 * TODO: Instead of linked lists for permit and deny, use a data
-	 * structure that allows fast lookups AND decent performance when
-	 * iterating through all items. Fast lookups should help performance
-	 * for protocols like MSN, where all your buddies exist in your permit
-	 * list therefore the permit list is large. Possibly GTree or
-	 * GHashTable.
-	 */
-	GSList *permit;             /* Permit list.                           */
-	GSList *deny;               /* Deny list.                             */
+	PrivacyList permit;         /* Permit list.                           */
+	PrivacyList deny;           /* Deny list.                             */
 	PurpleAccountPrivacyType privacy_type;  /* The permit/deny setting.   */
 
 	GList *status_types;        /* Status types.                          */
@@ -1565,11 +1569,78 @@ purple_account_get_privacy_type(const PurpleAccount *account)
 	return priv->privacy_type;
 }
 
+static void
+privacy_list_init(PrivacyList *list)
+{
+	list->names = list->last = NULL;
+	list->set = g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+static void
+privacy_list_destroy(PrivacyList *list)
+{
+	g_hash_table_destroy(list->set);
+	g_slist_free_full(list->names, g_free);
+	list->names = list->last = NULL;
+	list->set = NULL;
+}
+
+static gboolean
+privacy_list_contains(PrivacyList *list, const char *name)
+{
+	return g_hash_table_contains(list->set, name);
+}
+
+/* Appends a name, which the list takes, unless it's there already. */
+static gboolean
+privacy_list_add(PrivacyList *list, char *name)
+{
+	GSList *link;
+
+	if (privacy_list_contains(list, name))
+		return FALSE;
+
+	link = g_slist_prepend(NULL, name);
+	if (list->last != NULL)
+		list->last->next = link;
+	else
+		list->names = link;
+	list->last = link;
+	g_hash_table_add(list->set, name);
+
+	return TRUE;
+}
+
+/* Removes a name and returns the list's copy of it, or NULL. */
+static char *
+privacy_list_remove(PrivacyList *list, const char *name)
+{
+	GSList *l, *prev = NULL;
+	char *del;
+
+	if (!g_hash_table_lookup_extended(list->set, name, (gpointer *)&del, NULL))
+		return NULL;
+
+	g_hash_table_remove(list->set, name);
+
+	for (l = list->names; l->data != del; l = l->next)
+		prev = l;
+
+	if (prev != NULL)
+		prev->next = l->next;
+	else
+		list->names = l->next;
+	if (list->last == l)
+		list->last = prev;
+	g_slist_free_1(l);
+
+	return del;
+}
+
 gboolean
 purple_account_privacy_permit_add(PurpleAccount *account, const char *who,
 						gboolean local_only)
 {
-	GSList *l;
 	char *name;
 	PurpleBuddy *buddy;
 	PurpleBlistUiOps *blist_ops;
@@ -1582,21 +1653,13 @@ purple_account_privacy_permit_add(PurpleAccount *account, const char *who,
 	priv = PURPLE_ACCOUNT_GET_PRIVATE(account);
 	name = g_strdup(purple_normalize(account, who));
 
-	for (l = priv->permit; l != NULL; l = l->next) {
-		if (g_str_equal(name, l->data))
-			/* This buddy already exists */
-			break;
-	}
-
-	if (l != NULL)
+	if (!privacy_list_add(&priv->permit, name))
 	{
 		/* This buddy already exists, so bail out */
 		g_free(name);
 		return FALSE;
 	}
 
-	priv->permit = g_slist_append(priv->permit, name);
-
 	if (!local_only && purple_account_is_connected(account))
 		purple_serv_add_permit(purple_account_get_connection(account), who);
 
@@ -1620,7 +1683,6 @@ gboolean
 purple_account_privacy_permit_remove(PurpleAccount *account, const char *who,
 						   gboolean local_only)
 {
-	GSList *l;
 	const char *name;
 	PurpleBuddy *buddy;
 	char *del;
@@ -1634,22 +1696,14 @@ purple_account_privacy_permit_remove(PurpleAccount *account, const char *who,
 	priv = PURPLE_ACCOUNT_GET_PRIVATE(account);
 	name = purple_normalize(account, who);
 
-	for (l = priv->permit; l != NULL; l = l->next) {
-		if (g_str_equal(name, l->data))
-			/* We found the buddy we were looking for */
-			break;
-	}
-
-	if (l == NULL)
+	/* We should not free the list's copy of the name just yet. There can be
+	 * occasions where it is who. In such cases, freeing it here can cause
+	 * crashes later when who is used. */
+	del = privacy_list_remove(&priv->permit, name);
+	if (del == NULL)
 		/* We didn't find the buddy we were looking for, so bail out */
 		return FALSE;
 
-	/* We should not free l->data just yet. There can be occasions where
-	 * l->data == who. In such cases, freeing l->data here can cause crashes
-	 * later when who is used. */
-	del = l->data;
-	priv->permit = g_slist_delete_link(priv->permit, l);
-
 	if (!local_only && purple_account_is_connected(account))
 		purple_serv_rem_permit(purple_account_get_connection(account), who);
 
@@ -1673,7 +1727,6 @@ gboolean
 purple_account_privacy_deny_add(PurpleAccount *account, const char *who,
 					  gboolean local_only)
 {
-	GSList *l;
 	char *name;
 	PurpleBuddy *buddy;
 	PurpleBlistUiOps *blist_ops;
@@ -1686,21 +1739,13 @@ purple_account_privacy_deny_add(PurpleAccount *account, const char *who,
 	priv = PURPLE_ACCOUNT_GET_PRIVATE(account);
 	name = g_strdup(purple_normalize(account, who));
 
-	for (l = priv->deny; l != NULL; l = l->next) {
-		if (g_str_equal(name, l->data))
-			/* This buddy already exists */
-			break;
-	}
-
-	if (l != NULL)
+	if (!privacy_list_add(&priv->deny, name))
 	{
 		/* This buddy already exists, so bail out */
 		g_free(name);
 		return FALSE;
 	}
 
-	priv->deny = g_slist_append(priv->deny, name);
-
 	if (!local_only && purple_account_is_connected(account))
 		purple_serv_add_deny(purple_account_get_connection(account), who);
 
@@ -1723,7 +1768,6 @@ gboolean
 purple_account_privacy_deny_remove(PurpleAccount *account, const char *who,
 						 gboolean local_only)
 {
-	GSList *l;
 	const char *normalized;
 	char *name;
 	PurpleBuddy *buddy;
@@ -1737,21 +1781,13 @@ purple_account_privacy_deny_remove(PurpleAccount *account, const char *who,
 	priv = PURPLE_ACCOUNT_GET_PRIVATE(account);
 	normalized = purple_normalize(account, who);
 
-	for (l = priv->deny; l != NULL; l = l->next) {
-		if (g_str_equal(normalized, l->data))
-			/* We found the buddy we were looking for */
-			break;
-	}
-
-	if (l == NULL)
+	name = privacy_list_remove(&priv->deny, normalized);
+	if (name == NULL)
 		/* We didn't find the buddy we were looking for, so bail out */
 		return FALSE;
 
 	buddy = purple_blist_find_buddy(account, normalized);
 
-	name = l->data;
-	priv->deny = g_slist_delete_link(priv->deny, l);
-
 	if (!local_only && purple_account_is_connected(account))
 		purple_serv_rem_deny(purple_account_get_connection(account), name);
 
@@ -1783,7 +1819,7 @@ add_all_buddies_to_permit_list(PurpleAccount *account, gboolean local)
 	PurpleAccountPrivate *priv = PURPLE_ACCOUNT_GET_PRIVATE(account);
 
 	/* Remove anyone in the permit list who is not in the buddylist */
-	for (list = priv->permit; list != NULL; ) {
+	for (list = priv->permit.names; list != NULL; ) {
 		char *person = list->data;
 		list = list->next;
 		if (!purple_blist_find_buddy(account, person))
@@ -1797,8 +1833,11 @@ add_all_buddies_to_permit_list(PurpleAccount *account, gboolean local)
 		PurpleBuddy *buddy = list->data;
 		const gchar *name = purple_buddy_get_name(buddy);
 
-		if (!g_slist_find_custom(priv->permit, name, (GCompareFunc)g_utf8_collate))
+		if (!privacy_list_contains(&priv->permit,
+				purple_normalize(account, name)))
+		{
 			purple_account_privacy_permit_add(account, name, local);
+		}
 		list = g_slist_delete_link(list, list);
 	}
 }
@@ -1823,7 +1862,7 @@ purple_account_privacy_allow(PurpleAccount *account, const char *who)
 			{
 				/* Empty the allow-list. */
 				const char *norm = purple_normalize(account, who);
-				for (list = priv->permit; list != NULL;) {
+				for (list = priv->permit.names; list != NULL;) {
 					char *person = list->data;
 					list = list->next;
 					if (!purple_strequal(norm, person))
@@ -1861,7 +1900,7 @@ purple_account_privacy_deny(PurpleAccount *account, const char *who)
 			{
 				/* Empty the deny-list. */
 				const char *norm = purple_normalize(account, who);
-				for (list = priv->deny; list != NULL; ) {
+				for (list = priv->deny.names; list != NULL; ) {
 					char *person = list->data;
 					list = list->next;
 					if (!purple_strequal(norm, person))
@@ -1902,7 +1941,7 @@ purple_account_privacy_get_permitted(PurpleAccount *account)
 
 	g_return_val_if_fail(priv != NULL, NULL);
 
-	return priv->permit;
+	return priv->permit.names;
 }
 
 GSList *
@@ -1912,13 +1951,12 @@ purple_account_privacy_get_denied(PurpleAccount *account)
 
 	g_return_val_if_fail(priv != NULL, NULL);
 
-	return priv->deny;
+	return priv->deny.names;
 }
 
 gboolean
 purple_account_privacy_check(PurpleAccount *account, const char *who)
 {
-	GSList *list;
 	PurpleAccountPrivate *priv = PURPLE_ACCOUNT_GET_PRIVATE(account);
 
 	switch (purple_account_get_privacy_type(account)) {
@@ -1929,20 +1967,12 @@ purple_account_privacy_check(PurpleAccount *account, const char *who)
 			return FALSE;
 
 		case PURPLE_ACCOUNT_PRIVACY_ALLOW_USERS:
-			who = purple_normalize(account, who);
-			for (list=priv->permit; list!=NULL; list=list->next) {
-				if (g_str_equal(who, list->data))
-					return TRUE;
-			}
-			return FALSE;
+			return privacy_list_contains(&priv->permit,
+					purple_normalize(account, who));
 
 		case PURPLE_ACCOUNT_PRIVACY_DENY_USERS:
-			who = purple_normalize(account, who);
-			for (list=priv->deny; list!=NULL; list=list->next) {
-				if (g_str_equal(who, list->data))
-					return FALSE;
-			}
-			return TRUE;
+			return !privacy_list_contains(&priv->deny,
+					purple_normalize(account, who));
 
 		case PURPLE_ACCOUNT_PRIVACY_ALLOW_BUDDYLIST:
 			return (purple_blist_find_buddy(account, who) != NULL);
@@ -2892,6 +2922,8 @@ static void purple_account_init(GTypeInstance *instance, gpointer klass)
 	priv->system_log = NULL;
 
 	priv->privacy_type = PURPLE_ACCOUNT_PRIVACY_ALLOW_ALL;
+	privacy_list_init(&priv->permit);
+	privacy_list_init(&priv->deny);
 
 	PURPLE_DBUS_REGISTER_POINTER(account, PurpleAccount);
 }
@@ -3005,15 +3037,8 @@ purple_account_finalize(GObject *object)
 	g_hash_table_destroy(priv->settings);
 	g_hash_table_destroy(priv->ui_settings);
 
-	while (priv->deny) {
-		g_free(priv->deny->data);
-		priv->deny = g_slist_delete_link(priv->deny, priv->deny);
-	}
-
-	while (priv->permit) {
-		g_free(priv->permit->data);
-		priv->permit = g_slist_delete_link(priv->permit, priv->permit);
-	}
+	privacy_list_destroy(&priv->deny);
+	privacy_list_destroy(&priv->permit);
 
 	PURPLE_DBUS_UNREGISTER_POINTER(account);
 
@@ -365,6 +365,7 @@ purple_buddy_update_status(PurpleBuddy *buddy, PurpleStatus *old_status)
 	PurpleCountingNode *contact_counter, *group_counter;
 	PurpleBlistUiOps *ops = purple_blist_get_ui_ops();
 	PurpleBuddyPrivate *priv = PURPLE_BUDDY_GET_PRIVATE(buddy);
+	gboolean batched;
 
 	g_return_if_fail(priv != NULL);
 
@@ -386,6 +387,9 @@ purple_buddy_update_status(PurpleBuddy *buddy, PurpleStatus *old_status)
 		purple_counting_node_change_online_count(contact_counter, +1);
 		if (purple_counting_node_get_online_count(contact_counter) == 1)
 			purple_counting_node_change_online_count(group_counter, +1);
+
+		batched = _purple_blist_presence_batch_add_status(buddy, old_status,
+				TRUE);
 	} else if (!purple_status_is_online(status) &&
 				purple_status_is_online(old_status)) {
 
@@ -400,10 +404,14 @@ purple_buddy_update_status(PurpleBuddy *buddy, PurpleStatus *old_status)
 		purple_counting_node_change_online_count(contact_counter, -1);
 		if (purple_counting_node_get_online_count(contact_counter) == 0)
 			purple_counting_node_change_online_count(group_counter, -1);
-	} else {
-		purple_signal_emit(purple_blist_get_handle(),
-		                 "buddy-status-changed", buddy, old_status,
-		                 status);
+
+		batched = _purple_blist_presence_batch_add_status(buddy, old_status,
+				TRUE);
+	} else if (!(batched = _purple_blist_presence_batch_add_status(buddy,
+			old_status, FALSE))) {
+		purple_signal_emit_by_id(
+		                 _purple_blist_get_buddy_status_changed_signal(),
+		                 buddy, old_status, status);
 	}
 
 	/*
@@ -418,7 +426,8 @@ purple_buddy_update_status(PurpleBuddy *buddy, PurpleStatus *old_status)
 	 */
 	purple_contact_invalidate_priority_buddy(purple_buddy_get_contact(buddy));
 
-	if (ops && ops->update)
+	/* A presence batch updates the UI once it's committed. */
+	if (!batched && ops && ops->update)
 		ops->update(purple_blist_get_buddy_list(), PURPLE_BLIST_NODE(buddy));
 }
 
@@ -55,16 +55,69 @@ static GObjectClass *parent_class;
  */
 static GHashTable *buddies_cache = NULL;
 
+/*
+ * A hash table used to find all of an account's buddies with a given name,
+ * whatever group they are in.
+ * PurpleAccount* => GHashTable*, with the inner hash table being
+ * normalized name => GSList* of PurpleBuddy*
+ */
+static GHashTable *buddies_names = NULL;
+
 /*
  * A hash table used for efficient lookups of groups by name.
  * UTF-8 collate-key => PurpleGroup*.
  */
 static GHashTable *groups_cache = NULL;
 
+/*
+ * The IDs of the contacts in blist.xml, which journal records refer to them
+ * by. PurpleContact* => guint. Contacts get one when they are first saved.
+ */
+static GHashTable *contact_ids = NULL;
+static guint next_contact_id = 1;
+/* Whether blist.xml was written before contacts had IDs */
+static gboolean contacts_without_id = FALSE;
+
 static guint          save_timer = 0;
 static gboolean       blist_loaded = FALSE;
 static gchar *localized_default_group_name = NULL;
 
+/* Emitted for every presence update, so it's emitted by its ID. */
+static gulong buddy_status_changed_signal = 0;
+static gulong buddies_status_changed_signal = 0;
+
+/* A buddy whose presence notifications are held back by a batch. */
+typedef struct {
+	PurpleBuddy *buddy;
+	gboolean status_changed;
+	PurpleStatus *old_status;
+	gboolean idle_changed;
+	gboolean old_idle;
+	gboolean removed;
+} PresenceBatchBuddy;
+
+/* A system log line held back by a batch. */
+typedef struct {
+	PurpleAccount *account;
+	char *from;
+	GDateTime *time;
+	char *message;
+} PresenceBatchLine;
+
+static guint presence_batch_depth = 0;
+static guint presence_batch_timeout = 0;
+static gboolean presence_batch_flushing = FALSE;
+
+/*
+ * The buddies of the open batch, PurpleBuddy* => PresenceBatchBuddy*, and
+ * the same entries in the order they were added.  presence_batch_committing
+ * holds the entries which are being delivered.
+ */
+static GHashTable *presence_batch_buddies = NULL;
+static GQueue presence_batch_order = G_QUEUE_INIT;
+static GQueue presence_batch_committing = G_QUEUE_INIT;
+static GQueue presence_batch_lines = G_QUEUE_INIT;
+
 /*********************************************************************
  * Private utility functions                                         *
  *********************************************************************/
@@ -139,12 +192,328 @@ purple_blist_buddies_cache_add_account(PurpleAccount *account)
 						(GEqualFunc)_purple_blist_hbuddy_equal,
 						(GDestroyNotify)_purple_blist_hbuddy_free_key, NULL);
 	g_hash_table_insert(buddies_cache, account, account_buddies);
+
+	g_hash_table_insert(buddies_names, account,
+			g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, (GDestroyNotify)g_slist_free));
 }
 
 static void
 purple_blist_buddies_cache_remove_account(const PurpleAccount *account)
 {
 	g_hash_table_remove(buddies_cache, account);
+	g_hash_table_remove(buddies_names, account);
+}
+
+/* Adds a buddy to the names index, unless it's already there. */
+static void
+purple_blist_buddies_names_add(PurpleAccount *account, const char *name,
+		PurpleBuddy *buddy)
+{
+	GHashTable *account_names;
+	gchar *key;
+	GSList *list;
+
+	account_names = g_hash_table_lookup(buddies_names, account);
+	g_return_if_fail(account_names != NULL);
+
+	if (!g_hash_table_lookup_extended(account_names, name,
+			(gpointer *)&key, (gpointer *)&list)) {
+		g_hash_table_insert(account_names, g_strdup(name),
+				g_slist_prepend(NULL, buddy));
+		return;
+	}
+
+	if (g_slist_find(list, buddy))
+		return;
+
+	/* Steal the entry so the old list head isn't freed */
+	g_hash_table_steal(account_names, name);
+	g_hash_table_insert(account_names, key, g_slist_prepend(list, buddy));
+}
+
+static void
+purple_blist_buddies_names_remove(PurpleAccount *account, const char *name,
+		PurpleBuddy *buddy)
+{
+	GHashTable *account_names;
+	gchar *key;
+	GSList *list;
+
+	account_names = g_hash_table_lookup(buddies_names, account);
+	if (account_names == NULL)
+		return;
+
+	if (!g_hash_table_lookup_extended(account_names, name,
+			(gpointer *)&key, (gpointer *)&list))
+		return;
+
+	g_hash_table_steal(account_names, name);
+	list = g_slist_remove(list, buddy);
+	if (list)
+		g_hash_table_insert(account_names, key, list);
+	else
+		g_free(key);
+}
+
+/*********************************************************************
+ * Presence batches                                                  *
+ *********************************************************************/
+
+static void
+presence_batch_buddy_free(PresenceBatchBuddy *pb)
+{
+	g_object_unref(pb->buddy);
+	g_slice_free(PresenceBatchBuddy, pb);
+}
+
+static void
+presence_batch_line_free(PresenceBatchLine *line)
+{
+	g_object_unref(line->account);
+	g_free(line->from);
+	g_date_time_unref(line->time);
+	g_free(line->message);
+	g_slice_free(PresenceBatchLine, line);
+}
+
+static void
+presence_batch_line_write(PresenceBatchLine *line)
+{
+	PurpleLog *log = purple_account_get_log(line->account, FALSE);
+
+	if (log != NULL) {
+		purple_log_write(log, PURPLE_MESSAGE_SYSTEM, line->from,
+				line->time, line->message);
+	}
+	presence_batch_line_free(line);
+}
+
+/* Returns the batch entry of a buddy, or NULL if no batch is open. */
+static PresenceBatchBuddy *
+presence_batch_get_buddy(PurpleBuddy *buddy)
+{
+	PresenceBatchBuddy *pb;
+
+	if (presence_batch_depth == 0)
+		return NULL;
+
+	if (presence_batch_buddies == NULL)
+		presence_batch_buddies = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	pb = g_hash_table_lookup(presence_batch_buddies, buddy);
+	if (pb == NULL) {
+		pb = g_slice_new0(PresenceBatchBuddy);
+		pb->buddy = g_object_ref(buddy);
+		g_hash_table_insert(presence_batch_buddies, buddy, pb);
+		g_queue_push_tail(&presence_batch_order, pb);
+	}
+
+	return pb;
+}
+
+static void
+presence_batch_flush(void)
+{
+	PurpleBlistUiOps *ops = purple_blist_get_ui_ops();
+	PresenceBatchBuddy *pb;
+	PresenceBatchLine *line;
+	GList *buddies = NULL;
+	gboolean want_list;
+
+	while ((line = g_queue_pop_head(&presence_batch_lines)) != NULL)
+		presence_batch_line_write(line);
+
+	while ((pb = g_queue_pop_head(&presence_batch_order)) != NULL)
+		g_queue_push_tail(&presence_batch_committing, pb);
+	if (presence_batch_buddies != NULL)
+		g_hash_table_remove_all(presence_batch_buddies);
+
+	/* A batch committed by a signal handler below is delivered with ours. */
+	if (presence_batch_flushing)
+		return;
+	presence_batch_flushing = TRUE;
+
+#ifdef HAVE_DBUS
+	/* The signal is broadcast over D-Bus even if nobody here listens. */
+	want_list = TRUE;
+#else
+	want_list = purple_signal_has_handlers(buddies_status_changed_signal);
+#endif
+
+	/* Entries stay queued while they're delivered, so that the buddies can be
+	 * marked as removed by the signal handlers. */
+	while ((pb = g_queue_peek_head(&presence_batch_committing)) != NULL) {
+		PurpleBuddy *buddy = pb->buddy;
+		PurplePresence *presence = purple_buddy_get_presence(buddy);
+		PurpleStatus *status = purple_presence_get_active_status(presence);
+		gboolean idle = purple_presence_is_idle(presence);
+
+		/* Nothing to tell if the status changed back during the batch. */
+		if (pb->status_changed && pb->old_status != status && !pb->removed) {
+			purple_signal_emit_by_id(buddy_status_changed_signal, buddy,
+					pb->old_status, status);
+		}
+
+		if (pb->idle_changed && pb->old_idle != idle && !pb->removed) {
+			purple_signal_emit(purple_blist_get_handle(),
+					"buddy-idle-changed", buddy, pb->old_idle, idle);
+		}
+
+		if (!pb->removed && ops && ops->update)
+			ops->update(purplebuddylist, PURPLE_BLIST_NODE(buddy));
+
+		g_queue_pop_head(&presence_batch_committing);
+
+		if (want_list && !pb->removed) {
+			/* The list takes over the reference. */
+			buddies = g_list_prepend(buddies, buddy);
+			g_slice_free(PresenceBatchBuddy, pb);
+		} else {
+			presence_batch_buddy_free(pb);
+		}
+	}
+
+	presence_batch_flushing = FALSE;
+
+	if (buddies != NULL) {
+		buddies = g_list_reverse(buddies);
+		purple_signal_emit_by_id(buddies_status_changed_signal, buddies);
+		g_list_free_full(buddies, g_object_unref);
+	}
+}
+
+static gboolean
+presence_batch_timeout_cb(gpointer unused)
+{
+	presence_batch_timeout = 0;
+	purple_blist_presence_batch_commit();
+
+	return FALSE;
+}
+
+void
+purple_blist_presence_batch_begin(void)
+{
+	presence_batch_depth++;
+}
+
+void
+purple_blist_presence_batch_commit(void)
+{
+	g_return_if_fail(presence_batch_depth > 0);
+
+	if (--presence_batch_depth == 0)
+		presence_batch_flush();
+}
+
+gboolean
+purple_blist_presence_batch_is_committing(void)
+{
+	return presence_batch_flushing;
+}
+
+void
+_purple_blist_presence_batch_auto(void)
+{
+	if (presence_batch_depth > 0)
+		return;
+
+	purple_blist_presence_batch_begin();
+	presence_batch_timeout = g_timeout_add(0, presence_batch_timeout_cb, NULL);
+}
+
+gboolean
+_purple_blist_presence_batch_add_status(PurpleBuddy *buddy,
+		PurpleStatus *old_status, gboolean signed_on_off)
+{
+	PresenceBatchBuddy *pb = presence_batch_get_buddy(buddy);
+
+	if (pb == NULL)
+		return FALSE;
+
+	if (signed_on_off) {
+		/* "buddy-signed-on" and "buddy-signed-off" replace it. */
+		pb->status_changed = FALSE;
+	} else if (!pb->status_changed) {
+		pb->status_changed = TRUE;
+		pb->old_status = old_status;
+	}
+
+	return TRUE;
+}
+
+gboolean
+_purple_blist_presence_batch_add_idle(PurpleBuddy *buddy, gboolean old_idle)
+{
+	PresenceBatchBuddy *pb = presence_batch_get_buddy(buddy);
+
+	if (pb == NULL)
+		return FALSE;
+
+	if (!pb->idle_changed) {
+		pb->idle_changed = TRUE;
+		pb->old_idle = old_idle;
+	}
+
+	return TRUE;
+}
+
+gboolean
+_purple_blist_presence_batch_add_log(PurpleAccount *account, const char *from,
+		GDateTime *time, const char *message)
+{
+	PresenceBatchLine *line;
+
+	if (presence_batch_depth == 0)
+		return FALSE;
+
+	line = g_slice_new(PresenceBatchLine);
+	line->account = g_object_ref(account);
+	line->from = g_strdup(from);
+	line->time = g_date_time_ref(time);
+	line->message = g_strdup(message);
+	g_queue_push_tail(&presence_batch_lines, line);
+
+	return TRUE;
+}
+
+void
+_purple_blist_presence_batch_write_log(PurpleAccount *account)
+{
+	GList *l, *next;
+
+	for (l = presence_batch_lines.head; l != NULL; l = next) {
+		PresenceBatchLine *line = l->data;
+
+		next = l->next;
+		if (line->account == account) {
+			g_queue_delete_link(&presence_batch_lines, l);
+			presence_batch_line_write(line);
+		}
+	}
+}
+
+/* Drops a buddy which is being removed from the list from any batch. */
+static void
+presence_batch_remove_buddy(PurpleBuddy *buddy)
+{
+	PresenceBatchBuddy *pb;
+	GList *l;
+
+	if (presence_batch_buddies != NULL &&
+		(pb = g_hash_table_lookup(presence_batch_buddies, buddy)) != NULL)
+	{
+		g_hash_table_remove(presence_batch_buddies, buddy);
+		g_queue_remove(&presence_batch_order, pb);
+		presence_batch_buddy_free(pb);
+	}
+
+	for (l = presence_batch_committing.head; l != NULL; l = l->next) {
+		pb = l->data;
+		if (pb->buddy == buddy)
+			pb->removed = TRUE;
+	}
 }
 
 /*********************************************************************
@@ -229,6 +598,28 @@ buddy_to_xmlnode(PurpleBuddy *buddy)
 	return node;
 }
 
+static guint
+blist_contact_id(PurpleContact *contact)
+{
+	guint id = GPOINTER_TO_UINT(g_hash_table_lookup(contact_ids, contact));
+
+	if (id == 0) {
+		id = next_contact_id++;
+		g_hash_table_insert(contact_ids, contact, GUINT_TO_POINTER(id));
+	}
+
+	return id;
+}
+
+static void
+blist_xmlnode_set_id(PurpleXmlNode *node, guint id)
+{
+	char buf[16];
+
+	g_snprintf(buf, sizeof(buf), "%u", id);
+	purple_xmlnode_set_attrib(node, "id", buf);
+}
+
 static PurpleXmlNode *
 contact_to_xmlnode(PurpleContact *contact)
 {
@@ -237,6 +628,7 @@ contact_to_xmlnode(PurpleContact *contact)
 	gchar *alias;
 
 	node = purple_xmlnode_new("contact");
+	blist_xmlnode_set_id(node, blist_contact_id(contact));
 	g_object_get(contact, "alias", &alias, NULL);
 
 	if (alias != NULL)
@@ -295,8 +687,10 @@ chat_to_xmlnode(PurpleChat *chat)
 	return node;
 }
 
+/* With contacts_by_id, the contacts are only referred to by their ID, for
+ * a journal record. */
 static PurpleXmlNode *
-group_to_xmlnode(PurpleGroup *group)
+group_to_xmlnode(PurpleGroup *group, gboolean contacts_by_id)
 {
 	PurpleXmlNode *node, *child;
 	PurpleBlistNode *cnode;
@@ -314,7 +708,12 @@ group_to_xmlnode(PurpleGroup *group)
 	{
 		if (purple_blist_node_is_transient(cnode))
 			continue;
-		if (PURPLE_IS_CONTACT(cnode))
+		if (PURPLE_IS_CONTACT(cnode) && contacts_by_id)
+		{
+			child = purple_xmlnode_new_child(node, "contact");
+			blist_xmlnode_set_id(child, blist_contact_id(PURPLE_CONTACT(cnode)));
+		}
+		else if (PURPLE_IS_CONTACT(cnode))
 		{
 			child = contact_to_xmlnode(PURPLE_CONTACT(cnode));
 			purple_xmlnode_insert_child(node, child);
@@ -385,7 +784,7 @@ blist_to_xmlnode(void)
 			continue;
 		if (PURPLE_IS_GROUP(gnode))
 		{
-			grandchild = group_to_xmlnode(PURPLE_GROUP(gnode));
+			grandchild = group_to_xmlnode(PURPLE_GROUP(gnode), FALSE);
 			purple_xmlnode_insert_child(child, grandchild);
 		}
 	}
@@ -401,12 +800,364 @@ blist_to_xmlnode(void)
 	return node;
 }
 
+/*
+ * Changes to the buddy list are saved by appending them to blist.journal,
+ * next to blist.xml. Each journal record holds the contacts changed since
+ * the previous record, the groups whose settings, chats or contacts
+ * changed, the order of the groups when it changed, and the privacy
+ * settings of the accounts that changed. Groups only refer to their
+ * contacts by ID, so a change to a contact doesn't rewrite its group. When
+ * the journal grows as big as blist.xml, the whole list is written to
+ * blist.xml again and the journal is emptied. Loading replays the journal
+ * over blist.xml.
+ *
+ * The XML trees are built on the main thread, but serializing and writing
+ * them is done by a worker thread.
+ */
+
+#define BLIST_JOURNAL_FILE "blist.journal"
+
+/* Don't bother compacting smaller journals. */
+#define BLIST_JOURNAL_MIN_COMPACT (256 * 1024)
+
+typedef enum {
+	BLIST_WRITE_JOURNAL,
+	BLIST_WRITE_SNAPSHOT,
+	BLIST_WRITE_STOP
+} BlistWriteKind;
+
+typedef struct {
+	BlistWriteKind kind;
+	PurpleXmlNode *node;
+	gchar *path;
+	gchar *journal_path; /* For a snapshot, the journal it replaces. */
+} BlistWriteJob;
+
+static GThread *blist_writer = NULL;
+static GAsyncQueue *blist_write_queue = NULL;
+
+/* Written by the worker thread. */
+static gint blist_journal_size = 0;
+static gint blist_snapshot_size = 0;
+
+/* The errors of the worker thread, newest first, until they are reported
+ * on the main thread. */
+static GMutex blist_write_lock;
+static GSList *blist_write_errors = NULL; /* GError* */
+static guint blist_write_report_id = 0;
+
+static GHashTable *dirty_groups = NULL;   /* PurpleGroup* */
+static GHashTable *dirty_contacts = NULL; /* PurpleContact* */
+static GHashTable *dirty_accounts = NULL; /* "protocol\nusername" */
+static gboolean snapshot_needed = TRUE;
+
+/* What was last saved, to tell when a snapshot or a group order record is
+ * needed. */
+static gchar *saved_group_order = NULL;
+static GHashTable *saved_usernames = NULL; /* PurpleAccount* => username */
+
+/* Main thread only. Takes the ownership of errors, newest first. */
 static void
-purple_blist_sync(void)
+blist_write_report(GSList *errors)
 {
-	PurpleXmlNode *node;
-	char *data;
+	errors = g_slist_reverse(errors);
+	while (errors != NULL) {
+		GError *error = errors->data;
+
+		purple_debug_error("buddylist", "%s\n", error->message);
+		g_error_free(error);
+		errors = g_slist_delete_link(errors, errors);
+	}
+}
+
+static gboolean
+blist_write_report_cb(gpointer unused)
+{
+	GSList *errors;
+
+	g_mutex_lock(&blist_write_lock);
+	errors = blist_write_errors;
+	blist_write_errors = NULL;
+	blist_write_report_id = 0;
+	g_mutex_unlock(&blist_write_lock);
+
+	blist_write_report(errors);
+
+	return FALSE;
+}
+
+static void
+blist_write_set_error(GError **error, const gchar *action, const gchar *path)
+{
+	int err = errno;
+
+	if (error != NULL && *error == NULL) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+				"Could not %s %s: %s", action, path, g_strerror(err));
+	}
+}
+
+/* Like purple_util_write_data_to_file_absolute(), but safe to call from
+ * the worker thread. */
+static gboolean
+blist_write_file(const gchar *path, const gchar *data, gsize len,
+		GError **error)
+{
+	gchar *temp = g_strconcat(path, ".save", NULL);
+	FILE *file;
+	gboolean ret = TRUE;
+
+	file = g_fopen(temp, "wb");
+	if (file == NULL) {
+		blist_write_set_error(error, "open", temp);
+		g_free(temp);
+		return FALSE;
+	}
+
+#ifdef HAVE_FILENO
+#ifndef _WIN32
+	if (fchmod(fileno(file), S_IRUSR | S_IWUSR) != 0) {
+		blist_write_set_error(error, "set the permissions of", temp);
+		ret = FALSE;
+	}
+#endif
+#endif
+
+	if (ret && fwrite(data, 1, len, file) != len) {
+		blist_write_set_error(error, "write", temp);
+		ret = FALSE;
+	}
+#ifdef HAVE_FILENO
+	/* See purple_util_write_data_to_file_absolute() on why this is
+	 * flushed before it is renamed. */
+	if (ret && (fflush(file) != 0 || fsync(fileno(file)) != 0)) {
+		blist_write_set_error(error, "sync", temp);
+		ret = FALSE;
+	}
+#endif
+	if (fclose(file) != 0 && ret) {
+		blist_write_set_error(error, "close", temp);
+		ret = FALSE;
+	}
+
+	if (ret && g_rename(temp, path) != 0) {
+		blist_write_set_error(error, "rename", temp);
+		ret = FALSE;
+	}
+	if (!ret)
+		g_unlink(temp);
+
+	g_free(temp);
+	return ret;
+}
+
+static gboolean
+blist_append_record(const gchar *path, const gchar *header,
+		const gchar *data, gsize len, GError **error)
+{
+	FILE *file;
+	gboolean ret;
+
+	file = g_fopen(path, "ab");
+	if (file == NULL) {
+		blist_write_set_error(error, "open", path);
+		return FALSE;
+	}
+
+	ret = fputs(header, file) != EOF &&
+			fwrite(data, 1, len, file) == len &&
+			fputc('\n', file) != EOF;
+	if (!ret)
+		blist_write_set_error(error, "write", path);
+
+	/* Close it even when writing failed. */
+	if (fclose(file) != 0 && ret) {
+		blist_write_set_error(error, "close", path);
+		ret = FALSE;
+	}
+
+	return ret;
+}
+
+/* Runs on the worker thread, unless it couldn't be started. Returns FALSE
+ * and sets error if the job failed. */
+static gboolean
+blist_write_job_run(BlistWriteJob *job, GError **error)
+{
+	gchar *data;
+	int len = 0;
+	gboolean ret;
+
+	if (job->kind == BLIST_WRITE_SNAPSHOT) {
+		data = purple_xmlnode_to_formatted_str(job->node, &len);
+		ret = blist_write_file(job->path, data, len, error);
+		if (ret) {
+			g_unlink(job->journal_path);
+
+			g_atomic_int_set(&blist_snapshot_size, len);
+			g_atomic_int_set(&blist_journal_size, 0);
+		}
+	} else {
+		gchar *header;
+
+		data = purple_xmlnode_to_str(job->node, &len);
+		header = g_strdup_printf("%d\n", len);
+
+		ret = blist_append_record(job->path, header, data, len, error);
+		if (ret) {
+			g_atomic_int_add(&blist_journal_size,
+					strlen(header) + len + 1);
+		}
+		g_free(header);
+	}
+
+	g_free(data);
+	purple_xmlnode_free(job->node);
+	g_free(job->path);
+	g_free(job->journal_path);
+	g_free(job);
+
+	return ret;
+}
 
+static gpointer
+blist_writer_thread(gpointer data)
+{
+	BlistWriteJob *job;
+
+	while ((job = g_async_queue_pop(blist_write_queue))->kind !=
+			BLIST_WRITE_STOP)
+	{
+		GError *error = NULL;
+
+		if (blist_write_job_run(job, &error))
+			continue;
+
+		g_mutex_lock(&blist_write_lock);
+		blist_write_errors = g_slist_prepend(blist_write_errors, error);
+		if (blist_write_report_id == 0) {
+			blist_write_report_id = g_idle_add(blist_write_report_cb,
+					NULL);
+		}
+		g_mutex_unlock(&blist_write_lock);
+	}
+	g_free(job);
+
+	return NULL;
+}
+
+static void
+blist_write_queue_push(BlistWriteKind kind, PurpleXmlNode *node)
+{
+	BlistWriteJob *job = g_new0(BlistWriteJob, 1);
+	const gchar *user_dir = purple_user_dir();
+	GError *error = NULL;
+
+	/* The worker thread can't call purple_user_dir(). */
+	job->kind = kind;
+	job->node = node;
+	job->journal_path = g_build_filename(user_dir, BLIST_JOURNAL_FILE, NULL);
+	if (kind == BLIST_WRITE_SNAPSHOT) {
+		job->path = g_build_filename(user_dir, "blist.xml", NULL);
+		purple_build_dir(user_dir, S_IRUSR | S_IWUSR | S_IXUSR);
+	} else {
+		job->path = g_strdup(job->journal_path);
+	}
+
+	if (blist_writer != NULL)
+		g_async_queue_push(blist_write_queue, job);
+	else if (!blist_write_job_run(job, &error))
+		blist_write_report(g_slist_prepend(NULL, error));
+}
+
+static void
+blist_writer_start(void)
+{
+	GError *error = NULL;
+
+	blist_write_queue = g_async_queue_new();
+	blist_writer = g_thread_try_new("blist writer", blist_writer_thread,
+			NULL, &error);
+	if (blist_writer == NULL) {
+		purple_debug_warning("buddylist", "Could not start the buddy list "
+				"writer, saving synchronously: %s\n", error->message);
+		g_error_free(error);
+	}
+}
+
+static void
+blist_writer_stop(void)
+{
+	if (blist_writer != NULL) {
+		BlistWriteJob *job = g_new0(BlistWriteJob, 1);
+
+		job->kind = BLIST_WRITE_STOP;
+		g_async_queue_push(blist_write_queue, job);
+		g_thread_join(blist_writer);
+		blist_writer = NULL;
+	}
+
+	if (blist_write_report_id != 0) {
+		g_source_remove(blist_write_report_id);
+		blist_write_report_id = 0;
+	}
+	blist_write_report(blist_write_errors);
+	blist_write_errors = NULL;
+
+	g_async_queue_unref(blist_write_queue);
+	blist_write_queue = NULL;
+}
+
+static gchar *
+blist_account_key(PurpleAccount *account)
+{
+	return g_strconcat(purple_account_get_protocol_id(account), "\n",
+			purple_account_get_username(account), NULL);
+}
+
+static gchar *
+blist_get_group_order(void)
+{
+	GString *order = g_string_new(NULL);
+	PurpleBlistNode *gnode;
+
+	for (gnode = purplebuddylist->root; gnode != NULL; gnode = gnode->next) {
+		if (!PURPLE_IS_GROUP(gnode) || purple_blist_node_is_transient(gnode))
+			continue;
+		if (gnode != PURPLE_BLIST_NODE(purple_blist_get_default_group()))
+			g_string_append(order, purple_group_get_name(PURPLE_GROUP(gnode)));
+		g_string_append_c(order, '\n');
+	}
+
+	return g_string_free(order, FALSE);
+}
+
+/* Forgets the changes, after they were saved. */
+static void
+blist_saved(gboolean everything)
+{
+	GList *cur;
+
+	g_hash_table_remove_all(dirty_groups);
+	g_hash_table_remove_all(dirty_contacts);
+	g_hash_table_remove_all(dirty_accounts);
+
+	if (!everything)
+		return;
+
+	g_free(saved_group_order);
+	saved_group_order = blist_get_group_order();
+	g_hash_table_remove_all(saved_usernames);
+	for (cur = purple_accounts_get_all(); cur != NULL; cur = cur->next) {
+		g_hash_table_insert(saved_usernames, cur->data,
+				g_strdup(purple_account_get_username(cur->data)));
+	}
+	snapshot_needed = FALSE;
+}
+
+static void
+purple_blist_sync(void)
+{
 	if (!blist_loaded)
 	{
 		purple_debug_error("buddylist", "Attempted to save buddy list before it "
@@ -414,17 +1165,90 @@ purple_blist_sync(void)
 		return;
 	}
 
-	node = blist_to_xmlnode();
-	data = purple_xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_file("blist.xml", data, -1);
-	g_free(data);
-	purple_xmlnode_free(node);
+	blist_write_queue_push(BLIST_WRITE_SNAPSHOT, blist_to_xmlnode());
+	blist_saved(TRUE);
+}
+
+static void
+purple_blist_sync_journal(void)
+{
+	PurpleXmlNode *record, *node, *child;
+	GHashTableIter iter;
+	gpointer key;
+	gchar *order;
+
+	if (!blist_loaded)
+		return;
+
+	record = purple_xmlnode_new("changes");
+
+	order = blist_get_group_order();
+	if (!purple_strequal(order, saved_group_order)) {
+		PurpleBlistNode *gnode;
+
+		node = purple_xmlnode_new_child(record, "groups");
+		for (gnode = purplebuddylist->root; gnode != NULL; gnode = gnode->next) {
+			if (!PURPLE_IS_GROUP(gnode) || purple_blist_node_is_transient(gnode))
+				continue;
+			child = purple_xmlnode_new_child(node, "group");
+			if (gnode != PURPLE_BLIST_NODE(purple_blist_get_default_group()))
+				purple_xmlnode_set_attrib(child, "name",
+						purple_group_get_name(PURPLE_GROUP(gnode)));
+		}
+		g_free(saved_group_order);
+		saved_group_order = order;
+	} else {
+		g_free(order);
+	}
+
+	/* The contacts go first, so that the groups find the new ones. */
+	g_hash_table_iter_init(&iter, dirty_contacts);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		PurpleBlistNode *cnode = key;
+
+		if (cnode->parent == NULL || purple_blist_node_is_transient(cnode) ||
+				purple_blist_node_is_transient(cnode->parent))
+			continue;
+		purple_xmlnode_insert_child(record, contact_to_xmlnode(key));
+	}
+
+	g_hash_table_iter_init(&iter, dirty_groups);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		if (purple_blist_node_is_transient(key))
+			continue;
+		purple_xmlnode_insert_child(record, group_to_xmlnode(key, TRUE));
+	}
+
+	g_hash_table_iter_init(&iter, dirty_accounts);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		gchar **parts = g_strsplit(key, "\n", 2);
+		PurpleAccount *account = purple_accounts_find(parts[1], parts[0]);
+
+		if (account != NULL) {
+			purple_xmlnode_insert_child(record,
+					accountprivacy_to_xmlnode(account));
+		}
+		g_strfreev(parts);
+	}
+
+	blist_saved(FALSE);
+
+	if (record->child != NULL)
+		blist_write_queue_push(BLIST_WRITE_JOURNAL, record);
+	else
+		purple_xmlnode_free(record);
 }
 
 static gboolean
 save_cb(gpointer data)
 {
-	purple_blist_sync();
+	gint journal_size = g_atomic_int_get(&blist_journal_size);
+
+	if (snapshot_needed || (journal_size > BLIST_JOURNAL_MIN_COMPACT &&
+			journal_size > g_atomic_int_get(&blist_snapshot_size)))
+		purple_blist_sync();
+	else
+		purple_blist_sync_journal();
 	save_timer = 0;
 	return FALSE;
 }
@@ -436,23 +1260,51 @@ _purple_blist_schedule_save()
 		save_timer = g_timeout_add_seconds(5, save_cb, NULL);
 }
 
+/* Remembers that the contact containing node, or else the group containing
+ * it, has to be saved. Adding, moving and removing contacts marks their
+ * groups. */
+static void
+purple_blist_mark_node(PurpleBlistNode *node)
+{
+	if (node != NULL && PURPLE_IS_BUDDY(node))
+		node = node->parent;
+
+	if (node != NULL && PURPLE_IS_CONTACT(node)) {
+		g_hash_table_add(dirty_contacts, node);
+		return;
+	}
+
+	while (node != NULL && !PURPLE_IS_GROUP(node))
+		node = node->parent;
+
+	if (node != NULL)
+		g_hash_table_add(dirty_groups, node);
+	else
+		snapshot_needed = TRUE;
+}
+
 static void
 purple_blist_save_account(PurpleAccount *account)
 {
-#if 1
-	_purple_blist_schedule_save();
-#else
 	if (account != NULL) {
-		/* Save the buddies and privacy data for this account */
+		/* The buddies of a renamed account all need to be saved again. */
+		if (!purple_strequal(g_hash_table_lookup(saved_usernames, account),
+				purple_account_get_username(account)))
+			snapshot_needed = TRUE;
+		else
+			g_hash_table_add(dirty_accounts, blist_account_key(account));
 	} else {
 		/* Save all buddies and privacy data */
+		snapshot_needed = TRUE;
 	}
-#endif
+
+	_purple_blist_schedule_save();
 }
 
 static void
 purple_blist_save_node(PurpleBlistNode *node)
 {
+	purple_blist_mark_node(node);
 	_purple_blist_schedule_save();
 }
 
@@ -469,6 +1321,297 @@ void purple_blist_schedule_save()
  * Reading from disk                                                 *
  *********************************************************************/
 
+/* Finds the child of parent named name, whose attribute attr is value. */
+static PurpleXmlNode *
+blist_xml_find_child(PurpleXmlNode *parent, const char *name,
+		const char *attr, const char *value)
+{
+	PurpleXmlNode *child;
+
+	for (child = purple_xmlnode_get_child(parent, name); child != NULL;
+			child = purple_xmlnode_get_next_twin(child)) {
+		if (purple_strequal(purple_xmlnode_get_attrib(child, attr), value))
+			return child;
+	}
+
+	return NULL;
+}
+
+/* Puts node in the place of old, or at the end of parent. */
+static void
+blist_xml_replace_child(PurpleXmlNode *parent, PurpleXmlNode *old,
+		PurpleXmlNode *node)
+{
+	if (old == NULL) {
+		purple_xmlnode_insert_child(parent, node);
+		return;
+	}
+
+	purple_xmlnode_replace(old, node);
+	purple_xmlnode_free(old);
+}
+
+/* What the replay of a journal needs besides the tree. */
+typedef struct {
+	/* ID => <contact/>, for the contacts of the tree and of detached */
+	GHashTable *contacts;
+	/* The contacts taken out of their groups by the current record, until
+	 * another group of the record takes them. The others are dropped with
+	 * the record. */
+	PurpleXmlNode *detached;
+} BlistReplay;
+
+static guint
+blist_xml_get_id(PurpleXmlNode *node)
+{
+	const char *id = purple_xmlnode_get_attrib(node, "id");
+
+	return id != NULL ? (guint)strtoul(id, NULL, 10) : 0;
+}
+
+/* Moves the contacts of group which have an ID to detached. */
+static void
+blist_xml_detach_contacts(BlistReplay *replay, PurpleXmlNode *group)
+{
+	PurpleXmlNode *x, *next;
+
+	for (x = purple_xmlnode_get_child(group, "contact"); x != NULL; x = next) {
+		next = purple_xmlnode_get_next_twin(x);
+		if (blist_xml_get_id(x) != 0) {
+			purple_xmlnode_unlink(x);
+			purple_xmlnode_insert_child(replay->detached, x);
+		}
+	}
+}
+
+/* Puts the groups of blist in the order of the groups of a journal record,
+ * dropping the ones which aren't in it anymore. The attributes of blist are
+ * kept. */
+static void
+blist_xml_reorder_groups(BlistReplay *replay, PurpleXmlNode *blist,
+		PurpleXmlNode *groups)
+{
+	PurpleXmlNode *old_children = NULL, *last = NULL, *x, *next;
+
+	while ((x = blist->child) != NULL) {
+		purple_xmlnode_unlink(x);
+		if (last != NULL)
+			last->next = x;
+		else
+			old_children = x;
+		last = x;
+	}
+
+	for (x = purple_xmlnode_get_child(groups, "group"); x != NULL;
+			x = purple_xmlnode_get_next_twin(x)) {
+		const char *name = purple_xmlnode_get_attrib(x, "name");
+		PurpleXmlNode *group, *prev = NULL;
+
+		for (group = old_children; group != NULL; prev = group, group = group->next) {
+			if (group->type == PURPLE_XMLNODE_TYPE_TAG &&
+					purple_strequal(group->name, "group") &&
+					purple_strequal(purple_xmlnode_get_attrib(group, "name"), name))
+				break;
+		}
+
+		if (group != NULL) {
+			if (prev != NULL)
+				prev->next = group->next;
+			else
+				old_children = group->next;
+			group->next = NULL;
+			group->parent = NULL;
+		} else {
+			group = purple_xmlnode_new("group");
+			if (name != NULL)
+				purple_xmlnode_set_attrib(group, "name", name);
+		}
+		purple_xmlnode_insert_child(blist, group);
+	}
+
+	for (x = old_children; x != NULL; x = next) {
+		next = x->next;
+		x->parent = NULL;
+		x->next = NULL;
+		if (x->type == PURPLE_XMLNODE_TYPE_ATTRIB) {
+			purple_xmlnode_insert_child(blist, x);
+			continue;
+		}
+		/* A renamed group takes its contacts along. */
+		if (x->type == PURPLE_XMLNODE_TYPE_TAG &&
+				purple_strequal(x->name, "group"))
+			blist_xml_detach_contacts(replay, x);
+		purple_xmlnode_free(x);
+	}
+}
+
+/* Puts the contacts a group record refers to by ID in the record. */
+static void
+blist_xml_resolve_contacts(BlistReplay *replay, PurpleXmlNode *group)
+{
+	PurpleXmlNode *x, *next;
+
+	for (x = purple_xmlnode_get_child(group, "contact"); x != NULL; x = next) {
+		PurpleXmlNode *contact;
+		guint id;
+
+		next = purple_xmlnode_get_next_twin(x);
+		if ((id = blist_xml_get_id(x)) == 0)
+			continue;
+
+		contact = g_hash_table_lookup(replay->contacts, GUINT_TO_POINTER(id));
+		if (contact != NULL) {
+			purple_xmlnode_unlink(contact);
+			purple_xmlnode_replace(x, contact);
+		} else {
+			purple_xmlnode_unlink(x);
+		}
+		purple_xmlnode_free(x);
+	}
+}
+
+static void
+blist_xml_replay_record(BlistReplay *replay, PurpleXmlNode *purple,
+		PurpleXmlNode *record)
+{
+	PurpleXmlNode *blist, *privacy, *x, *next;
+
+	blist = purple_xmlnode_get_child(purple, "blist");
+	if (blist == NULL)
+		blist = purple_xmlnode_new_child(purple, "blist");
+	privacy = purple_xmlnode_get_child(purple, "privacy");
+	if (privacy == NULL)
+		privacy = purple_xmlnode_new_child(purple, "privacy");
+	replay->detached = purple_xmlnode_new("detached");
+
+	for (x = record->child; x != NULL; x = next) {
+		PurpleXmlNode *old, *parent;
+
+		next = x->next;
+		if (x->type != PURPLE_XMLNODE_TYPE_TAG)
+			continue;
+
+		if (purple_strequal(x->name, "groups")) {
+			blist_xml_reorder_groups(replay, blist, x);
+			continue;
+		}
+
+		if (purple_strequal(x->name, "contact")) {
+			guint id = blist_xml_get_id(x);
+
+			if (id == 0)
+				continue;
+			old = g_hash_table_lookup(replay->contacts, GUINT_TO_POINTER(id));
+			/* A new contact waits for its group. */
+			parent = old != NULL ? old->parent : replay->detached;
+			g_hash_table_insert(replay->contacts, GUINT_TO_POINTER(id), x);
+		} else if (purple_strequal(x->name, "group")) {
+			old = blist_xml_find_child(blist, "group", "name",
+					purple_xmlnode_get_attrib(x, "name"));
+			blist_xml_resolve_contacts(replay, x);
+			if (old != NULL)
+				blist_xml_detach_contacts(replay, old);
+			parent = blist;
+		} else if (purple_strequal(x->name, "account")) {
+			const char *proto = purple_xmlnode_get_attrib(x, "proto");
+
+			for (old = blist_xml_find_child(privacy, "account", "name",
+					purple_xmlnode_get_attrib(x, "name"));
+					old != NULL && !purple_strequal(proto,
+						purple_xmlnode_get_attrib(old, "proto"));
+					old = purple_xmlnode_get_next_twin(old))
+				;
+			parent = privacy;
+		} else {
+			continue;
+		}
+
+		/* Move the node from the record to the tree. */
+		purple_xmlnode_unlink(x);
+		blist_xml_replace_child(parent, old, x);
+	}
+
+	/* The contacts no group took were removed. */
+	for (x = purple_xmlnode_get_child(replay->detached, "contact"); x != NULL;
+			x = purple_xmlnode_get_next_twin(x))
+		g_hash_table_remove(replay->contacts,
+				GUINT_TO_POINTER(blist_xml_get_id(x)));
+	purple_xmlnode_free(replay->detached);
+	replay->detached = NULL;
+}
+
+/* Applies the records of blist.journal to the tree read from blist.xml.
+ * Returns the number of records applied. */
+static int
+blist_replay_journal(PurpleXmlNode **purple)
+{
+	gchar *path, *contents, *pos, *end;
+	gsize length;
+	int count = 0;
+	BlistReplay replay;
+
+	path = g_build_filename(purple_user_dir(), BLIST_JOURNAL_FILE, NULL);
+	if (!g_file_get_contents(path, &contents, &length, NULL)) {
+		g_free(path);
+		return 0;
+	}
+
+	replay.contacts = g_hash_table_new(g_direct_hash, g_direct_equal);
+	replay.detached = NULL;
+	if (*purple != NULL) {
+		PurpleXmlNode *group, *contact;
+
+		for (group = purple_xmlnode_get_child(
+				purple_xmlnode_get_child(*purple, "blist"), "group");
+				group != NULL; group = purple_xmlnode_get_next_twin(group)) {
+			for (contact = purple_xmlnode_get_child(group, "contact");
+					contact != NULL;
+					contact = purple_xmlnode_get_next_twin(contact)) {
+				guint id = blist_xml_get_id(contact);
+
+				if (id != 0)
+					g_hash_table_insert(replay.contacts,
+							GUINT_TO_POINTER(id), contact);
+			}
+		}
+	}
+
+	pos = contents;
+	end = contents + length;
+	while (pos < end) {
+		PurpleXmlNode *record;
+		gchar *data;
+		guint64 len;
+
+		len = g_ascii_strtoull(pos, &data, 10);
+		/* A partial record is what a crash while writing leaves. */
+		if (data == pos || *data != '\n' || len > (guint64)(end - data - 1)) {
+			purple_debug_warning("buddylist", "Ignoring the end of %s\n", path);
+			break;
+		}
+		data++;
+
+		record = purple_xmlnode_from_str(data, len);
+		if (record != NULL) {
+			if (*purple == NULL) {
+				*purple = purple_xmlnode_new("purple");
+				purple_xmlnode_set_attrib(*purple, "version", "1.0");
+			}
+			blist_xml_replay_record(&replay, *purple, record);
+			purple_xmlnode_free(record);
+			count++;
+		}
+
+		pos = data + len + 1;
+	}
+
+	g_hash_table_destroy(replay.contacts);
+	g_free(contents);
+	g_free(path);
+
+	return count;
+}
+
 static void
 parse_setting(PurpleBlistNode *node, PurpleXmlNode *setting)
 {
@@ -535,11 +1678,23 @@ parse_contact(PurpleGroup *group, PurpleXmlNode *cnode)
 {
 	PurpleContact *contact = purple_contact_new();
 	PurpleXmlNode *x;
-	const char *alias;
+	const char *alias, *id;
 
 	purple_blist_add_contact(contact, group,
 			_purple_blist_get_last_child((PurpleBlistNode*)group));
 
+	/* Journal records refer to contacts by the ID they were saved with. */
+	if ((id = purple_xmlnode_get_attrib(cnode, "id")) != NULL) {
+		guint value = (guint)strtoul(id, NULL, 10);
+
+		if (value != 0 && value < G_MAXUINT) {
+			g_hash_table_insert(contact_ids, contact, GUINT_TO_POINTER(value));
+			next_contact_id = MAX(next_contact_id, value + 1);
+		}
+	}
+	if (!g_hash_table_contains(contact_ids, contact))
+		contacts_without_id = TRUE;
+
 	if ((alias = purple_xmlnode_get_attrib(cnode, "alias"))) {
 		purple_contact_set_alias(contact, alias);
 	}
@@ -632,10 +1787,22 @@ static void
 load_blist(void)
 {
 	PurpleXmlNode *purple, *blist, *privacy;
+	gboolean journaled;
 
 	blist_loaded = TRUE;
 
 	purple = purple_util_read_xml_from_file("blist.xml", _("buddy list"));
+	if (purple != NULL) {
+		gchar *path = g_build_filename(purple_user_dir(), "blist.xml", NULL);
+		GStatBuf st;
+
+		if (g_stat(path, &st) == 0)
+			g_atomic_int_set(&blist_snapshot_size, st.st_size);
+		g_free(path);
+	}
+
+	/* Fold the journal back into blist.xml on the next save. */
+	journaled = (blist_replay_journal(&purple) > 0);
 
 	if (purple == NULL)
 		return;
@@ -701,6 +1868,13 @@ load_blist(void)
 
 	purple_xmlnode_free(purple);
 
+	/* Adding the nodes above marked them as changed. */
+	blist_saved(TRUE);
+	if (journaled || contacts_without_id) {
+		snapshot_needed = TRUE;
+		_purple_blist_schedule_save();
+	}
+
 	/* This tells the buddy icon code to do its thing. */
 	_purple_buddy_icons_blist_loaded_cb();
 }
@@ -721,6 +1895,9 @@ purple_blist_boot(void)
 	buddies_cache = g_hash_table_new_full(g_direct_hash, g_direct_equal,
 					 NULL, (GDestroyNotify)g_hash_table_destroy);
 
+	buddies_names = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+					 NULL, (GDestroyNotify)g_hash_table_destroy);
+
 	groups_cache = g_hash_table_new_full((GHashFunc)g_str_hash,
 					 (GEqualFunc)g_str_equal,
 					 (GDestroyNotify)g_free, NULL);
@@ -820,9 +1997,13 @@ void purple_blist_update_buddies_cache(PurpleBuddy *buddy, const char *new_name)
 	account_buddies = g_hash_table_lookup(buddies_cache, account);
 	g_hash_table_remove(account_buddies, hb);
 
+	purple_blist_buddies_names_remove(account, hb->name, buddy);
+
 	hb->name = g_strdup(purple_normalize(account, new_name));
 	g_hash_table_replace(priv->buddies, hb, buddy);
 
+	purple_blist_buddies_names_add(account, hb->name, buddy);
+
 	hb2 = g_new(struct _purple_hbuddy, 1);
 	hb2->name = g_strdup(hb->name);
 	hb2->account = account;
@@ -872,6 +2053,7 @@ void purple_blist_add_chat(PurpleChat *chat, PurpleGroup *group, PurpleBlistNode
 		/* This chat was already in the list and is
 		 * being moved.
 		 */
+		purple_blist_mark_node(cnode->parent);
 		group_counter = PURPLE_COUNTING_NODE(cnode->parent);
 		purple_counting_node_change_total_size(group_counter, -1);
 		if (purple_account_is_connected(purple_chat_get_account(chat))) {
@@ -995,6 +2177,7 @@ void purple_blist_add_buddy(PurpleBuddy *buddy, PurpleContact *contact, PurpleGr
 		/* the group totalsize will be taken care of by remove_contact below */
 
 		if (bnode->parent->parent != (PurpleBlistNode*)g) {
+			purple_blist_mark_node(bnode->parent);
 			purple_signal_emit(purple_blist_get_handle(), "buddy-removed-from-group", buddy);
 			purple_serv_move_buddy(buddy, (PurpleGroup *)bnode->parent->parent, g);
 		}
@@ -1078,6 +2261,8 @@ void purple_blist_add_buddy(PurpleBuddy *buddy, PurpleContact *contact, PurpleGr
 
 	g_hash_table_replace(account_buddies, hb2, buddy);
 
+	purple_blist_buddies_names_add(account, hb->name, buddy);
+
 	purple_contact_invalidate_priority_buddy(purple_buddy_get_contact(buddy));
 
 	if (ops) {
@@ -1117,6 +2302,7 @@ void purple_blist_add_contact(PurpleContact *contact, PurpleGroup *group, Purple
 	cnode = (PurpleBlistNode*)contact;
 
 	if (cnode->parent) {
+		purple_blist_mark_node(cnode->parent);
 		if (cnode->parent->child == cnode)
 			cnode->parent->child = cnode->next;
 		if (cnode->prev)
@@ -1213,6 +2399,7 @@ void purple_blist_add_contact(PurpleContact *contact, PurpleGroup *group, Purple
 		gnode->child = cnode;
 		cnode->parent = gnode;
 	}
+	purple_blist_mark_node(gnode);
 
 	contact_counter = PURPLE_COUNTING_NODE(contact);
 	group_counter = PURPLE_COUNTING_NODE(g);
@@ -1342,6 +2529,7 @@ void purple_blist_remove_contact(PurpleContact *contact)
 		if (node->next)
 			node->next->prev = node->prev;
 		purple_counting_node_change_total_size(PURPLE_COUNTING_NODE(group), -1);
+		purple_blist_mark_node(gnode);
 
 		/* Update the UI */
 		if (ops && ops->remove)
@@ -1349,6 +2537,8 @@ void purple_blist_remove_contact(PurpleContact *contact)
 
 		if (ops && ops->remove_node)
 			ops->remove_node(node);
+		g_hash_table_remove(dirty_contacts, contact);
+		g_hash_table_remove(contact_ids, contact);
 
 		purple_signal_emit(purple_blist_get_handle(), "blist-node-removed",
 				PURPLE_BLIST_NODE(contact));
@@ -1421,6 +2611,10 @@ void purple_blist_remove_buddy(PurpleBuddy *buddy)
 	account_buddies = g_hash_table_lookup(buddies_cache, account);
 	g_hash_table_remove(account_buddies, &hb);
 
+	purple_blist_buddies_names_remove(account, hb.name, buddy);
+
+	presence_batch_remove_buddy(buddy);
+
 	/* Update the UI */
 	if (ops && ops->remove)
 		ops->remove(purplebuddylist, node);
@@ -1524,6 +2718,7 @@ void purple_blist_remove_group(PurpleGroup *group)
 
 	if (ops && ops->remove_node)
 		ops->remove_node(node);
+	g_hash_table_remove(dirty_groups, group);
 
 	purple_signal_emit(purple_blist_get_handle(), "blist-node-removed",
 			PURPLE_BLIST_NODE(group));
@@ -1546,6 +2741,8 @@ PurpleBuddy *purple_blist_find_buddy(PurpleAccount *account, const char *name)
 	PurpleBuddy *buddy;
 	struct _purple_hbuddy hb;
 	PurpleBlistNode *group;
+	GHashTable *names;
+	GSList *buddies;
 
 	g_return_val_if_fail(PURPLE_IS_BUDDY_LIST(purplebuddylist), NULL);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
@@ -1554,6 +2751,13 @@ PurpleBuddy *purple_blist_find_buddy(PurpleAccount *account, const char *name)
 	hb.account = account;
 	hb.name = (gchar *)purple_normalize(account, name);
 
+	/* Only buddies in more than one group need the group order */
+	if ((names = g_hash_table_lookup(buddies_names, account)) == NULL)
+		return NULL;
+	buddies = g_hash_table_lookup(names, hb.name);
+	if (buddies == NULL || buddies->next == NULL)
+		return buddies ? buddies->data : NULL;
+
 	for (group = purplebuddylist->root; group; group = group->next) {
 		if (!group->child)
 			continue;
@@ -1595,28 +2799,16 @@ static void find_acct_buddies(gpointer key, gpointer value, gpointer data)
 
 GSList *purple_blist_find_buddies(PurpleAccount *account, const char *name)
 {
-	PurpleBuddy *buddy;
-	PurpleBlistNode *node;
 	GSList *ret = NULL;
 
 	g_return_val_if_fail(PURPLE_IS_BUDDY_LIST(purplebuddylist), NULL);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
 
 	if ((name != NULL) && (*name != '\0')) {
-		struct _purple_hbuddy hb;
-
-		hb.name = (gchar *)purple_normalize(account, name);
-		hb.account = account;
-
-		for (node = purplebuddylist->root; node != NULL; node = node->next) {
-			if (!node->child)
-				continue;
-
-			hb.group = node;
-			if ((buddy = g_hash_table_lookup(PURPLE_BUDDY_LIST_GET_PRIVATE(purplebuddylist)->buddies,
-					&hb)) != NULL)
-				ret = g_slist_prepend(ret, buddy);
-		}
+		GHashTable *names = g_hash_table_lookup(buddies_names, account);
+		if (names != NULL)
+			ret = g_slist_copy(g_hash_table_lookup(names,
+					purple_normalize(account, name)));
 	} else {
 		GSList *list = NULL;
 		GHashTable *buddies = g_hash_table_lookup(buddies_cache, account);
@@ -1929,6 +3121,12 @@ _purple_blist_get_localized_default_group_name(void)
 	return localized_default_group_name;
 }
 
+gulong
+_purple_blist_get_buddy_status_changed_signal(void)
+{
+	return buddy_status_changed_signal;
+}
+
 void *
 purple_blist_get_handle(void)
 {
@@ -1942,10 +3140,15 @@ purple_blist_init(void)
 {
 	void *handle = purple_blist_get_handle();
 
-	purple_signal_register(handle, "buddy-status-changed",
+	buddy_status_changed_signal =
+		purple_signal_register(handle, "buddy-status-changed",
 	                     purple_marshal_VOID__POINTER_POINTER_POINTER,
-	                     G_TYPE_NONE, 3, PURPLE_TYPE_BUDDY, PURPLE_TYPE_STATUS, 
+	                     G_TYPE_NONE, 3, PURPLE_TYPE_BUDDY, PURPLE_TYPE_STATUS,
 	                     PURPLE_TYPE_STATUS);
+	buddies_status_changed_signal =
+		purple_signal_register(handle, "buddies-status-changed",
+	                     purple_marshal_VOID__POINTER, G_TYPE_NONE, 1,
+	                     G_TYPE_POINTER); /* (GList *) */
 	purple_signal_register(handle, "buddy-privacy-changed",
 	                     purple_marshal_VOID__POINTER, G_TYPE_NONE,
 	                     1, PURPLE_TYPE_BUDDY);
@@ -2007,6 +3210,15 @@ purple_blist_init(void)
 			handle,
 			PURPLE_CALLBACK(purple_blist_buddies_cache_remove_account),
 			NULL);
+
+	dirty_groups = g_hash_table_new(g_direct_hash, g_direct_equal);
+	dirty_contacts = g_hash_table_new(g_direct_hash, g_direct_equal);
+	contact_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+	dirty_accounts = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, NULL);
+	saved_usernames = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			NULL, g_free);
+	blist_writer_start();
 }
 
 static void
@@ -2041,14 +3253,26 @@ purple_blist_uninit(void)
 	PurpleBlistNode *node, *next_node;
 
 	/* This happens if we quit before purple_set_blist is called. */
-	if (purplebuddylist == NULL)
+	if (purplebuddylist == NULL) {
+		blist_writer_stop();
 		return;
+	}
+
+	/* Deliver the batches left open, however deeply they're nested. */
+	if (presence_batch_timeout != 0) {
+		g_source_remove(presence_batch_timeout);
+		presence_batch_timeout = 0;
+	}
+	if (presence_batch_depth > 0) {
+		presence_batch_depth = 0;
+		presence_batch_flush();
+	}
 
 	if (save_timer != 0) {
 		g_source_remove(save_timer);
-		save_timer = 0;
-		purple_blist_sync();
+		save_cb(NULL);
 	}
+	blist_writer_stop();
 
 	purple_debug(PURPLE_DEBUG_INFO, "buddylist", "Destroying\n");
 
@@ -2063,10 +3287,17 @@ purple_blist_uninit(void)
 	}
 	purplebuddylist->root = NULL;
 
+	if (presence_batch_buddies != NULL) {
+		g_hash_table_destroy(presence_batch_buddies);
+		presence_batch_buddies = NULL;
+	}
+
 	g_hash_table_destroy(buddies_cache);
+	g_hash_table_destroy(buddies_names);
 	g_hash_table_destroy(groups_cache);
 
 	buddies_cache = NULL;
+	buddies_names = NULL;
 	groups_cache = NULL;
 
 	g_object_unref(purplebuddylist);
@@ -2075,6 +3306,19 @@ purple_blist_uninit(void)
 	g_free(localized_default_group_name);
 	localized_default_group_name = NULL;
 
+	g_hash_table_destroy(dirty_groups);
+	g_hash_table_destroy(dirty_contacts);
+	g_hash_table_destroy(contact_ids);
+	g_hash_table_destroy(dirty_accounts);
+	g_hash_table_destroy(saved_usernames);
+	dirty_groups = dirty_contacts = contact_ids = NULL;
+	dirty_accounts = saved_usernames = NULL;
+	next_contact_id = 1;
+	contacts_without_id = FALSE;
+	g_free(saved_group_order);
+	saved_group_order = NULL;
+	snapshot_needed = TRUE;
+
 	purple_signals_disconnect_by_handle(purple_blist_get_handle());
 	purple_signals_unregister_by_instance(purple_blist_get_handle());
 }
@@ -435,6 +435,45 @@ void purple_blist_add_account(PurpleAccount *account);
  */
 void purple_blist_remove_account(PurpleAccount *account);
 
+/**
+ * purple_blist_presence_batch_begin:
+ *
+ * Starts a batch of presence updates.  Until the batch is committed, status
+ * and idle changes of buddies still take effect right away, but the
+ * "buddy-status-changed" and "buddy-idle-changed" signals, the UI updates and
+ * the system log lines they cause are held back.  Batches can be nested.
+ *
+ * Protocols which get many presence updates at once, such as at login,
+ * should wrap them in a batch.  Updates made through
+ * purple_protocol_got_user_status() and friends outside of a batch are
+ * batched until the next main loop iteration.
+ */
+void purple_blist_presence_batch_begin(void);
+
+/**
+ * purple_blist_presence_batch_commit:
+ *
+ * Ends a batch of presence updates started with
+ * purple_blist_presence_batch_begin().  When the outermost batch ends, the
+ * held back system log lines are written, and every buddy whose presence
+ * changed gets at most one "buddy-status-changed" and one
+ * "buddy-idle-changed", from its first to its last state, and one UI update.
+ * Then "buddies-status-changed" is emitted for the whole batch.
+ */
+void purple_blist_presence_batch_commit(void);
+
+/**
+ * purple_blist_presence_batch_is_committing:
+ *
+ * Checks whether a committed batch of presence updates is being delivered.
+ * A UI can use it to put off the updates of buddies it's asked for until
+ * "buddies-status-changed" is emitted, and then refresh the list once.
+ *
+ * Returns: %TRUE while the per-buddy signals and UI updates of a batch are
+ *          being delivered.
+ */
+gboolean purple_blist_presence_batch_is_committing(void);
+
 /****************************************************************************************/
 /* Buddy list file management API                                                       */
 /****************************************************************************************/
@@ -61,6 +61,8 @@ struct _PurpleConnectionPrivate
 
 	GSList *active_chats;         /* A list of active chats
 	                                  (#PurpleChatConversation structs). */
+	GHashTable *active_chat_set;  /* The same chats, to look them up
+	                                  when every message is written.   */
 
 	/* TODO Remove this and use protocol-specific subclasses. */
 	void *proto_data;             /* Protocol-specific data.           */
@@ -230,6 +232,9 @@ purple_connection_set_state(PurpleConnection *gc, PurpleConnectionState state)
 	else if (priv->state == PURPLE_CONNECTION_DISCONNECTED) {
 		PurpleAccount *account = purple_connection_get_account(gc);
 
+		/* Presence changes come before the sign off in the log. */
+		_purple_blist_presence_batch_write_log(account);
+
 		if (purple_prefs_get_bool("/purple/logging/log_system"))
 		{
 			PurpleLog *log = purple_account_get_log(account, FALSE);
@@ -390,6 +395,12 @@ _purple_connection_add_active_chat(PurpleConnection *gc, PurpleChatConversation
 
 	g_return_if_fail(priv != NULL);
 
+	if (priv->active_chat_set == NULL)
+		priv->active_chat_set = g_hash_table_new(g_direct_hash, g_direct_equal);
+	else if (g_hash_table_contains(priv->active_chat_set, chat))
+		return;
+
+	g_hash_table_add(priv->active_chat_set, chat);
 	priv->active_chats = g_slist_append(priv->active_chats, chat);
 }
 
@@ -400,9 +411,25 @@ _purple_connection_remove_active_chat(PurpleConnection *gc, PurpleChatConversati
 
 	g_return_if_fail(priv != NULL);
 
+	if (priv->active_chat_set == NULL ||
+			!g_hash_table_remove(priv->active_chat_set, chat))
+		return;
+
 	priv->active_chats = g_slist_remove(priv->active_chats, chat);
 }
 
+gboolean
+_purple_connection_has_active_chat(const PurpleConnection *gc,
+		const PurpleChatConversation *chat)
+{
+	PurpleConnectionPrivate *priv = PURPLE_CONNECTION_GET_PRIVATE(gc);
+
+	g_return_val_if_fail(priv != NULL, FALSE);
+
+	return priv->active_chat_set != NULL &&
+			g_hash_table_contains(priv->active_chat_set, chat);
+}
+
 gboolean
 _purple_connection_wants_to_die(const PurpleConnection *gc)
 {
@@ -832,9 +859,13 @@ purple_connection_finalize(GObject *object)
 		PurpleChatConversation *b = priv->active_chats->data;
 
 		priv->active_chats = g_slist_remove(priv->active_chats, b);
+		g_hash_table_remove(priv->active_chat_set, b);
 		purple_chat_conversation_leave(b);
 	}
 
+	if (priv->active_chat_set != NULL)
+		g_hash_table_destroy(priv->active_chat_set);
+
 	update_keepalive(gc, FALSE);
 
 	purple_protocol_class_close(priv->protocol, gc);
@@ -56,7 +56,8 @@ struct _PurpleConversationPrivate
 	PurpleConversationUiOps *ui_ops;  /* UI-specific operations.           */
 
 	PurpleConnectionFlags features;   /* The supported features            */
-	GList *message_history; /* Message history, as a GList of PurpleMessages */
+	GQueue message_history;           /* PurpleMessages, newest first      */
+	gsize history_size;               /* Bytes of text in message_history  */
 
 	PurpleE2eeState *e2ee_state;      /* End-to-end encryption state.      */
 
@@ -210,16 +211,46 @@ open_log(PurpleConversation *conv)
 
 /* Functions that deal with PurpleMessage history */
 
+static gsize
+message_history_size(PurpleMessage *msg)
+{
+	const gchar *author = purple_message_get_author(msg);
+	const gchar *alias = purple_message_get_author_alias(msg);
+	const gchar *contents = purple_message_get_contents(msg);
+
+	return (author ? strlen(author) : 0) +
+		(alias != author && alias ? strlen(alias) : 0) +
+		(contents ? strlen(contents) : 0);
+}
+
+/* Keeps the newest message, and as many of the ones before it as the
+ * /purple/conversations/history prefs allow. The dropped ones are still in
+ * the conversation's logs, if it's logged. */
 static void
 add_message_to_history(PurpleConversation *conv, PurpleMessage *msg)
 {
 	PurpleConversationPrivate *priv = PURPLE_CONVERSATION_GET_PRIVATE(conv);
+	gint max_messages, max_size;
 
 	g_return_if_fail(priv != NULL);
 	g_return_if_fail(msg != NULL);
 
 	g_object_ref(msg);
-	priv->message_history = g_list_prepend(priv->message_history, msg);
+	g_queue_push_head(&priv->message_history, msg);
+	priv->history_size += message_history_size(msg);
+
+	max_messages = purple_prefs_get_int("/purple/conversations/history/max_messages");
+	max_size = purple_prefs_get_int("/purple/conversations/history/max_size");
+
+	while (priv->message_history.length > 1 &&
+			((max_messages > 0 && priv->message_history.length > (guint)max_messages) ||
+			(max_size > 0 && priv->history_size > (gsize)max_size * 1024))) {
+		PurpleMessage *old = g_queue_pop_tail(&priv->message_history);
+
+		/* The contents may have changed since the message was added */
+		priv->history_size -= MIN(priv->history_size, message_history_size(old));
+		g_object_unref(old);
+	}
 }
 
 /**************************************************************************
@@ -541,6 +572,7 @@ _purple_conversation_write_common(PurpleConversation *conv, PurpleMessage *pmsg)
 	PurpleConversationUiOps *ops;
 	PurpleBuddy *b;
 	int plugin_return;
+	gulong writing_signal, wrote_signal;
 	PurpleConversationPrivate *priv = PURPLE_CONVERSATION_GET_PRIVATE(conv);
 	/* int logging_font_options = 0; */
 
@@ -554,18 +586,18 @@ _purple_conversation_write_common(PurpleConversation *conv, PurpleMessage *pmsg)
 	if (account != NULL)
 		gc = purple_account_get_connection(account);
 
-	if (PURPLE_IS_CHAT_CONVERSATION(conv) &&
-		(gc != NULL && !g_slist_find(purple_connection_get_active_chats(gc), conv)))
+	if (PURPLE_IS_CHAT_CONVERSATION(conv) && (gc != NULL &&
+		!_purple_connection_has_active_chat(gc, PURPLE_CHAT_CONVERSATION(conv))))
 		return;
 
-	if (PURPLE_IS_IM_CONVERSATION(conv) &&
-		!g_list_find(purple_conversations_get_all(), conv))
+	if (PURPLE_IS_IM_CONVERSATION(conv) && !_purple_conversations_contains(conv))
 		return;
 
-	plugin_return = GPOINTER_TO_INT(purple_signal_emit_return_1(
-		purple_conversations_get_handle(),
-		(PURPLE_IS_IM_CONVERSATION(conv) ? "writing-im-msg" : "writing-chat-msg"),
-		conv, pmsg));
+	_purple_conversations_get_write_signals(conv, &writing_signal,
+		&wrote_signal);
+
+	plugin_return = GPOINTER_TO_INT(purple_signal_emit_return_1_by_id(
+		writing_signal, conv, pmsg));
 
 	if (purple_message_is_empty(pmsg))
 		return;
@@ -640,9 +672,7 @@ _purple_conversation_write_common(PurpleConversation *conv, PurpleMessage *pmsg)
 
 	add_message_to_history(conv, pmsg);
 
-	purple_signal_emit(purple_conversations_get_handle(),
-		(PURPLE_IS_IM_CONVERSATION(conv) ? "wrote-im-msg" : "wrote-chat-msg"),
-		conv, pmsg);
+	purple_signal_emit_by_id(wrote_signal, conv, pmsg);
 }
 
 void
@@ -781,14 +811,13 @@ purple_conversation_get_extended_menu(PurpleConversation *conv)
 
 void purple_conversation_clear_message_history(PurpleConversation *conv)
 {
-	GList *list;
 	PurpleConversationPrivate *priv = PURPLE_CONVERSATION_GET_PRIVATE(conv);
 
 	g_return_if_fail(priv != NULL);
 
-	list = priv->message_history;
-	g_list_free_full(list, g_object_unref);
-	priv->message_history = NULL;
+	g_list_free_full(priv->message_history.head, g_object_unref);
+	g_queue_init(&priv->message_history);
+	priv->history_size = 0;
 
 	purple_signal_emit(purple_conversations_get_handle(),
 			"cleared-message-history", conv);
@@ -800,7 +829,7 @@ GList *purple_conversation_get_message_history(PurpleConversation *conv)
 
 	g_return_val_if_fail(priv != NULL, NULL);
 
-	return priv->message_history;
+	return priv->message_history.head;
 }
 
 void purple_conversation_set_ui_data(PurpleConversation *conv, gpointer ui_data)
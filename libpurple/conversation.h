@@ -557,7 +557,10 @@ void purple_conversation_update(PurpleConversation *conv, PurpleConversationUpda
  * purple_conversation_get_message_history:
  * @conv:   The conversation
  *
- * Retrieve the message history of a conversation.
+ * Retrieve the message history of a conversation.  Only the newest messages
+ * are kept, as many as the /purple/conversations/history/max_messages pref
+ * allows (0 for no limit) and as long as they take less than
+ * /purple/conversations/history/max_size KiB.
  *
  * Returns: (element-type PurpleMessage) (transfer none):
  *          A GList of PurpleMessage's. You must not modify the
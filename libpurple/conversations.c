@@ -33,6 +33,22 @@ static PurpleConversationUiOps *default_ops = NULL;
  */
 static GHashTable *conversation_cache = NULL;
 
+/* The conversations in the conversations list, to check a conversation is
+ * still there without walking the list. */
+static GHashTable *conversation_set = NULL;
+
+/* IDs of the signals emitted for every written message. */
+static gulong writing_im_msg_signal = 0;
+static gulong wrote_im_msg_signal = 0;
+static gulong writing_chat_msg_signal = 0;
+static gulong wrote_chat_msg_signal = 0;
+
+/* IDs of the signals emitted for every user joining a chat. */
+static gulong chat_user_joining_signal = 0;
+static gulong chat_users_joining_signal = 0;
+static gulong chat_user_joined_signal = 0;
+static gulong chat_users_joined_signal = 0;
+
 struct _purple_hconv {
 	gboolean im;
 	char *name;
@@ -68,9 +84,10 @@ purple_conversations_add(PurpleConversation *conv)
 
 	g_return_if_fail(conv != NULL);
 
-	if (g_list_find(conversations, conv) != NULL)
+	if (g_hash_table_contains(conversation_set, conv))
 		return;
 
+	g_hash_table_add(conversation_set, conv);
 	conversations = g_list_prepend(conversations, conv);
 
 	if (PURPLE_IS_IM_CONVERSATION(conv))
@@ -97,6 +114,9 @@ purple_conversations_remove(PurpleConversation *conv)
 
 	g_return_if_fail(conv != NULL);
 
+	if (!g_hash_table_remove(conversation_set, conv))
+		return;
+
 	conversations = g_list_remove(conversations, conv);
 
 	if (PURPLE_IS_IM_CONVERSATION(conv))
@@ -142,6 +162,35 @@ _purple_conversations_update_cache(PurpleConversation *conv, const char *name,
 	g_hash_table_insert(conversation_cache, hc, conv);
 }
 
+void
+_purple_conversations_get_write_signals(PurpleConversation *conv,
+		gulong *writing, gulong *wrote)
+{
+	if (PURPLE_IS_IM_CONVERSATION(conv)) {
+		*writing = writing_im_msg_signal;
+		*wrote = wrote_im_msg_signal;
+	} else {
+		*writing = writing_chat_msg_signal;
+		*wrote = wrote_chat_msg_signal;
+	}
+}
+
+void
+_purple_conversations_get_join_signals(gulong *joining_all, gulong *joining,
+		gulong *joined, gulong *joined_all)
+{
+	*joining_all = chat_users_joining_signal;
+	*joining = chat_user_joining_signal;
+	*joined = chat_user_joined_signal;
+	*joined_all = chat_users_joined_signal;
+}
+
+gboolean
+_purple_conversations_contains(const PurpleConversation *conv)
+{
+	return g_hash_table_contains(conversation_set, conv);
+}
+
 GList *
 purple_conversations_get_all(void)
 {
@@ -263,6 +312,7 @@ purple_conversations_init(void)
 	conversation_cache = g_hash_table_new_full((GHashFunc)_purple_conversations_hconv_hash,
 						(GEqualFunc)_purple_conversations_hconv_equal,
 						(GDestroyNotify)_purple_conversations_hconv_free_key, NULL);
+	conversation_set = g_hash_table_new(g_direct_hash, g_direct_equal);
 
 	/**********************************************************************
 	 * Register preferences
@@ -279,15 +329,20 @@ purple_conversations_init(void)
 	purple_prefs_add_none("/purple/conversations/im");
 	purple_prefs_add_bool("/purple/conversations/im/send_typing", TRUE);
 
+	/* Conversations -> Message history */
+	purple_prefs_add_none("/purple/conversations/history");
+	purple_prefs_add_int("/purple/conversations/history/max_messages", 1000);
+	purple_prefs_add_int("/purple/conversations/history/max_size", 1024);
+
 
 	/**********************************************************************
 	 * Register signals
 	 **********************************************************************/
-	purple_signal_register(handle, "writing-im-msg",
+	writing_im_msg_signal = purple_signal_register(handle, "writing-im-msg",
 		purple_marshal_BOOLEAN__POINTER_POINTER, G_TYPE_BOOLEAN, 2,
 		PURPLE_TYPE_IM_CONVERSATION, PURPLE_TYPE_MESSAGE);
 
-	purple_signal_register(handle, "wrote-im-msg",
+	wrote_im_msg_signal = purple_signal_register(handle, "wrote-im-msg",
 		purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE, 2,
 		PURPLE_TYPE_IM_CONVERSATION, PURPLE_TYPE_MESSAGE);
 
@@ -327,11 +382,11 @@ purple_conversations_init(void)
 						 G_TYPE_NONE, 5, PURPLE_TYPE_ACCOUNT, G_TYPE_STRING,
 						 G_TYPE_STRING, G_TYPE_UINT, G_TYPE_UINT);
 
-	purple_signal_register(handle, "writing-chat-msg",
+	writing_chat_msg_signal = purple_signal_register(handle, "writing-chat-msg",
 		purple_marshal_BOOLEAN__POINTER_POINTER, G_TYPE_BOOLEAN, 2,
 		PURPLE_TYPE_IM_CONVERSATION, PURPLE_TYPE_MESSAGE);
 
-	purple_signal_register(handle, "wrote-chat-msg",
+	wrote_chat_msg_signal = purple_signal_register(handle, "wrote-chat-msg",
 		purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE, 2,
 		PURPLE_TYPE_IM_CONVERSATION, PURPLE_TYPE_MESSAGE);
 
@@ -380,16 +435,29 @@ purple_conversations_init(void)
 						 purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE, 2,
 						 PURPLE_TYPE_ACCOUNT, G_TYPE_STRING);
 
-	purple_signal_register(handle, "chat-user-joining",
+	chat_user_joining_signal = purple_signal_register(handle, "chat-user-joining",
 						 purple_marshal_BOOLEAN__POINTER_POINTER_UINT,
 						 G_TYPE_BOOLEAN, 3, PURPLE_TYPE_CHAT_CONVERSATION,
 						 G_TYPE_STRING, G_TYPE_UINT);
 
-	purple_signal_register(handle, "chat-user-joined",
+	chat_users_joining_signal = purple_signal_register(handle, "chat-users-joining",
+						 purple_marshal_VOID__POINTER_POINTER_POINTER_POINTER,
+						 G_TYPE_NONE, 4, PURPLE_TYPE_CHAT_CONVERSATION,
+						 G_TYPE_POINTER, /* (GList *) */
+						 G_TYPE_POINTER, /* (GList *) */
+						 G_TYPE_POINTER); /* (GHashTable *) */
+
+	chat_user_joined_signal = purple_signal_register(handle, "chat-user-joined",
 						 purple_marshal_VOID__POINTER_POINTER_UINT_UINT,
 						 G_TYPE_NONE, 4, PURPLE_TYPE_CHAT_CONVERSATION,
 						 G_TYPE_STRING, G_TYPE_UINT, G_TYPE_BOOLEAN);
 
+	chat_users_joined_signal = purple_signal_register(handle, "chat-users-joined",
+						 purple_marshal_VOID__POINTER_POINTER_UINT,
+						 G_TYPE_NONE, 3, PURPLE_TYPE_CHAT_CONVERSATION,
+						 G_TYPE_POINTER, /* (GList *) */
+						 G_TYPE_BOOLEAN);
+
 	purple_signal_register(handle, "chat-user-flags",
 						 purple_marshal_VOID__POINTER_UINT_UINT, G_TYPE_NONE, 3,
 						 PURPLE_TYPE_CHAT_USER, G_TYPE_UINT, G_TYPE_UINT);
@@ -464,5 +532,6 @@ purple_conversations_uninit(void)
 		g_object_unref(G_OBJECT(conversations->data));
 
 	g_hash_table_destroy(conversation_cache);
+	g_hash_table_destroy(conversation_set);
 	purple_signals_unregister_by_instance(purple_conversations_get_handle());
 }
@@ -854,6 +854,10 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users, G
 	PurpleProtocol *protocol;
 	GList *ul, *fl;
 	GList *cbuddies = NULL;
+	GHashTable *quiet_users = NULL;
+	gulong joining_all_signal, joining_signal, joined_signal, joined_all_signal;
+	gboolean unique_names, watch_joining, watch_joined, watch_joining_all;
+	const char *my_alias = NULL;
 
 	priv = PURPLE_CHAT_CONVERSATION_GET_PRIVATE(chat);
 
@@ -869,6 +873,33 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users, G
 	protocol = purple_connection_get_protocol(gc);
 	g_return_if_fail(PURPLE_IS_PROTOCOL(protocol));
 
+	/* Rooms can have thousands of users, so do what doesn't depend on the
+	 * user only once, and skip the signals nobody listens to. Emitting a
+	 * signal also broadcasts it over D-Bus, where its listeners aren't
+	 * handlers, so nothing is skipped then. */
+	_purple_conversations_get_join_signals(&joining_all_signal,
+			&joining_signal, &joined_signal, &joined_all_signal);
+#ifdef HAVE_DBUS
+	watch_joining = watch_joined = watch_joining_all = TRUE;
+#else
+	watch_joining = purple_signal_has_handlers(joining_signal);
+	watch_joined = purple_signal_has_handlers(joined_signal);
+	watch_joining_all = purple_signal_has_handlers(joining_all_signal);
+#endif
+
+	if (new_arrivals && watch_joining_all) {
+		quiet_users = g_hash_table_new(g_str_hash, g_str_equal);
+		purple_signal_emit_by_id(joining_all_signal, chat, users, flags,
+				quiet_users);
+	}
+
+	unique_names = (purple_protocol_get_options(protocol) & OPT_PROTO_UNIQUE_CHATNAME);
+	if (!unique_names) {
+		my_alias = purple_account_get_private_alias(account);
+		if (my_alias == NULL)
+			my_alias = purple_connection_get_display_name(gc);
+	}
+
 	ul = users;
 	fl = flags;
 	while ((ul != NULL) && (fl != NULL)) {
@@ -878,26 +909,21 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users, G
 		PurpleChatUserFlags flag = GPOINTER_TO_INT(fl->data);
 		const char *extra_msg = (extra_msgs ? extra_msgs->data : NULL);
 
-		if(!(purple_protocol_get_options(protocol) & OPT_PROTO_UNIQUE_CHATNAME)) {
+		if (!unique_names) {
 			if (purple_strequal(priv->nick, purple_normalize(account, user))) {
-				const char *alias2 = purple_account_get_private_alias(account);
-				if (alias2 != NULL)
-					alias = alias2;
-				else
-				{
-					const char *display_name = purple_connection_get_display_name(gc);
-					if (display_name != NULL)
-						alias = display_name;
-				}
+				if (my_alias != NULL)
+					alias = my_alias;
 			} else {
 				PurpleBuddy *buddy;
-				if ((buddy = purple_blist_find_buddy(purple_connection_get_account(gc), user)) != NULL)
+				if ((buddy = purple_blist_find_buddy(account, user)) != NULL)
 					alias = purple_buddy_get_contact_alias(buddy);
 			}
 		}
 
-		quiet = GPOINTER_TO_INT(purple_signal_emit_return_1(purple_conversations_get_handle(),
-						 "chat-user-joining", chat, user, flag)) ||
+		quiet = (watch_joining && GPOINTER_TO_INT(purple_signal_emit_return_1_by_id(
+						 joining_signal, chat, user, flag))) ||
+				(quiet_users != NULL &&
+				 g_hash_table_contains(quiet_users, user)) ||
 				purple_chat_conversation_is_ignored_user(chat, user);
 
 		chatuser = purple_chat_user_new(chat, user, alias, flag);
@@ -927,8 +953,8 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users, G
 			g_free(tmp);
 		}
 
-		purple_signal_emit(purple_conversations_get_handle(),
-						 "chat-user-joined", chat, user, flag, new_arrivals);
+		if (watch_joined)
+			purple_signal_emit_by_id(joined_signal, chat, user, flag, new_arrivals);
 		ul = ul->next;
 		fl = fl->next;
 		if (extra_msgs != NULL)
@@ -940,7 +966,11 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users, G
 	if (ops != NULL && ops->chat_add_users != NULL)
 		ops->chat_add_users(chat, cbuddies, new_arrivals);
 
+	purple_signal_emit_by_id(joined_all_signal, chat, cbuddies, new_arrivals);
+
 	g_list_free(cbuddies);
+	if (quiet_users != NULL)
+		g_hash_table_destroy(quiet_users);
 }
 
 void
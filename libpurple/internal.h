@@ -217,6 +217,75 @@ PurpleXmlNode *_purple_account_to_xmlnode(PurpleAccount *account);
  */
 PurpleBlistNode *_purple_blist_get_last_child(PurpleBlistNode *node);
 
+/**
+ * _purple_blist_get_buddy_status_changed_signal:
+ *
+ * Returns the ID of the "buddy-status-changed" signal, which is emitted for
+ * every presence update.
+ *
+ * Returns: The signal ID.
+ */
+gulong _purple_blist_get_buddy_status_changed_signal(void);
+
+/**
+ * _purple_blist_presence_batch_auto:
+ *
+ * Opens a presence batch which is committed in the next main loop iteration,
+ * unless a batch is open already.
+ */
+void _purple_blist_presence_batch_auto(void);
+
+/**
+ * _purple_blist_presence_batch_add_status:
+ * @buddy:         The buddy whose status changed.
+ * @old_status:    The status before the change.
+ * @signed_on_off: Whether the buddy signed on or off, and
+ *                 "buddy-status-changed" isn't emitted for the change.
+ *
+ * Adds a status change to the open presence batch.
+ *
+ * Returns: %TRUE if the batch will emit "buddy-status-changed" and update the
+ *          UI, %FALSE if no batch is open.
+ */
+gboolean _purple_blist_presence_batch_add_status(PurpleBuddy *buddy,
+		PurpleStatus *old_status, gboolean signed_on_off);
+
+/**
+ * _purple_blist_presence_batch_add_idle:
+ * @buddy:    The buddy whose idle state changed.
+ * @old_idle: The idle state before the change.
+ *
+ * Adds an idle change to the open presence batch.
+ *
+ * Returns: %TRUE if the batch will emit "buddy-idle-changed" and update the
+ *          UI, %FALSE if no batch is open.
+ */
+gboolean _purple_blist_presence_batch_add_idle(PurpleBuddy *buddy,
+		gboolean old_idle);
+
+/**
+ * _purple_blist_presence_batch_add_log:
+ * @account: The account whose system log the line goes to.
+ * @from:    The source of the line.
+ * @time:    The time of the line.
+ * @message: The line.
+ *
+ * Holds back a system log line until the open presence batch is committed.
+ *
+ * Returns: %TRUE if the line was added, %FALSE if no batch is open.
+ */
+gboolean _purple_blist_presence_batch_add_log(PurpleAccount *account,
+		const char *from, GDateTime *time, const char *message);
+
+/**
+ * _purple_blist_presence_batch_write_log:
+ * @account: The account.
+ *
+ * Writes the system log lines of an account held back by the open presence
+ * batch, before its system log goes away.
+ */
+void _purple_blist_presence_batch_write_log(PurpleAccount *account);
+
 /* This is for the accounts code to notify the buddy icon code that
  * it's done loading.  We may want to replace this with a signal. */
 void
@@ -298,6 +367,19 @@ void _purple_connection_add_active_chat(PurpleConnection *gc,
 void _purple_connection_remove_active_chat(PurpleConnection *gc,
                                            PurpleChatConversation *chat);
 
+/**
+ * _purple_connection_has_active_chat:
+ * @gc:    The connection
+ * @chat:  The chat conversation to look for
+ *
+ * Checks, in constant time, whether a chat is in the active chats list of a
+ * connection.
+ *
+ * Returns: %TRUE if @chat is active on @gc.
+ */
+gboolean _purple_connection_has_active_chat(const PurpleConnection *gc,
+                                            const PurpleChatConversation *chat);
+
 /**
  * _purple_conversations_update_cache:
  * @conv:    The conversation.
@@ -314,6 +396,48 @@ void _purple_connection_remove_active_chat(PurpleConnection *gc,
 void _purple_conversations_update_cache(PurpleConversation *conv,
 		const char *name, PurpleAccount *account);
 
+/**
+ * _purple_conversations_contains:
+ * @conv: The conversation.
+ *
+ * Checks, in constant time, whether a conversation is in the list returned by
+ * purple_conversations_get_all().
+ *
+ * Returns: %TRUE if @conv has been added and not removed since.
+ */
+gboolean _purple_conversations_contains(const PurpleConversation *conv);
+
+/**
+ * _purple_conversations_get_write_signals:
+ * @conv:    The conversation.
+ * @writing: (out): The ID of the "writing-im-msg" or "writing-chat-msg"
+ *           signal, depending on the type of @conv.
+ * @wrote:   (out): The ID of the "wrote-im-msg" or "wrote-chat-msg" signal.
+ *
+ * Returns the IDs of the signals emitted around writing a message to a
+ * conversation.
+ *
+ * Note: This function should only be called by
+ *       _purple_conversation_write_common() in conversation.c.
+ */
+void _purple_conversations_get_write_signals(PurpleConversation *conv,
+		gulong *writing, gulong *wrote);
+
+/**
+ * _purple_conversations_get_join_signals:
+ * @joining_all: (out): The ID of the "chat-users-joining" signal.
+ * @joining:    (out): The ID of the "chat-user-joining" signal.
+ * @joined:     (out): The ID of the "chat-user-joined" signal.
+ * @joined_all: (out): The ID of the "chat-users-joined" signal.
+ *
+ * Returns the IDs of the signals emitted around users joining a chat.
+ *
+ * Note: This function should only be called by
+ *       purple_chat_conversation_add_users() in conversationtypes.c.
+ */
+void _purple_conversations_get_join_signals(gulong *joining_all,
+		gulong *joining, gulong *joined, gulong *joined_all);
+
 /**
  * _purple_statuses_get_primitive_scores:
  *
@@ -36,6 +36,11 @@ static GSList *loggers = NULL;
 static PurpleLogLogger *html_logger;
 static PurpleLogLogger *txt_logger;
 static PurpleLogLogger *old_logger;
+static PurpleLogLogger *indexed_logger;
+static GHashTable *indexed_logger_dirs = NULL;
+static GQueue indexed_logger_dirs_unused = G_QUEUE_INIT;
+static GHashTable *log_search_indexes = NULL;
+static GQueue log_search_indexes_used = G_QUEUE_INIT;
 
 struct _purple_logsize_user {
 	char *name;
@@ -46,6 +51,10 @@ static GHashTable *logsize_users_decayed = NULL;
 
 static void log_get_log_sets_common(GHashTable *sets);
 
+static void log_search_log_written(PurpleLog *log, const char *from,
+		const char *message);
+static void log_search_log_deleted(PurpleLog *log);
+
 static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
                                const char *from, GDateTime *time, const char *message);
 static void html_logger_finalize(PurpleLog *log);
@@ -69,6 +78,17 @@ static GList *txt_logger_list_syslog(PurpleAccount *account);
 static char *txt_logger_read(PurpleLog *log, PurpleLogReadFlags *flags);
 static int txt_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account);
 
+static gsize indexed_logger_write(PurpleLog *log, PurpleMessageFlags type,
+                                  const char *from, GDateTime *time, const char *message);
+static void indexed_logger_finalize(PurpleLog *log);
+static GList *indexed_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account);
+static GList *indexed_logger_list_syslog(PurpleAccount *account);
+static char *indexed_logger_read(PurpleLog *log, PurpleLogReadFlags *flags);
+static int indexed_logger_size(PurpleLog *log);
+static int indexed_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account);
+static gboolean indexed_logger_remove(PurpleLog *log);
+static gboolean indexed_logger_is_deletable(PurpleLog *log);
+
 /**************************************************************************
  * PUBLIC LOGGING FUNCTIONS ***********************************************
  **************************************************************************/
@@ -123,6 +143,7 @@ void purple_log_write(PurpleLog *log, PurpleMessageFlags type,
 	g_return_if_fail(log->logger->write);
 
 	written = (log->logger->write)(log, type, from, time, message);
+	log_search_log_written(log, from, message);
 
 	lu = g_new(struct _purple_logsize_user, 1);
 
@@ -158,7 +179,11 @@ char *purple_log_read(PurpleLog *log, PurpleLogReadFlags *flags)
 	PurpleLogReadFlags mflags;
 	g_return_val_if_fail(log && log->logger, NULL);
 	if (log->logger->read) {
-		char *ret = (log->logger->read)(log, flags ? flags : &mflags);
+		char *ret;
+
+		purple_log_flush();
+
+		ret = (log->logger->read)(log, flags ? flags : &mflags);
 		purple_str_strip_char(ret, '\r');
 		return ret;
 	}
@@ -169,8 +194,10 @@ int purple_log_get_size(PurpleLog *log)
 {
 	g_return_val_if_fail(log && log->logger, 0);
 
-	if (log->logger->size)
+	if (log->logger->size) {
+		purple_log_flush();
 		return log->logger->size(log);
+	}
 	return 0;
 }
 
@@ -207,6 +234,8 @@ int purple_log_get_total_size(PurpleLogType type, const char *name, PurpleAccoun
 		g_free(lu->name);
 		g_free(lu);
 	} else {
+		purple_log_flush();
+
 		for (n = loggers; n; n = n->next) {
 			PurpleLogLogger *logger = n->data;
 
@@ -298,8 +327,14 @@ gboolean purple_log_delete(PurpleLog *log)
 	g_return_val_if_fail(log != NULL, FALSE);
 	g_return_val_if_fail(log->logger != NULL, FALSE);
 
-	if (log->logger->remove != NULL)
-		return log->logger->remove(log);
+	if (log->logger->remove != NULL) {
+		purple_log_flush();
+		if (!log->logger->remove(log))
+			return FALSE;
+
+		log_search_log_deleted(log);
+		return TRUE;
+	}
 
 	return FALSE;
 }
@@ -603,922 +638,3117 @@ GList *purple_log_get_system_logs(PurpleAccount *account)
 }
 
 /****************************************************************************
- * LOG SUBSYSTEM ************************************************************
+ * LOG WRITER ***************************************************************
  ****************************************************************************/
 
-void *
-purple_log_get_handle(void)
+/* Log files opened with purple_log_common_writer() are written by a worker
+ * thread. Entries are queued by the main thread and written in batches,
+ * at most flush_interval after they were queued. */
+
+/* Wake the writer early when this much data is waiting. */
+#define LOG_WRITER_MAX_PENDING (64 * 1024)
+
+typedef enum {
+	LOG_WRITER_SYNC_NONE,
+	LOG_WRITER_SYNC_CLOSE,
+	LOG_WRITER_SYNC_BATCH
+} LogWriterSync;
+
+typedef struct {
+	FILE *file;
+	gchar *text;
+	gsize len;
+	gboolean close;
+} LogWriterEntry;
+
+/* The writer thread must not call purple_debug(), so it records its errors
+ * and the main thread reports them. */
+typedef struct {
+	const gchar *action;
+	int error;
+} LogWriterError;
+
+static GThread *log_writer = NULL;
+static GMutex log_writer_lock;
+static GCond log_writer_cond;
+static GCond log_writer_drained_cond;
+static GQueue log_writer_queue = G_QUEUE_INIT;
+static gsize log_writer_pending = 0;
+static gboolean log_writer_atexit_registered = FALSE;
+static guint64 log_writer_queued_seq = 0;
+static guint64 log_writer_written_seq = 0;
+static gboolean log_writer_flushing = FALSE;
+static gboolean log_writer_stopping = FALSE;
+static gint64 log_writer_interval = G_USEC_PER_SEC;
+static LogWriterSync log_writer_sync = LOG_WRITER_SYNC_NONE;
+static GSList *log_writer_errors = NULL;
+static guint log_writer_report_id = 0;
+
+static void
+log_writer_error(GSList **errors, const gchar *action)
 {
-	static int handle;
+	LogWriterError *error = g_new(LogWriterError, 1);
 
-	return &handle;
+	error->action = action;
+	error->error = errno;
+	*errors = g_slist_prepend(*errors, error);
 }
 
-void purple_log_init(void)
+/* Main thread only. Takes the ownership of errors, newest first. */
+static void
+log_writer_report(GSList *errors)
 {
-	void *handle = purple_log_get_handle();
+	errors = g_slist_reverse(errors);
+	while (errors != NULL) {
+		LogWriterError *error = errors->data;
+
+		purple_debug_error("log", "Failed to %s a log file: %s\n",
+			error->action, g_strerror(error->error));
+		g_free(error);
+		errors = g_slist_delete_link(errors, errors);
+	}
+}
 
-	purple_prefs_add_none("/purple/logging");
-	purple_prefs_add_bool("/purple/logging/log_ims", TRUE);
-	purple_prefs_add_bool("/purple/logging/log_chats", TRUE);
-	purple_prefs_add_bool("/purple/logging/log_system", FALSE);
+static gboolean
+log_writer_report_cb(gpointer unused)
+{
+	GSList *errors;
 
-	purple_prefs_add_string("/purple/logging/format", "html");
+	g_mutex_lock(&log_writer_lock);
+	errors = log_writer_errors;
+	log_writer_errors = NULL;
+	log_writer_report_id = 0;
+	g_mutex_unlock(&log_writer_lock);
 
-	html_logger = purple_log_logger_new("html", _("HTML"), 11,
-									  NULL,
-									  html_logger_write,
-									  html_logger_finalize,
-									  html_logger_list,
-									  html_logger_read,
-									  purple_log_common_sizer,
-									  html_logger_total_size,
-									  html_logger_list_syslog,
-									  NULL,
-									  purple_log_common_deleter,
-									  purple_log_common_is_deletable);
-	purple_log_logger_add(html_logger);
+	log_writer_report(errors);
 
-	txt_logger = purple_log_logger_new("txt", _("Plain text"), 11,
-									 NULL,
-									 txt_logger_write,
-									 txt_logger_finalize,
-									 txt_logger_list,
-									 txt_logger_read,
-									 purple_log_common_sizer,
-									 txt_logger_total_size,
-									 txt_logger_list_syslog,
-									 NULL,
-									 purple_log_common_deleter,
-									 purple_log_common_is_deletable);
-	purple_log_logger_add(txt_logger);
+	return FALSE;
+}
 
-	old_logger = purple_log_logger_new("old", _("Old flat format"), 9,
-									 NULL,
-									 NULL,
-									 old_logger_finalize,
-									 old_logger_list,
-									 old_logger_read,
-									 old_logger_size,
-									 old_logger_total_size,
-									 NULL,
-									 old_logger_get_log_sets);
-	purple_log_logger_add(old_logger);
+static void
+log_writer_sync_file(FILE *file, GSList **errors)
+{
+	if (fflush(file) != 0 || g_fsync(fileno(file)) != 0)
+		log_writer_error(errors, "sync");
+}
 
-	purple_signal_register(handle, "log-timestamp",
-			     purple_marshal_POINTER__POINTER_POINTER_BOOLEAN,
-	                     G_TYPE_STRING, 3,
-	                     PURPLE_TYPE_LOG,
-	                     G_TYPE_OBJECT,
-	                     G_TYPE_BOOLEAN);
+static void
+log_writer_write_entry(LogWriterEntry *entry, LogWriterSync sync,
+	GList **dirty, GSList **errors)
+{
+	if (entry->text != NULL) {
+		if (fwrite(entry->text, 1, entry->len, entry->file) != entry->len)
+			log_writer_error(errors, "write");
+		if (dirty != NULL && g_list_find(*dirty, entry->file) == NULL)
+			*dirty = g_list_prepend(*dirty, entry->file);
+	}
 
-	purple_prefs_connect_callback(NULL, "/purple/logging/format",
-							    logger_pref_cb, NULL);
-	purple_prefs_trigger_callback("/purple/logging/format");
+	if (entry->close) {
+		if (sync != LOG_WRITER_SYNC_NONE)
+			log_writer_sync_file(entry->file, errors);
+		if (fclose(entry->file) != 0)
+			log_writer_error(errors, "close");
+		if (dirty != NULL)
+			*dirty = g_list_remove(*dirty, entry->file);
+	} else if (dirty == NULL) {
+		fflush(entry->file);
+	}
 
-	logsize_users = g_hash_table_new_full((GHashFunc)_purple_logsize_user_hash,
-			(GEqualFunc)_purple_logsize_user_equal,
-			(GDestroyNotify)_purple_logsize_user_free_key, NULL);
-	logsize_users_decayed = g_hash_table_new_full((GHashFunc)_purple_logsize_user_hash,
-				(GEqualFunc)_purple_logsize_user_equal,
-				(GDestroyNotify)_purple_logsize_user_free_key, NULL);
+	g_free(entry->text);
+	g_slice_free(LogWriterEntry, entry);
 }
 
-void
-purple_log_uninit(void)
+static void
+log_writer_write_batch(GQueue *batch, LogWriterSync sync, GSList **errors)
 {
-	purple_signals_unregister_by_instance(purple_log_get_handle());
-
-	purple_log_logger_remove(html_logger);
-	purple_log_logger_free(html_logger);
-	html_logger = NULL;
+	LogWriterEntry *entry;
+	GList *dirty = NULL;
 
-	purple_log_logger_remove(txt_logger);
-	purple_log_logger_free(txt_logger);
-	txt_logger = NULL;
+	while ((entry = g_queue_pop_head(batch)) != NULL)
+		log_writer_write_entry(entry, sync, &dirty, errors);
 
-	purple_log_logger_remove(old_logger);
-	purple_log_logger_free(old_logger);
-	old_logger = NULL;
+	/* One flush per file and batch, instead of one per message. */
+	while (dirty != NULL) {
+		FILE *file = dirty->data;
 
-	g_hash_table_destroy(logsize_users);
-	g_hash_table_destroy(logsize_users_decayed);
+		if (sync == LOG_WRITER_SYNC_BATCH)
+			log_writer_sync_file(file, errors);
+		else if (fflush(file) != 0)
+			log_writer_error(errors, "write");
+		dirty = g_list_delete_link(dirty, dirty);
+	}
 }
 
-static PurpleLog *
-purple_log_copy(PurpleLog *log)
+static gpointer
+log_writer_thread(gpointer unused)
 {
-	PurpleLog *log_copy;
+	g_mutex_lock(&log_writer_lock);
 
-	g_return_val_if_fail(log != NULL, NULL);
+	while (TRUE) {
+		GQueue batch = G_QUEUE_INIT;
+		GSList *errors = NULL;
+		LogWriterSync sync;
+		guint64 seq;
+		gint64 deadline;
 
-	log_copy = g_new(PurpleLog, 1);
-	*log_copy = *log;
+		while (g_queue_is_empty(&log_writer_queue) && !log_writer_stopping)
+			g_cond_wait(&log_writer_cond, &log_writer_lock);
 
-	return log_copy;
+		if (g_queue_is_empty(&log_writer_queue))
+			break;
+
+		/* Give more entries the chance to join this batch. */
+		deadline = g_get_monotonic_time() + log_writer_interval;
+		while (!log_writer_flushing && !log_writer_stopping &&
+			log_writer_pending < LOG_WRITER_MAX_PENDING)
+		{
+			if (!g_cond_wait_until(&log_writer_cond, &log_writer_lock,
+				deadline))
+			{
+				break;
+			}
+		}
+
+		batch = log_writer_queue;
+		g_queue_init(&log_writer_queue);
+		log_writer_pending = 0;
+		log_writer_flushing = FALSE;
+		seq = log_writer_queued_seq;
+		sync = log_writer_sync;
+
+		g_mutex_unlock(&log_writer_lock);
+		log_writer_write_batch(&batch, sync, &errors);
+		g_mutex_lock(&log_writer_lock);
+
+		if (errors != NULL) {
+			log_writer_errors = g_slist_concat(errors, log_writer_errors);
+			if (log_writer_report_id == 0) {
+				log_writer_report_id = g_idle_add(log_writer_report_cb,
+					NULL);
+			}
+		}
+
+		log_writer_written_seq = seq;
+		g_cond_broadcast(&log_writer_drained_cond);
+	}
+
+	g_mutex_unlock(&log_writer_lock);
+
+	return NULL;
 }
 
-GType
-purple_log_get_type(void)
+/* Takes the ownership of text. */
+static void
+log_writer_push(FILE *file, gchar *text, gsize len, gboolean close)
 {
-	static GType type = 0;
+	LogWriterEntry *entry;
+	gboolean wake;
 
-	if (type == 0) {
-		type = g_boxed_type_register_static("PurpleLog",
-				(GBoxedCopyFunc)purple_log_copy,
-				(GBoxedFreeFunc)g_free);
+	g_return_if_fail(file != NULL);
+
+	entry = g_slice_new(LogWriterEntry);
+	entry->file = file;
+	entry->text = text;
+	entry->len = len;
+	entry->close = close;
+
+	/* Without the thread (i.e. before init or after uninit), write
+	 * synchronously. */
+	if (log_writer == NULL) {
+		GSList *errors = NULL;
+
+		log_writer_write_entry(entry, log_writer_sync, NULL, &errors);
+		log_writer_report(errors);
+		return;
 	}
 
-	return type;
+	g_mutex_lock(&log_writer_lock);
+	wake = g_queue_is_empty(&log_writer_queue);
+	g_queue_push_tail(&log_writer_queue, entry);
+	log_writer_pending += len;
+	log_writer_queued_seq++;
+	if (log_writer_pending >= LOG_WRITER_MAX_PENDING)
+		wake = TRUE;
+	if (wake)
+		g_cond_signal(&log_writer_cond);
+	g_mutex_unlock(&log_writer_lock);
 }
 
-/****************************************************************************
- * LOGGERS ******************************************************************
- ****************************************************************************/
+void
+purple_log_flush(void)
+{
+	guint64 seq;
 
-static char *log_get_timestamp(PurpleLog *log, GDateTime *when)
+	if (log_writer == NULL)
+		return;
+
+	g_mutex_lock(&log_writer_lock);
+	seq = log_writer_queued_seq;
+	if (log_writer_written_seq < seq) {
+		log_writer_flushing = TRUE;
+		g_cond_signal(&log_writer_cond);
+		while (log_writer_written_seq < seq)
+			g_cond_wait(&log_writer_drained_cond, &log_writer_lock);
+	}
+	g_mutex_unlock(&log_writer_lock);
+}
+
+static void
+log_writer_start(void)
 {
-	gboolean show_date;
-	char *date;
-	GDateTime *dt;
+	g_return_if_fail(log_writer == NULL);
+
+	log_writer_stopping = FALSE;
+	log_writer = g_thread_try_new("log writer", log_writer_thread, NULL,
+		NULL);
+	if (log_writer == NULL)
+		purple_debug_warning("log", "Failed to start the log writer thread, "
+			"logs will be written synchronously\n");
+}
 
-	dt = g_date_time_new_now_utc();
-	show_date = (log->type == PURPLE_LOG_SYSTEM) || (g_date_time_difference(dt, when) > 20L * G_TIME_SPAN_MINUTE);
-	g_date_time_unref(dt);
+/* Writes everything still queued and stops the thread. The recorded errors
+ * are reported if report is TRUE, and dropped otherwise. */
+static void
+log_writer_stop(gboolean report)
+{
+	GThread *thread = log_writer;
 
-	date = purple_signal_emit_return_1(purple_log_get_handle(),
-	                          "log-timestamp",
-	                          log, when, show_date);
-	if (date != NULL)
-		return date;
+	if (thread == NULL)
+		return;
 
-	dt = g_date_time_to_local(when);
-	if (show_date)
-		date = g_date_time_format(dt, _("%x %X"));
-	else
-		date = g_date_time_format(dt, "%X");
-	g_date_time_unref(dt);
+	g_mutex_lock(&log_writer_lock);
+	log_writer_stopping = TRUE;
+	g_cond_signal(&log_writer_cond);
+	g_mutex_unlock(&log_writer_lock);
 
-	return date;
+	g_thread_join(thread);
+	log_writer = NULL;
+
+	if (log_writer_report_id != 0) {
+		g_source_remove(log_writer_report_id);
+		log_writer_report_id = 0;
+	}
+	if (report) {
+		log_writer_report(log_writer_errors);
+	} else {
+		g_slist_free_full(log_writer_errors, g_free);
+	}
+	log_writer_errors = NULL;
 }
 
-/* NOTE: This can return msg (which you may or may not want to g_free())
- * NOTE: or a newly allocated string which you MUST g_free().
- * TODO: XXX: does it really works?
- */
-static char *
-convert_image_tags(const PurpleLog *log, const char *msg)
+static void
+log_writer_atexit(void)
 {
-	const char *tmp;
-	const char *start;
-	const char *end;
-	GData *attributes;
-	GString *newmsg = NULL;
+	/* The UI may exit without uninitializing libpurple. Its debug ops
+	 * may be gone by now. */
+	log_writer_stop(FALSE);
+}
 
-	tmp = msg;
+static void
+log_writer_pref_cb(const char *name, PurplePrefType type,
+	gconstpointer value, gpointer data)
+{
+	g_mutex_lock(&log_writer_lock);
+	if (purple_strequal(name, "/purple/logging/flush_interval")) {
+		log_writer_interval = (gint64)MAX(GPOINTER_TO_INT(value), 0) *
+			(G_USEC_PER_SEC / 1000);
+	} else if (purple_strequal(name, "/purple/logging/sync")) {
+		if (purple_strequal(value, "batch"))
+			log_writer_sync = LOG_WRITER_SYNC_BATCH;
+		else if (purple_strequal(value, "close"))
+			log_writer_sync = LOG_WRITER_SYNC_CLOSE;
+		else
+			log_writer_sync = LOG_WRITER_SYNC_NONE;
+	}
+	g_mutex_unlock(&log_writer_lock);
+}
 
-	while (purple_markup_find_tag("img", tmp, &start, &end, &attributes)) {
-		int imgid = 0;
-		char *idstr = NULL;
+void
+purple_log_common_write(PurpleLog *log, const char *text, gssize len)
+{
+	PurpleLogCommonLoggerData *data;
 
-		if (newmsg == NULL)
-			newmsg = g_string_new("");
+	g_return_if_fail(log != NULL);
+	g_return_if_fail(text != NULL);
 
-		/* copy any text before the img tag */
-		if (tmp < start)
-			g_string_append_len(newmsg, tmp, start - tmp);
+	data = log->logger_data;
+	if (data == NULL || data->file == NULL)
+		return;
 
-		if ((idstr = g_datalist_get_data(&attributes, "id")) != NULL)
-			imgid = atoi(idstr);
+	if (len < 0)
+		len = strlen(text);
 
-		if (imgid != 0)
-		{
-			FILE *image_file;
-			char *dir;
-			PurpleImage *image;
-			gconstpointer image_data;
-			const gchar *new_filename = NULL;
-			char *path = NULL;
-			size_t image_byte_count;
+	log_writer_push(data->file, g_strndup(text, len), len, FALSE);
+}
 
-			image = purple_image_store_get(imgid);
-			if (image == NULL)
-			{
-				/* This should never happen. */
-				/* This *does* happen for failed Direct-IMs -DAA */
-				g_string_free(newmsg, TRUE);
-				g_return_val_if_reached((char *)msg);
-			}
+void
+purple_log_common_close(PurpleLog *log, const char *footer)
+{
+	PurpleLogCommonLoggerData *data;
 
-			image_data       = purple_image_get_data(image);
-			image_byte_count = purple_image_get_data_size(image);
-			dir              = purple_log_get_log_dir(log->type, log->name, log->account);
-			new_filename = purple_image_generate_filename(image);
+	g_return_if_fail(log != NULL);
 
-			path = g_build_filename(dir, new_filename, NULL);
+	data = log->logger_data;
+	if (data == NULL || data->file == NULL)
+		return;
 
-			/* Only save unique files. */
-			if (!g_file_test(path, G_FILE_TEST_EXISTS))
-			{
-				if ((image_file = g_fopen(path, "wb")) != NULL)
-				{
-					if (!fwrite(image_data, image_byte_count, 1, image_file))
-					{
-						purple_debug_error("log", "Error writing %s: %s\n",
-						                   path, g_strerror(errno));
-						fclose(image_file);
+	log_writer_push(data->file, g_strdup(footer),
+		footer ? strlen(footer) : 0, TRUE);
+	data->file = NULL;
+}
 
-						/* Attempt to not leave half-written files around. */
-						if (g_unlink(path)) {
-							purple_debug_error("log", "Error deleting partial "
-									"file %s: %s\n", path, g_strerror(errno));
-						}
-					}
-					else
-					{
-						purple_debug_info("log", "Wrote image file: %s\n", path);
-						fclose(image_file);
-					}
-				}
-				else
-				{
-					purple_debug_error("log", "Unable to create file %s: %s\n",
-					                   path, g_strerror(errno));
-				}
-			}
-
-			/* Write the new image tag */
-			g_string_append_printf(newmsg, "<img src=\"%s\">", new_filename);
-			g_free(path);
-		}
+/****************************************************************************
+ * SEARCH INDEX *************************************************************
+ ****************************************************************************/
 
-		/* Continue from the end of the tag */
-		tmp = end + 1;
-	}
+/* An inverted index of the words in the logs, kept per conversation. Logs
+ * are numbered per conversation; a posting is a log number and the number
+ * of the message in that log.
+ *
+ * The index is saved in the log directory of the conversation. When it is
+ * loaded, the logs whose size changed since they were indexed are indexed
+ * again, so only new logs are read. While the index is loaded,
+ * purple_log_write() keeps it up to date. Only the indexes of the most
+ * recently searched conversations stay loaded. */
+
+#define LOG_SEARCH_INDEX_FILE    "purple-search.idx"
+#define LOG_SEARCH_INDEX_VERSION 1
+#define LOG_SEARCH_INDEX_TYPE    "(ua(sxu)a(sa(uu)))"
+
+/* Longer words are not indexed. */
+#define LOG_SEARCH_MAX_TERM 64
+
+/* How many indexes are kept loaded. The least recently searched ones are
+ * saved and dropped. */
+#define LOG_SEARCH_MAX_INDEXES 16
+
+typedef struct {
+	guint32 doc;
+	guint32 message;
+} LogSearchPosting;
+
+typedef struct {
+	gchar *term;
+	GArray *postings;
+} LogSearchTerm;
+
+typedef struct {
+	PurpleLogType type;
+	gchar *name;
+	PurpleAccount *account;
+	gchar *path;           /* NULL if it can't be saved */
+	gboolean dirty;
+	GList *used_link;      /* in log_search_indexes_used */
 
-	if (newmsg == NULL)
-	{
-		/* No images were found to change. */
-		return (char *)msg;
-	}
+	GHashTable *docs;      /* log ID -> log number + 1 */
+	GArray *messages;      /* log number -> message count */
+	GArray *sizes;         /* log number -> log size when indexed, or -1 */
+	GHashTable *terms;     /* word -> LogSearchTerm */
+	GPtrArray *sorted;     /* LogSearchTerm, by word; NULL when outdated */
+} LogSearchIndex;
 
-	/* Append any remaining message data */
-	g_string_append(newmsg, tmp);
+static guint
+log_search_index_hash(gconstpointer key)
+{
+	const LogSearchIndex *index = key;
 
-	return g_string_free(newmsg, FALSE);
+	return g_str_hash(index->name) ^ index->type;
 }
 
-void purple_log_common_writer(PurpleLog *log, const char *ext)
+static gboolean
+log_search_index_equal(gconstpointer a, gconstpointer b)
 {
-	PurpleLogCommonLoggerData *data = log->logger_data;
+	const LogSearchIndex *index1 = a, *index2 = b;
 
-	if (data == NULL)
-	{
-		/* This log is new */
-		char *dir;
-		GDateTime *dt;
-		const char *tz;
-		gchar *date;
-		char *filename;
-		char *path;
+	return index1->type == index2->type &&
+		index1->account == index2->account &&
+		purple_strequal(index1->name, index2->name);
+}
 
-		dir = purple_log_get_log_dir(log->type, log->name, log->account);
-		if (dir == NULL)
-			return;
+static void
+log_search_term_free(gpointer data)
+{
+	LogSearchTerm *term = data;
 
-		purple_build_dir (dir, S_IRUSR | S_IWUSR | S_IXUSR);
+	g_array_free(term->postings, TRUE);
+	g_free(term->term);
+	g_free(term);
+}
 
-		dt = g_date_time_to_local(log->time);
-		tz = purple_escape_filename(g_date_time_get_timezone_abbreviation(dt));
-		date = g_date_time_format(dt, "%Y-%m-%d.%H%M%S%z");
-		g_date_time_unref(dt);
+static void
+log_search_index_free(gpointer data)
+{
+	LogSearchIndex *index = data;
+
+	if (index->used_link != NULL)
+		g_queue_delete_link(&log_search_indexes_used, index->used_link);
+	if (index->sorted != NULL)
+		g_ptr_array_free(index->sorted, TRUE);
+	g_hash_table_destroy(index->terms);
+	g_hash_table_destroy(index->docs);
+	g_array_free(index->messages, TRUE);
+	g_array_free(index->sizes, TRUE);
+	g_free(index->path);
+	g_free(index->name);
+	g_free(index);
+}
 
-		filename = g_strdup_printf("%s%s%s", date, tz, ext ? ext : "");
+static gchar *
+log_search_doc_id(PurpleLog *log)
+{
+	return g_strdup_printf("%s/%" G_GINT64_FORMAT, log->logger->id,
+		log->time ? g_date_time_to_unix(log->time) : (gint64)0);
+}
 
-		path = g_build_filename(dir, filename, NULL);
-		g_free(dir);
-		g_free(date);
-		g_free(filename);
+/* Splits text into case folded words. */
+static GPtrArray *
+log_search_tokenize(const gchar *text)
+{
+	GPtrArray *words = g_ptr_array_new_with_free_func(g_free);
+	const gchar *start = NULL, *p = text;
 
-		log->logger_data = data = g_slice_new0(PurpleLogCommonLoggerData);
+	if (text == NULL || !g_utf8_validate(text, -1, NULL))
+		return words;
 
-		data->file = g_fopen(path, "a");
-		if (data->file == NULL)
-		{
-			purple_debug(PURPLE_DEBUG_ERROR, "log",
-					"Could not create log file %s\n", path);
+	for (;;) {
+		gunichar c = g_utf8_get_char(p);
 
-			if (log->conv != NULL)
-				purple_conversation_write_system_message(log->conv,
-					_("Logging of this conversation failed."),
-					PURPLE_MESSAGE_ERROR);
+		if (c != 0 && g_unichar_isalnum(c)) {
+			if (start == NULL)
+				start = p;
+		} else if (start != NULL) {
+			if (p - start <= LOG_SEARCH_MAX_TERM) {
+				gchar *folded = g_utf8_casefold(start, p - start);
 
-			g_free(path);
-			return;
+				g_ptr_array_add(words,
+					g_utf8_normalize(folded, -1, G_NORMALIZE_ALL));
+				g_free(folded);
+			}
+			start = NULL;
 		}
-		g_free(path);
+
+		if (c == 0)
+			break;
+		p = g_utf8_next_char(p);
 	}
+
+	return words;
 }
 
-GList *purple_log_common_lister(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext, PurpleLogLogger *logger)
+static guint32
+log_search_index_get_doc(LogSearchIndex *index, PurpleLog *log)
 {
-	GDir *dir;
-	GList *list = NULL;
-	const char *filename;
-	char *path;
+	gchar *id = log_search_doc_id(log);
+	gpointer doc;
+	gint64 size = -1;
+
+	doc = g_hash_table_lookup(index->docs, id);
+	if (doc != NULL) {
+		g_free(id);
+		return GPOINTER_TO_UINT(doc) - 1;
+	}
 
-	if(!account)
-		return NULL;
+	g_array_set_size(index->messages, index->messages->len + 1);
+	g_array_append_val(index->sizes, size);
+	g_hash_table_insert(index->docs, id,
+		GUINT_TO_POINTER(index->messages->len));
 
-	path = purple_log_get_log_dir(type, name, account);
-	if (path == NULL)
-		return NULL;
+	return index->messages->len - 1;
+}
 
-	if (!(dir = g_dir_open(path, 0, NULL)))
-	{
-		g_free(path);
-		return NULL;
+static LogSearchTerm *
+log_search_index_get_term(LogSearchIndex *index, const gchar *word)
+{
+	LogSearchTerm *term;
+
+	term = g_hash_table_lookup(index->terms, word);
+	if (term == NULL) {
+		term = g_new(LogSearchTerm, 1);
+		term->term = g_strdup(word);
+		term->postings = g_array_new(FALSE, FALSE,
+			sizeof(LogSearchPosting));
+		g_hash_table_insert(index->terms, term->term, term);
+
+		if (index->sorted != NULL) {
+			g_ptr_array_free(index->sorted, TRUE);
+			index->sorted = NULL;
+		}
 	}
 
-	while ((filename = g_dir_read_name(dir)))
-	{
-		if (purple_str_has_suffix(filename, ext) &&
-		    strlen(filename) >= (17 + strlen(ext)))
-		{
-			PurpleLog *log;
-			PurpleLogCommonLoggerData *data;
-			GDateTime *stamp = purple_str_to_date_time(purple_unescape_filename(filename), FALSE);
+	return term;
+}
 
-			log = purple_log_new(type, name, account, NULL, stamp);
-			log->logger = logger;
-			log->logger_data = data = g_slice_new0(PurpleLogCommonLoggerData);
+/* Indexes the next message of a log. */
+static void
+log_search_index_add(LogSearchIndex *index, guint32 doc, const gchar *text)
+{
+	GPtrArray *words;
+	LogSearchPosting posting;
+	guint i;
 
-			data->path = g_build_filename(path, filename, NULL);
-			list = g_list_prepend(list, log);
+	posting.doc = doc;
+	posting.message = g_array_index(index->messages, guint32, doc)++;
 
-			g_date_time_unref(stamp);
+	words = log_search_tokenize(text);
+	for (i = 0; i < words->len; i++) {
+		LogSearchTerm *term;
+		LogSearchPosting *last;
+
+		term = log_search_index_get_term(index, g_ptr_array_index(words, i));
+
+		/* The same word twice in a message is one posting. */
+		if (term->postings->len > 0) {
+			last = &g_array_index(term->postings, LogSearchPosting,
+				term->postings->len - 1);
+			if (last->doc == posting.doc && last->message == posting.message)
+				continue;
 		}
+		g_array_append_val(term->postings, posting);
 	}
-	g_dir_close(dir);
-	g_free(path);
-	return list;
+	g_ptr_array_free(words, TRUE);
+
+	index->dirty = TRUE;
 }
 
-int purple_log_common_total_sizer(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext)
+static void
+log_search_index_add_message(LogSearchIndex *index, guint32 doc,
+	const char *from, const char *message)
 {
-	GDir *dir;
-	int size = 0;
-	const char *filename;
-	char *path;
+	gchar *stripped = purple_markup_strip_html(message);
+	gchar *text = g_strconcat(from ? from : "", " ", stripped, NULL);
 
-	if(!account)
-		return 0;
+	log_search_index_add(index, doc, text);
+	g_free(text);
+	g_free(stripped);
+}
 
-	path = purple_log_get_log_dir(type, name, account);
-	if (path == NULL)
-		return 0;
+/* Indexes a log already on disk, the way purple_log_write() would have. A
+ * message starts with its timestamp in parentheses, or with "----" in
+ * system logs. Lines before the first message are a header, and lines
+ * without a timestamp continue the message before them. */
+static void
+log_search_index_add_log(LogSearchIndex *index, PurpleLog *log)
+{
+	guint32 doc = log_search_index_get_doc(index, log);
+	GString *message = NULL;
+	gchar *read, **lines;
+	guint i;
 
-	if (!(dir = g_dir_open(path, 0, NULL)))
-	{
-		g_free(path);
-		return 0;
-	}
+	read = purple_log_read(log, NULL);
+	if (read == NULL)
+		return;
 
-	while ((filename = g_dir_read_name(dir)))
-	{
-		if (purple_str_has_suffix(filename, ext) &&
-		    strlen(filename) >= (17 + strlen(ext)))
-		{
-			char *tmp = g_build_filename(path, filename, NULL);
-			GStatBuf st;
-			if (g_stat(tmp, &st))
-			{
-				purple_debug_error("log", "Error stating log file: %s\n", tmp);
-				g_free(tmp);
-				continue;
-			}
-			g_free(tmp);
-			size += st.st_size;
+	lines = g_strsplit(read, "\n", -1);
+	for (i = 0; lines[i] != NULL; i++) {
+		gchar *stripped = purple_markup_strip_html(lines[i]);
+		const gchar *text;
+
+		if (stripped == NULL)
+			continue;
+		text = g_strstrip(stripped);
+
+		if (*text == '(' || g_str_has_prefix(text, "----")) {
+			if (message != NULL)
+				log_search_index_add(index, doc, message->str);
+			else
+				message = g_string_new(NULL);
+			g_string_truncate(message, 0);
+
+			/* The timestamp isn't part of the message. */
+			if (*text == '(' && strchr(text, ')') != NULL)
+				text = strchr(text, ')') + 1;
+			g_string_append(message, text);
+		} else if (message != NULL && *text != '\0') {
+			g_string_append_c(message, ' ');
+			g_string_append(message, text);
 		}
+		g_free(stripped);
 	}
-	g_dir_close(dir);
-	g_free(path);
-	return size;
+	if (message != NULL) {
+		log_search_index_add(index, doc, message->str);
+		g_string_free(message, TRUE);
+	}
+	g_strfreev(lines);
+	g_free(read);
+
+	g_array_index(index->sizes, gint64, doc) = purple_log_get_size(log);
 }
 
-int purple_log_common_sizer(PurpleLog *log)
+static LogSearchIndex *
+log_search_index_lookup(PurpleLogType type, const char *name,
+	PurpleAccount *account)
 {
-	GStatBuf st;
-	PurpleLogCommonLoggerData *data = log->logger_data;
+	LogSearchIndex key;
 
-	g_return_val_if_fail(data != NULL, 0);
+	key.type = type;
+	key.name = (gchar *)name;
+	key.account = account;
 
-	if (!data->path || g_stat(data->path, &st))
-		st.st_size = 0;
+	return g_hash_table_lookup(log_search_indexes, &key);
+}
 
-	return st.st_size;
+/* Reads a saved index into an empty one. Returns FALSE, leaving the index
+ * empty, if the file is missing or damaged. */
+static gboolean
+log_search_index_load(LogSearchIndex *index)
+{
+	GVariant *variant, *docs, *terms, *postings;
+	GVariantIter iter;
+	gchar *contents;
+	const gchar *word;
+	gsize len, i, n_docs;
+	guint32 version;
+	gboolean valid = TRUE;
+
+	if (index->path == NULL ||
+		!g_file_get_contents(index->path, &contents, &len, NULL))
+	{
+		return FALSE;
+	}
+
+	variant = g_variant_new_from_data(G_VARIANT_TYPE(LOG_SEARCH_INDEX_TYPE),
+		contents, len, FALSE, g_free, contents);
+	g_variant_ref_sink(variant);
+
+	/* Saved on a machine of the other byte order. */
+	g_variant_get_child(variant, 0, "u", &version);
+	if (GUINT32_SWAP_LE_BE(version) == LOG_SEARCH_INDEX_VERSION) {
+		GVariant *swapped = g_variant_byteswap(variant);
+
+		g_variant_unref(variant);
+		variant = swapped;
+		version = LOG_SEARCH_INDEX_VERSION;
+	}
+	if (version != LOG_SEARCH_INDEX_VERSION) {
+		g_variant_unref(variant);
+		return FALSE;
+	}
+
+	docs = g_variant_get_child_value(variant, 1);
+	n_docs = g_variant_n_children(docs);
+	for (i = 0; i < n_docs; i++) {
+		const gchar *id;
+		gint64 size;
+		guint32 count;
+
+		g_variant_get_child(docs, i, "(&sxu)", &id, &size, &count);
+		g_array_append_val(index->messages, count);
+		g_array_append_val(index->sizes, size);
+		if (!g_hash_table_contains(index->docs, id)) {
+			g_hash_table_insert(index->docs, g_strdup(id),
+				GUINT_TO_POINTER(i + 1));
+		}
+	}
+	g_variant_unref(docs);
+
+	terms = g_variant_get_child_value(variant, 2);
+	g_variant_iter_init(&iter, terms);
+	while (valid && g_variant_iter_next(&iter, "(&s@a(uu))", &word, &postings)) {
+		const LogSearchPosting *array;
+		gsize n_postings, j;
+
+		array = g_variant_get_fixed_array(postings, &n_postings,
+			sizeof(LogSearchPosting));
+		for (j = 0; j < n_postings; j++) {
+			if (array[j].doc >= n_docs || array[j].message >=
+				g_array_index(index->messages, guint32, array[j].doc))
+			{
+				valid = FALSE;
+			}
+		}
+		if (valid && n_postings > 0) {
+			g_array_append_vals(log_search_index_get_term(index, word)->postings,
+				array, n_postings);
+		}
+		g_variant_unref(postings);
+	}
+	g_variant_unref(terms);
+	g_variant_unref(variant);
+
+	if (!valid) {
+		purple_debug_error("log", "Invalid search index %s\n", index->path);
+		g_hash_table_remove_all(index->terms);
+		g_hash_table_remove_all(index->docs);
+		g_array_set_size(index->messages, 0);
+		g_array_set_size(index->sizes, 0);
+		if (index->sorted != NULL) {
+			g_ptr_array_free(index->sorted, TRUE);
+			index->sorted = NULL;
+		}
+	}
+
+	return valid;
 }
 
-/* This will build log sets for all loggers that use the common logger
- * functions because they use the same directory structure. */
-static void log_get_log_sets_common(GHashTable *sets)
+/* Saves the index, leaving out the postings of logs which are gone. */
+static void
+log_search_index_save(LogSearchIndex *index)
 {
-	gchar *log_path = g_build_filename(purple_user_dir(), "logs", NULL);
-	GDir *log_dir = g_dir_open(log_path, 0, NULL);
-	const gchar *protocol;
+	GVariantBuilder docs, terms;
+	GVariant *variant;
+	GHashTableIter iter;
+	gpointer key, value;
+	guint32 *numbers, n_docs = 0;
+	gchar *dir;
+	guint i;
+
+	if (index->path == NULL)
+		return;
+	index->dirty = FALSE;
 
-	if (log_dir == NULL) {
-		g_free(log_path);
+	if (g_hash_table_size(index->docs) == 0) {
+		g_unlink(index->path);
 		return;
 	}
 
-	while ((protocol = g_dir_read_name(log_dir)) != NULL) {
-		gchar *protocol_path = g_build_filename(log_path, protocol, NULL);
-		GDir *protocol_dir;
-		const gchar *username;
-		gchar *protocol_unescaped;
-		GList *account_iter;
-		GList *accounts = NULL;
+	numbers = g_new(guint32, index->messages->len);
+	for (i = 0; i < index->messages->len; i++)
+		numbers[i] = G_MAXUINT32;
 
-		if ((protocol_dir = g_dir_open(protocol_path, 0, NULL)) == NULL) {
-			g_free(protocol_path);
-			continue;
-		}
+	g_variant_builder_init(&docs, G_VARIANT_TYPE("a(sxu)"));
+	g_hash_table_iter_init(&iter, index->docs);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		guint doc = GPOINTER_TO_UINT(value) - 1;
 
-		/* Using g_strdup() to cover the one-in-a-million chance that a
-		 * protocol's list_icon function uses purple_unescape_filename(). */
-		protocol_unescaped = g_strdup(purple_unescape_filename(protocol));
+		numbers[doc] = n_docs++;
+		g_variant_builder_add(&docs, "(sxu)", key,
+			g_array_index(index->sizes, gint64, doc),
+			g_array_index(index->messages, guint32, doc));
+	}
 
-		/* Find all the accounts for protocol. */
-		for (account_iter = purple_accounts_get_all() ; account_iter != NULL ; account_iter = account_iter->next) {
-			PurpleProtocol *protocol;
+	g_variant_builder_init(&terms, G_VARIANT_TYPE("a(sa(uu))"));
+	g_hash_table_iter_init(&iter, index->terms);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		LogSearchTerm *term = value;
+		GVariantBuilder postings;
+		gboolean empty = TRUE;
 
-			protocol = purple_protocols_find(purple_account_get_protocol_id((PurpleAccount *)account_iter->data));
-			if (!protocol)
-				continue;
+		g_variant_builder_init(&postings, G_VARIANT_TYPE("a(uu)"));
+		for (i = 0; i < term->postings->len; i++) {
+			LogSearchPosting *posting = &g_array_index(term->postings,
+				LogSearchPosting, i);
 
-			if (purple_strequal(protocol_unescaped, purple_protocol_class_list_icon(protocol, (PurpleAccount *)account_iter->data, NULL)))
-				accounts = g_list_prepend(accounts, account_iter->data);
+			if (numbers[posting->doc] == G_MAXUINT32)
+				continue;
+			g_variant_builder_add(&postings, "(uu)", numbers[posting->doc],
+				posting->message);
+			empty = FALSE;
 		}
-		g_free(protocol_unescaped);
 
-		while ((username = g_dir_read_name(protocol_dir)) != NULL) {
-			gchar *username_path = g_build_filename(protocol_path, username, NULL);
-			GDir *username_dir;
-			const gchar *username_unescaped;
-			PurpleAccount *account = NULL;
-			gchar *name;
+		if (empty)
+			g_variant_builder_clear(&postings);
+		else
+			g_variant_builder_add(&terms, "(sa(uu))", term->term, &postings);
+	}
+	g_free(numbers);
 
-			if ((username_dir = g_dir_open(username_path, 0, NULL)) == NULL) {
-				g_free(username_path);
-				continue;
-			}
+	variant = g_variant_ref_sink(g_variant_new(LOG_SEARCH_INDEX_TYPE,
+		LOG_SEARCH_INDEX_VERSION, &docs, &terms));
 
-			/* Find the account for username in the list of accounts for protocol. */
-			username_unescaped = purple_unescape_filename(username);
-			for (account_iter = g_list_first(accounts) ; account_iter != NULL ; account_iter = account_iter->next) {
+	dir = g_path_get_dirname(index->path);
+	if (purple_build_dir(dir, S_IRUSR | S_IWUSR | S_IXUSR) == 0) {
+		purple_util_write_data_to_file_absolute(index->path,
+			g_variant_get_data(variant), g_variant_get_size(variant));
+	}
+	g_free(dir);
+	g_variant_unref(variant);
+}
+
+static void
+log_search_index_save_dirty(gpointer key, gpointer value, gpointer data)
+{
+	LogSearchIndex *index = value;
+
+	if (index->dirty)
+		log_search_index_save(index);
+}
+
+/* Loads the index of a conversation, unless rebuild is TRUE, and brings it
+ * up to date with the logs. */
+static LogSearchIndex *
+log_search_index_build(PurpleLogType type, const char *name,
+	PurpleAccount *account, gboolean rebuild)
+{
+	LogSearchIndex *index;
+	GList *logs, *l;
+	gboolean *seen;
+	guint n_loaded;
+	GHashTableIter iter;
+	gpointer value;
+	gchar *dir;
+
+	index = g_new0(LogSearchIndex, 1);
+	index->type = type;
+	index->name = g_strdup(name);
+	index->account = account;
+	index->docs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	index->messages = g_array_new(FALSE, TRUE, sizeof(guint32));
+	index->sizes = g_array_new(FALSE, FALSE, sizeof(gint64));
+	index->terms = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		log_search_term_free);
+
+	dir = purple_log_get_log_dir(type, name, account);
+	if (dir != NULL) {
+		index->path = g_build_filename(dir, LOG_SEARCH_INDEX_FILE, NULL);
+		g_free(dir);
+	}
+
+	if (rebuild || !log_search_index_load(index))
+		index->dirty = TRUE;
+
+	if (type == PURPLE_LOG_SYSTEM)
+		logs = purple_log_get_system_logs(account);
+	else
+		logs = purple_log_get_logs(type, name, account);
+
+	/* Logs that were added or changed since the index was saved are
+	 * indexed again. Their old postings are left behind, and dropped by
+	 * the next save. */
+	n_loaded = index->messages->len;
+	seen = g_new0(gboolean, n_loaded);
+	for (l = logs; l != NULL; l = l->next) {
+		PurpleLog *log = l->data;
+		gchar *id = log_search_doc_id(log);
+		gpointer doc = g_hash_table_lookup(index->docs, id);
+
+		if (doc != NULL) {
+			guint32 number = GPOINTER_TO_UINT(doc) - 1;
+
+			if (g_array_index(index->sizes, gint64, number) ==
+				purple_log_get_size(log))
+			{
+				seen[number] = TRUE;
+				g_free(id);
+				purple_log_free(log);
+				continue;
+			}
+			g_hash_table_remove(index->docs, id);
+		}
+		g_free(id);
+
+		log_search_index_add_log(index, log);
+		purple_log_free(log);
+	}
+	g_list_free(logs);
+
+	/* Logs that are gone. The ones indexed above are past the end of seen. */
+	g_hash_table_iter_init(&iter, index->docs);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		guint32 number = GPOINTER_TO_UINT(value) - 1;
+
+		if (number < n_loaded && !seen[number]) {
+			g_hash_table_iter_remove(&iter);
+			index->dirty = TRUE;
+		}
+	}
+	g_free(seen);
+
+	if (index->dirty)
+		log_search_index_save(index);
+
+	g_hash_table_replace(log_search_indexes, index, index);
+	g_queue_push_head(&log_search_indexes_used, index);
+	index->used_link = log_search_indexes_used.head;
+
+	return index;
+}
+
+static void
+log_search_index_use(LogSearchIndex *index)
+{
+	g_queue_unlink(&log_search_indexes_used, index->used_link);
+	g_queue_push_head_link(&log_search_indexes_used, index->used_link);
+}
+
+/* Not done while searching, which holds on to the indexes it used. */
+static void
+log_search_indexes_trim(void)
+{
+	while (log_search_indexes_used.length > LOG_SEARCH_MAX_INDEXES) {
+		LogSearchIndex *index = g_queue_peek_tail(&log_search_indexes_used);
+
+		if (index->dirty)
+			log_search_index_save(index);
+		g_hash_table_remove(log_search_indexes, index);
+	}
+}
+
+static gint
+log_search_term_compare(gconstpointer a, gconstpointer b)
+{
+	const LogSearchTerm *term1 = *(LogSearchTerm * const *)a;
+	const LogSearchTerm *term2 = *(LogSearchTerm * const *)b;
+
+	return strcmp(term1->term, term2->term);
+}
+
+/* Returns the messages of each log containing a word starting with prefix,
+ * as a table of log number -> GArray of message numbers. */
+static GHashTable *
+log_search_index_find_prefix(LogSearchIndex *index, const gchar *prefix)
+{
+	GHashTable *found;
+	gsize prefix_len = strlen(prefix);
+	guint low, high;
+
+	if (index->sorted == NULL) {
+		GHashTableIter iter;
+		gpointer term;
+
+		index->sorted = g_ptr_array_sized_new(g_hash_table_size(index->terms));
+		g_hash_table_iter_init(&iter, index->terms);
+		while (g_hash_table_iter_next(&iter, NULL, &term))
+			g_ptr_array_add(index->sorted, term);
+		g_ptr_array_sort(index->sorted, log_search_term_compare);
+	}
+
+	found = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+		(GDestroyNotify)g_array_unref);
+
+	/* Find the first word not before the prefix. */
+	low = 0;
+	high = index->sorted->len;
+	while (low < high) {
+		guint mid = low + (high - low) / 2;
+		LogSearchTerm *term = g_ptr_array_index(index->sorted, mid);
+
+		if (strcmp(term->term, prefix) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (; low < index->sorted->len; low++) {
+		LogSearchTerm *term = g_ptr_array_index(index->sorted, low);
+		guint i;
+
+		if (strncmp(term->term, prefix, prefix_len) != 0)
+			break;
+
+		for (i = 0; i < term->postings->len; i++) {
+			LogSearchPosting *posting = &g_array_index(term->postings,
+				LogSearchPosting, i);
+			GArray *messages;
+
+			messages = g_hash_table_lookup(found,
+				GUINT_TO_POINTER(posting->doc));
+			if (messages == NULL) {
+				messages = g_array_new(FALSE, FALSE, sizeof(guint));
+				g_hash_table_insert(found, GUINT_TO_POINTER(posting->doc),
+					messages);
+			}
+			g_array_append_val(messages, posting->message);
+		}
+	}
+
+	return found;
+}
+
+static gint
+log_search_message_compare(gconstpointer a, gconstpointer b)
+{
+	guint message1 = *(const guint *)a, message2 = *(const guint *)b;
+
+	return (message1 > message2) - (message1 < message2);
+}
+
+/* Returns the logs matching all the words, as a table of log number ->
+ * GArray of the numbers of the messages matching the first word. */
+static GHashTable *
+log_search_index_query(LogSearchIndex *index, GPtrArray *words)
+{
+	GHashTable *matches;
+	GHashTableIter iter;
+	gpointer doc, messages;
+	guint i;
+
+	matches = log_search_index_find_prefix(index,
+		g_ptr_array_index(words, 0));
+
+	for (i = 1; i < words->len && g_hash_table_size(matches) > 0; i++) {
+		GHashTable *found = log_search_index_find_prefix(index,
+			g_ptr_array_index(words, i));
+
+		g_hash_table_iter_init(&iter, matches);
+		while (g_hash_table_iter_next(&iter, &doc, NULL)) {
+			if (!g_hash_table_contains(found, doc))
+				g_hash_table_iter_remove(&iter);
+		}
+		g_hash_table_destroy(found);
+	}
+
+	/* Several words may share a prefix, so sort and remove duplicates. */
+	g_hash_table_iter_init(&iter, matches);
+	while (g_hash_table_iter_next(&iter, NULL, &messages)) {
+		GArray *array = messages;
+		guint j, k = 0;
+
+		g_array_sort(array, log_search_message_compare);
+		for (j = 0; j < array->len; j++) {
+			if (k == 0 || g_array_index(array, guint, k - 1) !=
+				g_array_index(array, guint, j))
+			{
+				g_array_index(array, guint, k++) =
+					g_array_index(array, guint, j);
+			}
+		}
+		g_array_set_size(array, k);
+	}
+
+	return matches;
+}
+
+/* Called by purple_log_write(). Only conversations which were searched
+ * before have an index to update. */
+static void
+log_search_log_written(PurpleLog *log, const char *from, const char *message)
+{
+	LogSearchIndex *index;
+	guint32 doc;
+
+	index = log_search_index_lookup(log->type, log->name, log->account);
+	if (index == NULL)
+		return;
+
+	doc = log_search_index_get_doc(index, log);
+	log_search_index_add_message(index, doc, from, message);
+
+	/* Index the whole log again the next time the index is loaded, rather
+	 * than flushing it to learn its size. */
+	g_array_index(index->sizes, gint64, doc) = -1;
+}
+
+/* Called by purple_log_delete(). The postings of the log are left behind,
+ * but can't be found anymore. */
+static void
+log_search_log_deleted(PurpleLog *log)
+{
+	LogSearchIndex *index;
+	gchar *id;
+
+	index = log_search_index_lookup(log->type, log->name, log->account);
+	if (index == NULL)
+		return;
+
+	id = log_search_doc_id(log);
+	if (g_hash_table_remove(index->docs, id))
+		index->dirty = TRUE;
+	g_free(id);
+}
+
+GList *
+purple_log_search(GList *logs, const char *query)
+{
+	GHashTable *queried;
+	GPtrArray *words;
+	GList *results = NULL;
+
+	g_return_val_if_fail(query != NULL, NULL);
+
+	words = log_search_tokenize(query);
+	if (words->len == 0) {
+		g_ptr_array_free(words, TRUE);
+		return NULL;
+	}
+
+	/* Index -> matches, so each conversation is only queried once. */
+	queried = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+		(GDestroyNotify)g_hash_table_destroy);
+
+	for (; logs != NULL; logs = logs->next) {
+		PurpleLog *log = logs->data;
+		LogSearchIndex *index;
+		GHashTable *matches;
+		GArray *messages;
+		gchar *id;
+		gpointer doc;
+
+		if (log == NULL || log->logger == NULL)
+			continue;
+
+		index = log_search_index_lookup(log->type, log->name, log->account);
+		if (index == NULL) {
+			index = log_search_index_build(log->type, log->name, log->account,
+				FALSE);
+		} else {
+			log_search_index_use(index);
+		}
+
+		matches = g_hash_table_lookup(queried, index);
+		if (matches == NULL) {
+			matches = log_search_index_query(index, words);
+			g_hash_table_insert(queried, index, matches);
+		}
+
+		id = log_search_doc_id(log);
+		doc = g_hash_table_lookup(index->docs, id);
+		g_free(id);
+		if (doc == NULL)
+			continue;
+
+		messages = g_hash_table_lookup(matches,
+			GUINT_TO_POINTER(GPOINTER_TO_UINT(doc) - 1));
+		if (messages != NULL) {
+			PurpleLogSearchResult *result = g_new(PurpleLogSearchResult, 1);
+
+			result->log = log;
+			result->offsets = g_array_ref(messages);
+			results = g_list_prepend(results, result);
+		}
+	}
+
+	g_hash_table_destroy(queried);
+	g_ptr_array_free(words, TRUE);
+	log_search_indexes_trim();
+
+	return g_list_reverse(results);
+}
+
+void
+purple_log_search_result_free(PurpleLogSearchResult *result)
+{
+	g_return_if_fail(result != NULL);
+
+	g_array_unref(result->offsets);
+	g_free(result);
+}
+
+void
+purple_log_search_rebuild(PurpleLogType type, const char *name,
+	PurpleAccount *account)
+{
+	g_return_if_fail(name != NULL);
+
+	purple_log_flush();
+	log_search_index_build(type, purple_normalize(account, name), account,
+		TRUE);
+	log_search_indexes_trim();
+}
+
+/****************************************************************************
+ * LOG SUBSYSTEM ************************************************************
+ ****************************************************************************/
+
+void *
+purple_log_get_handle(void)
+{
+	static int handle;
+
+	return &handle;
+}
+
+void purple_log_init(void)
+{
+	void *handle = purple_log_get_handle();
+
+	purple_prefs_add_none("/purple/logging");
+	purple_prefs_add_bool("/purple/logging/log_ims", TRUE);
+	purple_prefs_add_bool("/purple/logging/log_chats", TRUE);
+	purple_prefs_add_bool("/purple/logging/log_system", FALSE);
+
+	purple_prefs_add_string("/purple/logging/format", "html");
+	purple_prefs_add_int("/purple/logging/flush_interval", 1000);
+	purple_prefs_add_string("/purple/logging/sync", "none");
+
+	html_logger = purple_log_logger_new("html", _("HTML"), 11,
+									  NULL,
+									  html_logger_write,
+									  html_logger_finalize,
+									  html_logger_list,
+									  html_logger_read,
+									  purple_log_common_sizer,
+									  html_logger_total_size,
+									  html_logger_list_syslog,
+									  NULL,
+									  purple_log_common_deleter,
+									  purple_log_common_is_deletable);
+	purple_log_logger_add(html_logger);
+
+	txt_logger = purple_log_logger_new("txt", _("Plain text"), 11,
+									 NULL,
+									 txt_logger_write,
+									 txt_logger_finalize,
+									 txt_logger_list,
+									 txt_logger_read,
+									 purple_log_common_sizer,
+									 txt_logger_total_size,
+									 txt_logger_list_syslog,
+									 NULL,
+									 purple_log_common_deleter,
+									 purple_log_common_is_deletable);
+	purple_log_logger_add(txt_logger);
+
+	old_logger = purple_log_logger_new("old", _("Old flat format"), 9,
+									 NULL,
+									 NULL,
+									 old_logger_finalize,
+									 old_logger_list,
+									 old_logger_read,
+									 old_logger_size,
+									 old_logger_total_size,
+									 NULL,
+									 old_logger_get_log_sets);
+	purple_log_logger_add(old_logger);
+
+	indexed_logger = purple_log_logger_new("indexed", _("Indexed"), 11,
+									 NULL,
+									 indexed_logger_write,
+									 indexed_logger_finalize,
+									 indexed_logger_list,
+									 indexed_logger_read,
+									 indexed_logger_size,
+									 indexed_logger_total_size,
+									 indexed_logger_list_syslog,
+									 NULL,
+									 indexed_logger_remove,
+									 indexed_logger_is_deletable);
+	purple_log_logger_add(indexed_logger);
+	indexed_logger_dirs = g_hash_table_new(g_str_hash, g_str_equal);
+
+	purple_signal_register(handle, "log-timestamp",
+			     purple_marshal_POINTER__POINTER_POINTER_BOOLEAN,
+	                     G_TYPE_STRING, 3,
+	                     PURPLE_TYPE_LOG,
+	                     G_TYPE_OBJECT,
+	                     G_TYPE_BOOLEAN);
+
+	purple_prefs_connect_callback(NULL, "/purple/logging/format",
+							    logger_pref_cb, NULL);
+	purple_prefs_trigger_callback("/purple/logging/format");
+
+	purple_prefs_connect_callback(handle, "/purple/logging/flush_interval",
+		log_writer_pref_cb, NULL);
+	purple_prefs_trigger_callback("/purple/logging/flush_interval");
+	purple_prefs_connect_callback(handle, "/purple/logging/sync",
+		log_writer_pref_cb, NULL);
+	purple_prefs_trigger_callback("/purple/logging/sync");
+
+	log_writer_start();
+	if (!log_writer_atexit_registered) {
+		atexit(log_writer_atexit);
+		log_writer_atexit_registered = TRUE;
+	}
+
+	logsize_users = g_hash_table_new_full((GHashFunc)_purple_logsize_user_hash,
+			(GEqualFunc)_purple_logsize_user_equal,
+			(GDestroyNotify)_purple_logsize_user_free_key, NULL);
+	logsize_users_decayed = g_hash_table_new_full((GHashFunc)_purple_logsize_user_hash,
+				(GEqualFunc)_purple_logsize_user_equal,
+				(GDestroyNotify)_purple_logsize_user_free_key, NULL);
+	log_search_indexes = g_hash_table_new_full(log_search_index_hash,
+			log_search_index_equal, NULL, log_search_index_free);
+}
+
+void
+purple_log_uninit(void)
+{
+	purple_signals_unregister_by_instance(purple_log_get_handle());
+
+	log_writer_stop(TRUE);
+
+	purple_log_logger_remove(html_logger);
+	purple_log_logger_free(html_logger);
+	html_logger = NULL;
+
+	purple_log_logger_remove(txt_logger);
+	purple_log_logger_free(txt_logger);
+	txt_logger = NULL;
+
+	purple_log_logger_remove(old_logger);
+	purple_log_logger_free(old_logger);
+	old_logger = NULL;
+
+	purple_log_logger_remove(indexed_logger);
+	purple_log_logger_free(indexed_logger);
+	indexed_logger = NULL;
+	/* Directories of logs that are still alive go away with their logs. */
+	g_hash_table_destroy(indexed_logger_dirs);
+	indexed_logger_dirs = NULL;
+	while (!g_queue_is_empty(&indexed_logger_dirs_unused)) {
+		IndexedLogDir *dir = g_queue_pop_head(&indexed_logger_dirs_unused);
+
+		dir->unused_link = NULL;
+		indexed_logger_dir_unref(dir);
+	}
+
+	g_hash_table_destroy(logsize_users);
+	g_hash_table_destroy(logsize_users_decayed);
+	g_hash_table_foreach(log_search_indexes, log_search_index_save_dirty,
+		NULL);
+	g_hash_table_destroy(log_search_indexes);
+	log_search_indexes = NULL;
+}
+
+static PurpleLog *
+purple_log_copy(PurpleLog *log)
+{
+	PurpleLog *log_copy;
+
+	g_return_val_if_fail(log != NULL, NULL);
+
+	log_copy = g_new(PurpleLog, 1);
+	*log_copy = *log;
+
+	return log_copy;
+}
+
+GType
+purple_log_get_type(void)
+{
+	static GType type = 0;
+
+	if (type == 0) {
+		type = g_boxed_type_register_static("PurpleLog",
+				(GBoxedCopyFunc)purple_log_copy,
+				(GBoxedFreeFunc)g_free);
+	}
+
+	return type;
+}
+
+/****************************************************************************
+ * LOGGERS ******************************************************************
+ ****************************************************************************/
+
+static char *log_get_timestamp(PurpleLog *log, GDateTime *when)
+{
+	gboolean show_date;
+	char *date;
+	GDateTime *dt;
+
+	dt = g_date_time_new_now_utc();
+	show_date = (log->type == PURPLE_LOG_SYSTEM) || (g_date_time_difference(dt, when) > 20L * G_TIME_SPAN_MINUTE);
+	g_date_time_unref(dt);
+
+	date = purple_signal_emit_return_1(purple_log_get_handle(),
+	                          "log-timestamp",
+	                          log, when, show_date);
+	if (date != NULL)
+		return date;
+
+	dt = g_date_time_to_local(when);
+	if (show_date)
+		date = g_date_time_format(dt, _("%x %X"));
+	else
+		date = g_date_time_format(dt, "%X");
+	g_date_time_unref(dt);
+
+	return date;
+}
+
+/* NOTE: This can return msg (which you may or may not want to g_free())
+ * NOTE: or a newly allocated string which you MUST g_free().
+ * TODO: XXX: does it really works?
+ */
+static char *
+convert_image_tags(const PurpleLog *log, const char *msg)
+{
+	const char *tmp;
+	const char *start;
+	const char *end;
+	GData *attributes;
+	GString *newmsg = NULL;
+
+	tmp = msg;
+
+	while (purple_markup_find_tag("img", tmp, &start, &end, &attributes)) {
+		int imgid = 0;
+		char *idstr = NULL;
+
+		if (newmsg == NULL)
+			newmsg = g_string_new("");
+
+		/* copy any text before the img tag */
+		if (tmp < start)
+			g_string_append_len(newmsg, tmp, start - tmp);
+
+		if ((idstr = g_datalist_get_data(&attributes, "id")) != NULL)
+			imgid = atoi(idstr);
+
+		if (imgid != 0)
+		{
+			FILE *image_file;
+			char *dir;
+			PurpleImage *image;
+			gconstpointer image_data;
+			const gchar *new_filename = NULL;
+			char *path = NULL;
+			size_t image_byte_count;
+
+			image = purple_image_store_get(imgid);
+			if (image == NULL)
+			{
+				/* This should never happen. */
+				/* This *does* happen for failed Direct-IMs -DAA */
+				g_string_free(newmsg, TRUE);
+				g_return_val_if_reached((char *)msg);
+			}
+
+			image_data       = purple_image_get_data(image);
+			image_byte_count = purple_image_get_data_size(image);
+			dir              = purple_log_get_log_dir(log->type, log->name, log->account);
+			new_filename = purple_image_generate_filename(image);
+
+			path = g_build_filename(dir, new_filename, NULL);
+
+			/* Only save unique files. */
+			if (!g_file_test(path, G_FILE_TEST_EXISTS))
+			{
+				if ((image_file = g_fopen(path, "wb")) != NULL)
+				{
+					if (!fwrite(image_data, image_byte_count, 1, image_file))
+					{
+						purple_debug_error("log", "Error writing %s: %s\n",
+						                   path, g_strerror(errno));
+						fclose(image_file);
+
+						/* Attempt to not leave half-written files around. */
+						if (g_unlink(path)) {
+							purple_debug_error("log", "Error deleting partial "
+									"file %s: %s\n", path, g_strerror(errno));
+						}
+					}
+					else
+					{
+						purple_debug_info("log", "Wrote image file: %s\n", path);
+						fclose(image_file);
+					}
+				}
+				else
+				{
+					purple_debug_error("log", "Unable to create file %s: %s\n",
+					                   path, g_strerror(errno));
+				}
+			}
+
+			/* Write the new image tag */
+			g_string_append_printf(newmsg, "<img src=\"%s\">", new_filename);
+			g_free(path);
+		}
+
+		/* Continue from the end of the tag */
+		tmp = end + 1;
+	}
+
+	if (newmsg == NULL)
+	{
+		/* No images were found to change. */
+		return (char *)msg;
+	}
+
+	/* Append any remaining message data */
+	g_string_append(newmsg, tmp);
+
+	return g_string_free(newmsg, FALSE);
+}
+
+void purple_log_common_writer(PurpleLog *log, const char *ext)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+
+	if (data == NULL)
+	{
+		/* This log is new */
+		char *dir;
+		GDateTime *dt;
+		const char *tz;
+		gchar *date;
+		char *filename;
+		char *path;
+
+		dir = purple_log_get_log_dir(log->type, log->name, log->account);
+		if (dir == NULL)
+			return;
+
+		purple_build_dir (dir, S_IRUSR | S_IWUSR | S_IXUSR);
+
+		dt = g_date_time_to_local(log->time);
+		tz = purple_escape_filename(g_date_time_get_timezone_abbreviation(dt));
+		date = g_date_time_format(dt, "%Y-%m-%d.%H%M%S%z");
+		g_date_time_unref(dt);
+
+		filename = g_strdup_printf("%s%s%s", date, tz, ext ? ext : "");
+
+		path = g_build_filename(dir, filename, NULL);
+		g_free(dir);
+		g_free(date);
+		g_free(filename);
+
+		log->logger_data = data = g_slice_new0(PurpleLogCommonLoggerData);
+
+		data->file = g_fopen(path, "a");
+		if (data->file == NULL)
+		{
+			purple_debug(PURPLE_DEBUG_ERROR, "log",
+					"Could not create log file %s\n", path);
+
+			if (log->conv != NULL)
+				purple_conversation_write_system_message(log->conv,
+					_("Logging of this conversation failed."),
+					PURPLE_MESSAGE_ERROR);
+
+			g_free(path);
+			return;
+		}
+		g_free(path);
+	}
+}
+
+GList *purple_log_common_lister(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext, PurpleLogLogger *logger)
+{
+	GDir *dir;
+	GList *list = NULL;
+	const char *filename;
+	char *path;
+
+	if(!account)
+		return NULL;
+
+	path = purple_log_get_log_dir(type, name, account);
+	if (path == NULL)
+		return NULL;
+
+	if (!(dir = g_dir_open(path, 0, NULL)))
+	{
+		g_free(path);
+		return NULL;
+	}
+
+	while ((filename = g_dir_read_name(dir)))
+	{
+		if (purple_str_has_suffix(filename, ext) &&
+		    strlen(filename) >= (17 + strlen(ext)))
+		{
+			PurpleLog *log;
+			PurpleLogCommonLoggerData *data;
+			GDateTime *stamp = purple_str_to_date_time(purple_unescape_filename(filename), FALSE);
+
+			log = purple_log_new(type, name, account, NULL, stamp);
+			log->logger = logger;
+			log->logger_data = data = g_slice_new0(PurpleLogCommonLoggerData);
+
+			data->path = g_build_filename(path, filename, NULL);
+			list = g_list_prepend(list, log);
+
+			g_date_time_unref(stamp);
+		}
+	}
+	g_dir_close(dir);
+	g_free(path);
+	return list;
+}
+
+int purple_log_common_total_sizer(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext)
+{
+	GDir *dir;
+	int size = 0;
+	const char *filename;
+	char *path;
+
+	if(!account)
+		return 0;
+
+	path = purple_log_get_log_dir(type, name, account);
+	if (path == NULL)
+		return 0;
+
+	if (!(dir = g_dir_open(path, 0, NULL)))
+	{
+		g_free(path);
+		return 0;
+	}
+
+	while ((filename = g_dir_read_name(dir)))
+	{
+		if (purple_str_has_suffix(filename, ext) &&
+		    strlen(filename) >= (17 + strlen(ext)))
+		{
+			char *tmp = g_build_filename(path, filename, NULL);
+			GStatBuf st;
+			if (g_stat(tmp, &st))
+			{
+				purple_debug_error("log", "Error stating log file: %s\n", tmp);
+				g_free(tmp);
+				continue;
+			}
+			g_free(tmp);
+			size += st.st_size;
+		}
+	}
+	g_dir_close(dir);
+	g_free(path);
+	return size;
+}
+
+int purple_log_common_sizer(PurpleLog *log)
+{
+	GStatBuf st;
+	PurpleLogCommonLoggerData *data = log->logger_data;
+
+	g_return_val_if_fail(data != NULL, 0);
+
+	if (!data->path || g_stat(data->path, &st))
+		st.st_size = 0;
+
+	return st.st_size;
+}
+
+/* This will build log sets for all loggers that use the common logger
+ * functions because they use the same directory structure. */
+static void log_get_log_sets_common(GHashTable *sets)
+{
+	gchar *log_path = g_build_filename(purple_user_dir(), "logs", NULL);
+	GDir *log_dir = g_dir_open(log_path, 0, NULL);
+	const gchar *protocol;
+
+	if (log_dir == NULL) {
+		g_free(log_path);
+		return;
+	}
+
+	while ((protocol = g_dir_read_name(log_dir)) != NULL) {
+		gchar *protocol_path = g_build_filename(log_path, protocol, NULL);
+		GDir *protocol_dir;
+		const gchar *username;
+		gchar *protocol_unescaped;
+		GList *account_iter;
+		GList *accounts = NULL;
+
+		if ((protocol_dir = g_dir_open(protocol_path, 0, NULL)) == NULL) {
+			g_free(protocol_path);
+			continue;
+		}
+
+		/* Using g_strdup() to cover the one-in-a-million chance that a
+		 * protocol's list_icon function uses purple_unescape_filename(). */
+		protocol_unescaped = g_strdup(purple_unescape_filename(protocol));
+
+		/* Find all the accounts for protocol. */
+		for (account_iter = purple_accounts_get_all() ; account_iter != NULL ; account_iter = account_iter->next) {
+			PurpleProtocol *protocol;
+
+			protocol = purple_protocols_find(purple_account_get_protocol_id((PurpleAccount *)account_iter->data));
+			if (!protocol)
+				continue;
+
+			if (purple_strequal(protocol_unescaped, purple_protocol_class_list_icon(protocol, (PurpleAccount *)account_iter->data, NULL)))
+				accounts = g_list_prepend(accounts, account_iter->data);
+		}
+		g_free(protocol_unescaped);
+
+		while ((username = g_dir_read_name(protocol_dir)) != NULL) {
+			gchar *username_path = g_build_filename(protocol_path, username, NULL);
+			GDir *username_dir;
+			const gchar *username_unescaped;
+			PurpleAccount *account = NULL;
+			gchar *name;
+
+			if ((username_dir = g_dir_open(username_path, 0, NULL)) == NULL) {
+				g_free(username_path);
+				continue;
+			}
+
+			/* Find the account for username in the list of accounts for protocol. */
+			username_unescaped = purple_unescape_filename(username);
+			for (account_iter = g_list_first(accounts) ; account_iter != NULL ; account_iter = account_iter->next) {
 				if (purple_strequal(purple_account_get_username((PurpleAccount *)account_iter->data), username_unescaped)) {
 					account = account_iter->data;
 					break;
 				}
 			}
 
-			/* Don't worry about the cast, name will point to dynamically allocated memory shortly. */
-			while ((name = (gchar *)g_dir_read_name(username_dir)) != NULL) {
-				size_t len;
-				PurpleLogSet *set;
+			/* Don't worry about the cast, name will point to dynamically allocated memory shortly. */
+			while ((name = (gchar *)g_dir_read_name(username_dir)) != NULL) {
+				size_t len;
+				PurpleLogSet *set;
+
+				/* IMPORTANT: Always initialize all members of PurpleLogSet */
+				set = g_slice_new(PurpleLogSet);
+
+				/* Unescape the filename. */
+				name = g_strdup(purple_unescape_filename(name));
+
+				/* Get the (possibly new) length of name. */
+				len = strlen(name);
+
+				set->type = PURPLE_LOG_IM;
+				set->name = name;
+				set->account = account;
+				/* set->buddy is always set below */
+				set->normalized_name = g_strdup(purple_normalize(account, name));
+
+				/* Check for .chat or .system at the end of the name to determine the type. */
+				if (len >= 7) {
+					gchar *tmp = &name[len - 7];
+					if (purple_strequal(tmp, ".system")) {
+						set->type = PURPLE_LOG_SYSTEM;
+						*tmp = '\0';
+					}
+				}
+				if (len > 5) {
+					gchar *tmp = &name[len - 5];
+					if (purple_strequal(tmp, ".chat")) {
+						set->type = PURPLE_LOG_CHAT;
+						*tmp = '\0';
+					}
+				}
+
+				/* Determine if this (account, name) combination exists as a buddy. */
+				if (account != NULL && *name != '\0')
+					set->buddy = (purple_blist_find_buddy(account, name) != NULL);
+				else
+					set->buddy = FALSE;
+
+				log_add_log_set_to_hash(sets, set);
+			}
+			g_free(username_path);
+			g_dir_close(username_dir);
+		}
+		g_free(protocol_path);
+		g_list_free(accounts);
+		g_dir_close(protocol_dir);
+	}
+	g_free(log_path);
+	g_dir_close(log_dir);
+}
+
+gboolean purple_log_common_deleter(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data;
+	int ret;
+
+	g_return_val_if_fail(log != NULL, FALSE);
+
+	data = log->logger_data;
+	if (data == NULL)
+		return FALSE;
+
+	if (data->path == NULL)
+		return FALSE;
+
+	ret = g_unlink(data->path);
+	if (ret == 0)
+		return TRUE;
+	else if (ret == -1)
+	{
+		purple_debug_error("log", "Failed to delete: %s - %s\n", data->path, g_strerror(errno));
+	}
+	else
+	{
+		/* I'm not sure that g_unlink() will ever return
+		 * something other than 0 or -1. -- rlaager */
+		purple_debug_error("log", "Failed to delete: %s\n", data->path);
+	}
+
+	return FALSE;
+}
+
+gboolean purple_log_common_is_deletable(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data;
+#ifndef _WIN32
+	gchar *dirname;
+#endif
+
+	g_return_val_if_fail(log != NULL, FALSE);
+
+	data = log->logger_data;
+	if (data == NULL)
+		return FALSE;
+
+	if (data->path == NULL)
+		return FALSE;
+
+#ifndef _WIN32
+	dirname = g_path_get_dirname(data->path);
+	if (g_access(dirname, W_OK) == 0)
+	{
+		g_free(dirname);
+		return TRUE;
+	}
+	purple_debug_info("log", "access(%s) failed: %s\n", dirname, g_strerror(errno));
+	g_free(dirname);
+#else
+	/* Unless and until someone writes equivalent win32 code,
+	 * we'll assume the file is deletable. */
+	return TRUE;
+#endif
+
+	return FALSE;
+}
+
+static char *process_txt_log(char *txt, char *to_free)
+{
+	char *tmp;
+
+	/* The to_free argument allows us to save a
+	 * g_strdup() in some cases. */
+
+	if (to_free == NULL)
+		to_free = txt;
+
+	/* g_markup_escape_text requires valid UTF-8 */
+	if (!g_utf8_validate(txt, -1, NULL))
+	{
+		tmp = purple_utf8_salvage(txt);
+		g_free(to_free);
+		to_free = txt = tmp;
+	}
+
+	tmp = g_markup_escape_text(txt, -1);
+	g_free(to_free);
+	txt = purple_markup_linkify(tmp);
+	g_free(tmp);
+
+	return txt;
+}
+
+/****************************
+ ** HTML LOGGER *************
+ ****************************/
+
+/* Formats a message the way it's stored in HTML logs. */
+static void html_logger_format_message(PurpleLog *log, PurpleMessageFlags type,
+                                       const char *from, GDateTime *time,
+                                       const char *message, GString *out)
+{
+	char *msg_fixed;
+	char *image_corrected_msg;
+	char *date;
+	char *escaped_from;
+
+	escaped_from = g_markup_escape_text(from != NULL ? from : "<NULL>",
+			-1);
+
+	image_corrected_msg = convert_image_tags(log, message);
+	purple_markup_html_to_xhtml(image_corrected_msg, &msg_fixed, NULL);
+
+	/* Yes, this breaks encapsulation.  But it's a static function and
+	 * this saves a needless strdup(). */
+	if (image_corrected_msg != message)
+		g_free(image_corrected_msg);
+
+	date = log_get_timestamp(log, time);
+
+	if(log->type == PURPLE_LOG_SYSTEM){
+		g_string_append_printf(out, "---- %s @ %s ----<br/>\n", msg_fixed, date);
+	} else {
+		if (type & PURPLE_MESSAGE_SYSTEM)
+			g_string_append_printf(out, "<font size=\"2\">(%s)</font><b> %s</b><br/>\n", date, msg_fixed);
+		else if (type & PURPLE_MESSAGE_RAW)
+			g_string_append_printf(out, "<font size=\"2\">(%s)</font> %s<br/>\n", date, msg_fixed);
+		else if (type & PURPLE_MESSAGE_ERROR)
+			g_string_append_printf(out, "<font color=\"#FF0000\"><font size=\"2\">(%s)</font><b> %s</b></font><br/>\n", date, msg_fixed);
+		else if (type & PURPLE_MESSAGE_AUTO_RESP) {
+			if (type & PURPLE_MESSAGE_SEND)
+				g_string_append_printf(out, _("<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
+			else if (type & PURPLE_MESSAGE_RECV)
+				g_string_append_printf(out, _("<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
+		} else if (type & PURPLE_MESSAGE_RECV) {
+			if(purple_message_meify(msg_fixed, -1))
+				g_string_append_printf(out, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
+						date, escaped_from, msg_fixed);
+			else
+				g_string_append_printf(out, "<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
+						date, escaped_from, msg_fixed);
+		} else if (type & PURPLE_MESSAGE_SEND) {
+			if(purple_message_meify(msg_fixed, -1))
+				g_string_append_printf(out, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
+						date, escaped_from, msg_fixed);
+			else
+				g_string_append_printf(out, "<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
+						date, escaped_from, msg_fixed);
+		} else {
+			purple_debug_error("log", "Unhandled message type.\n");
+			g_string_append_printf(out, "<font size=\"2\">(%s)</font><b> %s:</b></font> %s<br/>\n",
+						date, escaped_from, msg_fixed);
+		}
+	}
+	g_free(date);
+	g_free(msg_fixed);
+	g_free(escaped_from);
+}
+
+static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
+                               const char *from, GDateTime *time, const char *message)
+{
+	char *header;
+	PurpleProtocol *protocol =
+			purple_protocols_find(purple_account_get_protocol_id(log->account));
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	GString *out;
+	gsize written;
+
+	out = g_string_new(NULL);
+
+	if(!data) {
+		const char *proto = purple_protocol_class_list_icon(protocol, log->account, NULL);
+		GDateTime *dt;
+		gchar *date;
+		purple_log_common_writer(log, ".html");
+
+		data = log->logger_data;
+
+		/* if we can't write to the file, give up before we hurt ourselves */
+		if(!data->file) {
+			g_string_free(out, TRUE);
+			return 0;
+		}
+
+		dt = g_date_time_to_local(log->time);
+		date = g_date_time_format(dt, "%c");
+		g_date_time_unref(dt);
+
+		g_string_append_printf(out, "<html><head>");
+		g_string_append_printf(out, "<meta http-equiv=\"content-type\" content=\"text/html; charset=UTF-8\">");
+		g_string_append_printf(out, "<title>");
+		if (log->type == PURPLE_LOG_SYSTEM)
+			header = g_strdup_printf("System log for account %s (%s) connected at %s",
+					purple_account_get_username(log->account), proto, date);
+		else
+			header = g_strdup_printf("Conversation with %s at %s on %s (%s)",
+					log->name, date, purple_account_get_username(log->account), proto);
+
+		g_string_append_printf(out, "%s", header);
+		g_string_append_printf(out, "</title></head><body>");
+		g_string_append_printf(out, "<h3>%s</h3>\n", header);
+		g_free(date);
+		g_free(header);
+	}
+
+	/* if we can't write to the file, give up before we hurt ourselves */
+	if(!data->file) {
+		g_string_free(out, TRUE);
+		return 0;
+	}
+
+	html_logger_format_message(log, type, from, time, message, out);
+
+	written = out->len;
+	log_writer_push(data->file, g_string_free(out, FALSE), written, FALSE);
+
+	return written;
+}
+
+static void html_logger_finalize(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	if (data) {
+		purple_log_common_close(log, "</body></html>\n");
+		g_free(data->path);
+
+		g_slice_free(PurpleLogCommonLoggerData, data);
+	}
+}
+
+static GList *html_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
+{
+	return purple_log_common_lister(type, sn, account, ".html", html_logger);
+}
+
+static GList *html_logger_list_syslog(PurpleAccount *account)
+{
+	return purple_log_common_lister(PURPLE_LOG_SYSTEM, ".system", account, ".html", html_logger);
+}
+
+static char *html_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
+{
+	char *read;
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	*flags = PURPLE_LOG_READ_NO_NEWLINE;
+	if (!data || !data->path)
+		return g_strdup(_("<font color=\"red\"><b>Unable to find log path!</b></font>"));
+	if (g_file_get_contents(data->path, &read, NULL, NULL)) {
+		char *minus_header = strchr(read, '\n');
+
+		if (!minus_header)
+			return read;
+
+		minus_header = g_strdup(minus_header + 1);
+		g_free(read);
+
+		return minus_header;
+	}
+	return g_strdup_printf(_("<font color=\"red\"><b>Could not read file: %s</b></font>"), data->path);
+}
+
+static int html_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account)
+{
+	return purple_log_common_total_sizer(type, name, account, ".html");
+}
+
+
+/****************************
+ ** PLAIN TEXT LOGGER *******
+ ****************************/
+
+static gsize txt_logger_write(PurpleLog *log, PurpleMessageFlags type,
+                              const char *from, GDateTime *time, const char *message)
+{
+	char *date;
+	PurpleProtocol *protocol =
+			purple_protocols_find(purple_account_get_protocol_id(log->account));
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	char *stripped = NULL;
+	GString *out;
+	gsize written;
+
+	out = g_string_new(NULL);
+
+	if (data == NULL) {
+		/* This log is new.  We could use the loggers 'new' function, but
+		 * creating a new file there would result in empty files in the case
+		 * that you open a convo with someone, but don't say anything.
+		 */
+		const char *proto = purple_protocol_class_list_icon(protocol, log->account, NULL);
+		GDateTime *dt;
+		gchar *date;
+		purple_log_common_writer(log, ".txt");
+
+		data = log->logger_data;
+
+		/* if we can't write to the file, give up before we hurt ourselves */
+		if(!data || !data->file) {
+			g_string_free(out, TRUE);
+			return 0;
+		}
+
+		dt = g_date_time_to_local(log->time);
+		date = g_date_time_format(dt, "%c");
+		if (log->type == PURPLE_LOG_SYSTEM)
+			g_string_append_printf(out, "System log for account %s (%s) connected at %s\n",
+				purple_account_get_username(log->account), proto,
+				date);
+		else
+			g_string_append_printf(out, "Conversation with %s at %s on %s (%s)\n",
+				log->name, date,
+				purple_account_get_username(log->account), proto);
+		g_free(date);
+		g_date_time_unref(dt);
+	}
+
+	/* if we can't write to the file, give up before we hurt ourselves */
+	if(!data->file) {
+		g_string_free(out, TRUE);
+		return 0;
+	}
+
+	stripped = purple_markup_strip_html(message);
+	date = log_get_timestamp(log, time);
+
+	if(log->type == PURPLE_LOG_SYSTEM){
+		g_string_append_printf(out, "---- %s @ %s ----\n", stripped, date);
+	} else {
+		if (type & PURPLE_MESSAGE_SEND ||
+			type & PURPLE_MESSAGE_RECV) {
+			if (type & PURPLE_MESSAGE_AUTO_RESP) {
+				g_string_append_printf(out, _("(%s) %s <AUTO-REPLY>: %s\n"), date,
+						from, stripped);
+			} else {
+				if(purple_message_meify(stripped, -1))
+					g_string_append_printf(out, "(%s) ***%s %s\n", date, from,
+							stripped);
+				else
+					g_string_append_printf(out, "(%s) %s: %s\n", date, from,
+							stripped);
+			}
+		} else if (type & PURPLE_MESSAGE_SYSTEM ||
+			type & PURPLE_MESSAGE_ERROR ||
+			type & PURPLE_MESSAGE_RAW)
+			g_string_append_printf(out, "(%s) %s\n", date, stripped);
+		else if (type & PURPLE_MESSAGE_NO_LOG) {
+			/* This shouldn't happen */
+			g_free(date);
+			g_free(stripped);
+			written = out->len;
+			log_writer_push(data->file, g_string_free(out, FALSE), written,
+				FALSE);
+			return written;
+		} else
+			g_string_append_printf(out, "(%s) %s%s %s\n", date, from ? from : "",
+					from ? ":" : "", stripped);
+	}
+	g_free(date);
+	g_free(stripped);
+
+	written = out->len;
+	log_writer_push(data->file, g_string_free(out, FALSE), written, FALSE);
+
+	return written;
+}
+
+static void txt_logger_finalize(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	if (data) {
+		purple_log_common_close(log, NULL);
+		g_free(data->path);
+
+		g_slice_free(PurpleLogCommonLoggerData, data);
+	}
+}
+
+static GList *txt_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
+{
+	return purple_log_common_lister(type, sn, account, ".txt", txt_logger);
+}
+
+static GList *txt_logger_list_syslog(PurpleAccount *account)
+{
+	return purple_log_common_lister(PURPLE_LOG_SYSTEM, ".system", account, ".txt", txt_logger);
+}
+
+static char *txt_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
+{
+	char *read, *minus_header;
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	*flags = 0;
+	if (!data || !data->path)
+		return g_strdup(_("<font color=\"red\"><b>Unable to find log path!</b></font>"));
+	if (g_file_get_contents(data->path, &read, NULL, NULL)) {
+		minus_header = strchr(read, '\n');
+
+		if (minus_header)
+			return process_txt_log(minus_header + 1, read);
+		else
+			return process_txt_log(read, NULL);
+	}
+	return g_strdup_printf(_("<font color=\"red\"><b>Could not read file: %s</b></font>"), data->path);
+}
 
-				/* IMPORTANT: Always initialize all members of PurpleLogSet */
-				set = g_slice_new(PurpleLogSet);
+static int txt_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account)
+{
+	return purple_log_common_total_sizer(type, name, account, ".txt");
+}
 
-				/* Unescape the filename. */
-				name = g_strdup(purple_unescape_filename(name));
 
-				/* Get the (possibly new) length of name. */
-				len = strlen(name);
+/****************************
+ ** INDEXED LOGGER **********
+ ****************************/
 
-				set->type = PURPLE_LOG_IM;
-				set->name = name;
-				set->account = account;
-				/* set->buddy is always set below */
-				set->normalized_name = g_strdup(purple_normalize(account, name));
+/* The indexed logger keeps all the logs of a conversation in two
+ * append-only files in its log directory. The segment file holds the
+ * messages as records tagged with the ID of their log. The index file holds
+ * a few fixed-size records per log, telling where it starts, where it ends
+ * and how big it is. The index of a directory is read once and kept in
+ * memory, so listing and sizing logs doesn't touch the disk again.
+ *
+ * Deleting a log overwrites its messages in place. Once deleted logs make
+ * up half of the segment, both files are rewritten without them the next
+ * time the directory is opened for writing.
+ *
+ * A directory stays loaded while any of its logs is alive, and the most
+ * recently used ones are kept around after that.
+ */
 
-				/* Check for .chat or .system at the end of the name to determine the type. */
-				if (len >= 7) {
-					gchar *tmp = &name[len - 7];
-					if (purple_strequal(tmp, ".system")) {
-						set->type = PURPLE_LOG_SYSTEM;
-						*tmp = '\0';
-					}
-				}
-				if (len > 5) {
-					gchar *tmp = &name[len - 5];
-					if (purple_strequal(tmp, ".chat")) {
-						set->type = PURPLE_LOG_CHAT;
-						*tmp = '\0';
-					}
-				}
+#define INDEXED_LOGGER_INDEX_FILE   "purple-log.idx"
+#define INDEXED_LOGGER_SEGMENT_FILE "purple-log.seg"
+
+/* Suffix of the files written by a compaction before they replace the
+ * current ones. */
+#define INDEXED_LOGGER_NEW_SUFFIX ".new"
+
+#define INDEXED_LOGGER_INDEX_MAGIC   "PLIDX001"
+#define INDEXED_LOGGER_SEGMENT_MAGIC "PLSEG001"
+#define INDEXED_LOGGER_MAGIC_LEN     8
+
+/* Segment records: magic, log ID and length, followed by the message. */
+#define INDEXED_LOGGER_RECORD_MAGIC       0x474c5350
+#define INDEXED_LOGGER_RECORD_HEADER_SIZE 12
+
+/* Index records: kind, log ID and three 64-bit values. */
+#define INDEXED_LOGGER_INDEX_RECORD_SIZE 32
+
+/* How many directories are kept loaded when none of their logs is alive. */
+#define INDEXED_LOGGER_UNUSED_DIRS_MAX 32
+
+typedef enum {
+	INDEXED_LOG_BEGIN = 1,   /* start time, first offset */
+	INDEXED_LOG_END = 2,     /* end offset, size */
+	INDEXED_LOG_DELETE = 3
+} IndexedLogRecordKind;
+
+typedef struct {
+	gint64 time;
+	guint64 first;
+	guint64 end;
+	guint64 size;
+	gboolean terminated;
+	gboolean writing;
+	gboolean deleted;
+} IndexedLogEntry;
+
+typedef struct {
+	gchar *path;
+	guint ref;
+	GList *unused_link;
+	GArray *logs;   /* log IDs are indices + 1 */
+	guint64 total_size;
+	guint64 deleted_size;
+
+	gboolean broken;
+	guint64 index_size;
+	guint64 segment_size;
+	FILE *index_file;
+	FILE *segment_file;
+	guint writers;
+} IndexedLogDir;
+
+struct indexed_logger_data {
+	IndexedLogDir *dir;
+	guint32 id;
+	gboolean writing;
+};
 
-				/* Determine if this (account, name) combination exists as a buddy. */
-				if (account != NULL && *name != '\0')
-					set->buddy = (purple_blist_find_buddy(account, name) != NULL);
-				else
-					set->buddy = FALSE;
+static inline guint32
+indexed_logger_get32(const guint8 *buf)
+{
+	guint32 val;
 
-				log_add_log_set_to_hash(sets, set);
-			}
-			g_free(username_path);
-			g_dir_close(username_dir);
+	memcpy(&val, buf, sizeof(val));
+	return GUINT32_FROM_LE(val);
+}
+
+static inline guint64
+indexed_logger_get64(const guint8 *buf)
+{
+	guint64 val;
+
+	memcpy(&val, buf, sizeof(val));
+	return GUINT64_FROM_LE(val);
+}
+
+static inline void
+indexed_logger_put32(guint8 *buf, guint32 val)
+{
+	val = GUINT32_TO_LE(val);
+	memcpy(buf, &val, sizeof(val));
+}
+
+static inline void
+indexed_logger_put64(guint8 *buf, guint64 val)
+{
+	val = GUINT64_TO_LE(val);
+	memcpy(buf, &val, sizeof(val));
+}
+
+static inline IndexedLogEntry *
+indexed_logger_entry(IndexedLogDir *dir, guint32 id)
+{
+	return &g_array_index(dir->logs, IndexedLogEntry, id - 1);
+}
+
+static void
+indexed_logger_put_index(guint8 *record, IndexedLogRecordKind kind,
+	guint32 id, guint64 val1, guint64 val2)
+{
+	memset(record, 0, INDEXED_LOGGER_INDEX_RECORD_SIZE);
+	indexed_logger_put32(record, kind);
+	indexed_logger_put32(record + 4, id);
+	indexed_logger_put64(record + 8, val1);
+	indexed_logger_put64(record + 16, val2);
+}
+
+static void
+indexed_logger_append_index_string(GString *index, IndexedLogRecordKind kind,
+	guint32 id, guint64 val1, guint64 val2)
+{
+	gsize len = index->len;
+
+	g_string_set_size(index, len + INDEXED_LOGGER_INDEX_RECORD_SIZE);
+	indexed_logger_put_index((guint8 *)index->str + len, kind, id, val1,
+		val2);
+}
+
+/* Reads the segment from first to end, or to its end if end is 0. */
+static guint8 *
+indexed_logger_read_segment(IndexedLogDir *dir, guint64 first, guint64 end,
+	gsize *len)
+{
+	gchar *path;
+	FILE *file;
+	guint8 *buf = NULL;
+
+	*len = 0;
+
+	path = g_build_filename(dir->path, INDEXED_LOGGER_SEGMENT_FILE, NULL);
+	file = g_fopen(path, "rb");
+	g_free(path);
+	if (file == NULL)
+		return NULL;
+
+	if (end == 0 && fseek(file, 0, SEEK_END) == 0)
+		end = ftell(file);
+
+	if (end > first && fseek(file, first, SEEK_SET) == 0) {
+		buf = g_malloc(end - first);
+		*len = fread(buf, 1, end - first, file);
+	}
+	fclose(file);
+
+	return buf;
+}
+
+/* Walks the records of a segment part starting at offset base, collecting
+ * the messages of log id into out (if not NULL). Stops at the first
+ * damaged record. */
+static void
+indexed_logger_parse_segment(const guint8 *buf, gsize len, guint64 base,
+	guint32 id, GString *out, guint64 *size, guint64 *end)
+{
+	gsize pos = 0;
+
+	while (pos + INDEXED_LOGGER_RECORD_HEADER_SIZE <= len) {
+		guint32 record_len;
+
+		if (indexed_logger_get32(buf + pos) != INDEXED_LOGGER_RECORD_MAGIC)
+			break;
+		record_len = indexed_logger_get32(buf + pos + 8);
+		if (record_len > len - pos - INDEXED_LOGGER_RECORD_HEADER_SIZE)
+			break;
+
+		pos += INDEXED_LOGGER_RECORD_HEADER_SIZE;
+		if (indexed_logger_get32(buf + pos - 8) == id) {
+			if (out != NULL)
+				g_string_append_len(out, (const gchar *)buf + pos,
+					record_len);
+			if (size != NULL)
+				*size += record_len;
+			if (end != NULL)
+				*end = base + pos + record_len;
 		}
-		g_free(protocol_path);
-		g_list_free(accounts);
-		g_dir_close(protocol_dir);
+		pos += record_len;
 	}
-	g_free(log_path);
-	g_dir_close(log_dir);
 }
 
-gboolean purple_log_common_deleter(PurpleLog *log)
+static gchar *
+indexed_logger_dir_file(IndexedLogDir *dir, const gchar *name,
+	gboolean new_file)
 {
-	PurpleLogCommonLoggerData *data;
-	int ret;
+	gchar *path = g_build_filename(dir->path, name, NULL);
 
-	g_return_val_if_fail(log != NULL, FALSE);
+	if (new_file) {
+		gchar *tmp = path;
 
-	data = log->logger_data;
-	if (data == NULL)
-		return FALSE;
+		path = g_strconcat(tmp, INDEXED_LOGGER_NEW_SUFFIX, NULL);
+		g_free(tmp);
+	}
 
-	if (data->path == NULL)
-		return FALSE;
+	return path;
+}
 
-	ret = g_unlink(data->path);
-	if (ret == 0)
+/* Overwrites the messages of log id in the segment. Its records are kept,
+ * with the ID 0, so the segment still parses. */
+static gboolean
+indexed_logger_erase(IndexedLogDir *dir, guint32 id)
+{
+	IndexedLogEntry *entry = indexed_logger_entry(dir, id);
+	gchar *path;
+	FILE *file;
+	guint8 *buf;
+	gsize len, pos = 0;
+	gboolean ret;
+
+	if (entry->end <= entry->first)
 		return TRUE;
-	else if (ret == -1)
+
+	/* Nothing else writes to the segment until this returns. */
+	purple_log_flush();
+
+	buf = indexed_logger_read_segment(dir, entry->first, entry->end, &len);
+	if (buf == NULL)
+		return FALSE;
+
+	while (pos + INDEXED_LOGGER_RECORD_HEADER_SIZE <= len) {
+		guint32 record_len;
+
+		if (indexed_logger_get32(buf + pos) != INDEXED_LOGGER_RECORD_MAGIC)
+			break;
+		record_len = indexed_logger_get32(buf + pos + 8);
+		if (record_len > len - pos - INDEXED_LOGGER_RECORD_HEADER_SIZE)
+			break;
+
+		if (indexed_logger_get32(buf + pos + 4) == id) {
+			indexed_logger_put32(buf + pos + 4, 0);
+			memset(buf + pos + INDEXED_LOGGER_RECORD_HEADER_SIZE, 0,
+				record_len);
+		}
+		pos += INDEXED_LOGGER_RECORD_HEADER_SIZE + record_len;
+	}
+
+	path = indexed_logger_dir_file(dir, INDEXED_LOGGER_SEGMENT_FILE, FALSE);
+	file = g_fopen(path, "r+b");
+	ret = file != NULL && fseek(file, entry->first, SEEK_SET) == 0 &&
+		fwrite(buf, 1, pos, file) == pos;
+	if (file != NULL && fclose(file) != 0)
+		ret = FALSE;
+	if (!ret) {
+		purple_debug_error("log", "Could not erase a log from %s: %s\n",
+			path, g_strerror(errno));
+	}
+	g_free(path);
+	g_free(buf);
+
+	return ret;
+}
+
+/* A compaction writes both new files, then renames the segment and then
+ * the index. If it was interrupted, this either drops the new files or
+ * renames the index, whichever matches the current segment. */
+static void
+indexed_logger_dir_finish_compaction(IndexedLogDir *dir)
+{
+	gchar *segment_new, *index_new;
+
+	segment_new = indexed_logger_dir_file(dir, INDEXED_LOGGER_SEGMENT_FILE,
+		TRUE);
+	index_new = indexed_logger_dir_file(dir, INDEXED_LOGGER_INDEX_FILE, TRUE);
+
+	if (g_file_test(segment_new, G_FILE_TEST_EXISTS)) {
+		g_unlink(segment_new);
+		g_unlink(index_new);
+	} else if (g_file_test(index_new, G_FILE_TEST_EXISTS)) {
+		gchar *index_path = indexed_logger_dir_file(dir,
+			INDEXED_LOGGER_INDEX_FILE, FALSE);
+
+		if (g_rename(index_new, index_path) != 0) {
+			purple_debug_error("log", "Could not rename %s: %s\n",
+				index_new, g_strerror(errno));
+		}
+		g_free(index_path);
+	}
+
+	g_free(segment_new);
+	g_free(index_new);
+}
+
+/* Rewrites the segment without the records of deleted logs, and the index
+ * with the new offsets. The log IDs don't change. Must not be called while
+ * the files are open for writing. */
+static void
+indexed_logger_dir_compact(IndexedLogDir *dir)
+{
+	GArray *logs;
+	GString *segment, *index;
+	gboolean *seen;
+	guint8 *buf;
+	gsize len, pos = INDEXED_LOGGER_MAGIC_LEN;
+	gchar *segment_path, *index_path, *segment_new, *index_new;
+	guint i;
+
+	g_return_if_fail(dir->writers <= 1 && dir->segment_file == NULL);
+
+	/* The last writers may have left their close queued. */
+	purple_log_flush();
+
+	buf = indexed_logger_read_segment(dir, 0, 0, &len);
+	if (buf == NULL)
+		return;
+
+	logs = g_array_sized_new(FALSE, TRUE, sizeof(IndexedLogEntry),
+		dir->logs->len);
+	g_array_append_vals(logs, dir->logs->data, dir->logs->len);
+	seen = g_new0(gboolean, logs->len);
+	segment = g_string_new_len(INDEXED_LOGGER_SEGMENT_MAGIC,
+		INDEXED_LOGGER_MAGIC_LEN);
+
+	while (pos + INDEXED_LOGGER_RECORD_HEADER_SIZE <= len) {
+		guint32 id, record_len;
+
+		if (indexed_logger_get32(buf + pos) != INDEXED_LOGGER_RECORD_MAGIC)
+			break;
+		id = indexed_logger_get32(buf + pos + 4);
+		record_len = indexed_logger_get32(buf + pos + 8);
+		if (record_len > len - pos - INDEXED_LOGGER_RECORD_HEADER_SIZE)
+			break;
+
+		if (id > 0 && id <= logs->len) {
+			IndexedLogEntry *entry = &g_array_index(logs, IndexedLogEntry,
+				id - 1);
+
+			if (!entry->deleted) {
+				if (!seen[id - 1])
+					entry->first = segment->len;
+				seen[id - 1] = TRUE;
+				g_string_append_len(segment, (const gchar *)buf + pos,
+					INDEXED_LOGGER_RECORD_HEADER_SIZE + record_len);
+				entry->end = segment->len;
+			}
+		}
+		pos += INDEXED_LOGGER_RECORD_HEADER_SIZE + record_len;
+	}
+	g_free(buf);
+
+	/* Only a record cut short by a crash may follow the last log. */
+	if (len < INDEXED_LOGGER_MAGIC_LEN || pos < dir->segment_size) {
+		purple_debug_error("log", "Not compacting the damaged logs in %s\n",
+			dir->path);
+		/* Don't try again until more logs are deleted. */
+		dir->deleted_size = 0;
+		g_string_free(segment, TRUE);
+		g_array_free(logs, TRUE);
+		g_free(seen);
+		return;
+	}
+
+	index = g_string_new_len(INDEXED_LOGGER_INDEX_MAGIC,
+		INDEXED_LOGGER_MAGIC_LEN);
+	for (i = 0; i < logs->len; i++) {
+		IndexedLogEntry *entry = &g_array_index(logs, IndexedLogEntry, i);
+
+		if (!seen[i])
+			entry->first = entry->end = segment->len;
+		if (entry->deleted)
+			entry->size = 0;
+		entry->terminated = TRUE;
+
+		indexed_logger_append_index_string(index, INDEXED_LOG_BEGIN, i + 1,
+			entry->time, entry->first);
+		indexed_logger_append_index_string(index, INDEXED_LOG_END, i + 1,
+			entry->end, entry->size);
+		if (entry->deleted) {
+			indexed_logger_append_index_string(index, INDEXED_LOG_DELETE,
+				i + 1, 0, 0);
+		}
+	}
+	g_free(seen);
+
+	segment_path = indexed_logger_dir_file(dir, INDEXED_LOGGER_SEGMENT_FILE,
+		FALSE);
+	index_path = indexed_logger_dir_file(dir, INDEXED_LOGGER_INDEX_FILE, FALSE);
+	segment_new = indexed_logger_dir_file(dir, INDEXED_LOGGER_SEGMENT_FILE,
+		TRUE);
+	index_new = indexed_logger_dir_file(dir, INDEXED_LOGGER_INDEX_FILE, TRUE);
+
+	if (!g_file_set_contents(segment_new, segment->str, segment->len, NULL) ||
+		!g_file_set_contents(index_new, index->str, index->len, NULL) ||
+		g_rename(segment_new, segment_path) != 0)
 	{
-		purple_debug_error("log", "Failed to delete: %s - %s\n", data->path, g_strerror(errno));
+		purple_debug_error("log", "Could not compact the logs in %s\n",
+			dir->path);
+		g_unlink(segment_new);
+		g_unlink(index_new);
+		g_array_free(logs, TRUE);
+	} else {
+		/* The segment is replaced, so the old index is no use anymore. If
+		 * the rename fails, the next load retries it. */
+		if (g_rename(index_new, index_path) != 0) {
+			purple_debug_error("log", "Could not rename %s: %s\n",
+				index_new, g_strerror(errno));
+			dir->broken = TRUE;
+		}
+
+		g_array_free(dir->logs, TRUE);
+		dir->logs = logs;
+		dir->segment_size = segment->len;
+		dir->index_size = index->len;
+		dir->deleted_size = 0;
 	}
-	else
+
+	g_free(segment_path);
+	g_free(index_path);
+	g_free(segment_new);
+	g_free(index_new);
+	g_string_free(segment, TRUE);
+	g_string_free(index, TRUE);
+}
+
+static IndexedLogDir *
+indexed_logger_dir_load(const gchar *path)
+{
+	IndexedLogDir *dir;
+	gchar *index_path;
+	gchar *contents = NULL;
+	gsize len = 0, pos;
+	guint i;
+
+	dir = g_new0(IndexedLogDir, 1);
+	dir->path = g_strdup(path);
+	dir->logs = g_array_new(FALSE, TRUE, sizeof(IndexedLogEntry));
+
+	index_path = g_build_filename(path, INDEXED_LOGGER_INDEX_FILE, NULL);
+	indexed_logger_dir_finish_compaction(dir);
+	if (!g_file_get_contents(index_path, &contents, &len, NULL))
+		len = 0;
+	g_free(index_path);
+
+	if (len > 0 && (len < INDEXED_LOGGER_MAGIC_LEN || memcmp(contents,
+		INDEXED_LOGGER_INDEX_MAGIC, INDEXED_LOGGER_MAGIC_LEN) != 0))
 	{
-		/* I'm not sure that g_unlink() will ever return
-		 * something other than 0 or -1. -- rlaager */
-		purple_debug_error("log", "Failed to delete: %s\n", data->path);
+		purple_debug_error("log", "Invalid log index in %s\n", path);
+		dir->broken = TRUE;
+		len = 0;
 	}
 
-	return FALSE;
+	for (pos = INDEXED_LOGGER_MAGIC_LEN;
+		pos + INDEXED_LOGGER_INDEX_RECORD_SIZE <= len;
+		pos += INDEXED_LOGGER_INDEX_RECORD_SIZE)
+	{
+		const guint8 *record = (const guint8 *)contents + pos;
+		guint32 kind = indexed_logger_get32(record);
+		guint32 id = indexed_logger_get32(record + 4);
+		IndexedLogEntry *entry;
+
+		if (kind == INDEXED_LOG_BEGIN && id == dir->logs->len + 1) {
+			IndexedLogEntry new_entry = { 0 };
+
+			new_entry.time = (gint64)indexed_logger_get64(record + 8);
+			new_entry.first = new_entry.end = indexed_logger_get64(record + 16);
+			g_array_append_val(dir->logs, new_entry);
+			continue;
+		}
+
+		if (id == 0 || id > dir->logs->len)
+			break;
+		entry = indexed_logger_entry(dir, id);
+
+		if (kind == INDEXED_LOG_END) {
+			entry->end = indexed_logger_get64(record + 8);
+			entry->size = indexed_logger_get64(record + 16);
+			entry->terminated = TRUE;
+		} else if (kind == INDEXED_LOG_DELETE) {
+			entry->deleted = TRUE;
+		} else {
+			break;
+		}
+	}
+	if (len > 0)
+		dir->index_size = pos;
+	g_free(contents);
+
+	for (i = 0; i < dir->logs->len; i++) {
+		IndexedLogEntry *entry = &g_array_index(dir->logs, IndexedLogEntry, i);
+
+		/* The log was still being written when we crashed. */
+		if (!entry->terminated) {
+			guint8 *buf;
+			gsize buf_len;
+
+			buf = indexed_logger_read_segment(dir, entry->first, 0, &buf_len);
+			entry->size = 0;
+			indexed_logger_parse_segment(buf, buf_len, entry->first, i + 1,
+				NULL, &entry->size, &entry->end);
+			g_free(buf);
+		}
+
+		dir->segment_size = MAX(dir->segment_size, entry->end);
+		if (entry->deleted)
+			dir->deleted_size += entry->size;
+		else
+			dir->total_size += entry->size;
+	}
+
+	return dir;
 }
 
-gboolean purple_log_common_is_deletable(PurpleLog *log)
+static IndexedLogDir *
+indexed_logger_dir_ref(IndexedLogDir *dir)
 {
-	PurpleLogCommonLoggerData *data;
-#ifndef _WIN32
-	gchar *dirname;
-#endif
+	dir->ref++;
 
-	g_return_val_if_fail(log != NULL, FALSE);
+	return dir;
+}
 
-	data = log->logger_data;
-	if (data == NULL)
-		return FALSE;
+static void
+indexed_logger_dir_unref(IndexedLogDir *dir)
+{
+	g_return_if_fail(dir->ref > 0);
 
-	if (data->path == NULL)
-		return FALSE;
+	if (--dir->ref > 0)
+		return;
 
-#ifndef _WIN32
-	dirname = g_path_get_dirname(data->path);
-	if (g_access(dirname, W_OK) == 0)
+	/* The files are closed when the last writer is released, which holds
+	 * a reference. */
+	g_warn_if_fail(dir->writers == 0);
+
+	/* The table is gone after purple_log_uninit(), or it may be a new one
+	 * with another copy of the directory. */
+	if (indexed_logger_dirs != NULL &&
+		g_hash_table_lookup(indexed_logger_dirs, dir->path) == dir)
 	{
-		g_free(dirname);
-		return TRUE;
+		g_hash_table_remove(indexed_logger_dirs, dir->path);
 	}
-	purple_debug_info("log", "access(%s) failed: %s\n", dirname, g_strerror(errno));
-	g_free(dirname);
-#else
-	/* Unless and until someone writes equivalent win32 code,
-	 * we'll assume the file is deletable. */
-	return TRUE;
-#endif
 
-	return FALSE;
+	g_array_free(dir->logs, TRUE);
+	g_free(dir->path);
+	g_free(dir);
 }
 
-static char *process_txt_log(char *txt, char *to_free)
+/* Returns a new reference. There is never more than one IndexedLogDir per
+ * path, so that writers don't step on each other. */
+static IndexedLogDir *
+indexed_logger_dir_get(PurpleLogType type, const char *name,
+	PurpleAccount *account)
 {
-	char *tmp;
+	IndexedLogDir *dir;
+	gchar *path;
 
-	/* The to_free argument allows us to save a
-	 * g_strdup() in some cases. */
+	path = purple_log_get_log_dir(type, name, account);
+	if (path == NULL)
+		return NULL;
+
+	dir = g_hash_table_lookup(indexed_logger_dirs, path);
+	if (dir == NULL) {
+		/* A copy of the directory that was dropped from the cache may
+		 * still have writes queued, which the sizes read from the files
+		 * must include. */
+		purple_log_flush();
+		dir = indexed_logger_dir_load(path);
+		g_hash_table_insert(indexed_logger_dirs, dir->path, dir);
+	}
+	g_free(path);
+
+	/* The queue holds a reference on the most recently used directories. */
+	if (dir->unused_link != NULL) {
+		g_queue_unlink(&indexed_logger_dirs_unused, dir->unused_link);
+		g_queue_push_head_link(&indexed_logger_dirs_unused, dir->unused_link);
+	} else {
+		g_queue_push_head(&indexed_logger_dirs_unused,
+			indexed_logger_dir_ref(dir));
+		dir->unused_link = indexed_logger_dirs_unused.head;
+	}
+
+	while (indexed_logger_dirs_unused.length > INDEXED_LOGGER_UNUSED_DIRS_MAX) {
+		IndexedLogDir *old = g_queue_pop_tail(&indexed_logger_dirs_unused);
+
+		old->unused_link = NULL;
+		indexed_logger_dir_unref(old);
+	}
+
+	return indexed_logger_dir_ref(dir);
+}
+
+/* Opens an index or segment file to continue writing at *size, or at its
+ * end if *size is 0. */
+static FILE *
+indexed_logger_open_file(IndexedLogDir *dir, const gchar *name,
+	const gchar *magic, guint64 *size)
+{
+	gchar *path;
+	FILE *file;
+
+	path = g_build_filename(dir->path, name, NULL);
+	file = g_fopen(path, "r+b");
+	if (file == NULL)
+		file = g_fopen(path, "w+b");
+	if (file == NULL) {
+		purple_debug_error("log", "Could not open log file %s: %s\n",
+			path, g_strerror(errno));
+		g_free(path);
+		return NULL;
+	}
+	g_free(path);
+
+	if (*size == 0 && fseek(file, 0, SEEK_END) == 0)
+		*size = ftell(file);
+	if (*size == 0) {
+		fwrite(magic, 1, INDEXED_LOGGER_MAGIC_LEN, file);
+		*size = INDEXED_LOGGER_MAGIC_LEN;
+	} else {
+		fseek(file, *size, SEEK_SET);
+	}
+
+	return file;
+}
+
+static void
+indexed_logger_append_index(IndexedLogDir *dir, IndexedLogRecordKind kind,
+	guint32 id, guint64 val1, guint64 val2)
+{
+	guint8 *record = g_malloc(INDEXED_LOGGER_INDEX_RECORD_SIZE);
+
+	indexed_logger_put_index(record, kind, id, val1, val2);
+	log_writer_push(dir->index_file, (gchar *)record,
+		INDEXED_LOGGER_INDEX_RECORD_SIZE, FALSE);
+	dir->index_size += INDEXED_LOGGER_INDEX_RECORD_SIZE;
+}
+
+static gboolean
+indexed_logger_dir_open(IndexedLogDir *dir)
+{
+	guint i;
+
+	if (dir->broken)
+		return FALSE;
 
-	if (to_free == NULL)
-		to_free = txt;
+	if (dir->writers++ > 0)
+		return TRUE;
 
-	/* g_markup_escape_text requires valid UTF-8 */
-	if (!g_utf8_validate(txt, -1, NULL))
+	if (dir->deleted_size > 0 && dir->deleted_size >=
+		(dir->segment_size - INDEXED_LOGGER_MAGIC_LEN) / 2)
 	{
-		tmp = purple_utf8_salvage(txt);
-		g_free(to_free);
-		to_free = txt = tmp;
+		indexed_logger_dir_compact(dir);
+		if (dir->broken) {
+			dir->writers--;
+			return FALSE;
+		}
 	}
 
-	tmp = g_markup_escape_text(txt, -1);
-	g_free(to_free);
-	txt = purple_markup_linkify(tmp);
-	g_free(tmp);
+	if (purple_build_dir(dir->path, S_IRUSR | S_IWUSR | S_IXUSR) != 0 ||
+		(dir->segment_file = indexed_logger_open_file(dir,
+			INDEXED_LOGGER_SEGMENT_FILE, INDEXED_LOGGER_SEGMENT_MAGIC,
+			&dir->segment_size)) == NULL ||
+		(dir->index_file = indexed_logger_open_file(dir,
+			INDEXED_LOGGER_INDEX_FILE, INDEXED_LOGGER_INDEX_MAGIC,
+			&dir->index_size)) == NULL)
+	{
+		if (dir->segment_file != NULL)
+			fclose(dir->segment_file);
+		dir->segment_file = NULL;
+		dir->writers--;
+		return FALSE;
+	}
 
-	return txt;
-}
+	/* Terminate the logs recovered after a crash, so they don't have to
+	 * be recovered again. */
+	for (i = 0; i < dir->logs->len; i++) {
+		IndexedLogEntry *entry = &g_array_index(dir->logs, IndexedLogEntry, i);
 
-/****************************
- ** HTML LOGGER *************
- ****************************/
+		if (!entry->terminated && !entry->writing) {
+			indexed_logger_append_index(dir, INDEXED_LOG_END, i + 1,
+				entry->end, entry->size);
+			entry->terminated = TRUE;
+		}
+	}
 
-static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
-                               const char *from, GDateTime *time, const char *message)
+	return TRUE;
+}
+
+static void
+indexed_logger_dir_release(IndexedLogDir *dir)
 {
-	char *msg_fixed;
-	char *image_corrected_msg;
-	char *date;
-	char *header;
-	char *escaped_from;
-	PurpleProtocol *protocol =
-			purple_protocols_find(purple_account_get_protocol_id(log->account));
-	PurpleLogCommonLoggerData *data = log->logger_data;
-	gsize written = 0;
+	g_return_if_fail(dir->writers > 0);
 
-	if(!data) {
-		const char *proto = purple_protocol_class_list_icon(protocol, log->account, NULL);
-		GDateTime *dt;
-		gchar *date;
-		purple_log_common_writer(log, ".html");
+	if (--dir->writers > 0)
+		return;
 
-		data = log->logger_data;
+	log_writer_push(dir->index_file, NULL, 0, TRUE);
+	log_writer_push(dir->segment_file, NULL, 0, TRUE);
+	dir->index_file = NULL;
+	dir->segment_file = NULL;
+}
 
-		/* if we can't write to the file, give up before we hurt ourselves */
-		if(!data->file)
+static gsize indexed_logger_write(PurpleLog *log, PurpleMessageFlags type,
+                                  const char *from, GDateTime *time, const char *message)
+{
+	struct indexed_logger_data *data = log->logger_data;
+	IndexedLogDir *dir;
+	IndexedLogEntry *entry;
+	GString *out;
+	gsize len;
+
+	if (data == NULL) {
+		IndexedLogEntry new_entry = { 0 };
+
+		/* This log is new. Like the other loggers, nothing is stored until
+		 * the first message. */
+		dir = indexed_logger_dir_get(log->type, log->name, log->account);
+		if (dir == NULL || !indexed_logger_dir_open(dir)) {
+			purple_debug_error("log", "Could not open the log of %s\n",
+				log->name);
+			if (dir != NULL)
+				indexed_logger_dir_unref(dir);
 			return 0;
+		}
 
-		dt = g_date_time_to_local(log->time);
-		date = g_date_time_format(dt, "%c");
-		g_date_time_unref(dt);
+		new_entry.time = g_date_time_to_unix(log->time);
+		new_entry.first = new_entry.end = dir->segment_size;
+		new_entry.writing = TRUE;
+		g_array_append_val(dir->logs, new_entry);
 
-		written += fprintf(data->file, "<html><head>");
-		written += fprintf(data->file, "<meta http-equiv=\"content-type\" content=\"text/html; charset=UTF-8\">");
-		written += fprintf(data->file, "<title>");
-		if (log->type == PURPLE_LOG_SYSTEM)
-			header = g_strdup_printf("System log for account %s (%s) connected at %s",
-					purple_account_get_username(log->account), proto, date);
-		else
-			header = g_strdup_printf("Conversation with %s at %s on %s (%s)",
-					log->name, date, purple_account_get_username(log->account), proto);
+		log->logger_data = data = g_slice_new0(struct indexed_logger_data);
+		data->dir = dir;
+		data->id = dir->logs->len;
+		data->writing = TRUE;
 
-		written += fprintf(data->file, "%s", header);
-		written += fprintf(data->file, "</title></head><body>");
-		written += fprintf(data->file, "<h3>%s</h3>\n", header);
-		g_free(date);
-		g_free(header);
+		indexed_logger_append_index(dir, INDEXED_LOG_BEGIN, data->id,
+			new_entry.time, new_entry.first);
 	}
 
-	/* if we can't write to the file, give up before we hurt ourselves */
-	if(!data->file)
+	/* Logs returned by the lister are read-only. */
+	if (!data->writing)
 		return 0;
 
-	escaped_from = g_markup_escape_text(from != NULL ? from : "<NULL>",
-			-1);
+	dir = data->dir;
+	entry = indexed_logger_entry(dir, data->id);
 
-	image_corrected_msg = convert_image_tags(log, message);
-	purple_markup_html_to_xhtml(image_corrected_msg, &msg_fixed, NULL);
+	out = g_string_new(NULL);
+	g_string_set_size(out, INDEXED_LOGGER_RECORD_HEADER_SIZE);
+	html_logger_format_message(log, type, from, time, message, out);
 
-	/* Yes, this breaks encapsulation.  But it's a static function and
-	 * this saves a needless strdup(). */
-	if (image_corrected_msg != message)
-		g_free(image_corrected_msg);
+	len = out->len - INDEXED_LOGGER_RECORD_HEADER_SIZE;
+	indexed_logger_put32((guint8 *)out->str, INDEXED_LOGGER_RECORD_MAGIC);
+	indexed_logger_put32((guint8 *)out->str + 4, data->id);
+	indexed_logger_put32((guint8 *)out->str + 8, len);
 
-	date = log_get_timestamp(log, time);
+	dir->segment_size += out->len;
+	dir->total_size += len;
+	entry->end = dir->segment_size;
+	entry->size += len;
 
-	if(log->type == PURPLE_LOG_SYSTEM){
-		written += fprintf(data->file, "---- %s @ %s ----<br/>\n", msg_fixed, date);
-	} else {
-		if (type & PURPLE_MESSAGE_SYSTEM)
-			written += fprintf(data->file, "<font size=\"2\">(%s)</font><b> %s</b><br/>\n", date, msg_fixed);
-		else if (type & PURPLE_MESSAGE_RAW)
-			written += fprintf(data->file, "<font size=\"2\">(%s)</font> %s<br/>\n", date, msg_fixed);
-		else if (type & PURPLE_MESSAGE_ERROR)
-			written += fprintf(data->file, "<font color=\"#FF0000\"><font size=\"2\">(%s)</font><b> %s</b></font><br/>\n", date, msg_fixed);
-		else if (type & PURPLE_MESSAGE_AUTO_RESP) {
-			if (type & PURPLE_MESSAGE_SEND)
-				written += fprintf(data->file, _("<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
-			else if (type & PURPLE_MESSAGE_RECV)
-				written += fprintf(data->file, _("<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
-		} else if (type & PURPLE_MESSAGE_RECV) {
-			if(purple_message_meify(msg_fixed, -1))
-				written += fprintf(data->file, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
-						date, escaped_from, msg_fixed);
-			else
-				written += fprintf(data->file, "<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
-						date, escaped_from, msg_fixed);
-		} else if (type & PURPLE_MESSAGE_SEND) {
-			if(purple_message_meify(msg_fixed, -1))
-				written += fprintf(data->file, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
-						date, escaped_from, msg_fixed);
-			else
-				written += fprintf(data->file, "<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
-						date, escaped_from, msg_fixed);
-		} else {
-			purple_debug_error("log", "Unhandled message type.\n");
-			written += fprintf(data->file, "<font size=\"2\">(%s)</font><b> %s:</b></font> %s<br/>\n",
-						date, escaped_from, msg_fixed);
-		}
-	}
-	g_free(date);
-	g_free(msg_fixed);
-	g_free(escaped_from);
-	fflush(data->file);
+	log_writer_push(dir->segment_file, (gchar *)out->str, out->len, FALSE);
+	g_string_free(out, FALSE);
 
-	return written;
+	return len;
 }
 
-static void html_logger_finalize(PurpleLog *log)
+static void indexed_logger_finalize(PurpleLog *log)
 {
-	PurpleLogCommonLoggerData *data = log->logger_data;
-	if (data) {
-		if(data->file) {
-			fprintf(data->file, "</body></html>\n");
-			fclose(data->file);
-		}
-		g_free(data->path);
+	struct indexed_logger_data *data = log->logger_data;
 
-		g_slice_free(PurpleLogCommonLoggerData, data);
+	if (data == NULL)
+		return;
+
+	if (data->writing) {
+		IndexedLogEntry *entry = indexed_logger_entry(data->dir, data->id);
+
+		indexed_logger_append_index(data->dir, INDEXED_LOG_END, data->id,
+			entry->end, entry->size);
+		entry->terminated = TRUE;
+		entry->writing = FALSE;
+		indexed_logger_dir_release(data->dir);
 	}
-}
 
-static GList *html_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
-{
-	return purple_log_common_lister(type, sn, account, ".html", html_logger);
+	indexed_logger_dir_unref(data->dir);
+	g_slice_free(struct indexed_logger_data, data);
 }
 
-static GList *html_logger_list_syslog(PurpleAccount *account)
+static GList *indexed_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
 {
-	return purple_log_common_lister(PURPLE_LOG_SYSTEM, ".system", account, ".html", html_logger);
-}
+	IndexedLogDir *dir;
+	GList *list = NULL;
+	guint i;
 
-static char *html_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
-{
-	char *read;
-	PurpleLogCommonLoggerData *data = log->logger_data;
-	*flags = PURPLE_LOG_READ_NO_NEWLINE;
-	if (!data || !data->path)
-		return g_strdup(_("<font color=\"red\"><b>Unable to find log path!</b></font>"));
-	if (g_file_get_contents(data->path, &read, NULL, NULL)) {
-		char *minus_header = strchr(read, '\n');
+	if (account == NULL)
+		return NULL;
 
-		if (!minus_header)
-			return read;
+	dir = indexed_logger_dir_get(type, sn, account);
+	if (dir == NULL)
+		return NULL;
 
-		minus_header = g_strdup(minus_header + 1);
-		g_free(read);
+	for (i = 0; i < dir->logs->len; i++) {
+		IndexedLogEntry *entry = &g_array_index(dir->logs, IndexedLogEntry, i);
+		struct indexed_logger_data *data;
+		GDateTime *stamp;
+		PurpleLog *log;
 
-		return minus_header;
+		if (entry->deleted)
+			continue;
+
+		stamp = g_date_time_new_from_unix_local(entry->time);
+		log = purple_log_new(type, sn, account, NULL, stamp);
+		g_date_time_unref(stamp);
+
+		log->logger = indexed_logger;
+		log->logger_data = data = g_slice_new0(struct indexed_logger_data);
+		data->dir = indexed_logger_dir_ref(dir);
+		data->id = i + 1;
+
+		list = g_list_prepend(list, log);
 	}
-	return g_strdup_printf(_("<font color=\"red\"><b>Could not read file: %s</b></font>"), data->path);
+
+	indexed_logger_dir_unref(dir);
+
+	return list;
 }
 
-static int html_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account)
+static GList *indexed_logger_list_syslog(PurpleAccount *account)
 {
-	return purple_log_common_total_sizer(type, name, account, ".html");
+	return indexed_logger_list(PURPLE_LOG_SYSTEM, ".system", account);
 }
 
+static char *indexed_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
+{
+	struct indexed_logger_data *data = log->logger_data;
+	IndexedLogEntry *entry;
+	GString *out;
+	guint8 *buf;
+	gsize len;
 
-/****************************
- ** PLAIN TEXT LOGGER *******
- ****************************/
+	*flags = PURPLE_LOG_READ_NO_NEWLINE;
+	if (data == NULL)
+		return g_strdup(_("<font color=\"red\"><b>Unable to find log path!</b></font>"));
 
-static gsize txt_logger_write(PurpleLog *log, PurpleMessageFlags type,
-                              const char *from, GDateTime *time, const char *message)
-{
-	char *date;
-	PurpleProtocol *protocol =
-			purple_protocols_find(purple_account_get_protocol_id(log->account));
-	PurpleLogCommonLoggerData *data = log->logger_data;
-	char *stripped = NULL;
+	entry = indexed_logger_entry(data->dir, data->id);
+	buf = indexed_logger_read_segment(data->dir, entry->first, entry->end,
+		&len);
+	if (buf == NULL && entry->end > entry->first)
+		return g_strdup_printf(_("<font color=\"red\"><b>Could not read file: %s</b></font>"),
+			data->dir->path);
 
-	gsize written = 0;
+	out = g_string_sized_new(entry->size);
+	indexed_logger_parse_segment(buf, len, entry->first, data->id, out,
+		NULL, NULL);
+	g_free(buf);
 
-	if (data == NULL) {
-		/* This log is new.  We could use the loggers 'new' function, but
-		 * creating a new file there would result in empty files in the case
-		 * that you open a convo with someone, but don't say anything.
-		 */
-		const char *proto = purple_protocol_class_list_icon(protocol, log->account, NULL);
-		GDateTime *dt;
-		gchar *date;
-		purple_log_common_writer(log, ".txt");
+	return g_string_free(out, FALSE);
+}
 
-		data = log->logger_data;
+static int indexed_logger_size(PurpleLog *log)
+{
+	struct indexed_logger_data *data = log->logger_data;
 
-		/* if we can't write to the file, give up before we hurt ourselves */
-		if(!data || !data->file)
-			return 0;
+	g_return_val_if_fail(data != NULL, 0);
 
-		dt = g_date_time_to_local(log->time);
-		date = g_date_time_format(dt, "%c");
-		if (log->type == PURPLE_LOG_SYSTEM)
-			written += fprintf(data->file, "System log for account %s (%s) connected at %s\n",
-				purple_account_get_username(log->account), proto,
-				date);
-		else
-			written += fprintf(data->file, "Conversation with %s at %s on %s (%s)\n",
-				log->name, date,
-				purple_account_get_username(log->account), proto);
-		g_free(date);
-		g_date_time_unref(dt);
-	}
+	return MIN(indexed_logger_entry(data->dir, data->id)->size, G_MAXINT);
+}
 
-	/* if we can't write to the file, give up before we hurt ourselves */
-	if(!data->file)
+static int indexed_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account)
+{
+	IndexedLogDir *dir;
+	int size;
+
+	if (account == NULL)
 		return 0;
 
-	stripped = purple_markup_strip_html(message);
-	date = log_get_timestamp(log, time);
+	dir = indexed_logger_dir_get(type, name, account);
+	if (dir == NULL)
+		return 0;
 
-	if(log->type == PURPLE_LOG_SYSTEM){
-		written += fprintf(data->file, "---- %s @ %s ----\n", stripped, date);
-	} else {
-		if (type & PURPLE_MESSAGE_SEND ||
-			type & PURPLE_MESSAGE_RECV) {
-			if (type & PURPLE_MESSAGE_AUTO_RESP) {
-				written += fprintf(data->file, _("(%s) %s <AUTO-REPLY>: %s\n"), date,
-						from, stripped);
-			} else {
-				if(purple_message_meify(stripped, -1))
-					written += fprintf(data->file, "(%s) ***%s %s\n", date, from,
-							stripped);
-				else
-					written += fprintf(data->file, "(%s) %s: %s\n", date, from,
-							stripped);
-			}
-		} else if (type & PURPLE_MESSAGE_SYSTEM ||
-			type & PURPLE_MESSAGE_ERROR ||
-			type & PURPLE_MESSAGE_RAW)
-			written += fprintf(data->file, "(%s) %s\n", date, stripped);
-		else if (type & PURPLE_MESSAGE_NO_LOG) {
-			/* This shouldn't happen */
-			g_free(stripped);
-			return written;
-		} else
-			written += fprintf(data->file, "(%s) %s%s %s\n", date, from ? from : "",
-					from ? ":" : "", stripped);
-	}
-	g_free(date);
-	g_free(stripped);
-	fflush(data->file);
+	size = MIN(dir->total_size, G_MAXINT);
+	indexed_logger_dir_unref(dir);
 
-	return written;
+	return size;
 }
 
-static void txt_logger_finalize(PurpleLog *log)
+static gboolean indexed_logger_remove(PurpleLog *log)
 {
-	PurpleLogCommonLoggerData *data = log->logger_data;
-	if (data) {
-		if(data->file)
-			fclose(data->file);
-		g_free(data->path);
+	struct indexed_logger_data *data = log->logger_data;
+	IndexedLogEntry *entry;
 
-		g_slice_free(PurpleLogCommonLoggerData, data);
+	g_return_val_if_fail(data != NULL, FALSE);
+
+	entry = indexed_logger_entry(data->dir, data->id);
+	if (entry->writing || entry->deleted)
+		return FALSE;
+
+	/* The space is reclaimed by the next compaction. */
+	if (!indexed_logger_erase(data->dir, data->id) ||
+		!indexed_logger_dir_open(data->dir))
+	{
+		return FALSE;
 	}
-}
+	indexed_logger_append_index(data->dir, INDEXED_LOG_DELETE, data->id,
+		0, 0);
+	indexed_logger_dir_release(data->dir);
 
-static GList *txt_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
-{
-	return purple_log_common_lister(type, sn, account, ".txt", txt_logger);
-}
+	/* The compaction may have moved it. */
+	entry = indexed_logger_entry(data->dir, data->id);
+	entry->deleted = TRUE;
+	data->dir->total_size -= entry->size;
+	data->dir->deleted_size += entry->size;
 
-static GList *txt_logger_list_syslog(PurpleAccount *account)
-{
-	return purple_log_common_lister(PURPLE_LOG_SYSTEM, ".system", account, ".txt", txt_logger);
+	return TRUE;
 }
 
-static char *txt_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
+static gboolean indexed_logger_is_deletable(PurpleLog *log)
 {
-	char *read, *minus_header;
-	PurpleLogCommonLoggerData *data = log->logger_data;
-	*flags = 0;
-	if (!data || !data->path)
-		return g_strdup(_("<font color=\"red\"><b>Unable to find log path!</b></font>"));
-	if (g_file_get_contents(data->path, &read, NULL, NULL)) {
-		minus_header = strchr(read, '\n');
+	struct indexed_logger_data *data = log->logger_data;
 
-		if (minus_header)
-			return process_txt_log(minus_header + 1, read);
-		else
-			return process_txt_log(read, NULL);
-	}
-	return g_strdup_printf(_("<font color=\"red\"><b>Could not read file: %s</b></font>"), data->path);
-}
+	if (data == NULL)
+		return FALSE;
 
-static int txt_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account)
-{
-	return purple_log_common_total_sizer(type, name, account, ".txt");
+	return !indexed_logger_entry(data->dir, data->id)->writing;
 }
 
 
@@ -41,6 +41,7 @@ typedef struct _PurpleLog PurpleLog;
 typedef struct _PurpleLogLogger PurpleLogLogger;
 typedef struct _PurpleLogCommonLoggerData PurpleLogCommonLoggerData;
 typedef struct _PurpleLogSet PurpleLogSet;
+typedef struct _PurpleLogSearchResult PurpleLogSearchResult;
 
 typedef enum {
 	PURPLE_LOG_IM,
@@ -156,6 +157,20 @@ struct _PurpleLog {
 	 * IMPORTANT: Update that code if you add members here. */
 };
 
+/**
+ * PurpleLogSearchResult:
+ * @log:     The matching log
+ * @offsets: The messages of @log matching the query, as a sorted #GArray of
+ *           #guint message numbers, counting from 0. It must not be
+ *           modified.
+ *
+ * A log found by purple_log_search().
+ */
+struct _PurpleLogSearchResult {
+	PurpleLog *log;
+	GArray *offsets;
+};
+
 /**
  * PurpleLogCommonLoggerData:
  *
@@ -409,6 +424,57 @@ gint purple_log_set_compare(gconstpointer y, gconstpointer z);
  */
 void purple_log_set_free(PurpleLogSet *set);
 
+/**
+ * purple_log_flush:
+ *
+ * Waits until everything queued for the log files is written. Reading,
+ * sizing and deleting logs do this implicitly.
+ */
+void purple_log_flush(void);
+
+/**
+ * purple_log_search:
+ * @logs:  (element-type PurpleLog): The logs to search.
+ * @query: The words to search for.
+ *
+ * Finds the logs containing all the words of @query. A word of @query
+ * matches any word of a log starting with it, ignoring case. This is not a
+ * substring search: "ello" doesn't match "hello", and punctuation in
+ * @query is ignored. The timestamps of the messages aren't searched.
+ *
+ * The logs are searched using an index of their words, which is saved in
+ * the log directory of each conversation. Logs that were added or changed
+ * since the index was saved are indexed again the first time one of the
+ * logs of their conversation is searched.
+ *
+ * Returns: (element-type PurpleLogSearchResult) (transfer full): The
+ *          matching logs, in the order of @logs. The results refer to the
+ *          logs in @logs, and must be freed with
+ *          purple_log_search_result_free().
+ */
+GList *purple_log_search(GList *logs, const char *query);
+
+/**
+ * purple_log_search_result_free:
+ * @result: The search result.
+ *
+ * Frees a search result returned by purple_log_search(). The log it refers
+ * to is not freed.
+ */
+void purple_log_search_result_free(PurpleLogSearchResult *result);
+
+/**
+ * purple_log_search_rebuild:
+ * @type:    The type of the logs.
+ * @name:    The name of the logs.
+ * @account: The account.
+ *
+ * Rebuilds the search index of a conversation from its logs, such as after
+ * they were changed outside of libpurple.
+ */
+void purple_log_search_rebuild(PurpleLogType type, const char *name,
+		PurpleAccount *account);
+
 /******************************************/
 /* Common Logger Functions                */
 /******************************************/
@@ -425,6 +491,10 @@ void purple_log_set_free(PurpleLogSet *set);
  * set to a PurpleLogCommonLoggerData struct containing the log
  * file handle and log path.
  *
+ * The file handle should be written with purple_log_common_write() and
+ * closed with purple_log_common_close(), which hand the work to the log
+ * writer thread.
+ *
  * This function is intended to be used as a "common"
  * implementation of a logger's <literal>write</literal> function.
  * It should only be passed to purple_log_logger_new() and never
@@ -432,6 +502,30 @@ void purple_log_set_free(PurpleLogSet *set);
  */
 void purple_log_common_writer(PurpleLog *log, const char *ext);
 
+/**
+ * purple_log_common_write:
+ * @log:   The log to write to.
+ * @text:  The text to append to the log file.
+ * @len:   The length of @text, or -1 if it's nul-terminated.
+ *
+ * Queues @text to be appended to a log file opened with
+ * purple_log_common_writer(). Queued text is written in batches by a
+ * background thread, at most "/purple/logging/flush_interval" milliseconds
+ * after it was queued.
+ */
+void purple_log_common_write(PurpleLog *log, const char *text, gssize len);
+
+/**
+ * purple_log_common_close:
+ * @log:    The log to close.
+ * @footer: (nullable): Text to write before closing the file.
+ *
+ * Queues closing a log file opened with purple_log_common_writer(), after
+ * everything queued for it so far is written. The log's file handle is
+ * unset and must not be used anymore.
+ */
+void purple_log_common_close(PurpleLog *log, const char *footer);
+
 /**
  * purple_log_common_lister:
  * @type:     The type of the logs being listed.
@@ -631,7 +725,8 @@ void *purple_log_get_handle(void);
 /**
  * purple_log_uninit:
  *
- * Uninitializes the log subsystem.
+ * Uninitializes the log subsystem. Everything queued for the log files is
+ * written before it returns.
  */
 void purple_log_uninit(void);
 
@@ -35,15 +35,29 @@
 #define PURPLE_MEMORY_POOL_DEFAULT_BLOCK_SIZE 1024
 #define PURPLE_MEMORY_POOL_DISABLED FALSE
 
+/* Chunks up to 256 bytes are rounded up to the multiply of 8 bytes, larger
+ * ones - to the power of two. */
+#define PURPLE_MEMORY_POOL_SMALL_CLASSES 32
+#define PURPLE_MEMORY_POOL_SMALL_CLASS_STEP 8
+#define PURPLE_MEMORY_POOL_SIZE_CLASSES (PURPLE_MEMORY_POOL_SMALL_CLASSES + \
+	sizeof(gsize) * 8)
+
 typedef struct _PurpleMemoryPoolBlock PurpleMemoryPoolBlock;
 
 typedef struct
 {
 	gboolean disabled;
 	gulong block_size;
+	gboolean recycle;
 
 	PurpleMemoryPoolBlock *first_block;
 	PurpleMemoryPoolBlock *last_block;
+
+	/* used in the recycling mode only */
+	PurpleMemoryPoolBlock *spare_blocks;
+	gpointer free_chunks[PURPLE_MEMORY_POOL_SIZE_CLASSES];
+
+	PurpleMemoryPoolStats stats;
 } PurpleMemoryPoolPrivate;
 
 struct _PurpleMemoryPoolBlock
@@ -53,10 +67,18 @@ struct _PurpleMemoryPoolBlock
 	PurpleMemoryPoolBlock *next;
 };
 
+/* In the recycling mode, every chunk is preceded with its size class. */
+typedef union
+{
+	guint64 padding;
+	guint size_class;
+} PurpleMemoryPoolChunkHeader;
+
 enum
 {
 	PROP_ZERO,
 	PROP_BLOCK_SIZE,
+	PROP_RECYCLE,
 	PROP_LAST
 };
 
@@ -68,6 +90,15 @@ static GParamSpec *properties[PROP_LAST];
  * Memory allocation/deallocation
  ******************************************************************************/
 
+static inline gsize
+purple_memory_pool_block_header_size(void)
+{
+	/* ceil block struct size to the multipy of align */
+	return ((sizeof(PurpleMemoryPoolBlock) - 1) /
+		PURPLE_MEMORY_POOL_BLOCK_PADDING + 1) *
+		sizeof(PurpleMemoryPoolBlock);
+}
+
 static PurpleMemoryPoolBlock *
 purple_memory_pool_block_new(gulong block_size)
 {
@@ -75,10 +106,7 @@ purple_memory_pool_block_new(gulong block_size)
 	PurpleMemoryPoolBlock *block;
 	gsize total_size;
 
-	/* ceil block struct size to the multipy of align */
-	total_size = ((sizeof(PurpleMemoryPoolBlock) - 1) /
-		PURPLE_MEMORY_POOL_BLOCK_PADDING + 1) *
-		sizeof(PurpleMemoryPoolBlock);
+	total_size = purple_memory_pool_block_header_size();
 	g_return_val_if_fail(block_size < G_MAXSIZE - total_size, NULL);
 	total_size += block_size;
 
@@ -97,24 +125,63 @@ purple_memory_pool_block_new(gulong block_size)
 	return block;
 }
 
-static gpointer
-purple_memory_pool_alloc_impl(PurpleMemoryPool *pool, gsize size, guint alignment)
+static inline gsize
+purple_memory_pool_block_capacity(PurpleMemoryPoolBlock *block)
 {
-	PurpleMemoryPoolPrivate *priv = PURPLE_MEMORY_POOL_GET_PRIVATE(pool);
-	PurpleMemoryPoolBlock *blk;
-	gpointer mem = NULL;
+	return (guintptr)block->end_ptr - (guintptr)block -
+		purple_memory_pool_block_header_size();
+}
 
-	g_return_val_if_fail(priv != NULL, NULL);
+/* Gets a block from the spare ones (if there is a large enough one) or
+ * allocates a new one. */
+static PurpleMemoryPoolBlock *
+purple_memory_pool_block_get(PurpleMemoryPoolPrivate *priv, gulong block_size)
+{
+	PurpleMemoryPoolBlock **it, *block;
+
+	for (it = &priv->spare_blocks; *it != NULL; it = &(*it)->next) {
+		block = *it;
+		if (purple_memory_pool_block_capacity(block) < block_size)
+			continue;
+
+		*it = block->next;
+		block->next = NULL;
+		block->available_ptr = PURPLE_MEMORY_POINTER_SHIFT(block,
+			sizeof(PurpleMemoryPoolBlock));
+		return block;
+	}
 
-	if (priv->disabled) {
-		/* XXX: this may cause some leaks */
-		return g_try_malloc(size);
+	block = purple_memory_pool_block_new(block_size);
+	if (block != NULL) {
+		priv->stats.blocks_count++;
+		priv->stats.bytes_reserved +=
+			purple_memory_pool_block_capacity(block);
 	}
 
-	g_return_val_if_fail(alignment <= PURPLE_MEMORY_POOL_BLOCK_PADDING, NULL);
-	g_warn_if_fail(alignment >= 1);
-	if (alignment < 1)
-		alignment = 1;
+	return block;
+}
+
+static void
+purple_memory_pool_blocks_free(PurpleMemoryPoolPrivate *priv,
+	PurpleMemoryPoolBlock *blk)
+{
+	while (blk) {
+		PurpleMemoryPoolBlock *next = blk->next;
+
+		priv->stats.blocks_count--;
+		priv->stats.bytes_reserved -=
+			purple_memory_pool_block_capacity(blk);
+		g_free(blk);
+		blk = next;
+	}
+}
+
+static gpointer
+purple_memory_pool_alloc_chunk(PurpleMemoryPoolPrivate *priv, gsize size,
+	guint alignment)
+{
+	PurpleMemoryPoolBlock *blk;
+	gpointer mem = NULL;
 
 	blk = priv->last_block;
 
@@ -132,7 +199,7 @@ purple_memory_pool_alloc_impl(PurpleMemoryPool *pool, gsize size, guint alignmen
 		gsize real_size = priv->block_size;
 		if (real_size < size)
 			real_size = size;
-		blk = purple_memory_pool_block_new(real_size);
+		blk = purple_memory_pool_block_get(priv, real_size);
 		g_return_val_if_fail(blk != NULL, NULL);
 
 		g_assert((priv->first_block == NULL) ==
@@ -160,6 +227,106 @@ purple_memory_pool_alloc_impl(PurpleMemoryPool *pool, gsize size, guint alignmen
 	return mem;
 }
 
+static inline guint
+purple_memory_pool_size_class(gsize size)
+{
+	if (size <= PURPLE_MEMORY_POOL_SMALL_CLASSES *
+		PURPLE_MEMORY_POOL_SMALL_CLASS_STEP)
+	{
+		return (size - 1) / PURPLE_MEMORY_POOL_SMALL_CLASS_STEP;
+	}
+
+	/* 257-512 bytes goes to the first class after small ones */
+	return PURPLE_MEMORY_POOL_SMALL_CLASSES + g_bit_storage(size - 1) - 9;
+}
+
+static inline gsize
+purple_memory_pool_class_size(guint size_class)
+{
+	if (size_class < PURPLE_MEMORY_POOL_SMALL_CLASSES)
+		return (size_class + 1) * PURPLE_MEMORY_POOL_SMALL_CLASS_STEP;
+
+	return (gsize)1 << (size_class - PURPLE_MEMORY_POOL_SMALL_CLASSES + 9);
+}
+
+static gpointer
+purple_memory_pool_alloc_impl(PurpleMemoryPool *pool, gsize size, guint alignment)
+{
+	PurpleMemoryPoolPrivate *priv = PURPLE_MEMORY_POOL_GET_PRIVATE(pool);
+	PurpleMemoryPoolChunkHeader *header;
+	guint size_class;
+	gpointer mem;
+
+	g_return_val_if_fail(priv != NULL, NULL);
+
+	if (priv->disabled) {
+		/* XXX: this may cause some leaks */
+		return g_try_malloc(size);
+	}
+
+	g_return_val_if_fail(alignment <= PURPLE_MEMORY_POOL_BLOCK_PADDING, NULL);
+	g_warn_if_fail(alignment >= 1);
+	if (alignment < 1)
+		alignment = 1;
+
+	if (!priv->recycle) {
+		mem = purple_memory_pool_alloc_chunk(priv, size, alignment);
+		if (mem == NULL)
+			return NULL;
+	} else {
+		/* Every chunk is aligned to PURPLE_MEMORY_POOL_BLOCK_PADDING,
+		 * so it may be reused for any other allocation of this
+		 * size class. */
+		size_class = purple_memory_pool_size_class(size);
+		size = purple_memory_pool_class_size(size_class);
+
+		mem = priv->free_chunks[size_class];
+		if (mem != NULL) {
+			priv->free_chunks[size_class] = *(gpointer *)mem;
+		} else {
+			header = purple_memory_pool_alloc_chunk(priv,
+				sizeof(PurpleMemoryPoolChunkHeader) + size,
+				PURPLE_MEMORY_POOL_BLOCK_PADDING);
+			if (header == NULL)
+				return NULL;
+			header->size_class = size_class;
+			mem = header + 1;
+		}
+	}
+
+	priv->stats.bytes_live += size;
+	if (priv->stats.bytes_live > priv->stats.bytes_live_max)
+		priv->stats.bytes_live_max = priv->stats.bytes_live;
+
+	return mem;
+}
+
+static gpointer
+purple_memory_pool_free_impl(PurpleMemoryPool *pool, gpointer mem)
+{
+	PurpleMemoryPoolPrivate *priv = PURPLE_MEMORY_POOL_GET_PRIVATE(pool);
+	PurpleMemoryPoolChunkHeader *header;
+	guint size_class;
+
+	g_return_val_if_fail(priv != NULL, NULL);
+
+	/* Without the size class, we can't tell the size of a chunk. */
+	if (priv->disabled || !priv->recycle)
+		return NULL;
+
+	header = (PurpleMemoryPoolChunkHeader *)mem - 1;
+	size_class = header->size_class;
+	g_return_val_if_fail(size_class < PURPLE_MEMORY_POOL_SIZE_CLASSES,
+		NULL);
+
+	*(gpointer *)mem = priv->free_chunks[size_class];
+	priv->free_chunks[size_class] = mem;
+
+	priv->stats.bytes_live -= purple_memory_pool_class_size(size_class);
+
+	return NULL;
+}
+
 static void
 purple_memory_pool_cleanup_impl(PurpleMemoryPool *pool)
 {
@@ -171,11 +338,21 @@ purple_memory_pool_cleanup_impl(PurpleMemoryPool *pool)
 	blk = priv->first_block;
 	priv->first_block = NULL;
 	priv->last_block = NULL;
-	while (blk) {
-		PurpleMemoryPoolBlock *next = blk->next;
-		g_free(blk);
-		blk = next;
+	priv->stats.bytes_live = 0;
+	memset(priv->free_chunks, 0, sizeof(priv->free_chunks));
+
+	/* Keep the blocks for the next use, instead of freeing them. */
+	if (priv->recycle && blk != NULL) {
+		PurpleMemoryPoolBlock *last = blk;
+
+		while (last->next)
+			last = last->next;
+		last->next = priv->spare_blocks;
+		priv->spare_blocks = blk;
+		return;
 	}
+
+	purple_memory_pool_blocks_free(priv, blk);
 }
 
 
@@ -194,6 +371,61 @@ purple_memory_pool_set_block_size(PurpleMemoryPool *pool, gulong block_size)
 	g_object_notify_by_pspec(G_OBJECT(pool), properties[PROP_BLOCK_SIZE]);
 }
 
+gboolean
+purple_memory_pool_get_recycle(PurpleMemoryPool *pool)
+{
+	PurpleMemoryPoolPrivate *priv = PURPLE_MEMORY_POOL_GET_PRIVATE(pool);
+
+	g_return_val_if_fail(priv != NULL, FALSE);
+
+	return priv->recycle;
+}
+
+void
+purple_memory_pool_set_recycle(PurpleMemoryPool *pool, gboolean recycle)
+{
+	PurpleMemoryPoolPrivate *priv = PURPLE_MEMORY_POOL_GET_PRIVATE(pool);
+
+	g_return_if_fail(priv != NULL);
+
+	if (priv->recycle == recycle)
+		return;
+
+	/* chunks allocated so far have no size class header */
+	g_return_if_fail(priv->first_block == NULL);
+
+	priv->recycle = recycle;
+	if (!recycle) {
+		purple_memory_pool_blocks_free(priv, priv->spare_blocks);
+		priv->spare_blocks = NULL;
+	}
+
+	g_object_notify_by_pspec(G_OBJECT(pool), properties[PROP_RECYCLE]);
+}
+
+void
+purple_memory_pool_get_stats(PurpleMemoryPool *pool,
+	PurpleMemoryPoolStats *stats)
+{
+	PurpleMemoryPoolPrivate *priv = PURPLE_MEMORY_POOL_GET_PRIVATE(pool);
+
+	g_return_if_fail(priv != NULL);
+	g_return_if_fail(stats != NULL);
+
+	*stats = priv->stats;
+}
+
+void
+purple_memory_pool_trim(PurpleMemoryPool *pool)
+{
+	PurpleMemoryPoolPrivate *priv = PURPLE_MEMORY_POOL_GET_PRIVATE(pool);
+
+	g_return_if_fail(priv != NULL);
+
+	purple_memory_pool_blocks_free(priv, priv->spare_blocks);
+	priv->spare_blocks = NULL;
+}
+
 gpointer
 purple_memory_pool_alloc(PurpleMemoryPool *pool, gsize size, guint alignment)
 {
@@ -281,6 +513,7 @@ static void
 purple_memory_pool_finalize(GObject *obj)
 {
 	purple_memory_pool_cleanup(PURPLE_MEMORY_POOL(obj));
+	purple_memory_pool_trim(PURPLE_MEMORY_POOL(obj));
 
 	G_OBJECT_CLASS(parent_class)->finalize(obj);
 }
@@ -296,6 +529,9 @@ purple_memory_pool_get_property(GObject *obj, guint param_id, GValue *value,
 		case PROP_BLOCK_SIZE:
 			g_value_set_ulong(value, priv->block_size);
 			break;
+		case PROP_RECYCLE:
+			g_value_set_boolean(value, priv->recycle);
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 	}
@@ -312,6 +548,10 @@ purple_memory_pool_set_property(GObject *obj, guint param_id,
 		case PROP_BLOCK_SIZE:
 			priv->block_size = g_value_get_ulong(value);
 			break;
+		case PROP_RECYCLE:
+			purple_memory_pool_set_recycle(pool,
+				g_value_get_boolean(value));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 	}
@@ -331,6 +571,7 @@ purple_memory_pool_class_init(PurpleMemoryPoolClass *klass)
 	obj_class->set_property = purple_memory_pool_set_property;
 
 	klass->palloc = purple_memory_pool_alloc_impl;
+	klass->pfree = purple_memory_pool_free_impl;
 	klass->cleanup = purple_memory_pool_cleanup_impl;
 
 	properties[PROP_BLOCK_SIZE] = g_param_spec_ulong("block-size",
@@ -338,6 +579,12 @@ purple_memory_pool_class_init(PurpleMemoryPoolClass *klass)
 		0, G_MAXULONG, PURPLE_MEMORY_POOL_DEFAULT_BLOCK_SIZE,
 		G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
 
+	properties[PROP_RECYCLE] = g_param_spec_boolean("recycle",
+		"Recycle", "Determines, if the freed chunks of memory are reused "
+		"for the subsequent allocations and if the blocks are kept for "
+		"reuse on cleanup.", FALSE,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
+
 	g_object_class_install_properties(obj_class, PROP_LAST, properties);
 }
 
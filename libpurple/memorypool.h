@@ -35,12 +35,18 @@
  * It's purpose is to act as an internal storage for other object private
  * structures, like tree nodes, string chunks, list elements.
  *
- * Current implementation is not optimized for releasing individual objects,
- * so it may be extremely inefficient, when misused. On every memory allocation,
- * it checks if there is enough space in current block. If there is not enough
- * room here, it creates another block of memory. On pool destruction or calling
+ * By default, it's not optimized for releasing individual objects, so it may
+ * be extremely inefficient, when misused. On every memory allocation, it checks
+ * if there is enough space in current block. If there is not enough room here,
+ * it creates another block of memory. On pool destruction or calling
  * #purple_memory_pool_cleanup, the whole block chain will be freed, using only
  * one #g_free call for every block.
+ *
+ * For long-lived pools, where objects are often released, there is
+ * a recycling mode (see #PurpleMemoryPool:recycle). In this mode, every chunk
+ * is rounded up to one of size classes and freed chunks are kept on per-class
+ * lists to be reused by next allocations. Blocks are not freed on cleanup, but
+ * kept for reuse, until #purple_memory_pool_trim is called.
  */
 
 #include <glib-object.h>
@@ -59,6 +65,7 @@
 
 typedef struct _PurpleMemoryPool PurpleMemoryPool;
 typedef struct _PurpleMemoryPoolClass PurpleMemoryPoolClass;
+typedef struct _PurpleMemoryPoolStats PurpleMemoryPoolStats;
 
 /**
  * PurpleMemoryPool:
@@ -99,6 +106,25 @@ struct _PurpleMemoryPoolClass
 	void (*purple_reserved4)(void);
 };
 
+/**
+ * PurpleMemoryPoolStats:
+ * @bytes_reserved: the total size of blocks held by the pool, including the
+ *                  ones kept for reuse.
+ * @bytes_live: the total size of allocated chunks. Without the recycling mode,
+ *              freed chunks are not subtracted.
+ * @bytes_live_max: the highest value of @bytes_live so far.
+ * @blocks_count: the number of blocks held by the pool.
+ *
+ * Memory usage statistics of a #PurpleMemoryPool.
+ */
+struct _PurpleMemoryPoolStats
+{
+	gsize bytes_reserved;
+	gsize bytes_live;
+	gsize bytes_live_max;
+	guint blocks_count;
+};
+
 G_BEGIN_DECLS
 
 /**
@@ -130,6 +156,50 @@ purple_memory_pool_new(void);
 void
 purple_memory_pool_set_block_size(PurpleMemoryPool *pool, gulong block_size);
 
+/**
+ * purple_memory_pool_get_recycle:
+ * @pool: the memory pool.
+ *
+ * Checks, if the pool works in the recycling mode.
+ *
+ * Returns: %TRUE, if freed memory is recycled, %FALSE otherwise.
+ */
+gboolean
+purple_memory_pool_get_recycle(PurpleMemoryPool *pool);
+
+/**
+ * purple_memory_pool_set_recycle:
+ * @pool: the memory pool.
+ * @recycle: %TRUE, if freed memory should be recycled, %FALSE otherwise.
+ *
+ * Enables or disables the recycling mode. It can't be changed while there is
+ * any memory allocated within a pool, so set it right after creating the pool
+ * (or after #purple_memory_pool_cleanup).
+ */
+void
+purple_memory_pool_set_recycle(PurpleMemoryPool *pool, gboolean recycle);
+
+/**
+ * purple_memory_pool_get_stats:
+ * @pool: the memory pool.
+ * @stats: the structure to fill.
+ *
+ * Gets memory usage statistics of a pool.
+ */
+void
+purple_memory_pool_get_stats(PurpleMemoryPool *pool,
+	PurpleMemoryPoolStats *stats);
+
+/**
+ * purple_memory_pool_trim:
+ * @pool: the memory pool.
+ *
+ * Frees all blocks kept for reuse after #purple_memory_pool_cleanup in
+ * the recycling mode. Blocks in use are not affected.
+ */
+void
+purple_memory_pool_trim(PurpleMemoryPool *pool);
+
 /**
  * purple_memory_pool_alloc:
  * @pool: the memory pool.
@@ -167,7 +237,8 @@ purple_memory_pool_alloc0(PurpleMemoryPool *pool, gsize size, guint alignment);
  * Frees a memory allocated within a memory pool. This can be a no-op in certain
  * implementations. Thus, it don't need to be called in every case. Thus, the
  * freed memory is wasted until you call #purple_memory_pool_cleanup
- * or destroy the @pool.
+ * or destroy the @pool. In the recycling mode, it will be reused by next
+ * allocations.
  */
 void
 purple_memory_pool_free(PurpleMemoryPool *pool, gpointer mem);
@@ -117,11 +117,15 @@ static gboolean chat_user_leaving_cb(PurpleConversation *conv, const char *name,
 	return should_hide_notice(conv, name, users);
 }
 
-static gboolean chat_user_joining_cb(PurpleConversation *conv, const char *name,
-                                      PurpleChatUserFlags flags,
-                                      GHashTable *users)
+static void chat_users_joining_cb(PurpleConversation *conv, GList *names,
+                                  GList *flags, GHashTable *hidden,
+                                  GHashTable *users)
 {
-	return should_hide_notice(conv, name, users);
+	for (; names != NULL; names = names->next)
+	{
+		if (should_hide_notice(conv, names->data, users))
+			g_hash_table_add(hidden, names->data);
+	}
 }
 
 static void received_chat_msg_cb(PurpleAccount *account, char *sender,
@@ -247,8 +251,8 @@ static gboolean plugin_load(PurplePlugin *plugin, GError **error)
 	                              g_free);
 
 	conv_handle = purple_conversations_get_handle();
-	purple_signal_connect(conv_handle, "chat-user-joining", plugin,
-	                    PURPLE_CALLBACK(chat_user_joining_cb), users);
+	purple_signal_connect(conv_handle, "chat-users-joining", plugin,
+	                    PURPLE_CALLBACK(chat_users_joining_cb), users);
 	purple_signal_connect(conv_handle, "chat-user-leaving", plugin,
 	                    PURPLE_CALLBACK(chat_user_leaving_cb), users);
 	purple_signal_connect(conv_handle, "received-chat-msg", plugin,
@@ -611,8 +611,8 @@ purple_account_presence_get_account(const PurpleAccountPresence *presence)
 	return priv->account;
 }
 
-static int
-purple_buddy_presence_compute_score(const PurpleBuddyPresence *buddy_presence)
+int
+purple_buddy_presence_get_score(const PurpleBuddyPresence *buddy_presence)
 {
 	GList *l;
 	int score = 0;
@@ -665,10 +665,10 @@ purple_buddy_presence_compare(const PurpleBuddyPresence *buddy_presence1,
 		return 1;
 
 	/* Compute the score of the first set of statuses. */
-	score1 = purple_buddy_presence_compute_score(buddy_presence1);
+	score1 = purple_buddy_presence_get_score(buddy_presence1);
 
 	/* Compute the score of the second set of statuses. */
-	score2 = purple_buddy_presence_compute_score(buddy_presence2);
+	score2 = purple_buddy_presence_get_score(buddy_presence2);
 
 	idle_time_1 = time(NULL) - purple_presence_get_idle_time(presence1);
 	idle_time_2 = time(NULL) - purple_presence_get_idle_time(presence2);
@@ -815,6 +815,7 @@ purple_buddy_presence_update_idle(PurplePresence *presence, gboolean old_idle)
 	PurpleBlistUiOps *ops = purple_blist_get_ui_ops();
 	PurpleAccount *account = purple_buddy_get_account(buddy);
 	gboolean idle = purple_presence_is_idle(presence);
+	gboolean batched = _purple_blist_presence_batch_add_idle(buddy, old_idle);
 
 	if (!old_idle && idle)
 	{
@@ -830,9 +831,13 @@ purple_buddy_presence_update_idle(PurplePresence *presence, gboolean old_idle)
 				tmp2 = g_markup_escape_text(tmp, -1);
 				g_free(tmp);
 
-				purple_log_write(log, PURPLE_MESSAGE_SYSTEM,
-				                 purple_buddy_get_alias(buddy),
-				                 current_time, tmp2);
+				if (!_purple_blist_presence_batch_add_log(account,
+						purple_buddy_get_alias(buddy), current_time, tmp2))
+				{
+					purple_log_write(log, PURPLE_MESSAGE_SYSTEM,
+					                 purple_buddy_get_alias(buddy),
+					                 current_time, tmp2);
+				}
 				g_free(tmp2);
 			}
 		}
@@ -851,15 +856,19 @@ purple_buddy_presence_update_idle(PurplePresence *presence, gboolean old_idle)
 				tmp2 = g_markup_escape_text(tmp, -1);
 				g_free(tmp);
 
-				purple_log_write(log, PURPLE_MESSAGE_SYSTEM,
-				                 purple_buddy_get_alias(buddy),
-				                 current_time, tmp2);
+				if (!_purple_blist_presence_batch_add_log(account,
+						purple_buddy_get_alias(buddy), current_time, tmp2))
+				{
+					purple_log_write(log, PURPLE_MESSAGE_SYSTEM,
+					                 purple_buddy_get_alias(buddy),
+					                 current_time, tmp2);
+				}
 				g_free(tmp2);
 			}
 		}
 	}
 
-	if (old_idle != idle)
+	if (!batched && old_idle != idle)
 		purple_signal_emit(purple_blist_get_handle(), "buddy-idle-changed", buddy,
 		                 old_idle, idle);
 
@@ -869,7 +878,7 @@ purple_buddy_presence_update_idle(PurplePresence *presence, gboolean old_idle)
 	 * connect to buddy-[un]idle signals and update from there
 	 */
 
-	if (ops != NULL && ops->update != NULL)
+	if (!batched && ops != NULL && ops->update != NULL)
 		ops->update(purple_blist_get_buddy_list(), (PurpleBlistNode *)buddy);
 
 	g_date_time_unref(current_time);
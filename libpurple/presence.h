@@ -220,6 +220,18 @@ PurpleBuddyPresence *purple_buddy_presence_new(PurpleBuddy *buddy);
  */
 PurpleBuddy *purple_buddy_presence_get_buddy(const PurpleBuddyPresence *presence);
 
+/**
+ * purple_buddy_presence_get_score:
+ * @presence: The presence.
+ *
+ * Returns the availability score purple_buddy_presence_compare() compares
+ * online presences by, before it adds the idle time score to the presence
+ * which has been idle for less time.
+ *
+ * Returns: The score of the presence. Higher is more available.
+ */
+int purple_buddy_presence_get_score(const PurpleBuddyPresence *presence);
+
 /**
  * purple_buddy_presence_compare:
  * @buddy_presence1: The first presence.
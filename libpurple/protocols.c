@@ -282,6 +282,8 @@ purple_protocol_got_user_idle(PurpleAccount *account, const char *name,
 	if ((list = purple_blist_find_buddies(account, name)) == NULL)
 		return;
 
+	_purple_blist_presence_batch_auto();
+
 	while (list) {
 		presence = purple_buddy_get_presence(list->data);
 		list = g_slist_delete_link(list, list);
@@ -338,6 +340,8 @@ purple_protocol_got_user_status(PurpleAccount *account, const char *name,
 	if((list = purple_blist_find_buddies(account, name)) == NULL)
 		return;
 
+	_purple_blist_presence_batch_auto();
+
 	for(l = list; l != NULL; l = l->next) {
 		buddy = l->data;
 
@@ -386,6 +390,8 @@ void purple_protocol_got_user_status_deactive(PurpleAccount *account, const char
 	if((list = purple_blist_find_buddies(account, name)) == NULL)
 		return;
 
+	_purple_blist_presence_batch_auto();
+
 	for(l = list; l != NULL; l = l->next) {
 		buddy = l->data;
 
@@ -32,6 +32,7 @@ typedef struct _FbJsonValue FbJsonValue;
 struct _FbJsonValue
 {
 	const gchar *expr;
+	gchar **members;
 	FbJsonType type;
 	gboolean required;
 	GValue value;
@@ -65,6 +66,7 @@ fb_json_values_dispose(GObject *obj)
 			g_value_unset(&value->value);
 		}
 
+		g_strfreev(value->members);
 		g_free(value);
 	}
 
@@ -286,18 +288,98 @@ fb_json_node_new(const gchar *data, gssize size, GError **error)
 	return root;
 }
 
+/*
+ * Splits a #JsonPath expression of the form $.a.b.c into its member
+ * names, or returns NULL if the expression uses anything fancier
+ * (wildcards, slices, filters, ...).  "$" alone yields an empty vector.
+ */
+static gchar **
+fb_json_path_split(const gchar *expr)
+{
+	const gchar *c;
+
+	if (expr[0] != '$') {
+		return NULL;
+	}
+
+	if (expr[1] == '\0') {
+		return g_new0(gchar *, 1);
+	}
+
+	if ((expr[1] != '.') || (expr[2] == '\0')) {
+		return NULL;
+	}
+
+	for (c = expr + 2; *c != '\0'; c++) {
+		if (*c == '.') {
+			/* Empty member names, including "..", aren't simple */
+			if ((c[-1] == '.') || (c[1] == '\0')) {
+				return NULL;
+			}
+		} else if (!g_ascii_isalnum(*c) && (*c != '_')) {
+			return NULL;
+		}
+	}
+
+	return g_strsplit(expr + 2, ".", -1);
+}
+
+/*
+ * Looks up a split expression by walking object members directly. The
+ * returned #JsonNode belongs to @root and must not be freed.
+ */
+static JsonNode *
+fb_json_node_lookup(JsonNode *root, gchar **members, const gchar *expr,
+                    GError **error)
+{
+	JsonNode *node = root;
+	guint i;
+
+	for (i = 0; members[i] != NULL; i++) {
+		if (!JSON_NODE_HOLDS_OBJECT(node)) {
+			node = NULL;
+			break;
+		}
+
+		node = json_object_get_member(json_node_get_object(node),
+		                              members[i]);
+
+		if (node == NULL) {
+			break;
+		}
+	}
+
+	if (node == NULL) {
+		g_set_error(error, FB_JSON_ERROR, FB_JSON_ERROR_NOMATCH,
+		            _("No matches for %s"), expr);
+		return NULL;
+	}
+
+	if (JSON_NODE_HOLDS_NULL(node)) {
+		g_set_error(error, FB_JSON_ERROR, FB_JSON_ERROR_NULL,
+		            _("Null value for %s"), expr);
+		return NULL;
+	}
+
+	return node;
+}
+
 JsonNode *
 fb_json_node_get(JsonNode *root, const gchar *expr, GError **error)
 {
 	GError *err = NULL;
+	gchar **members;
 	guint size;
 	JsonArray *rslt;
 	JsonNode *node;
 	JsonNode *ret;
 
-	/* Special case for json-glib < 0.99.2 */
-	if (purple_strequal(expr, "$")) {
-		return json_node_copy(root);
+	members = fb_json_path_split(expr);
+
+	if (members != NULL) {
+		node = fb_json_node_lookup(root, members, expr, error);
+		g_strfreev(members);
+		return (node != NULL) ? json_node_copy(node) : NULL;
 	}
 
 	node = json_path_query(expr, root, &err);
@@ -465,6 +547,7 @@ fb_json_values_add(FbJsonValues *values, FbJsonType type, gboolean required,
 
 	value = g_new0(FbJsonValue, 1);
 	value->expr = expr;
+	value->members = fb_json_path_split(expr);
 	value->type = type;
 	value->required = required;
 
@@ -547,15 +630,20 @@ fb_json_values_update(FbJsonValues *values, GError **error)
 
 	for (l = priv->queue->head; l != NULL; l = l->next) {
 		value = l->data;
-		node = fb_json_node_get(root, value->expr, &err);
+
+		/* Simple expressions are looked up in place, without a copy */
+		if (value->members != NULL) {
+			node = fb_json_node_lookup(root, value->members,
+			                           value->expr, &err);
+		} else {
+			node = fb_json_node_get(root, value->expr, &err);
+		}
 
 		if (G_IS_VALUE(&value->value)) {
 			g_value_unset(&value->value);
 		}
 
 		if (err != NULL) {
-			json_node_free(node);
-
 			if (value->required) {
 				g_propagate_error(error, err);
 				return FALSE;
@@ -573,12 +661,19 @@ fb_json_values_update(FbJsonValues *values, GError **error)
 			            g_type_name(value->type),
 			            g_type_name(type),
 				    value->expr);
-			json_node_free(node);
+
+			if (value->members == NULL) {
+				json_node_free(node);
+			}
+
 			return FALSE;
 		}
 
 		json_node_get_value(node, &value->value);
-		json_node_free(node);
+
+		if (value->members == NULL) {
+			json_node_free(node);
+		}
 	}
 
 	priv->next = priv->queue->head;
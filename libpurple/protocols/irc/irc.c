@@ -430,9 +430,8 @@ irc_login_cb(GObject *source, GAsyncResult *res, gpointer user_data)
 			g_io_stream_get_output_stream(G_IO_STREAM(irc->conn)));
 
 	if (do_login(gc)) {
-		irc->input = g_data_input_stream_new(
-				g_io_stream_get_input_stream(
-						G_IO_STREAM(irc->conn)));
+		irc->input = g_object_ref(g_io_stream_get_input_stream(
+				G_IO_STREAM(irc->conn)));
 		irc_read_input(irc);
 	}
 }
@@ -462,6 +461,10 @@ static void irc_close(PurpleConnection *gc)
 	g_clear_object(&irc->output);
 	g_clear_object(&irc->conn);
 
+	if (irc->inbuf_timer)
+		g_source_remove(irc->inbuf_timer);
+	g_free(irc->inbuf);
+
 	if (irc->timer)
 		g_source_remove(irc->timer);
 	g_hash_table_destroy(irc->cmds);
@@ -575,24 +578,50 @@ static void irc_remove_buddy(PurpleConnection *gc, PurpleBuddy *buddy, PurpleGro
 	}
 }
 
+/* Parses the complete lines received so far, for at most IRC_INPUT_BUDGET.
+ * Returns FALSE if some were left for later. */
+static gboolean
+irc_process_input(struct irc_conn *irc)
+{
+	gsize used;
+
+	used = irc_parse_lines(irc, irc->inbuf, irc->inbufused,
+			g_get_monotonic_time() + IRC_INPUT_BUDGET, irc_parse_msg);
+
+	irc->inbufused -= used;
+	memmove(irc->inbuf, irc->inbuf + used, irc->inbufused);
+
+	return memchr(irc->inbuf, '\n', irc->inbufused) == NULL;
+}
+
+static gboolean
+irc_process_input_cb(gpointer data)
+{
+	struct irc_conn *irc = data;
+
+	if (!irc_process_input(irc))
+		return TRUE;
+
+	irc->inbuf_timer = 0;
+	irc_read_input(irc);
+	return FALSE;
+}
+
 static void
 irc_read_input_cb(GObject *source, GAsyncResult *res, gpointer data)
 {
 	PurpleConnection *gc = data;
 	struct irc_conn *irc;
-	gchar *line;
-	gsize len;
-	gsize start = 0;
+	gssize len;
 	GError *error = NULL;
 
-	line = g_data_input_stream_read_line_finish(
-			G_DATA_INPUT_STREAM(source), res, &len, &error);
+	len = g_input_stream_read_finish(G_INPUT_STREAM(source), res, &error);
 
-	if (line == NULL && error != NULL) {
+	if (len < 0) {
 		g_prefix_error(&error, _("Lost connection with server: "));
 		purple_connection_take_error(gc, error);
 		return;
-	} else if (line == NULL) {
+	} else if (len == 0) {
 		purple_connection_take_error(gc, g_error_new_literal(
 			PURPLE_CONNECTION_ERROR,
 			PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
@@ -604,19 +633,14 @@ irc_read_input_cb(GObject *source, GAsyncResult *res, gpointer data)
 
 	purple_connection_update_last_received(gc);
 
-	if (len > 0 && line[len - 1] == '\r')
-		line[len - 1] = '\0';
-
-	/* This is a hack to work around the fact that marv gets messages
-	 * with null bytes in them while using some weird irc server at work
- 	 */
-	while (start < len && line[start] == '\0')
-		++start;
+	irc->inbufused += len;
 
-	if (len - start > 0)
-		irc_parse_msg(irc, line + start);
-
-	g_free(line);
+	/* Don't read any more until the backlog has been parsed, but let the
+	 * UI catch up in between. */
+	if (!irc_process_input(irc)) {
+		irc->inbuf_timer = g_idle_add(irc_process_input_cb, irc);
+		return;
+	}
 
 	irc_read_input(irc);
 }
@@ -626,7 +650,13 @@ irc_read_input(struct irc_conn *irc)
 {
 	PurpleConnection *gc = purple_account_get_connection(irc->account);
 
-	g_data_input_stream_read_line_async(irc->input,
+	if (irc->inbuflen - irc->inbufused < IRC_READ_SIZE) {
+		irc->inbuflen = MAX(irc->inbuflen * 2, irc->inbufused + IRC_READ_SIZE);
+		irc->inbuf = g_realloc(irc->inbuf, irc->inbuflen);
+	}
+
+	g_input_stream_read_async(irc->input,
+			irc->inbuf + irc->inbufused, irc->inbuflen - irc->inbufused,
 			G_PRIORITY_DEFAULT, irc->cancellable,
 			irc_read_input_cb, gc);
 }
@@ -57,6 +57,11 @@
 
 #define IRC_MAX_MSG_SIZE 512
 
+/* Bytes requested from the server per read */
+#define IRC_READ_SIZE 16384
+/* How long a single dispatch may spend parsing received lines */
+#define IRC_INPUT_BUDGET (G_USEC_PER_SEC / 50)
+
 #define IRC_NAMES_FLAG "irc-namelist"
 
 enum { IRC_USEROPT_SERVER, IRC_USEROPT_PORT, IRC_USEROPT_CHARSET };
@@ -85,9 +90,14 @@ struct irc_conn {
 	gboolean ison_outstanding;
 	GList *buddies_outstanding;
 
-	GDataInputStream *input;
+	GInputStream *input;
 	PurpleQueuedOutputStream *output;
 
+	char *inbuf;
+	gsize inbuflen;
+	gsize inbufused;
+	guint inbuf_timer;
+
 	GString *motd;
 	GString *names;
 	struct _whois {
@@ -154,6 +164,8 @@ void irc_register_commands(void);
 void irc_unregister_commands(void);
 void irc_msg_table_build(struct irc_conn *irc);
 void irc_parse_msg(struct irc_conn *irc, char *input);
+gsize irc_parse_lines(struct irc_conn *irc, char *buf, gsize len, gint64 deadline,
+		void (*parse)(struct irc_conn *irc, char *input));
 char *irc_parse_ctcp(struct irc_conn *irc, const char *from, const char *to, const char *msg, int notice);
 char *irc_format(struct irc_conn *irc, const char *format, ...);
 
@@ -805,6 +805,41 @@ void irc_parse_msg(struct irc_conn *irc, char *input)
 	g_free(from);
 }
 
+/*
+ * Hands every complete line in buf to parse, splitting them in place.
+ * Stops early once deadline (in monotonic time) has passed, unless it
+ * is 0.  Returns the number of bytes consumed; the caller keeps the rest
+ * for the next call.
+ */
+gsize irc_parse_lines(struct irc_conn *irc, char *buf, gsize len, gint64 deadline,
+		void (*parse)(struct irc_conn *irc, char *input))
+{
+	char *cur = buf, *end = buf + len, *nl;
+
+	while (cur < end && (nl = memchr(cur, '\n', end - cur)) != NULL) {
+		char *line = cur;
+
+		*nl = '\0';
+		if (nl > line && nl[-1] == '\r')
+			nl[-1] = '\0';
+		cur = nl + 1;
+
+		/* This is a hack to work around the fact that marv gets messages
+		 * with null bytes in them while using some weird irc server at work
+		 */
+		while (line < nl && *line == '\0')
+			++line;
+
+		if (line < nl)
+			parse(irc, line);
+
+		if (deadline && g_get_monotonic_time() >= deadline)
+			break;
+	}
+
+	return cur - buf;
+}
+
 static void irc_parse_error_cb(struct irc_conn *irc, char *input)
 {
 	char *clean;
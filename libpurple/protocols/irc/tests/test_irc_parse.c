@@ -0,0 +1,273 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "protocols.h"
+#include "signals.h"
+
+#include "../irc.h"
+#include "../../../tests/test_ui.h"
+
+/* Set by the plugin when it is loaded. */
+extern PurpleProtocol *_irc_protocol;
+
+static GPtrArray *parsed = NULL;
+
+static void
+test_irc_parse_collect(struct irc_conn *irc, char *input) {
+	g_ptr_array_add(parsed, g_strdup(input));
+}
+
+static void
+test_irc_parse_lines(void) {
+	const gchar stream[] = "PING :irc.example.net\r\n"
+	                       "\0\0:nick!user@host PRIVMSG #chan :hi\n"
+	                       "\r\n"
+	                       "\n"
+	                       ":irc.example.net 353 me = #chan :a b c\r\n"
+	                       ":irc.example.net 366 me #ch";
+	gchar *buf = g_memdup(stream, sizeof(stream) - 1);
+	gsize used;
+
+	parsed = g_ptr_array_new_with_free_func(g_free);
+
+	used = irc_parse_lines(NULL, buf, sizeof(stream) - 1, 0,
+	                       test_irc_parse_collect);
+
+	g_assert_cmpuint(used, ==,
+	                 sizeof(stream) - 1 - strlen(":irc.example.net 366 me #ch"));
+	g_assert_cmpuint(parsed->len, ==, 3);
+	g_assert_cmpstr(g_ptr_array_index(parsed, 0), ==, "PING :irc.example.net");
+	g_assert_cmpstr(g_ptr_array_index(parsed, 1), ==,
+	                ":nick!user@host PRIVMSG #chan :hi");
+	g_assert_cmpstr(g_ptr_array_index(parsed, 2), ==,
+	                ":irc.example.net 353 me = #chan :a b c");
+
+	/* Nothing complete is left */
+	g_assert_cmpuint(irc_parse_lines(NULL, buf + used, sizeof(stream) - 1 - used,
+	                 0, test_irc_parse_collect), ==, 0);
+	g_assert_cmpuint(parsed->len, ==, 3);
+
+	g_ptr_array_free(parsed, TRUE);
+	g_free(buf);
+}
+
+static void
+test_irc_parse_lines_deadline(void) {
+	gchar buf[] = "PING :a\r\nPING :b\r\nPING :c\r\n";
+	gsize len = strlen(buf), used = 0;
+	guint calls = 0;
+
+	parsed = g_ptr_array_new_with_free_func(g_free);
+
+	/* A deadline in the past still makes progress, one line at a time */
+	while (used < len) {
+		used += irc_parse_lines(NULL, buf + used, len - used, 1,
+		                        test_irc_parse_collect);
+		calls++;
+		g_assert_cmpuint(parsed->len, ==, calls);
+	}
+
+	g_assert_cmpuint(calls, ==, 3);
+	g_assert_cmpstr(g_ptr_array_index(parsed, 2), ==, "PING :c");
+
+	g_ptr_array_free(parsed, TRUE);
+}
+
+/******************************************************************************
+ * Benchmark
+ *****************************************************************************/
+static guint perf_lines = 0;
+
+static void
+perf_parse(struct irc_conn *irc, char *input) {
+	perf_lines++;
+	irc_parse_msg(irc, input);
+}
+
+/* Something like what joining a few big channels looks like on the wire */
+static GString *
+perf_stream(guint lines) {
+	GString *str = g_string_new(NULL);
+	guint i;
+
+	for (i = 0; i < lines; i++) {
+		switch (i % 4) {
+			case 0:
+				g_string_append_printf(str,
+					":irc.example.net 353 me = #chan%u :@op%u +voice%u "
+					"user%u user%u user%u user%u user%u\r\n",
+					i / 1000, i, i, i, i + 1, i + 2, i + 3, i + 4);
+				break;
+			case 1:
+				g_string_append_printf(str,
+					":user%u!~user%u@host-%u.example.com JOIN #chan%u\r\n",
+					i, i, i, i / 1000);
+				break;
+			case 2:
+				g_string_append_printf(str,
+					":user%u!~user%u@host-%u.example.com PRIVMSG #chan%u "
+					":netsplit over, welcome back everyone\r\n",
+					i, i, i, i / 1000);
+				break;
+			default:
+				g_string_append_printf(str,
+					":user%u!~user%u@host-%u.example.com QUIT "
+					":*.net *.split\r\n", i, i, i);
+				break;
+		}
+	}
+
+	return str;
+}
+
+/* A signed on connection with nothing behind it, so that the messages go
+ * through the real handlers. The channels aren't joined, so the handlers
+ * stop at looking the conversations up. */
+static struct irc_conn *
+perf_irc_new(void) {
+	struct irc_conn *irc = g_new0(struct irc_conn, 1);
+	PurpleConnection *gc;
+
+	irc->account = test_ui_account_new("me");
+	gc = test_ui_account_connect(irc->account);
+	purple_connection_set_protocol_data(gc, irc);
+
+	irc->msgs = g_hash_table_new(g_str_hash, g_str_equal);
+	irc_msg_table_build(irc);
+	irc->buddies = g_hash_table_new(g_str_hash, g_str_equal);
+
+	return irc;
+}
+
+static void
+perf_irc_free(struct irc_conn *irc) {
+	purple_connection_set_protocol_data(
+		purple_account_get_connection(irc->account), NULL);
+	g_hash_table_destroy(irc->msgs);
+	g_hash_table_destroy(irc->buddies);
+	if (irc->names != NULL)
+		g_string_free(irc->names, TRUE);
+	g_free(irc);
+}
+
+/* Feeds the stream in IRC_READ_SIZE reads, the way irc.c does */
+static gdouble
+perf_batched(struct irc_conn *irc, const GString *stream) {
+	gchar *buf = g_malloc(IRC_READ_SIZE * 2);
+	gsize pos = 0, used = 0;
+
+	g_test_timer_start();
+	while (pos < stream->len) {
+		gsize n = MIN(IRC_READ_SIZE, stream->len - pos);
+
+		memcpy(buf + used, stream->str + pos, n);
+		pos += n;
+		used += n;
+
+		n = irc_parse_lines(irc, buf, used, 0, perf_parse);
+		used -= n;
+		memmove(buf, buf + n, used);
+	}
+
+	g_free(buf);
+	return g_test_timer_elapsed();
+}
+
+/* One allocated copy per line, as a line reader hands them out */
+static gdouble
+perf_per_line(struct irc_conn *irc, const GString *stream) {
+	const gchar *cur = stream->str, *end = stream->str + stream->len, *nl;
+
+	g_test_timer_start();
+	while ((nl = memchr(cur, '\n', end - cur)) != NULL) {
+		gchar *line = g_strndup(cur, nl - cur);
+		gsize len = nl - cur;
+
+		if (len > 0 && line[len - 1] == '\r')
+			line[len - 1] = '\0';
+		perf_parse(irc, line);
+		g_free(line);
+		cur = nl + 1;
+	}
+
+	return g_test_timer_elapsed();
+}
+
+static void
+test_irc_parse_perf_lines(void) {
+	const guint lines = 400000;
+	GString *stream = perf_stream(lines);
+	struct irc_conn *irc;
+	gdouble batched, per_line;
+
+	test_ui_purple_init();
+
+	/* Stands in for loading the plugin, which registers the signals
+	 * irc_parse_msg() emits. */
+	_irc_protocol = purple_protocols_find(TEST_UI_PROTOCOL_ID);
+	purple_signal_register(_irc_protocol, "irc-receiving-text",
+	                       purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE, 2,
+	                       PURPLE_TYPE_CONNECTION, G_TYPE_POINTER);
+
+	irc = perf_irc_new();
+
+	perf_lines = 0;
+	batched = perf_batched(irc, stream);
+	g_assert_cmpuint(perf_lines, ==, lines);
+
+	perf_lines = 0;
+	per_line = perf_per_line(irc, stream);
+	g_assert_cmpuint(perf_lines, ==, lines);
+
+	g_test_message("%" G_GSIZE_FORMAT " bytes: batched %.1f MB/s, "
+		"line copies %.1f MB/s", stream->len,
+		stream->len / batched / 1e6, stream->len / per_line / 1e6);
+	g_test_minimized_result(batched / lines,
+		"irc_parse_msg: %g s per line", batched / lines);
+
+	perf_irc_free(irc);
+	purple_signal_unregister(_irc_protocol, "irc-receiving-text");
+	_irc_protocol = NULL;
+	test_ui_purple_uninit();
+
+	g_string_free(stream, TRUE);
+}
+
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/irc/parse/lines",
+	                test_irc_parse_lines);
+	g_test_add_func("/irc/parse/lines/deadline",
+	                test_irc_parse_lines_deadline);
+
+	if (g_test_perf()) {
+		g_test_add_func("/irc/parse/perf/lines",
+		                test_irc_parse_perf_lines);
+	}
+
+	return g_test_run();
+}
@@ -102,21 +102,22 @@ JabberBuddy *jabber_buddy_find(JabberStream *js, const char *name,
 		gboolean create)
 {
 	JabberBuddy *jb;
-	char *realname;
+	JabberInternedID *iid;
 
 	if (js->buddies == NULL)
 		return NULL;
 
-	if(!(realname = jabber_get_bare_jid(name)))
+	if(!(iid = jabber_id_intern(name)))
 		return NULL;
 
-	jb = g_hash_table_lookup(js->buddies, realname);
+	jb = g_hash_table_lookup(js->buddies, iid->bare);
 
 	if(!jb && create) {
 		jb = g_new0(JabberBuddy, 1);
-		g_hash_table_insert(js->buddies, realname, jb);
-	} else
-		g_free(realname);
+		g_hash_table_insert(js->buddies, g_strdup(iid->bare), jb);
+	}
+
+	jabber_interned_id_unref(iid);
 
 	return jb;
 }
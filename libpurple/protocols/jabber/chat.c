@@ -261,6 +261,9 @@ static JabberChat *jabber_chat_new(JabberStream *js, const char *room,
 	jid = g_strdup_printf("%s@%s", room, server);
 	g_hash_table_insert(js->chats, jid, chat);
 
+	/* Occupant JIDs of this room normalize differently now */
+	purple_normalize_invalidate(purple_connection_get_account(js->gc));
+
 	return chat;
 }
 
@@ -438,6 +441,8 @@ void jabber_chat_destroy(JabberChat *chat)
 
 	g_hash_table_remove(js->chats, room_jid);
 	g_free(room_jid);
+
+	purple_normalize_invalidate(purple_connection_get_account(js->gc));
 }
 
 void jabber_chat_free(JabberChat *chat)
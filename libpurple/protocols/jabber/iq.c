@@ -438,10 +438,17 @@ void jabber_iq_parse(JabberStream *js, PurpleXmlNode *packet)
 	 * or if an outside plugin is interested.
 	 */
 	if(child && (xmlns = purple_xmlnode_get_namespace(child))) {
-		char *key = g_strdup_printf("%s %s", child->name, xmlns);
-		JabberIqHandler *jih = g_hash_table_lookup(iq_handlers, key);
-		int signal_ref = GPOINTER_TO_INT(g_hash_table_lookup(signal_iq_handlers, key));
-		g_free(key);
+		/* Every IQ ends up here, so only long keys are allocated */
+		char buf[256], *key = buf;
+		JabberIqHandler *jih;
+		int signal_ref;
+
+		if ((gsize)g_snprintf(buf, sizeof(buf), "%s %s", child->name, xmlns) >= sizeof(buf))
+			key = g_strdup_printf("%s %s", child->name, xmlns);
+		jih = g_hash_table_lookup(iq_handlers, key);
+		signal_ref = GPOINTER_TO_INT(g_hash_table_lookup(signal_iq_handlers, key));
+		if (key != buf)
+			g_free(key);
 
 		if (signal_ref > 0) {
 			signal_return = GPOINTER_TO_INT(purple_signal_emit_return_1(purple_connection_get_protocol(js->gc), "jabber-watched-iq",
@@ -83,6 +83,9 @@
  */
 #define DEFAULT_INACTIVITY_TIME 120
 
+/* The largest buffer kept around for serializing stanzas. */
+#define JABBER_SEND_BUFFER_MAX (64 * 1024)
+
 GList *jabber_features = NULL;
 GList *jabber_identities = NULL;
 
@@ -594,8 +597,7 @@ void jabber_send_signal_cb(PurpleConnection *pc, PurpleXmlNode **packet,
                            gpointer unused)
 {
 	JabberStream *js;
-	char *txt;
-	int len;
+	GString *txt;
 
 	if (NULL == packet)
 		return;
@@ -612,9 +614,24 @@ void jabber_send_signal_cb(PurpleConnection *pc, PurpleXmlNode **packet,
 				purple_strequal((*packet)->name, "iq") ||
 				purple_strequal((*packet)->name, "presence"))
 			purple_xmlnode_set_namespace(*packet, NS_XMPP_CLIENT);
-	txt = purple_xmlnode_to_str(*packet, &len);
-	jabber_send_raw(js, txt, len);
-	g_free(txt);
+
+	/* A handler of jabber-sending-text may send another packet, so the
+	 * buffer is taken out of the stream while it is being sent. */
+	txt = js->send_buffer;
+	js->send_buffer = NULL;
+	if (txt == NULL)
+		txt = g_string_sized_new(512);
+	else
+		g_string_truncate(txt, 0);
+
+	purple_xmlnode_append_to_string(*packet, txt);
+	jabber_send_raw(js, txt->str, txt->len);
+
+	/* Don't hold on to the memory of a huge packet. */
+	if (js->send_buffer == NULL && txt->allocated_len <= JABBER_SEND_BUFFER_MAX)
+		js->send_buffer = txt;
+	else
+		g_string_free(txt, TRUE);
 }
 
 void jabber_send(JabberStream *js, PurpleXmlNode *packet)
@@ -1689,6 +1706,8 @@ void jabber_close(PurpleConnection *gc)
 
 	if (js->write_buffer)
 		g_object_unref(G_OBJECT(js->write_buffer));
+	if (js->send_buffer)
+		g_string_free(js->send_buffer, TRUE);
 	if(js->writeh)
 		purple_input_remove(js->writeh);
 	if (js->auth_mech && js->auth_mech->dispose)
@@ -4018,6 +4037,7 @@ jabber_do_uninit(void)
 	jabber_auth_uninit();
 	jabber_features_destroy();
 	jabber_identities_destroy();
+	jabber_id_cache_uninit();
 
 	g_hash_table_destroy(jabber_cmds);
 	jabber_cmds = NULL;
@@ -212,6 +212,9 @@ struct _JabberStream
 	PurpleCircularBuffer *write_buffer;
 	guint writeh;
 
+	/* Reused to serialize outgoing stanzas; NULL while in use. */
+	GString *send_buffer;
+
 	gboolean reinit;
 
 	JabberCapabilities server_caps;
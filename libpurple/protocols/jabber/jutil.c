@@ -498,6 +498,186 @@ jabber_id_new_internal(const char *str, gboolean allow_terminating_slash)
 #endif /* USE_IDN */
 }
 
+/* Interned JIDs which nobody holds any more are kept for this many more. */
+#define JID_CACHE_UNUSED_MAX 1024
+
+/* string => JabberInternedID* */
+static GHashTable *jid_cache = NULL;
+/* The unreferenced interned JIDs, most recently used first. */
+static GQueue jid_cache_unused = G_QUEUE_INIT;
+/* bare JID => the number of interned JIDs sharing it */
+static GHashTable *jid_cache_bare = NULL;
+
+/* Takes over a bare JID and returns the copy shared by the interned JIDs. */
+static const char *
+jabber_id_cache_bare_ref(char *bare)
+{
+	gpointer key, count;
+
+	if (jid_cache_bare == NULL)
+		jid_cache_bare = g_hash_table_new(g_str_hash, g_str_equal);
+
+	if (g_hash_table_lookup_extended(jid_cache_bare, bare, &key, &count)) {
+		g_hash_table_insert(jid_cache_bare, key,
+				GUINT_TO_POINTER(GPOINTER_TO_UINT(count) + 1));
+		g_free(bare);
+		return key;
+	}
+
+	g_hash_table_insert(jid_cache_bare, bare, GUINT_TO_POINTER(1));
+	return bare;
+}
+
+static void
+jabber_id_cache_bare_unref(const char *bare)
+{
+	guint count = GPOINTER_TO_UINT(g_hash_table_lookup(jid_cache_bare, bare));
+
+	if (count > 1) {
+		g_hash_table_insert(jid_cache_bare, (gpointer)bare,
+				GUINT_TO_POINTER(count - 1));
+	} else {
+		g_hash_table_remove(jid_cache_bare, bare);
+		g_free((char *)bare);
+	}
+}
+
+static void
+jabber_interned_id_free(JabberInternedID *iid)
+{
+	g_free(iid->jid.node);
+	g_free(iid->jid.domain);
+	g_free(iid->jid.resource);
+	g_free(iid->full);
+	jabber_id_cache_bare_unref(iid->bare);
+	g_free(iid->str);
+	g_free(iid);
+}
+
+/* Moves an interned JID nobody holds to the front of the unused ones. */
+static void
+jabber_id_cache_release(JabberInternedID *iid)
+{
+	JabberInternedID *old;
+
+	g_queue_push_head(&jid_cache_unused, iid);
+	iid->unused_link = jid_cache_unused.head;
+
+	if (jid_cache_unused.length <= JID_CACHE_UNUSED_MAX)
+		return;
+
+	old = g_queue_pop_tail(&jid_cache_unused);
+	g_hash_table_remove(jid_cache, old->str);
+	jabber_interned_id_free(old);
+}
+
+/*
+ * Returns the interned JID for a string, parsing it if it isn't known yet,
+ * without taking a reference.
+ */
+static JabberInternedID *
+jabber_id_cache_lookup(const char *str)
+{
+	JabberInternedID *iid;
+	JabberID *jid;
+
+	if (str == NULL)
+		return NULL;
+
+	if (jid_cache == NULL)
+		jid_cache = g_hash_table_new(g_str_hash, g_str_equal);
+
+	iid = g_hash_table_lookup(jid_cache, str);
+	if (iid != NULL) {
+		if (iid->unused_link != NULL) {
+			g_queue_unlink(&jid_cache_unused, iid->unused_link);
+			g_queue_push_head_link(&jid_cache_unused, iid->unused_link);
+		}
+		return iid;
+	}
+
+	jid = jabber_id_new_internal(str, FALSE);
+	if (jid == NULL)
+		return NULL;
+
+	iid = g_new0(JabberInternedID, 1);
+	iid->jid = *jid;
+	g_free(jid);
+
+	iid->full = jabber_id_get_full_jid(&iid->jid);
+	iid->bare = jabber_id_cache_bare_ref(jabber_id_get_bare_jid(&iid->jid));
+
+	iid->str = g_strdup(str);
+	g_hash_table_insert(jid_cache, iid->str, iid);
+	jabber_id_cache_release(iid);
+
+	return iid;
+}
+
+JabberInternedID *
+jabber_id_intern(const char *str)
+{
+	JabberInternedID *iid = jabber_id_cache_lookup(str);
+
+	if (iid == NULL)
+		return NULL;
+
+	return jabber_interned_id_ref(iid);
+}
+
+JabberInternedID *
+jabber_interned_id_ref(JabberInternedID *iid)
+{
+	g_return_val_if_fail(iid != NULL, NULL);
+
+	if (iid->ref++ == 0) {
+		g_queue_delete_link(&jid_cache_unused, iid->unused_link);
+		iid->unused_link = NULL;
+	}
+
+	return iid;
+}
+
+void
+jabber_interned_id_unref(JabberInternedID *iid)
+{
+	if (iid == NULL)
+		return;
+
+	g_return_if_fail(iid->ref > 0);
+
+	if (--iid->ref == 0)
+		jabber_id_cache_release(iid);
+}
+
+void
+jabber_id_cache_uninit(void)
+{
+	JabberInternedID *iid;
+	GHashTableIter iter;
+
+	if (jid_cache == NULL)
+		return;
+
+	g_hash_table_iter_init(&iter, jid_cache);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&iid)) {
+		if (iid->ref > 0) {
+			purple_debug_warning("jabber", "Interned JID %s is still "
+			                     "referenced\n", iid->str);
+		}
+		jabber_interned_id_free(iid);
+	}
+
+	g_hash_table_destroy(jid_cache);
+	jid_cache = NULL;
+	g_queue_clear(&jid_cache_unused);
+
+	if (jid_cache_bare != NULL) {
+		g_hash_table_destroy(jid_cache_bare);
+		jid_cache_bare = NULL;
+	}
+}
+
 void
 jabber_id_free(JabberID *jid)
 {
@@ -530,30 +710,22 @@ jabber_id_equal(const JabberID *jid1, const JabberID *jid2)
 
 char *jabber_get_domain(const char *in)
 {
-	JabberID *jid = jabber_id_new(in);
-	char *out;
+	JabberInternedID *iid = jabber_id_cache_lookup(in);
 
-	if (!jid)
+	if (!iid)
 		return NULL;
 
-	out = g_strdup(jid->domain);
-	jabber_id_free(jid);
-
-	return out;
+	return g_strdup(iid->jid.domain);
 }
 
 char *jabber_get_resource(const char *in)
 {
-	JabberID *jid = jabber_id_new(in);
-	char *out;
+	JabberInternedID *iid = jabber_id_cache_lookup(in);
 
-	if(!jid)
+	if(!iid)
 		return NULL;
 
-	out = g_strdup(jid->resource);
-	jabber_id_free(jid);
-
-	return out;
+	return g_strdup(iid->jid.resource);
 }
 
 JabberID *
@@ -570,15 +742,12 @@ jabber_id_to_bare_jid(const JabberID *jid)
 char *
 jabber_get_bare_jid(const char *in)
 {
-	JabberID *jid = jabber_id_new(in);
-	char *out;
+	JabberInternedID *iid = jabber_id_cache_lookup(in);
 
-	if (!jid)
+	if (!iid)
 		return NULL;
-	out = jabber_id_get_bare_jid(jid);
-	jabber_id_free(jid);
 
-	return out;
+	return g_strdup(iid->bare);
 }
 
 char *
@@ -622,7 +791,19 @@ jabber_jid_is_domain(const char *jid)
 JabberID *
 jabber_id_new(const char *str)
 {
-	return jabber_id_new_internal(str, FALSE);
+	JabberInternedID *iid = jabber_id_cache_lookup(str);
+	JabberID *jid;
+
+	if (iid == NULL)
+		return NULL;
+
+	/* Callers own and may modify the result, so it's a copy. */
+	jid = g_new0(JabberID, 1);
+	jid->node = g_strdup(iid->jid.node);
+	jid->domain = g_strdup(iid->jid.domain);
+	jid->resource = g_strdup(iid->jid.resource);
+
+	return jid;
 }
 
 const char *jabber_normalize(const PurpleAccount *account, const char *in)
@@ -630,26 +811,32 @@ const char *jabber_normalize(const PurpleAccount *account, const char *in)
 	PurpleConnection *gc = NULL;
 	JabberStream *js = NULL;
 	static char buf[3072]; /* maximum legal length of a jabber jid */
-	JabberID *jid;
+	JabberInternedID *iid;
+	JabberID *parsed = NULL;
+	const JabberID *jid;
 
 	if (account)
 		gc = purple_account_get_connection(account);
 	if (gc)
 		js = purple_connection_get_protocol_data(gc);
 
-	jid = jabber_id_new_internal(in, TRUE);
-	if(!jid)
+	/* Only JIDs ending with a slash aren't in the cache */
+	if ((iid = jabber_id_cache_lookup(in)) != NULL)
+		jid = &iid->jid;
+	else if ((jid = parsed = jabber_id_new_internal(in, TRUE)) == NULL)
 		return NULL;
 
 	if(js && jid->node && jid->resource &&
 			jabber_chat_find(js, jid->node, jid->domain))
 		g_snprintf(buf, sizeof(buf), "%s@%s/%s", jid->node, jid->domain,
 				jid->resource);
+	else if (iid != NULL)
+		g_strlcpy(buf, iid->bare, sizeof(buf));
 	else
 		g_snprintf(buf, sizeof(buf), "%s%s%s", jid->node ? jid->node : "",
 				jid->node ? "@" : "", jid->domain);
 
-	jabber_id_free(jid);
+	jabber_id_free(parsed);
 
 	return buf;
 }
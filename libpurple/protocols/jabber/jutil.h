@@ -43,8 +43,43 @@ typedef enum {
 
 #include "jabber.h"
 
+/**
+ * A JID which is parsed once and shared by everyone who interns the same
+ * string.  None of it may be modified.
+ *
+ * @jid:  The node, domain and resource, as with jabber_id_new().
+ * @full: The normalized full JID.
+ * @bare: The normalized bare JID.  Interned JIDs with the same bare JID
+ *        share the string, so two interned JIDs which are both held can have
+ *        their bare JIDs compared by pointer.
+ */
+typedef struct _JabberInternedID {
+	JabberID jid;
+	char *full;
+	const char *bare;
+
+	/*< private >*/
+	char *str;
+	guint ref;
+	GList *unused_link;
+} JabberInternedID;
+
 JabberID* jabber_id_new(const char *str);
 
+/**
+ * Returns the interned JID for a string, with a new reference, or NULL if
+ * the string isn't a valid JID.  Interning the same string again returns the
+ * same JabberInternedID.
+ */
+JabberInternedID *jabber_id_intern(const char *str);
+JabberInternedID *jabber_interned_id_ref(JabberInternedID *iid);
+void jabber_interned_id_unref(JabberInternedID *iid);
+
+/**
+ * Frees all interned JIDs.  There must be no references left.
+ */
+void jabber_id_cache_uninit(void);
+
 /**
  * Compare two JIDs for equality. In addition to the node and domain,
  * the resources of the two JIDs must also be equal (or both absent).
@@ -32,10 +32,14 @@
 #include "usertune.h"
 
 static GHashTable *pep_handlers = NULL;
+/* <pubsub xmlns='http://jabber.org/protocol/pubsub'><items/> of item results */
+static PurpleXmlPath *pubsub_items_path = NULL;
 
 void jabber_pep_init(void) {
 	if(!pep_handlers) {
 		pep_handlers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		pubsub_items_path = purple_xmlnode_path_new("pubsub/items",
+				"http://jabber.org/protocol/pubsub");
 
 		/* register PEP handlers */
 		jabber_avatar_init();
@@ -52,6 +56,8 @@ void jabber_pep_uninit(void) {
 	 */
 	g_hash_table_destroy(pep_handlers);
 	pep_handlers = NULL;
+	purple_xmlnode_path_free(pubsub_items_path);
+	pubsub_items_path = NULL;
 }
 
 void jabber_pep_init_actions(GList **m) {
@@ -71,15 +77,11 @@ do_pep_iq_request_item_callback(JabberStream *js, const char *from,
                                 JabberIqType type, const char *id,
                                 PurpleXmlNode *packet, gpointer data)
 {
-	PurpleXmlNode *pubsub;
 	PurpleXmlNode *items = NULL;
 	JabberPEPHandler *cb = data;
 
-	if (type == JABBER_IQ_RESULT) {
-		pubsub = purple_xmlnode_get_child_with_namespace(packet, "pubsub", "http://jabber.org/protocol/pubsub");
-		if(pubsub)
-			items = purple_xmlnode_get_child(pubsub, "items");
-	}
+	if (type == JABBER_IQ_RESULT)
+		items = purple_xmlnode_path_get(pubsub_items_path, packet);
 
 	cb(js, from, items);
 }
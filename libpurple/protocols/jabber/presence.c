@@ -914,6 +914,7 @@ void jabber_presence_parse(JabberStream *js, PurpleXmlNode *packet)
 	JabberBuddyResource *jbr = NULL;
 	gboolean signal_return, ret;
 	JabberPresence presence;
+	JabberInternedID *from_id;
 	PurpleXmlNode *child;
 
 	memset(&presence, 0, sizeof(presence));
@@ -929,12 +930,13 @@ void jabber_presence_parse(JabberStream *js, PurpleXmlNode *packet)
 	presence.jb = jabber_buddy_find(js, presence.from, TRUE);
 	g_return_if_fail(presence.jb != NULL);
 
-	presence.jid_from = jabber_id_new(presence.from);
-	if (presence.jid_from == NULL) {
+	from_id = jabber_id_intern(presence.from);
+	if (from_id == NULL) {
 		purple_debug_error("jabber", "Ignoring presence with malformed 'from' "
 		                   "JID: %s\n", presence.from);
 		return;
 	}
+	presence.jid_from = &from_id->jid;
 
 	signal_return = GPOINTER_TO_INT(purple_signal_emit_return_1(purple_connection_get_protocol(js->gc),
 			"jabber-receiving-presence", js->gc, type, presence.from, packet));
@@ -1080,7 +1082,7 @@ out:
 	g_free(presence.status);
 	g_free(presence.vcard_avatar_hash);
 	g_free(presence.nickname);
-	jabber_id_free(presence.jid_from);
+	jabber_interned_id_unref(from_id);
 }
 
 void jabber_presence_subscription_set(JabberStream *js, const char *who, const char *type)
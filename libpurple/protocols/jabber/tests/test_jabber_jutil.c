@@ -235,6 +235,71 @@ test_jabber_util_jabber_normalize(void) {
 	purple_test_string_compare(partial_jabber_normalize, data);
 }
 
+static void
+test_jabber_util_id_intern(void) {
+	JabberInternedID *iid1, *iid2, *iid3;
+	JabberID *jid;
+
+	iid1 = jabber_id_intern("NoOne@Example.com/Home");
+	g_assert_nonnull(iid1);
+	g_assert_cmpstr("noone", ==, iid1->jid.node);
+	g_assert_cmpstr("example.com", ==, iid1->jid.domain);
+	g_assert_cmpstr("Home", ==, iid1->jid.resource);
+	g_assert_cmpstr("noone@example.com/Home", ==, iid1->full);
+	g_assert_cmpstr("noone@example.com", ==, iid1->bare);
+
+	/* The same string gives the same JID */
+	iid2 = jabber_id_intern("NoOne@Example.com/Home");
+	g_assert_true(iid1 == iid2);
+
+	/* Others with the same bare JID share it */
+	iid3 = jabber_id_intern("noone@example.com/Work");
+	g_assert_true(iid1 != iid3);
+	g_assert_true(iid1->bare == iid3->bare);
+
+	/* jabber_id_new() still returns copies */
+	jid = jabber_id_new("NoOne@Example.com/Home");
+	g_assert_nonnull(jid);
+	g_assert_true(jid->node != iid1->jid.node);
+	g_assert_true(jabber_id_equal(jid, &iid1->jid));
+	jabber_id_free(jid);
+
+	g_assert_null(jabber_id_intern("noone@"));
+
+	jabber_interned_id_unref(iid1);
+	jabber_interned_id_unref(iid2);
+	jabber_interned_id_unref(iid3);
+
+	jabber_id_cache_uninit();
+}
+
+static void
+test_jabber_util_id_intern_evict(void) {
+	JabberInternedID *iid, *kept;
+	gchar str[32];
+	gint i;
+
+	kept = jabber_id_intern("user0@example.com/Kept");
+
+	/* Enough JIDs nobody holds to evict the first ones */
+	for(i = 0; i < 5000; i++) {
+		g_snprintf(str, sizeof(str), "user%d@example.com/Home", i % 2500);
+		iid = jabber_id_intern(str);
+		g_assert_nonnull(iid);
+		jabber_interned_id_unref(iid);
+	}
+
+	/* The bare JID stays with the JID which still holds it */
+	iid = jabber_id_intern("user0@example.com/Home");
+	g_assert_cmpstr("user0@example.com", ==, iid->bare);
+	g_assert_true(kept->bare == iid->bare);
+	jabber_interned_id_unref(iid);
+
+	jabber_interned_id_unref(kept);
+
+	jabber_id_cache_uninit();
+}
+
 gint
 main(gint argc, gchar **argv) {
 	g_test_init(&argc, &argv, NULL);
@@ -264,5 +329,10 @@ main(gint argc, gchar **argv) {
 	g_test_add_func("/jabber/util/normalize",
 	                test_jabber_util_jabber_normalize);
 
+	g_test_add_func("/jabber/util/id_intern",
+	                test_jabber_util_id_intern);
+	g_test_add_func("/jabber/util/id_intern/evict",
+	                test_jabber_util_id_intern_evict);
+
 	return g_test_run();
 }
@@ -46,6 +46,14 @@
 #include "oscarcommon.h"
 #include "debug.h"
 
+/*
+ * The keys of the hash tables of named items.  The fields are separated, so
+ * that a type can't run into a name that starts with a hex digit (a group
+ * named "41" and the icon item named "1" used to share the key "141").
+ */
+#define AIM_SSI_NAME_KEY     "%hx:%s"     /* Type and name */
+#define AIM_SSI_GID_NAME_KEY "%hx:%hx:%s" /* Group ID#, type and name */
+
 static int aim_ssi_addmoddel(OscarData *od);
 
 static void aim_ssi_item_free(struct aim_ssi_item *item)
@@ -55,24 +63,80 @@ static void aim_ssi_item_free(struct aim_ssi_item *item)
 	g_free(item);
 }
 
-static void aim_ssi_item_set_name(struct aim_ssi_itemlist *list, struct aim_ssi_item *item, const char *name)
+/**
+ * Remember that an item was added, removed or modified, so that the next
+ * aim_ssi_sync() compares it against the other list.
+ */
+static void aim_ssi_itemlist_changed(struct aim_ssi_itemlist *list, struct aim_ssi_item *item)
 {
-	gchar key[3000];
+	g_hash_table_add(list->changed, GUINT_TO_POINTER(((guint32)item->gid << 16) + item->bid));
+}
+
+/**
+ * Add an item to, or remove it from, the hash tables keyed on its name.
+ * If another item has the same name (say, the same buddy in two groups),
+ * removing the indexed one points the entry at the other one instead.
+ */
+static void aim_ssi_itemlist_index_name(struct aim_ssi_itemlist *list, struct aim_ssi_item *item, gboolean add)
+{
+	gchar key[3000], gidkey[3000];
+	struct aim_ssi_item *cur, *other, *othergid;
+	gboolean indexed, gidindexed;
+
+	if (!item->name)
+		return;
+
+	snprintf(key, sizeof(key), AIM_SSI_NAME_KEY, item->type, oscar_normalize(NULL, item->name));
+	snprintf(gidkey, sizeof(gidkey), AIM_SSI_GID_NAME_KEY, item->gid, item->type, oscar_normalize(NULL, item->name));
+
+	if (add) {
+		g_hash_table_insert(list->idx_all_named_items, g_strdup(key), item);
+		g_hash_table_insert(list->idx_gid_named_items, g_strdup(gidkey), item);
+		return;
+	}
+
+	indexed = (g_hash_table_lookup(list->idx_all_named_items, key) == item);
+	gidindexed = (g_hash_table_lookup(list->idx_gid_named_items, gidkey) == item);
+	if (!indexed && !gidindexed)
+		return;
+
+	other = othergid = NULL;
+	for (cur = list->data; cur; cur = cur->next) {
+		if ((cur == item) || (cur->type != item->type) || !cur->name ||
+				oscar_util_name_compare(cur->name, item->name))
+			continue;
+		other = cur;
+		if (cur->gid == item->gid)
+			othergid = cur;
+	}
 
-	if (item->name) {
-		/* Remove old name from hash table */
-		snprintf(key, sizeof(key), "%hx%s", item->type, oscar_normalize(NULL, item->name));
-		g_hash_table_remove(list->idx_all_named_items, key);
+	if (indexed) {
+		if (other)
+			g_hash_table_insert(list->idx_all_named_items, g_strdup(key), other);
+		else
+			g_hash_table_remove(list->idx_all_named_items, key);
+	}
+
+	if (gidindexed) {
+		if (othergid)
+			g_hash_table_insert(list->idx_gid_named_items, g_strdup(gidkey), othergid);
+		else
+			g_hash_table_remove(list->idx_gid_named_items, gidkey);
 	}
+}
+
+static void aim_ssi_item_set_name(struct aim_ssi_itemlist *list, struct aim_ssi_item *item, const char *name)
+{
+	/* Remove old name from hash tables */
+	aim_ssi_itemlist_index_name(list, item, FALSE);
 
 	g_free(item->name);
 	item->name = g_strdup(name);
 
-	if (name) {
-		/* Add new name to hash table */
-		snprintf(key, sizeof(key), "%hx%s", item->type, oscar_normalize(NULL, item->name));
-		g_hash_table_insert(list->idx_all_named_items, g_strdup(key), item);
-	}
+	/* Add new name to hash tables */
+	aim_ssi_itemlist_index_name(list, item, TRUE);
+
+	aim_ssi_itemlist_changed(list, item);
 }
 
 /**
@@ -177,6 +241,7 @@ aim_ssi_itemlist_rebuildgroup(struct aim_ssi_itemlist *list, const char *name)
 						newlen += aimutil_put16(newdata+newlen, cur->bid);
 		}
 		aim_tlvlist_replace_raw(&group->data, 0x00c8, newlen, newdata);
+		aim_ssi_itemlist_changed(list, group);
 
 		g_free(newdata);
 	}
@@ -237,13 +302,7 @@ static struct aim_ssi_item *aim_ssi_itemlist_add(struct aim_ssi_itemlist *list,
 		if (new->bid == 0xFFFF) {
 			do {
 				new->bid += 0x0001;
-				exists = FALSE;
-				for (cur = list->data; cur != NULL; cur = cur->next)
-					if (cur->bid == new->bid && cur->gid == new->gid) {
-						exists = TRUE;
-						break;
-					}
-			} while (exists);
+			} while (aim_ssi_itemlist_find(list, new->gid, new->bid));
 		}
 	}
 
@@ -259,6 +318,8 @@ static struct aim_ssi_item *aim_ssi_itemlist_add(struct aim_ssi_itemlist *list,
 	/* Set the TLV list */
 	new->data = aim_tlvlist_copy(data);
 
+	aim_ssi_itemlist_changed(list, new);
+
 	/* Add the item to the list in the correct numerical position.  Fancy, eh? */
 	if (list->data) {
 		if ((new->gid < list->data->gid) || ((new->gid == list->data->gid) && (new->bid < list->data->bid))) {
@@ -287,8 +348,6 @@ static struct aim_ssi_item *aim_ssi_itemlist_add(struct aim_ssi_itemlist *list,
  */
 static int aim_ssi_itemlist_del(struct aim_ssi_itemlist *list, struct aim_ssi_item *del)
 {
-	gchar key[3000];
-
 	if (!(list->data) || !del)
 		return -EINVAL;
 
@@ -304,9 +363,9 @@ static int aim_ssi_itemlist_del(struct aim_ssi_itemlist *list, struct aim_ssi_it
 
 	/* Remove from the hashtables */
 	g_hash_table_remove(list->idx_gid_bid, GINT_TO_POINTER((del->gid << 16) + del->bid));
+	aim_ssi_itemlist_index_name(list, del, FALSE);
 
-	snprintf(key, sizeof(key), "%hx%s", del->type, oscar_normalize(NULL, del->name));
-	g_hash_table_remove(list->idx_all_named_items, key);
+	aim_ssi_itemlist_changed(list, del);
 
 	/* Free the removed item */
 	aim_ssi_item_free(del);
@@ -399,16 +458,14 @@ struct aim_ssi_item *aim_ssi_itemlist_finditem(struct aim_ssi_itemlist *list, co
 
 	if (gn && bn) { /* For finding buddies in groups */
 		g_return_val_if_fail(type == AIM_SSI_TYPE_BUDDY, NULL);
-		for (cur=list->data; cur; cur=cur->next)
-			if ((cur->type == type) && (cur->name) && !(oscar_util_name_compare(cur->name, bn))) {
-				struct aim_ssi_item *curg;
-				for (curg=list->data; curg; curg=curg->next)
-					if ((curg->type == AIM_SSI_TYPE_GROUP) && (curg->gid == cur->gid) && (curg->name) && !(oscar_util_name_compare(curg->name, gn)))
-						return cur;
-			}
+		snprintf(key, sizeof(key), AIM_SSI_NAME_KEY, AIM_SSI_TYPE_GROUP, oscar_normalize(NULL, gn));
+		if (!(cur = g_hash_table_lookup(list->idx_all_named_items, key)))
+			return NULL;
+		snprintf(key, sizeof(key), AIM_SSI_GID_NAME_KEY, cur->gid, type, oscar_normalize(NULL, bn));
+		return g_hash_table_lookup(list->idx_gid_named_items, key);
 
 	} else if (gn || bn) { /* For finding groups, permits, denies and ignores */
-		snprintf(key, sizeof(key), "%hx%s", type, oscar_normalize(NULL, gn ? gn : bn));
+		snprintf(key, sizeof(key), AIM_SSI_NAME_KEY, type, oscar_normalize(NULL, gn ? gn : bn));
 		return g_hash_table_lookup(list->idx_all_named_items, key);
 
 	/* For stuff without names--permit deny setting, visibility mask, etc. */
@@ -555,9 +612,51 @@ gboolean aim_ssi_waitingforauth(struct aim_ssi_itemlist *list, const char *gn, c
 	return FALSE;
 }
 
+static gint aim_ssi_sync_key_cmp(gconstpointer a, gconstpointer b)
+{
+	guint32 ka = *(const guint32 *)a, kb = *(const guint32 *)b;
+
+	return (ka > kb) - (ka < kb);
+}
+
+/**
+ * Collect the gid+bid keys of every item that changed in either list since
+ * the last sync, sorted the same way the item lists are.  Anything not in
+ * here is known to be identical in both lists.
+ */
+static GArray *aim_ssi_sync_changed(OscarData *od)
+{
+	GArray *keys;
+	GHashTableIter iter;
+	gpointer key;
+	guint32 id_key;
+
+	keys = g_array_sized_new(FALSE, FALSE, sizeof(guint32),
+			g_hash_table_size(od->ssi.local.changed) + g_hash_table_size(od->ssi.official.changed));
+
+	g_hash_table_iter_init(&iter, od->ssi.local.changed);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		id_key = GPOINTER_TO_UINT(key);
+		g_array_append_val(keys, id_key);
+	}
+
+	g_hash_table_iter_init(&iter, od->ssi.official.changed);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		if (g_hash_table_contains(od->ssi.local.changed, key))
+			continue;
+		id_key = GPOINTER_TO_UINT(key);
+		g_array_append_val(keys, id_key);
+	}
+
+	g_array_sort(keys, aim_ssi_sync_key_cmp);
+
+	return keys;
+}
+
 /**
  * If there are changes, then create temporary items and
- * call addmoddel.
+ * call addmoddel.  Only items that changed since the last sync are
+ * compared; the others are known to match the official list already.
  *
  * @param od The oscar session.
  * @return Return 0 if no errors, otherwise return the error number.
@@ -566,8 +665,11 @@ static int aim_ssi_sync(OscarData *od)
 {
 	struct aim_ssi_item *cur1, *cur2;
 	struct aim_ssi_tmp *cur, *new;
+	GArray *changed;
+	guint i;
+	guint32 id_key;
 	int n = 0;
-	GString *debugstr = g_string_new("");
+	GString *debugstr;
 
 	/*
 	 * The variable "n" is used to limit the number of addmoddel's that
@@ -582,6 +684,9 @@ static int aim_ssi_sync(OscarData *od)
 	if (od->ssi.waiting_for_ack)
 		return 0;
 
+	debugstr = g_string_new("");
+	changed = aim_ssi_sync_changed(od);
+
 	/*
 	 * Compare the 2 lists and create an aim_ssi_tmp for each difference.
 	 * We should only send either additions, modifications, or deletions
@@ -593,8 +698,10 @@ static int aim_ssi_sync(OscarData *od)
 
 	/* Deletions */
 	if (!od->ssi.pending) {
-		for (cur1=od->ssi.official.data; cur1 && (n < 15); cur1=cur1->next) {
-			if (!aim_ssi_itemlist_find(&od->ssi.local, cur1->gid, cur1->bid)) {
+		for (i = 0; (i < changed->len) && (n < 15); i++) {
+			id_key = g_array_index(changed, guint32, i);
+			cur1 = aim_ssi_itemlist_find(&od->ssi.official, id_key >> 16, id_key & 0xffff);
+			if (cur1 && !aim_ssi_itemlist_find(&od->ssi.local, cur1->gid, cur1->bid)) {
 				n++;
 				new = g_new(struct aim_ssi_tmp, 1);
 				new->action = SNAC_SUBTYPE_FEEDBAG_DEL;
@@ -615,8 +722,10 @@ static int aim_ssi_sync(OscarData *od)
 
 	/* Additions */
 	if (!od->ssi.pending) {
-		for (cur1=od->ssi.local.data; cur1 && (n < 15); cur1=cur1->next) {
-			if (!aim_ssi_itemlist_find(&od->ssi.official, cur1->gid, cur1->bid)) {
+		for (i = 0; (i < changed->len) && (n < 15); i++) {
+			id_key = g_array_index(changed, guint32, i);
+			cur1 = aim_ssi_itemlist_find(&od->ssi.local, id_key >> 16, id_key & 0xffff);
+			if (cur1 && !aim_ssi_itemlist_find(&od->ssi.official, cur1->gid, cur1->bid)) {
 				n++;
 				new = g_new(struct aim_ssi_tmp, 1);
 				new->action = SNAC_SUBTYPE_FEEDBAG_ADD;
@@ -637,9 +746,11 @@ static int aim_ssi_sync(OscarData *od)
 
 	/* Modifications */
 	if (!od->ssi.pending) {
-		for (cur1=od->ssi.local.data; cur1 && (n < 15); cur1=cur1->next) {
-			cur2 = aim_ssi_itemlist_find(&od->ssi.official, cur1->gid, cur1->bid);
-			if (cur2 && (aim_ssi_itemlist_cmp(cur1, cur2))) {
+		for (i = 0; (i < changed->len) && (n < 15); i++) {
+			id_key = g_array_index(changed, guint32, i);
+			cur1 = aim_ssi_itemlist_find(&od->ssi.local, id_key >> 16, id_key & 0xffff);
+			cur2 = aim_ssi_itemlist_find(&od->ssi.official, id_key >> 16, id_key & 0xffff);
+			if (cur1 && cur2 && (aim_ssi_itemlist_cmp(cur1, cur2))) {
 				n++;
 				new = g_new(struct aim_ssi_tmp, 1);
 				new->action = SNAC_SUBTYPE_FEEDBAG_MOD;
@@ -657,6 +768,19 @@ static int aim_ssi_sync(OscarData *od)
 			}
 		}
 	}
+
+	/* Forget about items that are the same in both lists again */
+	for (i = 0; i < changed->len; i++) {
+		id_key = g_array_index(changed, guint32, i);
+		cur1 = aim_ssi_itemlist_find(&od->ssi.local, id_key >> 16, id_key & 0xffff);
+		cur2 = aim_ssi_itemlist_find(&od->ssi.official, id_key >> 16, id_key & 0xffff);
+		if ((!cur1 && !cur2) || (cur1 && cur2 && !aim_ssi_itemlist_cmp(cur1, cur2))) {
+			g_hash_table_remove(od->ssi.local.changed, GUINT_TO_POINTER(id_key));
+			g_hash_table_remove(od->ssi.official.changed, GUINT_TO_POINTER(id_key));
+		}
+	}
+	g_array_free(changed, TRUE);
+
 	if (debugstr->len > 0) {
 		purple_debug_info("oscar", "%s", debugstr->str);
 		if (purple_debug_is_verbose()) {
@@ -696,6 +820,17 @@ static int aim_ssi_sync(OscarData *od)
 	return aim_ssi_addmoddel(od);;
 }
 
+/**
+ * Empty the hash tables of an item list whose items have been freed.
+ */
+static void aim_ssi_itemlist_clear(struct aim_ssi_itemlist *list)
+{
+	g_hash_table_remove_all(list->idx_gid_bid);
+	g_hash_table_remove_all(list->idx_all_named_items);
+	g_hash_table_remove_all(list->idx_gid_named_items);
+	g_hash_table_remove_all(list->changed);
+}
+
 /**
  * Free all SSI data.
  *
@@ -734,6 +869,8 @@ aim_ssi_freelist(OscarData *od)
 	od->ssi.numitems = 0;
 	od->ssi.official.data = NULL;
 	od->ssi.local.data = NULL;
+	aim_ssi_itemlist_clear(&od->ssi.official);
+	aim_ssi_itemlist_clear(&od->ssi.local);
 	od->ssi.pending = NULL;
 	od->ssi.timestamp = (time_t)0;
 }
@@ -743,7 +880,7 @@ aim_ssi_freelist(OscarData *od)
  * the TLV is not a valid UTF-8 string then use purple_utf8_salvage()
  * to replace invalid bytes with question marks.
  */
-static void cleanlist_ensure_utf8_data(struct aim_ssi_item *item, guint16 tlvtype)
+static void cleanlist_ensure_utf8_data(struct aim_ssi_itemlist *list, struct aim_ssi_item *item, guint16 tlvtype)
 {
 	aim_tlv_t *tlv;
 	gchar *value, *salvaged;
@@ -762,6 +899,7 @@ static void cleanlist_ensure_utf8_data(struct aim_ssi_item *item, guint16 tlvtyp
 		else
 			aim_tlvlist_remove(&item->data, tlvtype);
 		g_free(salvaged);
+		aim_ssi_itemlist_changed(list, item);
 	}
 }
 
@@ -827,10 +965,10 @@ static int aim_ssi_cleanlist(OscarData *od)
 			}
 
 			/* Make sure alias is valid UTF-8 */
-			cleanlist_ensure_utf8_data(cur, 0x0131);
+			cleanlist_ensure_utf8_data(&od->ssi.local, cur, 0x0131);
 
 			/* Make sure comment is valid UTF-8 */
-			cleanlist_ensure_utf8_data(cur, 0x013c);
+			cleanlist_ensure_utf8_data(&od->ssi.local, cur, 0x013c);
 		}
 		cur = cur->next;
 	}
@@ -1040,6 +1178,7 @@ int aim_ssi_aliasbuddy(OscarData *od, const char *gn, const char *bn, const char
 		aim_tlvlist_replace_str(&tmp->data, 0x0131, alias);
 	else
 		aim_tlvlist_remove(&tmp->data, 0x0131);
+	aim_ssi_itemlist_changed(&od->ssi.local, tmp);
 
 	/* Sync our local list with the server list */
 	return aim_ssi_sync(od);
@@ -1070,6 +1209,7 @@ int aim_ssi_editcomment(OscarData *od, const char *gn, const char *bn, const cha
 		aim_tlvlist_replace_str(&tmp->data, 0x013c, comment);
 	else
 		aim_tlvlist_remove(&tmp->data, 0x013c);
+	aim_ssi_itemlist_changed(&od->ssi.local, tmp);
 
 	/* Sync our local list with the server list */
 	return aim_ssi_sync(od);
@@ -1130,6 +1270,7 @@ int aim_ssi_setpermdeny(OscarData *od, guint8 permdeny)
 
 	/* Need to add the 0x00ca TLV to the TLV chain */
 	aim_tlvlist_replace_8(&tmp->data, 0x00ca, permdeny);
+	aim_ssi_itemlist_changed(&od->ssi.local, tmp);
 
 	/* Sync our local list with the server list */
 	return aim_ssi_sync(od);
@@ -1170,6 +1311,7 @@ int aim_ssi_seticon(OscarData *od, const guint8 *iconsum, guint8 iconsumlen)
 
 	/* Need to add the 0x0131 TLV to the TLV chain, used to cache the icon */
 	aim_tlvlist_replace_noval(&tmp->data, 0x0131);
+	aim_ssi_itemlist_changed(&od->ssi.local, tmp);
 
 	/* Sync our local list with the server list */
 	aim_ssi_sync(od);
@@ -1222,6 +1364,7 @@ int aim_ssi_setpresence(OscarData *od, guint32 presence) {
 
 	/* Need to add the x00c9 TLV to the TLV chain */
 	aim_tlvlist_replace_32(&tmp->data, 0x00c9, presence);
+	aim_ssi_itemlist_changed(&od->ssi.local, tmp);
 
 	/* Sync our local list with the server list */
 	return aim_ssi_sync(od);
@@ -1342,6 +1485,10 @@ static int parsedata(OscarData *od, FlapConnection *conn, aim_module_t *mod, Fla
 		for (cur=od->ssi.official.data; cur; cur=cur->next)
 			aim_ssi_itemlist_add(&od->ssi.local, cur->name, cur->gid, cur->bid, cur->type, cur->data);
 
+		/* Both lists are identical now, so there is nothing to sync yet */
+		g_hash_table_remove_all(od->ssi.local.changed);
+		g_hash_table_remove_all(od->ssi.official.changed);
+
 		/* Clean the buddy list */
 		aim_ssi_cleanlist(od);
 
@@ -1493,6 +1640,8 @@ static int parsemod(OscarData *od, FlapConnection *conn, aim_module_t *mod, Flap
 
 		/* Replace the 2 local items with the given one */
 		if ((item = aim_ssi_itemlist_find(&od->ssi.local, gid, bid))) {
+			/* Unindex the old name while the old type is still set */
+			aim_ssi_item_set_name(&od->ssi.local, item, NULL);
 			item->type = type;
 			aim_ssi_item_set_name(&od->ssi.local, item, name);
 			aim_tlvlist_free(item->data);
@@ -1500,6 +1649,8 @@ static int parsemod(OscarData *od, FlapConnection *conn, aim_module_t *mod, Flap
 		}
 
 		if ((item = aim_ssi_itemlist_find(&od->ssi.official, gid, bid))) {
+			/* Unindex the old name while the old type is still set */
+			aim_ssi_item_set_name(&od->ssi.official, item, NULL);
 			item->type = type;
 			aim_ssi_item_set_name(&od->ssi.official, item, name);
 			aim_tlvlist_free(item->data);
@@ -1590,7 +1741,7 @@ static int parseack(OscarData *od, FlapConnection *conn, aim_module_t *mod, Flap
 				if (aim_ssi_itemlist_valid(&od->ssi.local, cur->item)) {
 					struct aim_ssi_item *cur1;
 					if ((cur1 = aim_ssi_itemlist_find(&od->ssi.official, cur->item->gid, cur->item->bid))) {
-						aim_ssi_item_set_name(&od->ssi.official, cur->item, cur1->name);
+						aim_ssi_item_set_name(&od->ssi.local, cur->item, cur1->name);
 						aim_tlvlist_free(cur->item->data);
 						cur->item->data = aim_tlvlist_copy(cur1->data);
 					}
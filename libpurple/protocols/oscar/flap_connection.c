@@ -29,6 +29,9 @@
 #include <netinet/in.h>
 #endif
 
+/* How much to ask the socket for at a time when receiving FLAPs */
+#define FLAP_READ_SIZE 16384
+
 /**
  * This sends a channel 1 SNAC containing the FLAP version.
  * The FLAP version is sent by itself at the beginning of every
@@ -403,8 +406,10 @@ flap_connection_close(OscarData *od, FlapConnection *conn)
 		conn->gsc = NULL;
 	}
 
-	g_free(conn->buffer_incoming.data.data);
-	conn->buffer_incoming.data.data = NULL;
+	g_free(conn->buffer_incoming_data);
+	conn->buffer_incoming_data = NULL;
+	conn->buffer_incoming_size = 0;
+	conn->buffer_incoming_used = 0;
 
 	g_object_unref(G_OBJECT(conn->buffer_outgoing));
 	conn->buffer_outgoing = NULL;
@@ -728,10 +733,35 @@ flap_frame_new(OscarData *od, guint16 channel, int datalen)
 	return frame;
 }
 
+/**
+ * Hand a SNAC to the module registered for its family, then to the
+ * catch-all modules, stopping at the first one that handles it.
+ */
+static void
+dispatch_snac(OscarData *od, FlapConnection *conn, FlapFrame *frame, aim_modsnac_t *snac)
+{
+	aim_module_t *family, *mod;
+	GSList *cur;
+
+	family = aim__findmodulebygroup(od, snac->family);
+	if (family && family->snachandler(od, conn, family, frame, snac, &frame->data))
+		return;
+
+	for (cur = od->modmultifamily; cur; cur = cur->next) {
+		mod = cur->data;
+
+		/* Already had its turn above */
+		if (mod == family)
+			continue;
+
+		if (mod->snachandler(od, conn, mod, frame, snac, &frame->data))
+			return;
+	}
+}
+
 static void
 parse_snac(OscarData *od, FlapConnection *conn, FlapFrame *frame)
 {
-	aim_module_t *cur;
 	aim_modsnac_t snac;
 
 	if (byte_stream_bytes_left(&frame->data) < 10)
@@ -763,36 +793,19 @@ parse_snac(OscarData *od, FlapConnection *conn, FlapFrame *frame)
 		byte_stream_advance(&frame->data, byte_stream_get16(&frame->data));
 	}
 
-	for (cur = (aim_module_t *)od->modlistv; cur; cur = cur->next) {
-
-		if (!(cur->flags & AIM_MODFLAG_MULTIFAMILY) &&
-				(cur->family != snac.family))
-			continue;
-
-		if (cur->snachandler(od, conn, cur, frame, &snac, &frame->data))
-			return;
-	}
+	dispatch_snac(od, conn, frame, &snac);
 }
 
 static void
 parse_fakesnac(OscarData *od, FlapConnection *conn, FlapFrame *frame, guint16 family, guint16 subtype)
 {
-	aim_module_t *cur;
 	aim_modsnac_t snac;
 
 	snac.family = family;
 	snac.subtype = subtype;
 	snac.flags = snac.id = 0;
 
-	for (cur = (aim_module_t *)od->modlistv; cur; cur = cur->next) {
-
-		if (!(cur->flags & AIM_MODFLAG_MULTIFAMILY) &&
-				(cur->family != snac.family))
-			continue;
-
-		if (cur->snachandler(od, conn, cur, frame, &snac, &frame->data))
-			return;
-	}
+	dispatch_snac(od, conn, frame, &snac);
 }
 
 static void
@@ -866,11 +879,67 @@ parse_flap(OscarData *od, FlapConnection *conn, FlapFrame *frame)
 	}
 }
 
+/**
+ * Handle every complete FLAP sitting in the connection's receive buffer.
+ * Each frame is handed to parse_flap() as a ByteStream pointing straight
+ * into the buffer, so the payload is never copied.  Whatever is left over
+ * (the start of a frame that hasn't fully arrived yet) is moved to the
+ * front of the buffer.
+ *
+ * Returns FALSE if the data wasn't a valid FLAP and the connection has
+ * been scheduled for destruction.
+ */
+static gboolean
+flap_connection_parse_incoming(FlapConnection *conn)
+{
+	gsize pos = 0;
+
+	while (conn->buffer_incoming_used - pos >= 6)
+	{
+		guint8 *header = conn->buffer_incoming_data + pos;
+		FlapFrame frame;
+
+		/* All FLAP frames must start with the byte 0x2a */
+		if (aimutil_get8(&header[0]) != 0x2a)
+		{
+			flap_connection_schedule_destroy(conn,
+					OSCAR_DISCONNECT_INVALID_DATA, NULL);
+			return FALSE;
+		}
+
+		frame.data.len = aimutil_get16(&header[4]);
+		if (conn->buffer_incoming_used - pos < 6 + frame.data.len)
+			/* Waiting for the rest of this FLAP to arrive */
+			break;
+
+		frame.channel = aimutil_get8(&header[1]);
+		frame.seqnum = aimutil_get16(&header[2]);
+		frame.data.data = header + 6;
+		frame.data.offset = 0;
+
+		parse_flap(conn->od, conn, &frame);
+		conn->lastactivity = time(NULL);
+
+		pos += 6 + frame.data.len;
+	}
+
+	if (pos > 0)
+	{
+		conn->buffer_incoming_used -= pos;
+		memmove(conn->buffer_incoming_data,
+				conn->buffer_incoming_data + pos,
+				conn->buffer_incoming_used);
+	}
+
+	return TRUE;
+}
+
 /**
  * Read in all available data on the socket for a given connection.
- * All complete FLAPs handled immedate after they're received.
- * Incomplete FLAP data is stored locally and appended to the next
- * time this callback is triggered.
+ * Data is read in large chunks into a per-connection buffer and all
+ * complete FLAPs in it are handled immediately.  Incomplete FLAP data
+ * stays in the buffer and is completed the next time this callback
+ * is triggered.
  *
  * This is called by flap_connection_recv_cb and
  * flap_connection_recv_cb_ssl for unencrypted/encrypted connections.
@@ -878,113 +947,66 @@ parse_flap(OscarData *od, FlapConnection *conn, FlapFrame *frame)
 static void
 flap_connection_recv(FlapConnection *conn)
 {
-	gpointer buf;
 	gsize buflen;
 	gssize read;
 
 	/* Read data until we run out of data and break out of the loop */
 	while (TRUE)
 	{
-		/* Start reading a new FLAP */
-		if (conn->buffer_incoming.data.data == NULL)
+		/*
+		 * Make sure there is room for a full read.  The buffer only ever
+		 * holds the tail of one incomplete FLAP between reads, so this
+		 * tops out at a little over the 64KB maximum frame size.
+		 */
+		if (conn->buffer_incoming_size - conn->buffer_incoming_used < FLAP_READ_SIZE)
 		{
-			buf = conn->header + conn->header_received;
-			buflen = 6 - conn->header_received;
-
-			/* Read the first 6 bytes (the FLAP header) */
-			if (conn->gsc)
-				read = purple_ssl_read(conn->gsc, buf, buflen);
-			else
-				read = recv(conn->fd, buf, buflen, 0);
-
-			/* Check if the FLAP server closed the connection */
-			if (read == 0)
-			{
-				flap_connection_schedule_destroy(conn,
-						OSCAR_DISCONNECT_REMOTE_CLOSED, NULL);
-				break;
-			}
-
-			/* If there was an error then close the connection */
-			if (read < 0)
-			{
-				if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
-					/* No worries */
-					break;
-
-				/* Error! */
-				flap_connection_schedule_destroy(conn,
-						OSCAR_DISCONNECT_LOST_CONNECTION, g_strerror(errno));
-				break;
-			}
-			purple_connection_update_last_received(conn->od->gc);
+			conn->buffer_incoming_size = conn->buffer_incoming_used + FLAP_READ_SIZE;
+			conn->buffer_incoming_data = g_realloc(conn->buffer_incoming_data,
+					conn->buffer_incoming_size);
+		}
 
-			/* If we don't even have a complete FLAP header then do nothing */
-			conn->header_received += read;
-			if (conn->header_received < 6)
-				break;
+		buflen = conn->buffer_incoming_size - conn->buffer_incoming_used;
+		if (conn->gsc)
+			read = purple_ssl_read(conn->gsc,
+					conn->buffer_incoming_data + conn->buffer_incoming_used, buflen);
+		else
+			read = recv(conn->fd,
+					conn->buffer_incoming_data + conn->buffer_incoming_used, buflen, 0);
 
-			/* All FLAP frames must start with the byte 0x2a */
-			if (aimutil_get8(&conn->header[0]) != 0x2a)
-			{
-				flap_connection_schedule_destroy(conn,
-						OSCAR_DISCONNECT_INVALID_DATA, NULL);
-				break;
-			}
-
-			/* Initialize a new temporary FlapFrame for incoming data */
-			conn->buffer_incoming.channel = aimutil_get8(&conn->header[1]);
-			conn->buffer_incoming.seqnum = aimutil_get16(&conn->header[2]);
-			conn->buffer_incoming.data.len = aimutil_get16(&conn->header[4]);
-			conn->buffer_incoming.data.data = g_new(guint8, conn->buffer_incoming.data.len);
-			conn->buffer_incoming.data.offset = 0;
+		/* Check if the FLAP server closed the connection */
+		if (read == 0)
+		{
+			flap_connection_schedule_destroy(conn,
+					OSCAR_DISCONNECT_REMOTE_CLOSED, NULL);
+			break;
 		}
 
-		buflen = conn->buffer_incoming.data.len - conn->buffer_incoming.data.offset;
-		if (buflen)
+		/* If there was an error then close the connection */
+		if (read < 0)
 		{
-			buf = &conn->buffer_incoming.data.data[conn->buffer_incoming.data.offset];
-			/* Read data into the temporary FlapFrame until it is complete */
-			if (conn->gsc)
-				read = purple_ssl_read(conn->gsc, buf, buflen);
-			else
-				read = recv(conn->fd, buf, buflen, 0);
-
-			/* Check if the FLAP server closed the connection */
-			if (read == 0)
-			{
-				flap_connection_schedule_destroy(conn,
-						OSCAR_DISCONNECT_REMOTE_CLOSED, NULL);
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				/* No worries */
 				break;
-			}
-
-			if (read < 0)
-			{
-				if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
-					/* No worries */
-					break;
 
-				/* Error! */
-				flap_connection_schedule_destroy(conn,
-						OSCAR_DISCONNECT_LOST_CONNECTION, g_strerror(errno));
-				break;
-			}
-
-			conn->buffer_incoming.data.offset += read;
-			if (conn->buffer_incoming.data.offset < conn->buffer_incoming.data.len)
-				/* Waiting for more data to arrive */
-				break;
+			/* Error! */
+			flap_connection_schedule_destroy(conn,
+					OSCAR_DISCONNECT_LOST_CONNECTION, g_strerror(errno));
+			break;
 		}
+		purple_connection_update_last_received(conn->od->gc);
 
-		/* We have a complete FLAP!  Handle it and continue reading */
-		byte_stream_rewind(&conn->buffer_incoming.data);
-		parse_flap(conn->od, conn, &conn->buffer_incoming);
-		conn->lastactivity = time(NULL);
-
-		g_free(conn->buffer_incoming.data.data);
-		conn->buffer_incoming.data.data = NULL;
+		conn->buffer_incoming_used += read;
+		if (!flap_connection_parse_incoming(conn))
+			break;
 
-		conn->header_received = 0;
+		/*
+		 * A short read means the socket has been drained, so don't bother
+		 * with another recv() just to get EAGAIN.  SSL connections may
+		 * have decrypted data buffered that won't wake the watcher up
+		 * again, so those keep reading until they run dry.
+		 */
+		if (conn->gsc == NULL && (gsize)read < buflen)
+			break;
 	}
 }
 
@@ -298,9 +298,9 @@ struct _FlapConnection
 
 	int fd;
 	PurpleSslConnection *gsc;
-	guint8 header[6];
-	gssize header_received;
-	FlapFrame buffer_incoming;
+	guint8 *buffer_incoming_data; /**< Received data not yet parsed into FLAPs */
+	gsize buffer_incoming_size;
+	gsize buffer_incoming_used;
 	PurpleCircularBuffer *buffer_outgoing;
 	guint watcher_incoming;
 	guint watcher_outgoing;
@@ -336,6 +336,8 @@ struct aim_ssi_itemlist {
 	struct aim_ssi_item *data;
 	GHashTable *idx_gid_bid;
 	GHashTable *idx_all_named_items;
+	GHashTable *idx_gid_named_items; /* Named items keyed by group ID#, type and name */
+	GHashTable *changed; /* gid+bid keys of items touched since the last sync */
 };
 
 /**
@@ -382,6 +384,8 @@ struct _OscarData
 	PurpleConnection *gc;
 
 	void *modlistv;
+	GHashTable *modfamilies; /* SNAC family -> aim_module_t */
+	GSList *modmultifamily; /* Modules registered with AIM_MODFLAG_MULTIFAMILY */
 
 	/*
 	 * Outstanding snac handling
@@ -23,14 +23,7 @@
 
 aim_module_t *aim__findmodulebygroup(OscarData *od, guint16 group)
 {
-	aim_module_t *cur;
-
-	for (cur = (aim_module_t *)od->modlistv; cur; cur = cur->next) {
-		if (cur->family == group)
-			return cur;
-	}
-
-	return NULL;
+	return g_hash_table_lookup(od->modfamilies, GUINT_TO_POINTER(group));
 }
 
 aim_module_t *aim__findmodule(OscarData *od, const char *name)
@@ -69,6 +62,11 @@ int aim__registermodule(OscarData *od, int (*modfirst)(OscarData *, aim_module_t
 	mod->next = (aim_module_t *)od->modlistv;
 	od->modlistv = mod;
 
+	/* Later registrations take precedence, just like in the module list */
+	g_hash_table_insert(od->modfamilies, GUINT_TO_POINTER(mod->family), mod);
+	if (mod->flags & AIM_MODFLAG_MULTIFAMILY)
+		od->modmultifamily = g_slist_prepend(od->modmultifamily, mod);
+
 	return 0;
 }
 
@@ -91,5 +89,9 @@ void aim__shutdownmodules(OscarData *od)
 
 	od->modlistv = NULL;
 
+	g_hash_table_remove_all(od->modfamilies);
+	g_slist_free(od->modmultifamily);
+	od->modmultifamily = NULL;
+
 	return;
 }
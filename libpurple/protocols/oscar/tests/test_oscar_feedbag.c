@@ -0,0 +1,160 @@
+#include <glib.h>
+
+#include "../oscar.h"
+
+/* Acknowledges the pending changes as the server would, until there are
+ * none left. */
+static void
+test_oscar_feedbag_ack(OscarData *od) {
+	aim_module_t *mod = aim__findmodulebygroup(od, SNAC_FAMILY_FEEDBAG);
+	aim_modsnac_t snac = {
+		SNAC_FAMILY_FEEDBAG, SNAC_SUBTYPE_FEEDBAG_SRVACK, 0, 0
+	};
+	FlapFrame frame;
+	struct aim_ssi_tmp *cur;
+
+	g_assert_nonnull(mod);
+
+	while(od->ssi.pending != NULL) {
+		byte_stream_new(&frame.data, 0x100);
+		for(cur = od->ssi.pending; cur != NULL; cur = cur->next) {
+			byte_stream_put16(&frame.data, 0x0000);
+		}
+		byte_stream_rewind(&frame.data);
+
+		mod->snachandler(od, NULL, mod, &frame, &snac, &frame.data);
+
+		byte_stream_destroy(&frame.data);
+	}
+}
+
+static void
+test_oscar_feedbag_find_item(void) {
+	OscarData *od = oscar_data_new();
+	struct aim_ssi_item *friends, *work, *alice, *alice2;
+
+	aim_ssi_addbuddy(od, "Alice", "Friends", NULL, NULL, NULL, NULL, FALSE);
+	aim_ssi_addbuddy(od, "Bob", "Work", NULL, NULL, NULL, NULL, FALSE);
+	aim_ssi_addbuddy(od, "alice", "Work", NULL, NULL, NULL, NULL, FALSE);
+
+	friends = aim_ssi_itemlist_finditem(&od->ssi.local, "Friends", NULL,
+	                                    AIM_SSI_TYPE_GROUP);
+	work = aim_ssi_itemlist_finditem(&od->ssi.local, "work", NULL,
+	                                 AIM_SSI_TYPE_GROUP);
+	g_assert_nonnull(friends);
+	g_assert_nonnull(work);
+	g_assert_cmpint(friends->gid, !=, work->gid);
+
+	alice = aim_ssi_itemlist_finditem(&od->ssi.local, "Friends", "A lice",
+	                                  AIM_SSI_TYPE_BUDDY);
+	alice2 = aim_ssi_itemlist_finditem(&od->ssi.local, "Work", "ALICE",
+	                                   AIM_SSI_TYPE_BUDDY);
+	g_assert_nonnull(alice);
+	g_assert_nonnull(alice2);
+	g_assert_true(alice != alice2);
+	g_assert_cmpint(alice->gid, ==, friends->gid);
+	g_assert_cmpint(alice2->gid, ==, work->gid);
+	g_assert_null(aim_ssi_itemlist_finditem(&od->ssi.local, "Friends", "Bob",
+	                                        AIM_SSI_TYPE_BUDDY));
+
+	/* The name index falls back to the buddy left in the other group. */
+	aim_ssi_delbuddy(od, "Alice", "Friends");
+	g_assert_null(aim_ssi_itemlist_finditem(&od->ssi.local, "Friends",
+	                                        "Alice", AIM_SSI_TYPE_BUDDY));
+	g_assert_true(aim_ssi_itemlist_finditem(&od->ssi.local, NULL, "Alice",
+	                                        AIM_SSI_TYPE_BUDDY) == alice2);
+
+	oscar_data_destroy(od);
+}
+
+static void
+test_oscar_feedbag_find_item_key(void) {
+	OscarData *od = oscar_data_new();
+	const guint8 iconsum[] = { 0x01, 0x02, 0x03, 0x04 };
+	struct aim_ssi_item *group, *icon;
+
+	od->ssi.received_data = TRUE;
+
+	/* The type of a group is 1 and the one of the icon item, named "1", is
+	 * 0x14, so their keys mustn't just be the type and name run together. */
+	aim_ssi_addbuddy(od, "Alice", "41", NULL, NULL, NULL, NULL, FALSE);
+	aim_ssi_seticon(od, iconsum, sizeof(iconsum));
+
+	group = aim_ssi_itemlist_finditem(&od->ssi.local, "41", NULL,
+	                                  AIM_SSI_TYPE_GROUP);
+	icon = aim_ssi_itemlist_finditem(&od->ssi.local, NULL, "1",
+	                                 AIM_SSI_TYPE_ICONINFO);
+	g_assert_nonnull(group);
+	g_assert_nonnull(icon);
+	g_assert_cmpint(group->type, ==, AIM_SSI_TYPE_GROUP);
+	g_assert_cmpint(icon->type, ==, AIM_SSI_TYPE_ICONINFO);
+	g_assert_nonnull(aim_ssi_itemlist_finditem(&od->ssi.local, "41", "Alice",
+	                                           AIM_SSI_TYPE_BUDDY));
+
+	oscar_data_destroy(od);
+}
+
+static void
+test_oscar_feedbag_sync_changed(void) {
+	OscarData *od = oscar_data_new();
+	struct aim_ssi_item *alice;
+	gchar *alias;
+
+	aim_ssi_addbuddy(od, "Alice", "Friends", NULL, NULL, NULL, NULL, FALSE);
+	aim_ssi_addbuddy(od, "Bob", "Friends", NULL, NULL, NULL, NULL, FALSE);
+	test_oscar_feedbag_ack(od);
+
+	/* Both lists match, so nothing is left to compare. */
+	g_assert_nonnull(aim_ssi_itemlist_finditem(&od->ssi.official, "Friends",
+	                                           "Bob", AIM_SSI_TYPE_BUDDY));
+	g_assert_cmpuint(g_hash_table_size(od->ssi.local.changed), ==, 0);
+	g_assert_cmpuint(g_hash_table_size(od->ssi.official.changed), ==, 0);
+
+	/* Only the changed buddy is sent. */
+	alice = aim_ssi_itemlist_finditem(&od->ssi.local, "Friends", "Alice",
+	                                  AIM_SSI_TYPE_BUDDY);
+	aim_ssi_aliasbuddy(od, "Friends", "Alice", "Ally");
+	g_assert_nonnull(od->ssi.pending);
+	g_assert_cmpint(od->ssi.pending->action, ==, SNAC_SUBTYPE_FEEDBAG_MOD);
+	g_assert_true(od->ssi.pending->item == alice);
+	g_assert_null(od->ssi.pending->next);
+
+	test_oscar_feedbag_ack(od);
+
+	alias = aim_ssi_getalias(&od->ssi.official, "Friends", "Alice");
+	g_assert_cmpstr(alias, ==, "Ally");
+	g_free(alias);
+	g_assert_cmpuint(g_hash_table_size(od->ssi.local.changed), ==, 0);
+	g_assert_cmpuint(g_hash_table_size(od->ssi.official.changed), ==, 0);
+
+	/* A removal is sent as a deletion, and the group is updated after it. */
+	aim_ssi_delbuddy(od, "Bob", "Friends");
+	g_assert_nonnull(od->ssi.pending);
+	g_assert_cmpint(od->ssi.pending->action, ==, SNAC_SUBTYPE_FEEDBAG_DEL);
+	g_assert_null(od->ssi.pending->next);
+
+	test_oscar_feedbag_ack(od);
+
+	g_assert_null(aim_ssi_itemlist_finditem(&od->ssi.official, "Friends",
+	                                        "Bob", AIM_SSI_TYPE_BUDDY));
+	g_assert_nonnull(aim_ssi_itemlist_finditem(&od->ssi.official, "Friends",
+	                                           "Alice", AIM_SSI_TYPE_BUDDY));
+	g_assert_cmpuint(g_hash_table_size(od->ssi.local.changed), ==, 0);
+	g_assert_cmpuint(g_hash_table_size(od->ssi.official.changed), ==, 0);
+
+	oscar_data_destroy(od);
+}
+
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/oscar/feedbag/find item",
+	                test_oscar_feedbag_find_item);
+	g_test_add_func("/oscar/feedbag/find item/key",
+	                test_oscar_feedbag_find_item_key);
+	g_test_add_func("/oscar/feedbag/sync changed",
+	                test_oscar_feedbag_sync_changed);
+
+	return g_test_run();
+}
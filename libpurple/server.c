@@ -768,8 +768,7 @@ PurpleChatConversation *purple_serv_got_joined_chat(PurpleConnection *gc,
 	chat = purple_chat_conversation_new(account, name);
 	g_return_val_if_fail(chat != NULL, NULL);
 
-	if (!g_slist_find(purple_connection_get_active_chats(gc), chat))
-		_purple_connection_add_active_chat(gc, chat);
+	_purple_connection_add_active_chat(gc, chat);
 
 	purple_chat_conversation_set_id(chat, id);
 
@@ -34,13 +34,42 @@ typedef struct
 	GHashTable *signals;
 	size_t signal_count;
 
-	gulong next_signal_id;
-
 } PurpleInstanceData;
 
 typedef struct
 {
 	gulong id;
+	PurpleCallback cb;
+	void *handle;
+	void *data;
+	gboolean use_vargs;
+	int priority;
+
+	/* Set once the handler is disconnected, so emissions still walking
+	 * an older array skip it. */
+	gboolean disconnected;
+	gint ref_count;
+
+} PurpleSignalHandlerData;
+
+/*
+ * The handlers of a signal, sorted by priority. The array is never changed
+ * after it's built: connecting or disconnecting a handler replaces it with
+ * a new one, so an emission in progress keeps its own snapshot.
+ */
+typedef struct
+{
+	gint ref_count;
+
+	guint count;
+	PurpleSignalHandlerData **handlers;
+
+} PurpleSignalHandlers;
+
+typedef struct
+{
+	gulong id;
+	char *name;
 
 	PurpleSignalMarshalFunc marshal;
 
@@ -48,24 +77,150 @@ typedef struct
 	GType *value_types;
 	GType ret_type;
 
-	GList *handlers;
-	size_t handler_count;
+	PurpleSignalHandlers *handlers;
 
 	gulong next_handler_id;
 } PurpleSignalData;
 
-typedef struct
+static GHashTable *instance_table = NULL;
+
+/* Signals indexed by their IDs. IDs aren't reused, so a stale ID points to
+ * an empty slot instead of a different signal. */
+static GPtrArray *signal_table = NULL;
+
+/**************************************************************************
+ * Handler arrays
+ **************************************************************************/
+
+static void
+handler_data_unref(PurpleSignalHandlerData *handler_data)
 {
-	gulong id;
-	PurpleCallback cb;
-	void *handle;
-	void *data;
-	gboolean use_vargs;
-	int priority;
+	if (--handler_data->ref_count == 0)
+		g_free(handler_data);
+}
 
-} PurpleSignalHandlerData;
+static PurpleSignalHandlers *
+handlers_new(guint count)
+{
+	PurpleSignalHandlers *handlers;
 
-static GHashTable *instance_table = NULL;
+	handlers = g_new0(PurpleSignalHandlers, 1);
+	handlers->ref_count = 1;
+	handlers->count = count;
+	handlers->handlers = g_new(PurpleSignalHandlerData *, count);
+
+	return handlers;
+}
+
+static PurpleSignalHandlers *
+handlers_ref(PurpleSignalHandlers *handlers)
+{
+	handlers->ref_count++;
+
+	return handlers;
+}
+
+static void
+handlers_unref(PurpleSignalHandlers *handlers)
+{
+	guint i;
+
+	if (--handlers->ref_count > 0)
+		return;
+
+	for (i = 0; i < handlers->count; i++)
+		handler_data_unref(handlers->handlers[i]);
+	g_free(handlers->handlers);
+	g_free(handlers);
+}
+
+/* Replaces the handler array of a signal. An empty array is stored as NULL,
+ * which is what the emission fast path checks for. */
+static void
+signal_data_set_handlers(PurpleSignalData *signal_data,
+                         PurpleSignalHandlers *handlers)
+{
+	if (handlers != NULL && handlers->count == 0) {
+		handlers_unref(handlers);
+		handlers = NULL;
+	}
+
+	if (signal_data->handlers != NULL)
+		handlers_unref(signal_data->handlers);
+	signal_data->handlers = handlers;
+}
+
+static void
+signal_data_add_handler(PurpleSignalData *signal_data,
+                        PurpleSignalHandlerData *handler_data)
+{
+	PurpleSignalHandlers *old = signal_data->handlers;
+	PurpleSignalHandlers *handlers;
+	guint old_count = old ? old->count : 0;
+	guint i, pos;
+
+	/* A new handler goes before the existing ones of the same priority. */
+	for (pos = 0; pos < old_count; pos++) {
+		if (old->handlers[pos]->priority >= handler_data->priority)
+			break;
+	}
+
+	handlers = handlers_new(old_count + 1);
+	for (i = 0; i < old_count; i++) {
+		PurpleSignalHandlerData *hd = old->handlers[i];
+
+		hd->ref_count++;
+		handlers->handlers[i < pos ? i : i + 1] = hd;
+	}
+	handlers->handlers[pos] = handler_data;
+
+	signal_data_set_handlers(signal_data, handlers);
+}
+
+/* Removes the handlers connected with @handle and, if @func isn't NULL,
+ * @func; @first_only stops after the first match. Returns the number of
+ * removed handlers. */
+static guint
+signal_data_remove_handlers(PurpleSignalData *signal_data, void *handle,
+                            PurpleCallback func, gboolean first_only)
+{
+	PurpleSignalHandlers *old = signal_data->handlers;
+	PurpleSignalHandlers *handlers;
+	guint i, removed = 0;
+
+	if (old == NULL)
+		return 0;
+
+	handlers = handlers_new(old->count);
+	handlers->count = 0;
+	for (i = 0; i < old->count; i++) {
+		PurpleSignalHandlerData *hd = old->handlers[i];
+
+		if (hd->handle == handle && (func == NULL || hd->cb == func) &&
+			!(first_only && removed > 0))
+		{
+			hd->disconnected = TRUE;
+			removed++;
+			continue;
+		}
+
+		hd->ref_count++;
+		handlers->handlers[handlers->count++] = hd;
+	}
+
+	if (removed == 0) {
+		handlers_unref(handlers);
+		return 0;
+	}
+
+	signal_data_set_handlers(signal_data, handlers);
+
+	return removed;
+}
+
+/**************************************************************************
+ * Signal registry
+ **************************************************************************/
 
 static void
 destroy_instance_data(PurpleInstanceData *instance_data)
@@ -78,13 +233,45 @@ destroy_instance_data(PurpleInstanceData *instance_data)
 static void
 destroy_signal_data(PurpleSignalData *signal_data)
 {
-	g_list_foreach(signal_data->handlers, (GFunc)g_free, NULL);
-	g_list_free(signal_data->handlers);
+	if (signal_data->handlers != NULL) {
+		guint i;
 
+		/* An emission of this signal may still be running. */
+		for (i = 0; i < signal_data->handlers->count; i++)
+			signal_data->handlers->handlers[i]->disconnected = TRUE;
+		handlers_unref(signal_data->handlers);
+	}
+
+	signal_table->pdata[signal_data->id] = NULL;
+
+	g_free(signal_data->name);
 	g_free(signal_data->value_types);
 	g_free(signal_data);
 }
 
+static PurpleSignalData *
+signal_data_lookup(void *instance, const char *signal)
+{
+	PurpleInstanceData *instance_data;
+
+	instance_data =
+		(PurpleInstanceData *)g_hash_table_lookup(instance_table, instance);
+
+	if (instance_data == NULL)
+		return NULL;
+
+	return g_hash_table_lookup(instance_data->signals, signal);
+}
+
+static inline PurpleSignalData *
+signal_data_get(gulong signal_id)
+{
+	if (signal_id >= signal_table->len)
+		return NULL;
+
+	return g_ptr_array_index(signal_table, signal_id);
+}
+
 gulong
 purple_signal_register(void *instance, const char *signal,
 					 PurpleSignalMarshalFunc marshal,
@@ -106,17 +293,22 @@ purple_signal_register(void *instance, const char *signal,
 		instance_data = g_new0(PurpleInstanceData, 1);
 
 		instance_data->instance = instance;
-		instance_data->next_signal_id = 1;
 
 		instance_data->signals =
-			g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
 								  (GDestroyNotify)destroy_signal_data);
 
 		g_hash_table_insert(instance_table, instance, instance_data);
 	}
+	else if (g_hash_table_contains(instance_data->signals, signal))
+	{
+		/* Registering a signal twice replaces the old one. */
+		instance_data->signal_count--;
+	}
 
 	signal_data = g_new0(PurpleSignalData, 1);
-	signal_data->id              = instance_data->next_signal_id;
+	signal_data->id              = signal_table->len;
+	signal_data->name            = g_strdup(signal);
 	signal_data->marshal         = marshal;
 	signal_data->next_handler_id = 1;
 	signal_data->ret_type        = ret_type;
@@ -136,10 +328,10 @@ purple_signal_register(void *instance, const char *signal,
 		va_end(args);
 	}
 
-	g_hash_table_insert(instance_data->signals,
-						g_strdup(signal), signal_data);
+	g_ptr_array_add(signal_table, signal_data);
+	g_hash_table_replace(instance_data->signals,
+						 signal_data->name, signal_data);
 
-	instance_data->next_signal_id++;
 	instance_data->signal_count++;
 
 	return signal_data->id;
@@ -183,6 +375,27 @@ purple_signals_unregister_by_instance(void *instance)
 	/* g_return_if_fail(found); */
 }
 
+gulong
+purple_signal_lookup(void *instance, const char *signal)
+{
+	PurpleSignalData *signal_data;
+
+	g_return_val_if_fail(instance != NULL, 0);
+	g_return_val_if_fail(signal   != NULL, 0);
+
+	signal_data = signal_data_lookup(instance, signal);
+
+	return signal_data ? signal_data->id : 0;
+}
+
+gboolean
+purple_signal_has_handlers(gulong signal_id)
+{
+	PurpleSignalData *signal_data = signal_data_get(signal_id);
+
+	return (signal_data != NULL && signal_data->handlers != NULL);
+}
+
 void
 purple_signal_get_types(void *instance, const char *signal,
 					   GType *ret_type,
@@ -215,13 +428,9 @@ purple_signal_get_types(void *instance, const char *signal,
 		*ret_type = signal_data->ret_type;
 }
 
-static gint handler_priority(void * a, void * b) {
-	PurpleSignalHandlerData *ah = (PurpleSignalHandlerData*)a;
-	PurpleSignalHandlerData *bh = (PurpleSignalHandlerData*)b;
-	if (ah->priority > bh->priority) return 1;
-	if (ah->priority < bh->priority) return -1;
-	return 0;
-}
+/**************************************************************************
+ * Handlers
+ **************************************************************************/
 
 static gulong
 signal_connect_common(void *instance, const char *signal, void *handle,
@@ -266,10 +475,10 @@ signal_connect_common(void *instance, const char *signal, void *handle,
 	handler_data->handle    = handle;
 	handler_data->data      = data;
 	handler_data->use_vargs = use_vargs;
-	handler_data->priority = priority;
+	handler_data->priority  = priority;
+	handler_data->ref_count = 1;
 
-	signal_data->handlers = g_list_insert_sorted(signal_data->handlers, handler_data, (GCompareFunc)handler_priority);
-	signal_data->handler_count++;
+	signal_data_add_handler(signal_data, handler_data);
 	signal_data->next_handler_id++;
 
 	return handler_data->id;
@@ -309,9 +518,7 @@ purple_signal_disconnect(void *instance, const char *signal,
 {
 	PurpleInstanceData *instance_data;
 	PurpleSignalData *signal_data;
-	PurpleSignalHandlerData *handler_data;
-	GList *l;
-	gboolean found = FALSE;
+	gboolean found;
 
 	g_return_if_fail(instance != NULL);
 	g_return_if_fail(signal   != NULL);
@@ -335,54 +542,17 @@ purple_signal_disconnect(void *instance, const char *signal,
 		return;
 	}
 
-	/* Find the handler data. */
-	for (l = signal_data->handlers; l != NULL; l = l->next)
-	{
-		handler_data = (PurpleSignalHandlerData *)l->data;
-
-		if (handler_data->handle == handle && handler_data->cb == func)
-		{
-			g_free(handler_data);
-
-			signal_data->handlers = g_list_delete_link(signal_data->handlers,
-												       l);
-			signal_data->handler_count--;
-
-			found = TRUE;
-
-			break;
-		}
-	}
+	found = (signal_data_remove_handlers(signal_data, handle, func, TRUE) > 0);
 
 	/* See note somewhere about this actually helping developers.. */
 	g_return_if_fail(found);
 }
 
-/*
- * TODO: Make this all more efficient by storing a list of handlers, keyed
- *       to a handle.
- */
 static void
 disconnect_handle_from_signals(const char *signal,
 							   PurpleSignalData *signal_data, void *handle)
 {
-	GList *l, *l_next;
-	PurpleSignalHandlerData *handler_data;
-
-	for (l = signal_data->handlers; l != NULL; l = l_next)
-	{
-		handler_data = (PurpleSignalHandlerData *)l->data;
-		l_next = l->next;
-
-		if (handler_data->handle == handle)
-		{
-			g_free(handler_data);
-
-			signal_data->handler_count--;
-			signal_data->handlers = g_list_delete_link(signal_data->handlers,
-			                                           l);
-		}
-	}
+	signal_data_remove_handlers(signal_data, handle, NULL, FALSE);
 }
 
 static void
@@ -403,6 +573,102 @@ purple_signals_disconnect_by_handle(void *handle)
 						 (GHFunc)disconnect_handle_from_instance, handle);
 }
 
+/**************************************************************************
+ * Emission
+ **************************************************************************/
+
+static void
+signal_emit_vargs(PurpleSignalData *signal_data, va_list args)
+{
+	PurpleSignalHandlers *handlers = signal_data->handlers;
+	PurpleSignalMarshalFunc marshal = signal_data->marshal;
+	guint i;
+	va_list tmp;
+
+	/* Most signals have no handlers most of the time. */
+	if (handlers != NULL)
+	{
+		handlers_ref(handlers);
+
+		for (i = 0; i < handlers->count; i++)
+		{
+			PurpleSignalHandlerData *handler_data = handlers->handlers[i];
+
+			if (handler_data->disconnected)
+				continue;
+
+			/* This is necessary because a va_list may only be
+			 * evaluated once */
+			G_VA_COPY(tmp, args);
+
+			if (handler_data->use_vargs)
+			{
+				((void (*)(va_list, void *))handler_data->cb)(tmp,
+															  handler_data->data);
+			}
+			else
+			{
+				marshal(handler_data->cb, tmp, handler_data->data, NULL);
+			}
+
+			va_end(tmp);
+		}
+
+		handlers_unref(handlers);
+	}
+
+#ifdef HAVE_DBUS
+	purple_dbus_signal_emit_purple(signal_data->name, signal_data->num_values,
+				   signal_data->value_types, args);
+#endif	/* HAVE_DBUS */
+}
+
+static void *
+signal_emit_vargs_return_1(PurpleSignalData *signal_data, va_list args)
+{
+	PurpleSignalHandlers *handlers = signal_data->handlers;
+	PurpleSignalMarshalFunc marshal = signal_data->marshal;
+	void *ret_val = NULL;
+	guint i;
+	va_list tmp;
+
+#ifdef HAVE_DBUS
+	G_VA_COPY(tmp, args);
+	purple_dbus_signal_emit_purple(signal_data->name, signal_data->num_values,
+				   signal_data->value_types, tmp);
+	va_end(tmp);
+#endif	/* HAVE_DBUS */
+
+	if (handlers == NULL)
+		return NULL;
+
+	handlers_ref(handlers);
+
+	for (i = 0; i < handlers->count && ret_val == NULL; i++)
+	{
+		PurpleSignalHandlerData *handler_data = handlers->handlers[i];
+
+		if (handler_data->disconnected)
+			continue;
+
+		G_VA_COPY(tmp, args);
+		if (handler_data->use_vargs)
+		{
+			ret_val = ((void *(*)(va_list, void *))handler_data->cb)(
+				tmp, handler_data->data);
+		}
+		else
+		{
+			marshal(handler_data->cb, tmp, handler_data->data, &ret_val);
+		}
+		va_end(tmp);
+	}
+
+	handlers_unref(handlers);
+
+	return ret_val;
+}
+
 void
 purple_signal_emit(void *instance, const char *signal, ...)
 {
@@ -421,9 +687,6 @@ purple_signal_emit_vargs(void *instance, const char *signal, va_list args)
 {
 	PurpleInstanceData *instance_data;
 	PurpleSignalData *signal_data;
-	PurpleSignalHandlerData *handler_data;
-	GList *l, *l_next;
-	va_list tmp;
 
 	g_return_if_fail(instance != NULL);
 	g_return_if_fail(signal   != NULL);
@@ -443,35 +706,32 @@ purple_signal_emit_vargs(void *instance, const char *signal, va_list args)
 		return;
 	}
 
-	for (l = signal_data->handlers; l != NULL; l = l_next)
-	{
-		l_next = l->next;
+	signal_emit_vargs(signal_data, args);
+}
 
-		handler_data = (PurpleSignalHandlerData *)l->data;
+void
+purple_signal_emit_by_id(gulong signal_id, ...)
+{
+	va_list args;
 
-		/* This is necessary because a va_list may only be
-		 * evaluated once */
-		G_VA_COPY(tmp, args);
+	va_start(args, signal_id);
+	purple_signal_emit_vargs_by_id(signal_id, args);
+	va_end(args);
+}
 
-		if (handler_data->use_vargs)
-		{
-			((void (*)(va_list, void *))handler_data->cb)(tmp,
-														  handler_data->data);
-		}
-		else
-		{
-			signal_data->marshal(handler_data->cb, tmp,
-								 handler_data->data, NULL);
-		}
+void
+purple_signal_emit_vargs_by_id(gulong signal_id, va_list args)
+{
+	PurpleSignalData *signal_data = signal_data_get(signal_id);
 
-		va_end(tmp);
+	if (signal_data == NULL)
+	{
+		purple_debug(PURPLE_DEBUG_ERROR, "signals",
+				   "Signal data for ID %lu not found!\n", signal_id);
+		return;
 	}
 
-#ifdef HAVE_DBUS
-	purple_dbus_signal_emit_purple(signal, signal_data->num_values,
-				   signal_data->value_types, args);
-#endif	/* HAVE_DBUS */
-
+	signal_emit_vargs(signal_data, args);
 }
 
 void *
@@ -496,9 +756,6 @@ purple_signal_emit_vargs_return_1(void *instance, const char *signal,
 {
 	PurpleInstanceData *instance_data;
 	PurpleSignalData *signal_data;
-	PurpleSignalHandlerData *handler_data;
-	GList *l, *l_next;
-	va_list tmp;
 
 	g_return_val_if_fail(instance != NULL, NULL);
 	g_return_val_if_fail(signal   != NULL, NULL);
@@ -518,39 +775,35 @@ purple_signal_emit_vargs_return_1(void *instance, const char *signal,
 		return 0;
 	}
 
-#ifdef HAVE_DBUS
-	G_VA_COPY(tmp, args);
-	purple_dbus_signal_emit_purple(signal, signal_data->num_values,
-				   signal_data->value_types, tmp);
-	va_end(tmp);
-#endif	/* HAVE_DBUS */
+	return signal_emit_vargs_return_1(signal_data, args);
+}
 
-	for (l = signal_data->handlers; l != NULL; l = l_next)
-	{
-		void *ret_val = NULL;
+void *
+purple_signal_emit_return_1_by_id(gulong signal_id, ...)
+{
+	void *ret_val;
+	va_list args;
 
-		l_next = l->next;
+	va_start(args, signal_id);
+	ret_val = purple_signal_emit_vargs_return_1_by_id(signal_id, args);
+	va_end(args);
 
-		handler_data = (PurpleSignalHandlerData *)l->data;
+	return ret_val;
+}
 
-		G_VA_COPY(tmp, args);
-		if (handler_data->use_vargs)
-		{
-			ret_val = ((void *(*)(va_list, void *))handler_data->cb)(
-				tmp, handler_data->data);
-		}
-		else
-		{
-			signal_data->marshal(handler_data->cb, tmp,
-								 handler_data->data, &ret_val);
-		}
-		va_end(tmp);
+void *
+purple_signal_emit_vargs_return_1_by_id(gulong signal_id, va_list args)
+{
+	PurpleSignalData *signal_data = signal_data_get(signal_id);
 
-		if (ret_val != NULL)
-			return ret_val;
+	if (signal_data == NULL)
+	{
+		purple_debug(PURPLE_DEBUG_ERROR, "signals",
+				   "Signal data for ID %lu not found!\n", signal_id);
+		return NULL;
 	}
 
-	return NULL;
+	return signal_emit_vargs_return_1(signal_data, args);
 }
 
 void
@@ -561,6 +814,10 @@ purple_signals_init()
 	instance_table =
 		g_hash_table_new_full(g_direct_hash, g_direct_equal,
 							  NULL, (GDestroyNotify)destroy_instance_data);
+
+	/* Signal ID 0 is reserved for errors. */
+	signal_table = g_ptr_array_new();
+	g_ptr_array_add(signal_table, NULL);
 }
 
 void
@@ -570,6 +827,9 @@ purple_signals_uninit()
 
 	g_hash_table_destroy(instance_table);
 	instance_table = NULL;
+
+	g_ptr_array_free(signal_table, TRUE);
+	signal_table = NULL;
 }
 
 /**************************************************************************
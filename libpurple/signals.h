@@ -86,8 +86,11 @@ G_BEGIN_DECLS
  *
  * Registers a signal in an instance.
  *
- * Returns: The signal ID local to that instance, or 0 if the signal
- *          couldn't be registered.
+ * The returned ID can be kept to emit the signal with
+ * purple_signal_emit_by_id(), which skips looking the signal up by name.
+ * IDs are never reused, even after the signal is unregistered.
+ *
+ * Returns: The signal ID, or 0 if the signal couldn't be registered.
  */
 gulong purple_signal_register(void *instance, const char *signal,
 							PurpleSignalMarshalFunc marshal,
@@ -110,6 +113,28 @@ void purple_signal_unregister(void *instance, const char *signal);
  */
 void purple_signals_unregister_by_instance(void *instance);
 
+/**
+ * purple_signal_lookup:
+ * @instance: The instance the signal is registered to.
+ * @signal:   The signal name.
+ *
+ * Looks up the ID of a registered signal.
+ *
+ * Returns: The signal ID, or 0 if there is no such signal.
+ */
+gulong purple_signal_lookup(void *instance, const char *signal);
+
+/**
+ * purple_signal_has_handlers:
+ * @signal_id: The signal ID.
+ *
+ * Checks whether any handler is connected to a signal. Callers may use it
+ * to skip preparing the arguments of a signal nobody listens to.
+ *
+ * Returns: %TRUE if the signal has at least one handler.
+ */
+gboolean purple_signal_has_handlers(gulong signal_id);
+
 /**
  * purple_signal_get_types:
  * @instance:           The instance the signal is registered to.
@@ -267,6 +292,29 @@ void purple_signal_emit(void *instance, const char *signal, ...);
  */
 void purple_signal_emit_vargs(void *instance, const char *signal, va_list args);
 
+/**
+ * purple_signal_emit_by_id:
+ * @signal_id: The ID of the signal being emitted.
+ * @...:       The arguments to pass to the callbacks.
+ *
+ * Emits a signal by its ID, as returned by purple_signal_register() or
+ * purple_signal_lookup().
+ *
+ * See purple_signal_emit()
+ */
+void purple_signal_emit_by_id(gulong signal_id, ...);
+
+/**
+ * purple_signal_emit_vargs_by_id:
+ * @signal_id: The ID of the signal being emitted.
+ * @args:      The arguments list.
+ *
+ * Emits a signal by its ID, using a va_list of arguments.
+ *
+ * See purple_signal_emit_vargs()
+ */
+void purple_signal_emit_vargs_by_id(gulong signal_id, va_list args);
+
 /**
  * purple_signal_emit_return_1:
  * @instance: The instance emitting the signal.
@@ -298,6 +346,34 @@ void *purple_signal_emit_return_1(void *instance, const char *signal, ...);
 void *purple_signal_emit_vargs_return_1(void *instance, const char *signal,
 									  va_list args);
 
+/**
+ * purple_signal_emit_return_1_by_id:
+ * @signal_id: The ID of the signal being emitted.
+ * @...:       The arguments to pass to the callbacks.
+ *
+ * Emits a signal by its ID and returns the first non-NULL return value.
+ *
+ * See purple_signal_emit_return_1()
+ *
+ * Returns: The first non-NULL return value
+ */
+void *purple_signal_emit_return_1_by_id(gulong signal_id, ...);
+
+/**
+ * purple_signal_emit_vargs_return_1_by_id:
+ * @signal_id: The ID of the signal being emitted.
+ * @args:      The arguments list.
+ *
+ * Emits a signal by its ID, using a va_list of arguments, and returns the
+ * first non-NULL return value.
+ *
+ * See purple_signal_emit_vargs_return_1()
+ *
+ * Returns: The first non-NULL return value
+ */
+void *purple_signal_emit_vargs_return_1_by_id(gulong signal_id,
+									  va_list args);
+
 /**
  * purple_signals_init:
  *
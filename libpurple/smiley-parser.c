@@ -251,6 +251,7 @@ void
 _purple_smiley_parser_init(void)
 {
 	html_sentry = purple_trie_new();
+	purple_trie_set_compiled(html_sentry, TRUE);
 	purple_trie_add(html_sentry, "<", NULL);
 	purple_trie_add(html_sentry, ">", NULL);
 }
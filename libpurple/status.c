@@ -508,6 +508,7 @@ notify_buddy_status_update(PurpleBuddy *buddy, PurplePresence *presence,
 		GDateTime *current_time = g_date_time_new_now_utc();
 		const char *buddy_alias = purple_buddy_get_alias(buddy);
 		char *tmp, *logtmp;
+		PurpleAccount *account;
 		PurpleLog *log;
 
 		if (old_status != NULL)
@@ -538,8 +539,10 @@ notify_buddy_status_update(PurpleBuddy *buddy, PurplePresence *presence,
 			}
 		}
 
-		log = purple_account_get_log(purple_buddy_get_account(buddy), FALSE);
-		if (log != NULL)
+		account = purple_buddy_get_account(buddy);
+		log = purple_account_get_log(account, FALSE);
+		if (log != NULL && !_purple_blist_presence_batch_add_log(account,
+				buddy_alias, current_time, logtmp))
 		{
 			purple_log_write(log, PURPLE_MESSAGE_SYSTEM, buddy_alias,
 			               current_time, logtmp);
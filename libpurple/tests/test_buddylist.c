@@ -0,0 +1,341 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "../buddylist.h"
+#include "../log.h"
+#include "../prefs.h"
+#include "../protocols.h"
+#include "../signals.h"
+#include "../util.h"
+
+#include "test_ui.h"
+
+static int handle;
+
+/* What the signal handlers saw, such as "bob:signed-on;alice:away>available;" */
+static GString *events = NULL;
+
+/* The lines written to system logs */
+static GString *log_text = NULL;
+
+/* Called by the "buddy-status-changed" handler, if set */
+static void (*status_changed_hook)(PurpleBuddy *buddy) = NULL;
+static PurpleAccount *hook_account = NULL;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+test_buddylist_signed_on_cb(PurpleBuddy *buddy)
+{
+	g_string_append_printf(events, "%s:signed-on;",
+	                       purple_buddy_get_name(buddy));
+}
+
+static void
+test_buddylist_status_changed_cb(PurpleBuddy *buddy, PurpleStatus *old_status,
+                                 PurpleStatus *status)
+{
+	g_string_append_printf(events, "%s:%s>%s;", purple_buddy_get_name(buddy),
+	                       purple_status_get_id(old_status),
+	                       purple_status_get_id(status));
+
+	if (status_changed_hook != NULL)
+		status_changed_hook(buddy);
+}
+
+static void
+test_buddylist_buddies_changed_cb(GList *buddies)
+{
+	g_string_append(events, "batch:");
+	for (; buddies != NULL; buddies = buddies->next) {
+		g_string_append(events, purple_buddy_get_name(buddies->data));
+		if (buddies->next != NULL)
+			g_string_append_c(events, ',');
+	}
+	g_string_append_c(events, ';');
+}
+
+static gsize
+test_buddylist_log_write(PurpleLog *log, PurpleMessageFlags type,
+                         const char *from, GDateTime *time,
+                         const char *message)
+{
+	g_string_append_printf(log_text, "%s\n", message);
+
+	return strlen(message);
+}
+
+/* Returns a connected account with the given buddies, all of them online
+ * and available. */
+static PurpleAccount *
+test_buddylist_account_new(const gchar *username, const gchar *first, ...)
+{
+	PurpleAccount *account;
+	const gchar *name;
+	va_list args;
+
+	account = test_ui_account_new(username);
+	test_ui_account_connect(account);
+
+	purple_blist_presence_batch_begin();
+	va_start(args, first);
+	for (name = first; name != NULL; name = va_arg(args, const gchar *)) {
+		purple_blist_add_buddy(purple_buddy_new(account, name, NULL),
+		                       NULL, NULL, NULL);
+		purple_protocol_got_user_status(account, name, "available", NULL);
+	}
+	va_end(args);
+	purple_blist_presence_batch_commit();
+
+	g_string_truncate(events, 0);
+
+	return account;
+}
+
+static void
+test_buddylist_set_status(PurpleAccount *account, const gchar *name,
+                          const gchar *status_id)
+{
+	purple_protocol_got_user_status(account, name, status_id, NULL);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_buddylist_batch_sign_on_and_status(void)
+{
+	PurpleAccount *account;
+
+	account = test_buddylist_account_new("sign-on", NULL);
+	purple_blist_add_buddy(purple_buddy_new(account, "alice", NULL),
+	                       NULL, NULL, NULL);
+	purple_blist_add_buddy(purple_buddy_new(account, "bob", NULL),
+	                       NULL, NULL, NULL);
+
+	/* Outside of a batch, they're batched until the main loop runs. */
+	test_buddylist_set_status(account, "alice", "available");
+	test_buddylist_set_status(account, "bob", "available");
+	test_buddylist_set_status(account, "alice", "away");
+	g_assert_cmpstr(events->str, ==, "alice:signed-on;bob:signed-on;");
+
+	while (g_main_context_iteration(NULL, FALSE))
+		;
+
+	/* The sign on replaces the status change to available, but not the one
+	 * after it. */
+	g_assert_cmpstr(events->str, ==,
+	                "alice:signed-on;bob:signed-on;"
+	                "alice:available>away;"
+	                "batch:alice,bob;");
+
+	purple_account_disconnect(account);
+}
+
+static void
+test_buddylist_batch_status_restored(void)
+{
+	PurpleAccount *account;
+
+	account = test_buddylist_account_new("restored", "alice", "bob", NULL);
+
+	purple_blist_presence_batch_begin();
+	test_buddylist_set_status(account, "alice", "away");
+	test_buddylist_set_status(account, "alice", "available");
+	test_buddylist_set_status(account, "bob", "away");
+	purple_blist_presence_batch_commit();
+
+	/* Alice ended up where she started. */
+	g_assert_cmpstr(events->str, ==,
+	                "bob:available>away;"
+	                "batch:alice,bob;");
+
+	purple_account_disconnect(account);
+}
+
+static void
+test_buddylist_batch_nested_commit_hook(PurpleBuddy *buddy)
+{
+	if (!purple_strequal(purple_buddy_get_name(buddy), "alice"))
+		return;
+
+	purple_blist_presence_batch_begin();
+	test_buddylist_set_status(hook_account, "bob", "away");
+	purple_blist_presence_batch_commit();
+}
+
+static void
+test_buddylist_batch_nested_commit(void)
+{
+	PurpleAccount *account;
+
+	account = test_buddylist_account_new("nested", "alice", "bob", NULL);
+	hook_account = account;
+	status_changed_hook = test_buddylist_batch_nested_commit_hook;
+
+	purple_blist_presence_batch_begin();
+	test_buddylist_set_status(account, "alice", "away");
+	purple_blist_presence_batch_commit();
+
+	status_changed_hook = NULL;
+
+	/* The batch committed by the handler is delivered with the outer one. */
+	g_assert_cmpstr(events->str, ==,
+	                "alice:available>away;"
+	                "bob:available>away;"
+	                "batch:alice,bob;");
+
+	purple_account_disconnect(account);
+}
+
+static void
+test_buddylist_batch_remove_hook(PurpleBuddy *buddy)
+{
+	GSList *buddies;
+
+	if (!purple_strequal(purple_buddy_get_name(buddy), "alice"))
+		return;
+
+	buddies = purple_blist_find_buddies(hook_account, "bob");
+	g_assert_nonnull(buddies);
+	purple_blist_remove_buddy(buddies->data);
+	g_slist_free(buddies);
+}
+
+static void
+test_buddylist_batch_remove(void)
+{
+	PurpleAccount *account;
+
+	account = test_buddylist_account_new("remove", "alice", "bob", "carol",
+	                                     NULL);
+	hook_account = account;
+	status_changed_hook = test_buddylist_batch_remove_hook;
+
+	purple_blist_presence_batch_begin();
+	test_buddylist_set_status(account, "alice", "away");
+	test_buddylist_set_status(account, "bob", "away");
+	test_buddylist_set_status(account, "carol", "away");
+	purple_blist_presence_batch_commit();
+
+	status_changed_hook = NULL;
+
+	/* Bob was removed while alice was being delivered. */
+	g_assert_cmpstr(events->str, ==,
+	                "alice:available>away;"
+	                "carol:available>away;"
+	                "batch:alice,carol;");
+	g_assert_null(purple_blist_find_buddies(account, "bob"));
+
+	purple_account_disconnect(account);
+}
+
+static void
+test_buddylist_batch_log_disconnect(void)
+{
+	PurpleAccount *account;
+	const gchar *status, *signed_off;
+
+	purple_prefs_set_bool("/purple/logging/log_system", TRUE);
+
+	account = test_buddylist_account_new("log", "alice", NULL);
+	g_string_truncate(log_text, 0);
+
+	purple_blist_presence_batch_begin();
+	test_buddylist_set_status(account, "alice", "away");
+	g_assert_null(strstr(log_text->str, "changed status"));
+
+	/* The held back lines are written before the account signs off. */
+	purple_account_disconnect(account);
+	status = strstr(log_text->str, "alice (alice) changed status");
+	signed_off = strstr(log_text->str, "+++ log signed off");
+	g_assert_nonnull(status);
+	g_assert_nonnull(signed_off);
+	g_assert_true(status < signed_off);
+
+	/* And not again when the batch is committed. */
+	purple_blist_presence_batch_commit();
+	g_assert_null(strstr(status + 1, "alice (alice) changed status"));
+
+	purple_prefs_set_bool("/purple/logging/log_system", FALSE);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	PurpleLogLogger *logger;
+	gint ret;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	events = g_string_new(NULL);
+	log_text = g_string_new(NULL);
+
+	logger = purple_log_logger_new("test", "Test", 2, NULL,
+	                               test_buddylist_log_write);
+	purple_log_logger_add(logger);
+	purple_prefs_set_string("/purple/logging/format", "test");
+
+	purple_signal_connect(purple_blist_get_handle(), "buddy-signed-on",
+	                      &handle, PURPLE_CALLBACK(test_buddylist_signed_on_cb),
+	                      NULL);
+	purple_signal_connect(purple_blist_get_handle(), "buddy-status-changed",
+	                      &handle,
+	                      PURPLE_CALLBACK(test_buddylist_status_changed_cb),
+	                      NULL);
+	purple_signal_connect(purple_blist_get_handle(), "buddies-status-changed",
+	                      &handle,
+	                      PURPLE_CALLBACK(test_buddylist_buddies_changed_cb),
+	                      NULL);
+
+	g_test_add_func("/buddylist/presence batch/sign on and status",
+	                test_buddylist_batch_sign_on_and_status);
+	g_test_add_func("/buddylist/presence batch/status restored",
+	                test_buddylist_batch_status_restored);
+	g_test_add_func("/buddylist/presence batch/nested commit",
+	                test_buddylist_batch_nested_commit);
+	g_test_add_func("/buddylist/presence batch/remove",
+	                test_buddylist_batch_remove);
+	g_test_add_func("/buddylist/presence batch/log on disconnect",
+	                test_buddylist_batch_log_disconnect);
+
+	ret = g_test_run();
+
+	purple_signals_disconnect_by_handle(&handle);
+	test_ui_purple_uninit();
+
+	purple_log_logger_remove(logger);
+	purple_log_logger_free(logger);
+	g_string_free(events, TRUE);
+	g_string_free(log_text, TRUE);
+
+	return ret;
+}
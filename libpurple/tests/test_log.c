@@ -0,0 +1,579 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "../log.h"
+#include "../prefs.h"
+#include "../util.h"
+
+#include "test_ui.h"
+
+#define TEST_LOG_INDEX_HEADER_SIZE 8
+#define TEST_LOG_INDEX_RECORD_SIZE 32
+
+static PurpleAccount *account = NULL;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+test_log_write(const gchar *name, GDateTime *time, const gchar *first, ...)
+{
+	PurpleLog *log;
+	const gchar *message;
+	va_list args;
+
+	log = purple_log_new(PURPLE_LOG_IM, name, account, NULL, time);
+
+	va_start(args, first);
+	for (message = first; message != NULL; message = va_arg(args, const gchar *))
+		purple_log_write(log, PURPLE_MESSAGE_RECV, name, time, message);
+	va_end(args);
+
+	purple_log_free(log);
+}
+
+static void
+test_log_write_now(const gchar *name, const gchar *message)
+{
+	GDateTime *now = g_date_time_new_now_local();
+
+	test_log_write(name, now, message, NULL);
+	g_date_time_unref(now);
+}
+
+static gchar *
+test_log_path(const gchar *name, const gchar *file)
+{
+	gchar *dir, *path;
+
+	dir = purple_log_get_log_dir(PURPLE_LOG_IM, name, account);
+	path = g_build_filename(dir, file, NULL);
+	g_free(dir);
+
+	return path;
+}
+
+static gsize
+test_log_file_size(const gchar *name, const gchar *file)
+{
+	gchar *path, *contents = NULL;
+	gsize len = 0;
+
+	purple_log_flush();
+
+	path = test_log_path(name, file);
+	g_file_get_contents(path, &contents, &len, NULL);
+	g_free(contents);
+	g_free(path);
+
+	return len;
+}
+
+static gboolean
+test_log_file_contains(const gchar *name, const gchar *file,
+	const gchar *text)
+{
+	gchar *path, *contents = NULL;
+	gsize len = 0;
+	gboolean found;
+
+	purple_log_flush();
+
+	path = test_log_path(name, file);
+	g_file_get_contents(path, &contents, &len, NULL);
+	found = g_strstr_len(contents, len, text) != NULL;
+	g_free(contents);
+	g_free(path);
+
+	return found;
+}
+
+static gchar *
+test_log_read(PurpleLog *log)
+{
+	PurpleLogReadFlags flags;
+
+	return purple_log_read(log, &flags);
+}
+
+static void
+test_log_put32(GString *str, guint32 val)
+{
+	val = GUINT32_TO_LE(val);
+	g_string_append_len(str, (const gchar *)&val, sizeof(val));
+}
+
+static void
+test_log_put64(GString *str, guint64 val)
+{
+	val = GUINT64_TO_LE(val);
+	g_string_append_len(str, (const gchar *)&val, sizeof(val));
+}
+
+static void
+test_log_put_message(GString *str, guint32 id, const gchar *message)
+{
+	test_log_put32(str, 0x474c5350);
+	test_log_put32(str, id);
+	test_log_put32(str, strlen(message));
+	g_string_append(str, message);
+}
+
+/* Writes a log @seconds before now. */
+static void
+test_log_write_ago(const gchar *name, gint seconds, const gchar *first,
+	const gchar *second)
+{
+	GDateTime *now, *time;
+
+	now = g_date_time_new_now_local();
+	time = g_date_time_add_seconds(now, -seconds);
+	test_log_write(name, time, first, second, NULL);
+	g_date_time_unref(time);
+	g_date_time_unref(now);
+}
+
+/* Searches the logs of @name and returns the offsets found in each log,
+ * oldest first, as a string like "0,2;1". */
+static gchar *
+test_log_search(const gchar *name, const gchar *query)
+{
+	GList *logs, *results, *l;
+	GString *str = g_string_new(NULL);
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, name, account);
+	logs = g_list_reverse(logs);
+
+	results = purple_log_search(logs, query);
+	for (l = results; l != NULL; l = l->next) {
+		PurpleLogSearchResult *result = l->data;
+		guint i;
+
+		if (str->len > 0)
+			g_string_append_c(str, ';');
+		g_string_append_printf(str, "%d:", g_list_index(logs, result->log));
+		for (i = 0; i < result->offsets->len; i++) {
+			g_string_append_printf(str, i == 0 ? "%u" : ",%u",
+				g_array_index(result->offsets, guint, i));
+		}
+	}
+	g_list_free_full(results, (GDestroyNotify)purple_log_search_result_free);
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+
+	return g_string_free(str, FALSE);
+}
+
+/******************************************************************************
+ * Indexed logger tests
+ *****************************************************************************/
+static void
+test_log_indexed_round_trip(void)
+{
+	GDateTime *now;
+	GList *logs;
+	gchar *text, *hello, *world;
+
+	now = g_date_time_new_now_local();
+	test_log_write("round trip", now, "hello", "world", NULL);
+	g_date_time_unref(now);
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "round trip", account);
+	g_assert_cmpuint(g_list_length(logs), ==, 1);
+
+	text = test_log_read(logs->data);
+	hello = strstr(text, "hello");
+	world = strstr(text, "world");
+	g_assert_nonnull(hello);
+	g_assert_nonnull(world);
+	g_assert_true(hello < world);
+	g_assert_cmpint(purple_log_get_size(logs->data), ==, strlen(text));
+	g_assert_cmpint(purple_log_get_total_size(PURPLE_LOG_IM, "round trip",
+		account), ==, strlen(text));
+	g_free(text);
+
+	/* A begin and an end record. */
+	g_assert_cmpuint(test_log_file_size("round trip", "purple-log.idx"), ==,
+		TEST_LOG_INDEX_HEADER_SIZE + 2 * TEST_LOG_INDEX_RECORD_SIZE);
+
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+}
+
+static void
+test_log_indexed_delete(void)
+{
+	GList *logs;
+
+	test_log_write_now("delete", "goodbye");
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "delete", account);
+	g_assert_cmpuint(g_list_length(logs), ==, 1);
+	g_assert_true(purple_log_is_deletable(logs->data));
+	g_assert_true(purple_log_delete(logs->data));
+	g_assert_false(purple_log_delete(logs->data));
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+
+	g_assert_null(purple_log_get_logs(PURPLE_LOG_IM, "delete", account));
+
+	/* The delete record is all that was added to the index, and the
+	 * message was overwritten. */
+	g_assert_cmpuint(test_log_file_size("delete", "purple-log.idx"), ==,
+		TEST_LOG_INDEX_HEADER_SIZE + 3 * TEST_LOG_INDEX_RECORD_SIZE);
+	g_assert_false(test_log_file_contains("delete", "purple-log.seg",
+		"goodbye"));
+}
+
+static void
+test_log_indexed_compact(void)
+{
+	GList *logs, *l;
+	gsize size;
+	gchar *text;
+
+	test_log_write_now("compact", "deleted, and long enough to make up most "
+		"of the segment even with the timestamps and the names around the "
+		"messages");
+	test_log_write_now("compact", "kept");
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "compact", account);
+	g_assert_cmpuint(g_list_length(logs), ==, 2);
+	for (l = logs; l != NULL; l = l->next) {
+		text = test_log_read(l->data);
+		if (strstr(text, "deleted") != NULL)
+			g_assert_true(purple_log_delete(l->data));
+		g_free(text);
+	}
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+	size = test_log_file_size("compact", "purple-log.seg");
+
+	/* The next log is written to a compacted segment. */
+	test_log_write_now("compact", "new");
+	g_assert_cmpuint(test_log_file_size("compact", "purple-log.seg"), <,
+		size);
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "compact", account);
+	g_assert_cmpuint(g_list_length(logs), ==, 2);
+	for (l = logs; l != NULL; l = l->next) {
+		text = test_log_read(l->data);
+		g_assert_true(strstr(text, "kept") != NULL ||
+			strstr(text, "new") != NULL);
+		g_assert_cmpint(purple_log_get_size(l->data), ==, strlen(text));
+		g_free(text);
+	}
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+}
+
+static void
+test_log_indexed_recovery(void)
+{
+	GString *index, *segment;
+	GDateTime *now;
+	GList *logs, *l;
+	gchar *dir, *path, *text;
+	gboolean found_old = FALSE, found_new = FALSE;
+
+	now = g_date_time_new_now_local();
+
+	/* A log that was being written when we crashed: it has no end record
+	 * and its last message was cut short. */
+	index = g_string_new("PLIDX001");
+	test_log_put32(index, 1);
+	test_log_put32(index, 1);
+	test_log_put64(index, g_date_time_to_unix(now) - 3600);
+	test_log_put64(index, 8);
+	test_log_put64(index, 0);
+
+	segment = g_string_new("PLSEG001");
+	test_log_put_message(segment, 1, "first<br/>\n");
+	test_log_put_message(segment, 1, "second<br/>\n");
+	test_log_put32(segment, 0x474c5350);
+	test_log_put32(segment, 1);
+	test_log_put32(segment, 100);
+	g_string_append(segment, "thi");
+
+	dir = purple_log_get_log_dir(PURPLE_LOG_IM, "recovery", account);
+	g_assert_cmpint(g_mkdir_with_parents(dir, 0700), ==, 0);
+	path = g_build_filename(dir, "purple-log.idx", NULL);
+	g_assert_true(g_file_set_contents(path, index->str, index->len, NULL));
+	g_free(path);
+	path = g_build_filename(dir, "purple-log.seg", NULL);
+	g_assert_true(g_file_set_contents(path, segment->str, segment->len, NULL));
+	g_free(path);
+	g_free(dir);
+	g_string_free(index, TRUE);
+	g_string_free(segment, TRUE);
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "recovery", account);
+	g_assert_cmpuint(g_list_length(logs), ==, 1);
+	text = test_log_read(logs->data);
+	g_assert_cmpstr(text, ==, "first<br/>\nsecond<br/>\n");
+	g_assert_cmpint(purple_log_get_size(logs->data), ==, strlen(text));
+	g_free(text);
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+
+	/* The next log overwrites the damaged record, and the recovered log
+	 * gets its end record. */
+	test_log_write("recovery", now, "third", NULL);
+	g_date_time_unref(now);
+
+	g_assert_cmpuint(test_log_file_size("recovery", "purple-log.idx"), ==,
+		TEST_LOG_INDEX_HEADER_SIZE + 4 * TEST_LOG_INDEX_RECORD_SIZE);
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "recovery", account);
+	g_assert_cmpuint(g_list_length(logs), ==, 2);
+	for (l = logs; l != NULL; l = l->next) {
+		text = test_log_read(l->data);
+		if (purple_strequal(text, "first<br/>\nsecond<br/>\n")) {
+			found_old = TRUE;
+		} else {
+			g_assert_nonnull(strstr(text, "third"));
+			g_assert_null(strstr(text, "first"));
+			found_new = TRUE;
+		}
+		g_free(text);
+	}
+	g_assert_true(found_old && found_new);
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+}
+
+static void
+test_log_indexed_many_dirs(void)
+{
+	GList *held, *logs;
+	gchar name[32];
+	gchar *text;
+	gint i;
+
+	test_log_write_now("many 0", "kept");
+	held = purple_log_get_logs(PURPLE_LOG_IM, "many 0", account);
+	g_assert_cmpuint(g_list_length(held), ==, 1);
+
+	/* Enough other directories to push the first one out of the cache. */
+	for (i = 1; i <= 64; i++) {
+		g_snprintf(name, sizeof(name), "many %d", i);
+		test_log_write_now(name, name);
+	}
+
+	/* The listed log keeps its directory alive, and new logs share it. */
+	test_log_write_now("many 0", "again");
+	text = test_log_read(held->data);
+	g_assert_nonnull(strstr(text, "kept"));
+	g_free(text);
+	g_list_free_full(held, (GDestroyNotify)purple_log_free);
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "many 0", account);
+	g_assert_cmpuint(g_list_length(logs), ==, 2);
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+}
+
+/******************************************************************************
+ * Search tests
+ *****************************************************************************/
+static void
+test_log_search_offsets(gconstpointer data)
+{
+	const gchar *format = data;
+	gchar *name, *live, *rebuilt;
+
+	purple_prefs_set_string("/purple/logging/format", format);
+	name = g_strdup_printf("search %s", format);
+
+	test_log_write_ago(name, 100, "alpha <b>one</b>", "beta two");
+	live = test_log_search(name, "alpha");
+	g_assert_cmpstr(live, ==, "0:0");
+	g_free(live);
+
+	/* This log is indexed as it is written. */
+	test_log_write_ago(name, 50, "gamma", "alpha beta");
+	live = test_log_search(name, "beta");
+
+	purple_log_search_rebuild(PURPLE_LOG_IM, name, account);
+	rebuilt = test_log_search(name, "beta");
+
+	g_assert_cmpstr(live, ==, "0:1;1:1");
+	g_assert_cmpstr(rebuilt, ==, live);
+	g_free(live);
+	g_free(rebuilt);
+
+	/* The header of the log, and the timestamps, are not searched. */
+	live = test_log_search(name, "conversation");
+	g_assert_cmpstr(live, ==, "");
+	g_free(live);
+
+	g_free(name);
+	purple_prefs_set_string("/purple/logging/format", "indexed");
+}
+
+static void
+test_log_search_prefix(void)
+{
+	gchar *found;
+
+	test_log_write_ago("prefix", 10, "Alphabet soup", "more soup, please");
+
+	found = test_log_search("prefix", "alp");
+	g_assert_cmpstr(found, ==, "0:0");
+	g_free(found);
+
+	found = test_log_search("prefix", "ALPHABET");
+	g_assert_cmpstr(found, ==, "0:0");
+	g_free(found);
+
+	found = test_log_search("prefix", "soup");
+	g_assert_cmpstr(found, ==, "0:0,1");
+	g_free(found);
+
+	/* Every word must be found. */
+	found = test_log_search("prefix", "soup plea");
+	g_assert_cmpstr(found, ==, "0:0,1");
+	g_free(found);
+
+	found = test_log_search("prefix", "soup salad");
+	g_assert_cmpstr(found, ==, "");
+	g_free(found);
+
+	/* Words match by prefix, not by substring. */
+	found = test_log_search("prefix", "lphabet");
+	g_assert_cmpstr(found, ==, "");
+	g_free(found);
+}
+
+static void
+test_log_search_delete(void)
+{
+	GList *logs;
+	gchar *found;
+
+	test_log_write_ago("search delete", 100, "remove me", NULL);
+	test_log_write_ago("search delete", 50, "keep me", NULL);
+
+	found = test_log_search("search delete", "me");
+	g_assert_cmpstr(found, ==, "0:0;1:0");
+	g_free(found);
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "search delete", account);
+	g_assert_cmpuint(g_list_length(logs), ==, 2);
+	g_assert_true(purple_log_delete(g_list_last(logs)->data));
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+
+	found = test_log_search("search delete", "me");
+	g_assert_cmpstr(found, ==, "0:0");
+	g_free(found);
+
+	found = test_log_search("search delete", "remove");
+	g_assert_cmpstr(found, ==, "");
+	g_free(found);
+}
+
+static void
+test_log_search_saved(void)
+{
+	gchar *found;
+
+	test_log_write_ago("saved", 10, "persistent words", NULL);
+
+	found = test_log_search("saved", "persist");
+	g_assert_cmpstr(found, ==, "0:0");
+	g_free(found);
+
+	g_assert_cmpuint(test_log_file_size("saved", "purple-search.idx"), >, 0);
+}
+
+static void
+test_log_search_many(void)
+{
+	gsize size;
+	gchar name[32];
+	gchar *found;
+	gint i;
+
+	test_log_write_ago("search many", 100, "first", NULL);
+	found = test_log_search("search many", "first");
+	g_assert_cmpstr(found, ==, "0:0");
+	g_free(found);
+	size = test_log_file_size("search many", "purple-search.idx");
+
+	/* This goes to the loaded index, which is saved when enough other
+	 * conversations were searched to drop it. */
+	test_log_write_ago("search many", 50, "second", NULL);
+	for (i = 0; i < 32; i++) {
+		g_snprintf(name, sizeof(name), "search many %d", i);
+		test_log_write_ago(name, 10, name, NULL);
+		g_free(test_log_search(name, "many"));
+	}
+	g_assert_cmpuint(test_log_file_size("search many", "purple-search.idx"),
+		>, size);
+
+	found = test_log_search("search many", "second");
+	g_assert_cmpstr(found, ==, "1:0");
+	g_free(found);
+}
+
+/******************************************************************************
+ * MANE
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	gint ret;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+	account = test_ui_account_new("tester");
+	purple_prefs_set_string("/purple/logging/format", "indexed");
+
+	g_test_add_func("/log/indexed/round trip",
+	                test_log_indexed_round_trip);
+	g_test_add_func("/log/indexed/delete",
+	                test_log_indexed_delete);
+	g_test_add_func("/log/indexed/compact",
+	                test_log_indexed_compact);
+	g_test_add_func("/log/indexed/recovery",
+	                test_log_indexed_recovery);
+	g_test_add_func("/log/indexed/many directories",
+	                test_log_indexed_many_dirs);
+
+	g_test_add_data_func("/log/search/offsets/html", "html",
+	                     test_log_search_offsets);
+	g_test_add_data_func("/log/search/offsets/txt", "txt",
+	                     test_log_search_offsets);
+	g_test_add_data_func("/log/search/offsets/indexed", "indexed",
+	                     test_log_search_offsets);
+	g_test_add_func("/log/search/prefix",
+	                test_log_search_prefix);
+	g_test_add_func("/log/search/delete",
+	                test_log_search_delete);
+	g_test_add_func("/log/search/saved",
+	                test_log_search_saved);
+	g_test_add_func("/log/search/many conversations",
+	                test_log_search_many);
+
+	ret = g_test_run();
+
+	test_ui_purple_uninit();
+
+	return ret;
+}
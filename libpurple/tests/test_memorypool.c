@@ -0,0 +1,145 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include "../memorypool.h"
+
+static void
+test_memorypool_alloc(void) {
+	PurpleMemoryPool *pool;
+	PurpleMemoryPoolStats stats;
+	gchar *str;
+	gpointer mem;
+
+	pool = purple_memory_pool_new();
+	purple_memory_pool_set_block_size(pool, 256);
+
+	mem = purple_memory_pool_alloc(pool, 10, sizeof(gpointer));
+	g_assert_cmpuint((guintptr)mem % sizeof(gpointer), ==, 0);
+	str = purple_memory_pool_strdup(pool, "test");
+	g_assert_cmpstr("test", ==, str);
+
+	/* freeing doesn't give anything back in the default mode */
+	purple_memory_pool_free(pool, mem);
+	purple_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.bytes_live, ==, 10 + 5);
+	g_assert_cmpuint(stats.blocks_count, ==, 1);
+
+	/* larger than a block */
+	purple_memory_pool_alloc(pool, 1000, 1);
+	purple_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.blocks_count, ==, 2);
+	g_assert_cmpuint(stats.bytes_reserved, ==, 256 + 1000);
+
+	purple_memory_pool_cleanup(pool);
+	purple_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.blocks_count, ==, 0);
+	g_assert_cmpuint(stats.bytes_reserved, ==, 0);
+	g_assert_cmpuint(stats.bytes_live, ==, 0);
+	g_assert_cmpuint(stats.bytes_live_max, ==, 10 + 5 + 1000);
+
+	g_object_unref(pool);
+}
+
+static void
+test_memorypool_recycle(void) {
+	PurpleMemoryPool *pool;
+	PurpleMemoryPoolStats stats;
+	gpointer mem1, mem2, mem3;
+
+	pool = purple_memory_pool_new();
+	purple_memory_pool_set_recycle(pool, TRUE);
+
+	mem1 = purple_memory_pool_alloc(pool, 20, sizeof(gpointer));
+	mem2 = purple_memory_pool_alloc(pool, 100, 1);
+	purple_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.bytes_live, ==, 24 + 104);
+
+	/* a chunk of the same size class is reused */
+	purple_memory_pool_free(pool, mem1);
+	purple_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.bytes_live, ==, 104);
+	mem3 = purple_memory_pool_alloc(pool, 24, sizeof(gpointer));
+	g_assert_true(mem1 == mem3);
+
+	/* but not the one of the other */
+	purple_memory_pool_free(pool, mem2);
+	mem3 = purple_memory_pool_alloc(pool, 20, 1);
+	g_assert_true(mem2 != mem3);
+
+	purple_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.bytes_live, ==, 24 + 24);
+	g_assert_cmpuint(stats.bytes_live_max, ==, 24 + 104);
+
+	g_object_unref(pool);
+}
+
+static void
+test_memorypool_recycle_blocks(void) {
+	PurpleMemoryPool *pool;
+	PurpleMemoryPoolStats stats;
+	guint blocks_count, i;
+
+	pool = purple_memory_pool_new();
+	purple_memory_pool_set_recycle(pool, TRUE);
+	purple_memory_pool_set_block_size(pool, 512);
+
+	for (i = 0; i < 100; i++)
+		purple_memory_pool_alloc(pool, 50, 1);
+	purple_memory_pool_get_stats(pool, &stats);
+	blocks_count = stats.blocks_count;
+	g_assert_cmpuint(blocks_count, >, 1);
+
+	/* blocks are kept for the next use */
+	purple_memory_pool_cleanup(pool);
+	purple_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.blocks_count, ==, blocks_count);
+	g_assert_cmpuint(stats.bytes_live, ==, 0);
+
+	for (i = 0; i < 100; i++)
+		purple_memory_pool_alloc(pool, 50, 1);
+	purple_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.blocks_count, ==, blocks_count);
+
+	purple_memory_pool_cleanup(pool);
+	purple_memory_pool_trim(pool);
+	purple_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.blocks_count, ==, 0);
+	g_assert_cmpuint(stats.bytes_reserved, ==, 0);
+
+	g_object_unref(pool);
+}
+
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/memorypool/alloc",
+	                test_memorypool_alloc);
+	g_test_add_func("/memorypool/recycle",
+	                test_memorypool_recycle);
+	g_test_add_func("/memorypool/recycle/blocks",
+	                test_memorypool_recycle_blocks);
+
+	return g_test_run();
+}
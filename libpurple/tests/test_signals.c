@@ -0,0 +1,210 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include "../signals.h"
+
+static int instance;
+static int handle;
+static GString *calls;
+
+static void
+test_signals_cb_a(gint arg, gpointer data)
+{
+	g_string_append_printf(calls, "a%d", arg);
+}
+
+static void
+test_signals_cb_b(gint arg, gpointer data)
+{
+	g_string_append_printf(calls, "b%d", arg);
+}
+
+static void
+test_signals_cb_c(gint arg, gpointer data)
+{
+	g_string_append_printf(calls, "c%d", arg);
+}
+
+static void
+test_signals_cb_disconnect(gint arg, gpointer data)
+{
+	g_string_append_printf(calls, "d%d", arg);
+
+	/* removes a handler that didn't run yet */
+	purple_signal_disconnect(&instance, "test", &handle,
+		PURPLE_CALLBACK(test_signals_cb_c));
+}
+
+static gint
+test_signals_cb_return(gint arg, gpointer data)
+{
+	g_string_append_printf(calls, "r%d", GPOINTER_TO_INT(data));
+
+	return GPOINTER_TO_INT(data);
+}
+
+static void
+test_signals_setup(void)
+{
+	purple_signals_init();
+	calls = g_string_new(NULL);
+}
+
+static void
+test_signals_teardown(void)
+{
+	g_string_free(calls, TRUE);
+	purple_signals_uninit();
+}
+
+static void
+test_signals_emit(void) {
+	gulong id;
+
+	test_signals_setup();
+
+	id = purple_signal_register(&instance, "test",
+		purple_marshal_VOID__INT, G_TYPE_NONE, 1, G_TYPE_INT);
+	g_assert_cmpuint(id, !=, 0);
+	g_assert_cmpuint(purple_signal_lookup(&instance, "test"), ==, id);
+	g_assert_cmpuint(purple_signal_lookup(&instance, "other"), ==, 0);
+	g_assert_false(purple_signal_has_handlers(id));
+
+	purple_signal_emit(&instance, "test", 1);
+	g_assert_cmpstr(calls->str, ==, "");
+
+	purple_signal_connect(&instance, "test", &handle,
+		PURPLE_CALLBACK(test_signals_cb_a), NULL);
+	purple_signal_connect_priority(&instance, "test", &handle,
+		PURPLE_CALLBACK(test_signals_cb_b), NULL,
+		PURPLE_SIGNAL_PRIORITY_HIGHEST);
+	purple_signal_connect_priority(&instance, "test", &handle,
+		PURPLE_CALLBACK(test_signals_cb_c), NULL,
+		PURPLE_SIGNAL_PRIORITY_LOWEST);
+	g_assert_true(purple_signal_has_handlers(id));
+
+	purple_signal_emit(&instance, "test", 1);
+	g_assert_cmpstr(calls->str, ==, "c1a1b1");
+
+	/* a handler goes before the ones of the same priority */
+	purple_signal_connect(&instance, "test", &handle,
+		PURPLE_CALLBACK(test_signals_cb_disconnect), NULL);
+	g_string_truncate(calls, 0);
+	purple_signal_emit_by_id(id, 2);
+	g_assert_cmpstr(calls->str, ==, "c2d2a2b2");
+
+	/* c was disconnected by the previous emission */
+	purple_signal_disconnect(&instance, "test", &handle,
+		PURPLE_CALLBACK(test_signals_cb_disconnect));
+	g_string_truncate(calls, 0);
+	purple_signal_emit_by_id(id, 3);
+	g_assert_cmpstr(calls->str, ==, "a3b3");
+
+	purple_signals_disconnect_by_handle(&handle);
+	g_assert_false(purple_signal_has_handlers(id));
+	g_string_truncate(calls, 0);
+	purple_signal_emit_by_id(id, 4);
+	g_assert_cmpstr(calls->str, ==, "");
+
+	purple_signal_unregister(&instance, "test");
+	g_assert_cmpuint(purple_signal_lookup(&instance, "test"), ==, 0);
+
+	/* an unregistered ID reports an error, but calls nothing */
+	purple_signal_emit_by_id(id, 5);
+	purple_signal_emit_by_id(0, 5);
+	g_assert_cmpstr(calls->str, ==, "");
+	g_assert_null(purple_signal_emit_return_1_by_id(id, 5));
+
+	test_signals_teardown();
+}
+
+static void
+test_signals_disconnect_during_emit(void) {
+	gulong id;
+
+	test_signals_setup();
+
+	id = purple_signal_register(&instance, "test",
+		purple_marshal_VOID__INT, G_TYPE_NONE, 1, G_TYPE_INT);
+
+	purple_signal_connect_priority(&instance, "test", &handle,
+		PURPLE_CALLBACK(test_signals_cb_disconnect), NULL,
+		PURPLE_SIGNAL_PRIORITY_LOWEST);
+	purple_signal_connect(&instance, "test", &handle,
+		PURPLE_CALLBACK(test_signals_cb_c), NULL);
+	purple_signal_connect(&instance, "test", &handle,
+		PURPLE_CALLBACK(test_signals_cb_a), NULL);
+
+	purple_signal_emit_by_id(id, 1);
+	g_assert_cmpstr(calls->str, ==, "d1a1");
+
+	test_signals_teardown();
+}
+
+static void
+test_signals_return_1(void) {
+	gulong id;
+
+	test_signals_setup();
+
+	id = purple_signal_register(&instance, "test-return",
+		purple_marshal_INT__INT, G_TYPE_INT, 1, G_TYPE_INT);
+
+	g_assert_null(purple_signal_emit_return_1_by_id(id, 1));
+
+	purple_signal_connect_priority(&instance, "test-return", &handle,
+		PURPLE_CALLBACK(test_signals_cb_return), GINT_TO_POINTER(0),
+		PURPLE_SIGNAL_PRIORITY_LOWEST);
+	purple_signal_connect(&instance, "test-return", &handle,
+		PURPLE_CALLBACK(test_signals_cb_return), GINT_TO_POINTER(5));
+	purple_signal_connect_priority(&instance, "test-return", &handle,
+		PURPLE_CALLBACK(test_signals_cb_return), GINT_TO_POINTER(7),
+		PURPLE_SIGNAL_PRIORITY_HIGHEST);
+
+	/* the handlers after the first non-NULL return value aren't called */
+	g_assert_cmpint(GPOINTER_TO_INT(purple_signal_emit_return_1(
+		&instance, "test-return", 1)), ==, 5);
+	g_assert_cmpstr(calls->str, ==, "r0r5");
+
+	g_string_truncate(calls, 0);
+	g_assert_cmpint(GPOINTER_TO_INT(purple_signal_emit_return_1_by_id(
+		id, 1)), ==, 5);
+	g_assert_cmpstr(calls->str, ==, "r0r5");
+
+	test_signals_teardown();
+}
+
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/signals/emit",
+	                test_signals_emit);
+	g_test_add_func("/signals/disconnect_during_emit",
+	                test_signals_disconnect_during_emit);
+	g_test_add_func("/signals/return_1",
+	                test_signals_return_1);
+
+	return g_test_run();
+}
@@ -148,6 +148,54 @@ test_trie_replace_empty(void) {
 	g_free(out);
 }
 
+static void
+test_trie_replace_compiled(void) {
+	PurpleTrie *trie;
+	const gchar *in;
+	gchar *out;
+
+	trie = purple_trie_new();
+	purple_trie_set_compiled(trie, TRUE);
+	purple_trie_set_reset_on_match(trie, FALSE);
+
+	purple_trie_add(trie, "test", (gpointer)0x1001);
+	purple_trie_add(trie, "testing", (gpointer)0x1002);
+	purple_trie_add(trie, "overtested", (gpointer)0x1003);
+	purple_trie_add(trie, "trie", (gpointer)0x1004);
+	purple_trie_add(trie, "tree", (gpointer)0x1005);
+	purple_trie_add(trie, "implement", (gpointer)0x1006);
+	purple_trie_add(trie, "implementation", (gpointer)0x1007);
+
+	in = "Alice is testing her trie implementation, "
+		"but she's far away from making test tree overtested";
+
+	out = purple_trie_replace(trie, in, test_trie_replace_cb, (gpointer)1);
+
+	g_assert_cmpstr(
+		"Alice is [1:1002] her [1:1004] [1:1006]ation,"
+		" but she's far away from making test [1:1005] [1:1003]",
+		==,
+		out
+	);
+	g_free(out);
+
+	/* modifying a compiled trie rebuilds it */
+	purple_trie_remove(trie, "tree");
+	purple_trie_add(trie, "far", (gpointer)0x1008);
+
+	out = purple_trie_replace(trie, in, test_trie_replace_cb, (gpointer)1);
+
+	g_assert_cmpstr(
+		"Alice is [1:1002] her [1:1004] [1:1006]ation,"
+		" but she's [1:1008] away from making test tree [1:1003]",
+		==,
+		out
+	);
+
+	g_object_unref(trie);
+	g_free(out);
+}
+
 static void
 test_trie_multi_replace(void) {
 	PurpleTrie *trie1, *trie2, *trie3;
@@ -196,6 +244,49 @@ test_trie_multi_replace(void) {
 	g_free(out);
 }
 
+static void
+test_trie_multi_modified(void) {
+	PurpleTrie *trie1, *trie2;
+	GSList *tries = NULL;
+	const gchar *in;
+	gchar *out;
+
+	trie1 = purple_trie_new();
+	trie2 = purple_trie_new();
+
+	tries = g_slist_append(tries, trie1);
+	tries = g_slist_append(tries, trie2);
+
+	purple_trie_add(trie1, "alice", (gpointer)0x5101);
+	purple_trie_add(trie2, "bob", (gpointer)0x5102);
+
+	in = "alice bob cherry";
+
+	out = purple_trie_multi_replace(tries, in,
+		test_trie_replace_cb, (gpointer)5);
+	g_assert_cmpstr("[5:5101] [5:5102] cherry", ==, out);
+	g_free(out);
+
+	/* a cached, merged automaton has to be rebuilt */
+	purple_trie_add(trie2, "cherry", (gpointer)0x5103);
+	purple_trie_remove(trie1, "alice");
+	purple_trie_add(trie1, "bob", (gpointer)0x5104);
+
+	out = purple_trie_multi_replace(tries, in,
+		test_trie_replace_cb, (gpointer)5);
+	g_assert_cmpstr("alice [5:5104] [5:5103]", ==, out);
+	g_free(out);
+
+	/* the same tries in a different order */
+	tries = g_slist_reverse(tries);
+	out = purple_trie_multi_replace(tries, in,
+		test_trie_replace_cb, (gpointer)5);
+	g_assert_cmpstr("alice [5:5102] [5:5103]", ==, out);
+	g_free(out);
+
+	g_slist_free_full(tries, g_object_unref);
+}
+
 static void
 test_trie_remove(void) {
 	PurpleTrie *trie;
@@ -292,6 +383,39 @@ test_trie_find_noreset(void) {
 	g_object_unref(trie);
 }
 
+static void
+test_trie_find_compiled(void) {
+	PurpleTrie *trie;
+	const gchar *in;
+	gint out;
+
+	trie = purple_trie_new();
+	purple_trie_set_compiled(trie, TRUE);
+	purple_trie_set_reset_on_match(trie, FALSE);
+
+	purple_trie_add(trie, "alice", (gpointer)0x9001);
+	purple_trie_add(trie, "ali", (gpointer)0x9002);
+	purple_trie_add(trie, "al", (gpointer)0x9003);
+
+	in = "al ali alice";
+
+	find_sum = 0;
+	out = purple_trie_find(trie, in, test_trie_find_cb, (gpointer)9);
+
+	g_assert_cmpint(6, ==, out);
+	g_assert_cmpint(3 * 3 + 2 * 2 + 1, ==, find_sum);
+
+	purple_trie_set_reset_on_match(trie, TRUE);
+
+	find_sum = 0;
+	out = purple_trie_find(trie, in, test_trie_find_cb, (gpointer)9);
+
+	g_assert_cmpint(3, ==, out);
+	g_assert_cmpint(3 * 3, ==, find_sum);
+
+	g_object_unref(trie);
+}
+
 static void
 test_trie_multi_find(void) {
 	PurpleTrie *trie1, *trie2, *trie3;
@@ -339,6 +463,55 @@ test_trie_multi_find(void) {
 	g_slist_free_full(tries, g_object_unref);
 }
 
+/* Measures the cost of altering a trie, that is used for searching in
+ * between. It should depend on the length of altered words, not on the size
+ * of the whole dictionary. */
+static void
+test_trie_perf_incremental(void) {
+	const guint sizes[] = { 1000, 10000, 100000 };
+	const guint rounds = 1000;
+	guint s_idx;
+
+	for (s_idx = 0; s_idx < G_N_ELEMENTS(sizes); s_idx++) {
+		PurpleTrie *trie;
+		gchar *out;
+		gdouble elapsed;
+		guint i;
+
+		trie = purple_trie_new();
+		for (i = 0; i < sizes[s_idx]; i++) {
+			gchar *word = g_strdup_printf("w%08x",
+				i * 2654435761u);
+			purple_trie_add(trie, word, GUINT_TO_POINTER(i + 1));
+			g_free(word);
+		}
+
+		/* build the states */
+		out = purple_trie_replace(trie, "a", test_trie_replace_cb,
+			NULL);
+		g_free(out);
+
+		g_test_timer_start();
+		for (i = 0; i < rounds; i++) {
+			gchar word[32];
+
+			g_snprintf(word, sizeof(word), "smiley%u", i);
+			purple_trie_add(trie, word, (gpointer)0x1);
+			out = purple_trie_replace(trie, "a :-) smiley",
+				test_trie_replace_cb, NULL);
+			g_free(out);
+			purple_trie_remove(trie, word);
+		}
+		elapsed = g_test_timer_elapsed();
+
+		g_test_minimized_result(elapsed * 1000000 / rounds,
+			"add and remove in a trie of %u words: %.2f us",
+			sizes[s_idx], elapsed * 1000000 / rounds);
+
+		g_object_unref(trie);
+	}
+}
+
 gint
 main(gint argc, gchar **argv) {
 	g_test_init(&argc, &argv, NULL);
@@ -351,10 +524,15 @@ main(gint argc, gchar **argv) {
 	                test_trie_replace_inner);
 	g_test_add_func("/trie/replace/empty",
 	                test_trie_replace_empty);
+	g_test_add_func("/trie/replace/compiled",
+	                test_trie_replace_compiled);
 
 	g_test_add_func("/trie/multi_replace",
 	                test_trie_multi_replace);
 
+	g_test_add_func("/trie/multi_modified",
+	                test_trie_multi_modified);
+
 	g_test_add_func("/trie/remove",
 	                test_trie_remove);
 
@@ -364,9 +542,16 @@ main(gint argc, gchar **argv) {
 	                test_trie_find_reset);
 	g_test_add_func("/trie/find/noreset",
 	                test_trie_find_noreset);
+	g_test_add_func("/trie/find/compiled",
+	                test_trie_find_compiled);
 
 	g_test_add_func("/trie/multi_find",
 	                test_trie_multi_find);
 
+	if (g_test_perf()) {
+		g_test_add_func("/trie/perf/incremental",
+		                test_trie_perf_incremental);
+	}
+
 	return g_test_run();
 }
@@ -0,0 +1,196 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../accounts.h"
+#include "../core.h"
+#include "../debug.h"
+#include "../protocol.h"
+#include "../protocols.h"
+#include "../status.h"
+#include "../util.h"
+
+#include "test_ui.h"
+
+#define TEST_UI "test-ui"
+
+static gchar *test_ui_dir = NULL;
+
+/******************************************************************************
+ * Protocol
+ *****************************************************************************/
+typedef struct {
+	PurpleProtocol parent;
+} TestProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent_class;
+} TestProtocolClass;
+
+G_DEFINE_TYPE(TestProtocol, test_protocol, PURPLE_TYPE_PROTOCOL);
+
+static void
+test_protocol_login(PurpleAccount *account)
+{
+}
+
+static void
+test_protocol_close(PurpleConnection *gc)
+{
+}
+
+static GList *
+test_protocol_status_types(PurpleAccount *account)
+{
+	GList *types = NULL;
+
+	types = g_list_append(types, purple_status_type_new_full(
+		PURPLE_STATUS_AVAILABLE, NULL, NULL, TRUE, TRUE, FALSE));
+	types = g_list_append(types, purple_status_type_new_full(
+		PURPLE_STATUS_AWAY, NULL, NULL, TRUE, TRUE, FALSE));
+	types = g_list_append(types, purple_status_type_new_full(
+		PURPLE_STATUS_OFFLINE, NULL, NULL, TRUE, TRUE, FALSE));
+
+	return types;
+}
+
+static const char *
+test_protocol_list_icon(PurpleAccount *account, PurpleBuddy *buddy)
+{
+	return "test";
+}
+
+static void
+test_protocol_init(TestProtocol *self)
+{
+	PurpleProtocol *protocol = PURPLE_PROTOCOL(self);
+
+	protocol->id = TEST_UI_PROTOCOL_ID;
+	protocol->name = "Test";
+}
+
+static void
+test_protocol_class_init(TestProtocolClass *klass)
+{
+	PurpleProtocolClass *protocol_class = PURPLE_PROTOCOL_CLASS(klass);
+
+	protocol_class->login = test_protocol_login;
+	protocol_class->close = test_protocol_close;
+	protocol_class->status_types = test_protocol_status_types;
+	protocol_class->list_icon = test_protocol_list_icon;
+}
+
+/******************************************************************************
+ * UI
+ *****************************************************************************/
+static PurpleCoreUiOps test_ui_core_ops = {
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL
+};
+
+static void
+test_ui_remove_dir(const gchar *path)
+{
+	GDir *dir;
+	const gchar *name;
+
+	dir = g_dir_open(path, 0, NULL);
+	if (dir != NULL) {
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			gchar *child = g_build_filename(path, name, NULL);
+
+			if (g_file_test(child, G_FILE_TEST_IS_DIR))
+				test_ui_remove_dir(child);
+			else
+				g_unlink(child);
+			g_free(child);
+		}
+		g_dir_close(dir);
+	}
+
+	g_rmdir(path);
+}
+
+void
+test_ui_purple_init(void)
+{
+	GError *error = NULL;
+
+	test_ui_dir = g_dir_make_tmp("purple-test-XXXXXX", &error);
+	g_assert_no_error(error);
+
+	purple_util_set_user_dir(test_ui_dir);
+	purple_debug_set_enabled(FALSE);
+	purple_core_set_ui_ops(&test_ui_core_ops);
+
+	g_assert_true(purple_core_init(TEST_UI));
+
+	purple_protocols_add(test_protocol_get_type(), &error);
+	g_assert_no_error(error);
+}
+
+void
+test_ui_purple_uninit(void)
+{
+	purple_core_quit();
+
+	test_ui_remove_dir(test_ui_dir);
+	g_free(test_ui_dir);
+	test_ui_dir = NULL;
+}
+
+PurpleAccount *
+test_ui_account_new(const gchar *username)
+{
+	PurpleAccount *account;
+
+	account = purple_account_new(username, TEST_UI_PROTOCOL_ID);
+	purple_accounts_add(account);
+
+	return account;
+}
+
+PurpleConnection *
+test_ui_account_connect(PurpleAccount *account)
+{
+	PurpleConnection *gc;
+
+	purple_account_set_password(account, "password", NULL, NULL);
+	purple_account_set_enabled(account, TEST_UI, TRUE);
+	if (purple_account_is_disconnected(account))
+		purple_account_connect(account);
+
+	gc = purple_account_get_connection(account);
+	g_assert_nonnull(gc);
+	purple_connection_set_state(gc, PURPLE_CONNECTION_CONNECTED);
+
+	return gc;
+}
@@ -0,0 +1,50 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#ifndef PURPLE_TEST_UI_H
+#define PURPLE_TEST_UI_H
+
+#include <glib.h>
+
+#include "../account.h"
+#include "../connection.h"
+
+G_BEGIN_DECLS
+
+#define TEST_UI_PROTOCOL_ID "prpl-test"
+
+/* Initializes libpurple in a temporary user directory, with a protocol
+ * that does nothing registered as TEST_UI_PROTOCOL_ID. */
+void test_ui_purple_init(void);
+
+/* Shuts libpurple down and removes the user directory. */
+void test_ui_purple_uninit(void);
+
+/* Returns a new account on the test protocol, added to the account list. */
+PurpleAccount *test_ui_account_new(const gchar *username);
+
+/* Enables and signs on an account of the test protocol. */
+PurpleConnection *test_ui_account_connect(PurpleAccount *account);
+
+G_END_DECLS
+
+#endif /* PURPLE_TEST_UI_H */
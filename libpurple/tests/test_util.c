@@ -522,6 +522,58 @@ test_util_strdup_withhtml(void) {
 	g_free(result);
 }
 
+/******************************************************************************
+ * normalize tests
+ *****************************************************************************/
+static void
+test_util_normalize_cache(void) {
+	guint64 hits, misses, hits2, misses2;
+	gchar *composed;
+
+	purple_normalize_get_cache_stats(&hits, &misses);
+
+	composed = g_strdup(purple_normalize(NULL, "caf\xc3\xa9"));
+	g_assert_cmpstr("cafe\xcc\x81", ==, composed);
+	g_assert_cmpstr(composed, ==, purple_normalize(NULL, "cafe\xcc\x81"));
+
+	purple_normalize_get_cache_stats(&hits2, &misses2);
+	g_assert_cmpuint(hits2, ==, hits);
+	g_assert_cmpuint(misses2, ==, misses + 2);
+
+	g_assert_cmpstr(composed, ==, purple_normalize(NULL, "caf\xc3\xa9"));
+
+	purple_normalize_get_cache_stats(&hits2, &misses2);
+	g_assert_cmpuint(hits2, ==, hits + 1);
+	g_assert_cmpuint(misses2, ==, misses + 2);
+
+	g_free(composed);
+}
+
+static void
+test_util_normalize_cache_eviction(void) {
+	guint64 misses, misses2;
+	gchar name[16];
+	gint i;
+
+	purple_normalize(NULL, "name 0");
+
+	/* Push it out with enough other names. */
+	for(i = 1; i <= 5000; i++) {
+		g_snprintf(name, sizeof(name), "name %d", i);
+		g_assert_cmpstr(name, ==, purple_normalize(NULL, name));
+	}
+
+	purple_normalize_get_cache_stats(NULL, &misses);
+	g_assert_cmpstr("name 0", ==, purple_normalize(NULL, "name 0"));
+	purple_normalize_get_cache_stats(NULL, &misses2);
+	g_assert_cmpuint(misses2, ==, misses + 1);
+
+	purple_normalize_invalidate(NULL);
+	purple_normalize(NULL, "name 5000");
+	purple_normalize_get_cache_stats(NULL, &misses);
+	g_assert_cmpuint(misses, ==, misses2 + 1);
+}
+
 /******************************************************************************
  * MANE
  *****************************************************************************/
@@ -570,5 +622,10 @@ main(gint argc, gchar **argv) {
 	g_test_add_func("/util/test_strdup_withhtml",
 	                test_util_strdup_withhtml);
 
+	g_test_add_func("/util/normalize/cache",
+	                test_util_normalize_cache);
+	g_test_add_func("/util/normalize/cache eviction",
+	                test_util_normalize_cache_eviction);
+
 	return g_test_run();
 }
@@ -21,6 +21,7 @@
  *
  */
 #include <glib.h>
+#include <string.h>
 
 #include "../xmlnode.h"
 
@@ -133,6 +134,326 @@ test_strip_prefixes(void) {
 	purple_xmlnode_free(xml);
 }
 
+static void
+test_xmlnode_to_str_escaping(void) {
+	PurpleXmlNode *xml;
+	char *str;
+	int len;
+
+	xml = purple_xmlnode_new("msg");
+	purple_xmlnode_set_attrib(xml, "a", "x&y<'\"");
+	purple_xmlnode_insert_data(xml, "1 < 2 & 3 > 2 \x01 \xc2\x80 \xc2\x85", -1);
+
+	str = purple_xmlnode_to_str(xml, &len);
+	g_assert_cmpstr("<msg a='x&amp;y&lt;&apos;&quot;'>"
+		"1 &lt; 2 &amp; 3 &gt; 2 &#x1; &#x80; \xc2\x85</msg>", ==, str);
+	g_assert_cmpint(strlen(str), ==, len);
+
+	g_free(str);
+	purple_xmlnode_free(xml);
+}
+
+static void
+test_xmlnode_to_formatted_str(void) {
+	const char *xml_doc = "<a><b x='1'/><c>text</c><d><e/></d></a>";
+	PurpleXmlNode *xml;
+	char *str;
+	int len;
+
+	xml = purple_xmlnode_from_str(xml_doc, -1);
+	g_assert_nonnull(xml);
+
+	str = purple_xmlnode_to_formatted_str(xml, &len);
+	g_assert_cmpstr("<?xml version='1.0' encoding='UTF-8' ?>\n\n"
+		"<a>\n"
+		"\t<b x='1'/>\n"
+		"\t<c>text</c>\n"
+		"\t<d>\n"
+		"\t\t<e/>\n"
+		"\t</d>\n"
+		"</a>\n", ==, str);
+	g_assert_cmpint(strlen(str), ==, len);
+
+	g_free(str);
+	purple_xmlnode_free(xml);
+}
+
+static void
+test_xmlnode_append_to_string(void) {
+	const char *xml_doc = "<iq type='get' xmlns='jabber:client'><ping xmlns='urn:xmpp:ping'/></iq>";
+	PurpleXmlNode *xml;
+	GString *str;
+
+	xml = purple_xmlnode_from_str(xml_doc, -1);
+	g_assert_nonnull(xml);
+
+	str = g_string_new("<stream>");
+	purple_xmlnode_append_to_string(xml, str);
+	purple_xmlnode_append_to_string(xml, str);
+	g_assert_cmpstr("<stream>"
+		"<iq xmlns='jabber:client' type='get'><ping xmlns='urn:xmpp:ping'/></iq>"
+		"<iq xmlns='jabber:client' type='get'><ping xmlns='urn:xmpp:ping'/></iq>",
+		==, str->str);
+
+	g_string_free(str, TRUE);
+	purple_xmlnode_free(xml);
+}
+
+static void
+test_xmlnode_path(void) {
+	const char *xml_doc =
+		"<iq type='result'>"
+			"<pubsub xmlns='urn:other'/>"
+			"<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+				"<items node='a'><item id='1'/></items>"
+			"</pubsub>"
+		"</iq>";
+	PurpleXmlNode *xml, *items;
+	PurpleXmlPath *path;
+
+	xml = purple_xmlnode_from_str(xml_doc, -1);
+	g_assert_nonnull(xml);
+
+	path = purple_xmlnode_path_new("pubsub/items",
+			"http://jabber.org/protocol/pubsub");
+	items = purple_xmlnode_path_get(path, xml);
+	g_assert_nonnull(items);
+	g_assert_cmpstr("a", ==, purple_xmlnode_get_attrib(items, "node"));
+	g_assert_true(items == purple_xmlnode_get_child_with_namespace(xml,
+			"pubsub/items", "http://jabber.org/protocol/pubsub"));
+	purple_xmlnode_path_free(path);
+
+	path = purple_xmlnode_path_new("pubsub/items/item", NULL);
+	g_assert_null(purple_xmlnode_path_get(path, xml));
+	purple_xmlnode_path_free(path);
+
+	path = purple_xmlnode_path_new("pubsub/item", NULL);
+	g_assert_null(purple_xmlnode_path_get(path, xml));
+	purple_xmlnode_path_free(path);
+
+	purple_xmlnode_free(xml);
+}
+
+static void
+test_xmlnode_child_index(void) {
+	PurpleXmlNode *query, *x, *last;
+	char jid[32];
+	int i;
+
+	query = purple_xmlnode_new("query");
+	for (i = 0; i < 1000; i++) {
+		x = purple_xmlnode_new_child(query, "item");
+		g_snprintf(jid, sizeof(jid), "%d@example.com", i);
+		purple_xmlnode_set_attrib(x, "jid", jid);
+	}
+
+	/* A miss walks all the items, and leaves them indexed */
+	g_assert_null(purple_xmlnode_get_child(query, "group"));
+	g_assert_nonnull(query->child_index);
+
+	/* Children added later are found through the index */
+	x = purple_xmlnode_new_child(query, "group");
+	purple_xmlnode_set_namespace(x, "urn:a");
+	last = purple_xmlnode_new_child(query, "group");
+	purple_xmlnode_set_namespace(last, "urn:b");
+	g_assert_true(x == purple_xmlnode_get_child(query, "group"));
+	g_assert_true(last == purple_xmlnode_get_child_with_namespace(query, "group", "urn:b"));
+	g_assert_null(purple_xmlnode_get_child_with_namespace(query, "group", "urn:c"));
+
+	/* Taking children out doesn't leave them in the index, and keeps the
+	 * index of the others */
+	purple_xmlnode_free(x);
+	g_assert_nonnull(query->child_index);
+	g_assert_true(last == purple_xmlnode_get_child(query, "group"));
+	purple_xmlnode_unlink(last);
+	g_assert_null(last->parent);
+	g_assert_null(purple_xmlnode_get_child(query, "group"));
+	purple_xmlnode_insert_child(query, last);
+	g_assert_true(last == purple_xmlnode_get_child(query, "group"));
+	g_assert_true(last == query->lastchild);
+
+	x = purple_xmlnode_get_child(query, "item");
+	g_assert_cmpstr("0@example.com", ==, purple_xmlnode_get_attrib(x, "jid"));
+
+	/* The next item takes over the name the first one was indexed by */
+	purple_xmlnode_free(x);
+	g_assert_nonnull(query->child_index);
+	x = purple_xmlnode_get_child(query, "item");
+	g_assert_cmpstr("1@example.com", ==, purple_xmlnode_get_attrib(x, "jid"));
+
+	/* A replacement takes the place of the item in the index too */
+	last = purple_xmlnode_new("item");
+	purple_xmlnode_set_attrib(last, "jid", "new@example.com");
+	purple_xmlnode_replace(x, last);
+	g_assert_null(x->parent);
+	g_assert_true(last == query->child);
+	g_assert_nonnull(query->child_index);
+	g_assert_true(last == purple_xmlnode_get_child(query, "item"));
+	purple_xmlnode_free(x);
+
+	/* One with another name is found as well */
+	x = purple_xmlnode_new("other");
+	purple_xmlnode_replace(last, x);
+	purple_xmlnode_free(last);
+	g_assert_true(x == purple_xmlnode_get_child(query, "other"));
+	last = purple_xmlnode_get_child(query, "item");
+	g_assert_cmpstr("2@example.com", ==,
+			purple_xmlnode_get_attrib(last, "jid"));
+
+	purple_xmlnode_free(query);
+}
+
+/*
+ * Benchmarks, run with -m perf. They compare purple_xmlnode_to_str() with
+ * the way it used to work: a string per node, with every escaped name and
+ * value allocated separately.
+ */
+static char *
+perf_to_str_per_node(const PurpleXmlNode *node, int *len) {
+	GString *text = g_string_new("");
+	const PurpleXmlNode *c;
+	char *node_name, *esc, *esc2;
+	gboolean need_end = FALSE;
+
+	node_name = g_markup_escape_text(node->name, -1);
+	g_string_append_printf(text, "<%s", node_name);
+
+	for (c = node->child; c; c = c->next) {
+		if (c->type == PURPLE_XMLNODE_TYPE_ATTRIB) {
+			esc = g_markup_escape_text(c->name, -1);
+			esc2 = g_markup_escape_text(c->data, -1);
+			g_string_append_printf(text, " %s='%s'", esc, esc2);
+			g_free(esc);
+			g_free(esc2);
+		} else {
+			need_end = TRUE;
+		}
+	}
+
+	if (need_end) {
+		g_string_append_c(text, '>');
+		for (c = node->child; c; c = c->next) {
+			if (c->type == PURPLE_XMLNODE_TYPE_TAG) {
+				int esc_len;
+				esc = perf_to_str_per_node(c, &esc_len);
+				g_string_append_len(text, esc, esc_len);
+				g_free(esc);
+			} else if (c->type == PURPLE_XMLNODE_TYPE_DATA && c->data_sz > 0) {
+				esc = g_markup_escape_text(c->data, c->data_sz);
+				g_string_append(text, esc);
+				g_free(esc);
+			}
+		}
+		g_string_append_printf(text, "</%s>", node_name);
+	} else {
+		g_string_append(text, "/>");
+	}
+
+	g_free(node_name);
+
+	*len = text->len;
+	return g_string_free(text, FALSE);
+}
+
+static PurpleXmlNode *
+perf_blist_tree(void) {
+	PurpleXmlNode *purple, *blist, *group, *contact, *buddy, *child;
+	int g, c;
+
+	purple = purple_xmlnode_new("purple");
+	purple_xmlnode_set_attrib(purple, "version", "1.0");
+	blist = purple_xmlnode_new_child(purple, "blist");
+
+	for (g = 0; g < 50; g++) {
+		char *name = g_strdup_printf("Group %d", g);
+		group = purple_xmlnode_new_child(blist, "group");
+		purple_xmlnode_set_attrib(group, "name", name);
+		g_free(name);
+
+		for (c = 0; c < 100; c++) {
+			char *buddy_name = g_strdup_printf("buddy%d.%d@example.com", g, c);
+
+			contact = purple_xmlnode_new_child(group, "contact");
+			buddy = purple_xmlnode_new_child(contact, "buddy");
+			purple_xmlnode_set_attrib(buddy, "account", "me@example.com/Home");
+			purple_xmlnode_set_attrib(buddy, "proto", "prpl-jabber");
+			child = purple_xmlnode_new_child(buddy, "name");
+			purple_xmlnode_insert_data(child, buddy_name, -1);
+			child = purple_xmlnode_new_child(buddy, "alias");
+			purple_xmlnode_insert_data(child, "Tom & Jerry <3", -1);
+			child = purple_xmlnode_new_child(buddy, "setting");
+			purple_xmlnode_set_attrib(child, "name", "last_seen");
+			purple_xmlnode_set_attrib(child, "type", "int");
+			purple_xmlnode_insert_data(child, "1500000000", -1);
+
+			g_free(buddy_name);
+		}
+	}
+
+	return purple;
+}
+
+static PurpleXmlNode *
+perf_stanza_tree(void) {
+	const char *xml_doc = "<message xmlns='jabber:client' from='user@example.com/resource' to='another_user@example.org' type='chat' id='purple1234'>"
+		"<active xmlns='http://jabber.org/protocol/chatstates'/>"
+		"<body>Are we still on for lunch at 12? I'll bring the &quot;good&quot; coffee &amp; cookies.</body>"
+		"<html xmlns='http://jabber.org/protocol/xhtml-im'>"
+			"<body xmlns='http://www.w3.org/1999/xhtml'>"
+				"<p>Are we still on for lunch at <span style='font-weight: bold;'>12</span>?</p>"
+			"</body>"
+		"</html>"
+	"</message>";
+
+	return purple_xmlnode_from_str(xml_doc, -1);
+}
+
+static void
+perf_to_str(PurpleXmlNode *xml, int iterations) {
+	gdouble streaming, per_node;
+	gsize bytes = 0;
+	char *str;
+	int i, len;
+
+	g_test_timer_start();
+	for (i = 0; i < iterations; i++) {
+		str = purple_xmlnode_to_str(xml, &len);
+		bytes += len;
+		g_free(str);
+	}
+	streaming = g_test_timer_elapsed();
+
+	g_test_timer_start();
+	for (i = 0; i < iterations; i++) {
+		str = perf_to_str_per_node(xml, &len);
+		g_free(str);
+	}
+	per_node = g_test_timer_elapsed();
+
+	g_test_message("%d bytes: purple_xmlnode_to_str %.1f MB/s, "
+		"string per node %.1f MB/s",
+		len, bytes / streaming / 1e6, bytes / per_node / 1e6);
+	g_test_minimized_result(streaming / iterations,
+		"purple_xmlnode_to_str: %g s", streaming / iterations);
+}
+
+static void
+test_xmlnode_perf_blist(void) {
+	PurpleXmlNode *xml = perf_blist_tree();
+
+	perf_to_str(xml, 20);
+	purple_xmlnode_free(xml);
+}
+
+static void
+test_xmlnode_perf_stanza(void) {
+	PurpleXmlNode *xml = perf_stanza_tree();
+
+	g_assert_nonnull(xml);
+	perf_to_str(xml, 100000);
+	purple_xmlnode_free(xml);
+}
+
 gint
 main(gint argc, gchar **argv) {
 	g_test_init(&argc, &argv, NULL);
@@ -143,6 +464,23 @@ main(gint argc, gchar **argv) {
 	                test_xmlnode_prefixes);
 	g_test_add_func("/xmlnode/strip_prefixes",
 	                test_strip_prefixes);
+	g_test_add_func("/xmlnode/to_str/escaping",
+	                test_xmlnode_to_str_escaping);
+	g_test_add_func("/xmlnode/to_str/formatted",
+	                test_xmlnode_to_formatted_str);
+	g_test_add_func("/xmlnode/to_str/append",
+	                test_xmlnode_append_to_string);
+	g_test_add_func("/xmlnode/path",
+	                test_xmlnode_path);
+	g_test_add_func("/xmlnode/child_index",
+	                test_xmlnode_child_index);
+
+	if (g_test_perf()) {
+		g_test_add_func("/xmlnode/perf/blist",
+		                test_xmlnode_perf_blist);
+		g_test_add_func("/xmlnode/perf/stanza",
+		                test_xmlnode_perf_stanza);
+	}
 
 	return g_test_run();
 }
@@ -42,13 +42,19 @@
 #define PURPLE_TRIE_STATES_SMALL_POOL_BLOCK_SIZE 10880
 #define PURPLE_TRIE_STATES_LARGE_POOL_BLOCK_SIZE 102400
 
+/* The number of merged automatons kept by every trie, that is the first one
+ * on a list passed to multi-search functions. */
+#define PURPLE_TRIE_MERGED_CACHE_SIZE 8
+
 typedef struct _PurpleTrieRecord PurpleTrieRecord;
 typedef struct _PurpleTrieState PurpleTrieState;
 typedef struct _PurpleTrieRecordList PurpleTrieRecordList;
+typedef struct _PurpleTrieDfa PurpleTrieDfa;
 
 typedef struct
 {
 	gboolean reset_on_match;
+	gboolean compiled;
 
 	PurpleMemoryPool *records_str_mempool;
 	PurpleMemoryPool *records_obj_mempool;
@@ -58,6 +64,13 @@ typedef struct
 
 	PurpleMemoryPool *states_mempool;
 	PurpleTrieState *root_state;
+	gsize states_unused_size;
+
+	PurpleTrieDfa *dfa;
+
+	guint serial;
+	guint generation;
+	GQueue merged_cache;
 } PurpleTriePrivate;
 
 struct _PurpleTrieRecord
@@ -80,17 +93,68 @@ struct _PurpleTrieState
 {
 	PurpleTrieState *parent;
 	PurpleTrieState **children;
+	guint depth;
+
+	guchar character;
 
 	PurpleTrieState *longest_suffix;
 
+	/* A list of states, that have this one as their longest_suffix. The root
+	 * keeps them in suffix_of_char instead, one list for every character
+	 * they end with. */
+	PurpleTrieState *suffix_of;
+	PurpleTrieState *suffix_of_next;
+	PurpleTrieState *suffix_of_prev;
+	PurpleTrieState **suffix_of_char;
+
 	PurpleTrieRecord *found_word;
 };
 
+/* A compiled form of a trie (or a couple of them merged together):
+ * a deterministic automaton stored in a single table. Characters not used
+ * by any word share the class 0, so the table has only as many columns as
+ * there are distinct characters in the dictionary. Failure transitions are
+ * already folded into the table, thus every input character costs exactly
+ * one lookup. The state 0 is the root.
+ *
+ * Every word is tagged with the index of the trie it comes from (its
+ * source). For every state and source, we keep the longest word of that
+ * source being a suffix of the state.
+ */
+struct _PurpleTrieDfa
+{
+	guint8 char_class[256];
+	guint classes_count;
+	guint states_count;
+	guint sources_count;
+
+	/* transitions[state * classes_count + class] */
+	guint32 *transitions;
+	guint32 *fail;
+
+	/* found_words[state * sources_count + source] is the longest word
+	 * found in that state, that ends in found_states[...] state. */
+	PurpleTrieRecord **found_words;
+	guint32 *found_states;
+
+	/* All characters that may start a word, used to skip the parts of the
+	 * input, that can't match anything. */
+	gchar first_chars[256];
+
+	/* Identifies the tries (and their contents), the automaton was built
+	 * from. Used for merged automatons only. */
+	guint *source_serials;
+	guint *source_generations;
+};
+
 typedef struct
 {
 	PurpleTrieState *state;
-
 	PurpleTrieState *root_state;
+
+	const PurpleTrieDfa *dfa;
+	guint32 dfa_state;
+
 	gboolean reset_on_match;
 
 	PurpleTrieReplaceCb replace_cb;
@@ -103,11 +167,13 @@ enum
 {
 	PROP_ZERO,
 	PROP_RESET_ON_MATCH,
+	PROP_COMPILED,
 	PROP_LAST
 };
 
 static GObjectClass *parent_class = NULL;
 static GParamSpec *properties[PROP_LAST];
+static guint last_serial = 0;
 
 
 /*******************************************************************************
@@ -195,6 +261,9 @@ purple_record_list_remove(PurpleTrieRecordList *head,
  * States management
  ******************************************************************************/
 
+static void
+purple_trie_dfa_free(PurpleTrieDfa *dfa);
+
 static void
 purple_trie_states_cleanup(PurpleTrie *trie)
 {
@@ -205,6 +274,12 @@ purple_trie_states_cleanup(PurpleTrie *trie)
 	if (priv->root_state != NULL) {
 		purple_memory_pool_cleanup(priv->states_mempool);
 		priv->root_state = NULL;
+		priv->states_unused_size = 0;
+	}
+
+	if (priv->dfa != NULL) {
+		purple_trie_dfa_free(priv->dfa);
+		priv->dfa = NULL;
 	}
 }
 
@@ -221,10 +296,23 @@ purple_trie_state_new(PurpleTrie *trie, PurpleTrieState *parent, guchar characte
 		sizeof(PurpleTrieState), sizeof(gpointer));
 	g_return_val_if_fail(state != NULL, NULL);
 
-	if (parent == NULL)
+	if (parent == NULL) {
+		state->suffix_of_char = purple_memory_pool_alloc0(
+			priv->states_mempool,
+			/* PurpleTrieState *suffix_of_char[G_MAXUCHAR + 1] */
+			256 * sizeof(gpointer),
+			sizeof(gpointer));
+		if (state->suffix_of_char == NULL) {
+			purple_memory_pool_free(priv->states_mempool, state);
+			g_warn_if_reached();
+			return NULL;
+		}
 		return state;
+	}
 
 	state->parent = parent;
+	state->depth = parent->depth + 1;
+	state->character = character;
 	if (parent->children == NULL) {
 		parent->children = purple_memory_pool_alloc0(
 			priv->states_mempool,
@@ -244,6 +332,72 @@ purple_trie_state_new(PurpleTrie *trie, PurpleTrieState *parent, guchar characte
 	return state;
 }
 
+/* Returns the head of the list of states with the same longest_suffix, that
+ * the state belongs to (or would belong to). */
+static PurpleTrieState **
+purple_trie_state_suffix_list(PurpleTrieState *suffix, PurpleTrieState *state)
+{
+	if (suffix->suffix_of_char != NULL)
+		return &suffix->suffix_of_char[state->character];
+	return &suffix->suffix_of;
+}
+
+static void
+purple_trie_state_set_suffix(PurpleTrieState *state, PurpleTrieState *suffix)
+{
+	PurpleTrieState *old_suffix = state->longest_suffix;
+	PurpleTrieState **list;
+
+	if (old_suffix != NULL) {
+		if (state->suffix_of_prev != NULL)
+			state->suffix_of_prev->suffix_of_next =
+				state->suffix_of_next;
+		else {
+			list = purple_trie_state_suffix_list(old_suffix, state);
+			*list = state->suffix_of_next;
+		}
+		if (state->suffix_of_next != NULL)
+			state->suffix_of_next->suffix_of_prev =
+				state->suffix_of_prev;
+	}
+
+	list = purple_trie_state_suffix_list(suffix, state);
+	state->longest_suffix = suffix;
+	state->suffix_of_prev = NULL;
+	state->suffix_of_next = *list;
+	if (*list != NULL)
+		(*list)->suffix_of_prev = state;
+	*list = state;
+}
+
+/* Looks for a longest complete suffix of the state. It's searched in any path
+ * starting in root and ending in the (depth - 1) level of trie, so all states
+ * above have to be complete. */
+static PurpleTrieState *
+purple_trie_state_find_suffix(PurpleTrieState *root, PurpleTrieState *state,
+	guchar character)
+{
+	PurpleTrieState *lon_suf_parent = state->parent->longest_suffix;
+
+	while (lon_suf_parent) {
+		if (lon_suf_parent->children &&
+			lon_suf_parent->children[character])
+		{
+			return lon_suf_parent->children[character];
+		}
+		lon_suf_parent = lon_suf_parent->longest_suffix;
+	}
+
+	return root;
+}
+
+static inline gboolean
+purple_trie_state_has_own_word(PurpleTrieState *state)
+{
+	return (state->found_word != NULL &&
+		state->found_word->word_len == state->depth);
+}
+
 #if 0
 static gchar *
 purple_trie_print(PurpleTrieState *state, int limit)
@@ -327,7 +481,6 @@ purple_trie_states_build(PurpleTrie *trie)
 			PurpleTrieRecord *rec = it->rec;
 			guchar character = rec->word[cur_len];
 			PurpleTrieState *prefix = it->extra_data;
-			PurpleTrieState *lon_suf_parent;
 
 			g_assert(character != '\0');
 
@@ -350,8 +503,14 @@ purple_trie_states_build(PurpleTrie *trie)
 
 			/* The whole word is now added to the trie. */
 			if (rec->word[cur_len + 1] == '\0') {
-				if (prefix->found_word == NULL)
+				/* The state might already inherit a shorter word
+				 * from its longest_suffix, if it was created by
+				 * another word before. */
+				if (prefix->found_word == NULL ||
+					prefix->found_word->word_len <= cur_len)
+				{
 					prefix->found_word = rec;
+				}
 				else {
 					purple_debug_warning("trie", "found "
 						"a collision of \"%s\" words",
@@ -364,24 +523,12 @@ purple_trie_states_build(PurpleTrie *trie)
 			}
 
 			/* We need to fill the longest_suffix field -- a longest
-			 * complete suffix of the prefix we created. We look for
-			 * that suffix in any path starting in root and ending
-			 * in the (cur_len - 1) level of trie. */
+			 * complete suffix of the prefix we created. */
 			if (prefix->longest_suffix != NULL)
 				continue;
-			lon_suf_parent = prefix->parent->longest_suffix;
-			while (lon_suf_parent) {
-				if (lon_suf_parent->children &&
-					lon_suf_parent->children[character])
-				{
-					prefix->longest_suffix = lon_suf_parent->
-						children[character];
-					break;
-				}
-				lon_suf_parent = lon_suf_parent->longest_suffix;
-			}
-			if (prefix->longest_suffix == NULL)
-				prefix->longest_suffix = root;
+			purple_trie_state_set_suffix(prefix,
+				purple_trie_state_find_suffix(root, prefix,
+					character));
 			if (prefix->found_word == NULL) {
 				prefix->found_word =
 					prefix->longest_suffix->found_word;
@@ -394,13 +541,444 @@ purple_trie_states_build(PurpleTrie *trie)
 	return TRUE;
 }
 
+/*******************************************************************************
+ * Incremental updates
+ ******************************************************************************/
+
+/* Updates found_word of all states, that inherit it from the given one. It's
+ * never the root, which has no word. */
+static void
+purple_trie_states_propagate_word(PurpleTrieState *state)
+{
+	PurpleTrieState *it;
+
+	for (it = state->suffix_of; it != NULL; it = it->suffix_of_next) {
+		if (purple_trie_state_has_own_word(it))
+			continue;
+		it->found_word = state->found_word;
+		purple_trie_states_propagate_word(it);
+	}
+}
+
+/* The state was just created as a child of a suffix_parent. Every state, that
+ * has this new one as a suffix, but the longest_suffix field points to
+ * a shorter one, has to be updated. These are children of states having
+ * suffix_parent as a suffix and no longer suffix with such a child. They are
+ * collected first, as relinking them may alter lists we walk through.
+ *
+ * For a new child of the root, these are just the states ending with the same
+ * character, that have the root as their suffix, so the root's index is used
+ * instead of walking the whole trie. */
+static void
+purple_trie_states_find_relinked(PurpleTrieState *suffix_parent,
+	guchar character, GSList **relinked)
+{
+	PurpleTrieState *it;
+
+	if (suffix_parent->suffix_of_char != NULL) {
+		for (it = suffix_parent->suffix_of_char[character]; it != NULL;
+			it = it->suffix_of_next)
+		{
+			*relinked = g_slist_prepend(*relinked, it);
+		}
+		return;
+	}
+
+	for (it = suffix_parent->suffix_of; it != NULL; it = it->suffix_of_next) {
+		if (it->children && it->children[character]) {
+			*relinked = g_slist_prepend(*relinked,
+				it->children[character]);
+		} else {
+			purple_trie_states_find_relinked(it, character,
+				relinked);
+		}
+	}
+}
+
+/* Adds a word to already built states. Only the branch of a new word and
+ * the states having its parts as suffixes are modified. */
+static gboolean
+purple_trie_states_insert(PurpleTrie *trie, PurpleTrieRecord *rec)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+	PurpleTrieState *root = priv->root_state, *state = root;
+	GSList *relinked, *it;
+	guint i;
+
+	for (i = 0; i < rec->word_len; i++) {
+		guchar character = rec->word[i];
+		PurpleTrieState *child;
+
+		if (state->children && state->children[character]) {
+			state = state->children[character];
+			continue;
+		}
+
+		child = purple_trie_state_new(trie, state, character);
+		if (child == NULL)
+			return FALSE;
+
+		/* Before the child is on any of the lists */
+		relinked = NULL;
+		purple_trie_states_find_relinked(state, character, &relinked);
+
+		purple_trie_state_set_suffix(child,
+			purple_trie_state_find_suffix(root, child, character));
+		child->found_word = child->longest_suffix->found_word;
+
+		for (it = relinked; it != NULL; it = it->next)
+			purple_trie_state_set_suffix(it->data, child);
+		g_slist_free(relinked);
+
+		state = child;
+	}
+
+	state->found_word = rec;
+	purple_trie_states_propagate_word(state);
+
+	return TRUE;
+}
+
+/* Removes a word from already built states. Its branch is left in place, as
+ * it doesn't break anything. */
+static void
+purple_trie_states_remove(PurpleTrie *trie, PurpleTrieRecord *rec)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+	PurpleTrieState *state = priv->root_state;
+	guint i;
+
+	for (i = 0; i < rec->word_len && state != NULL; i++) {
+		guchar character = rec->word[i];
+
+		state = state->children ? state->children[character] : NULL;
+	}
+
+	g_return_if_fail(state != NULL);
+	g_return_if_fail(state->found_word == rec);
+
+	state->found_word = state->longest_suffix->found_word;
+	purple_trie_states_propagate_word(state);
+
+	priv->states_unused_size += rec->word_len;
+}
+
+/*******************************************************************************
+ * Compiled automaton
+ ******************************************************************************/
+
+static void
+purple_trie_dfa_free(PurpleTrieDfa *dfa)
+{
+	if (dfa == NULL)
+		return;
+
+	g_free(dfa->transitions);
+	g_free(dfa->fail);
+	g_free(dfa->found_words);
+	g_free(dfa->found_states);
+	g_free(dfa->source_serials);
+	g_free(dfa->source_generations);
+	g_free(dfa);
+}
+
+static PurpleTrieDfa *
+purple_trie_dfa_new(PurpleTrie **tries, guint tries_count)
+{
+	PurpleTrieDfa *dfa;
+	PurpleTrieRecordList *it;
+	gboolean is_first[256];
+	guint32 *fail, *queue;
+	guint classes, sources, states_max, first_count, head, tail;
+	guint c, i, src;
+
+	dfa = g_new0(PurpleTrieDfa, 1);
+	dfa->sources_count = sources = tries_count;
+	memset(is_first, 0, sizeof(is_first));
+
+	/* Assign a class to every character used within the dictionaries.
+	 * There is at most one state per character of every word, plus
+	 * the root. */
+	classes = 1;
+	states_max = 1;
+	for (src = 0; src < sources; src++) {
+		PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(tries[src]);
+
+		states_max += priv->records_total_size;
+		for (it = priv->records; it != NULL; it = it->next) {
+			const guchar *word = (const guchar *)it->rec->word;
+
+			is_first[word[0]] = TRUE;
+			for (i = 0; word[i] != '\0'; i++) {
+				if (dfa->char_class[word[i]] == 0)
+					dfa->char_class[word[i]] = classes++;
+			}
+		}
+	}
+	dfa->classes_count = classes;
+
+	first_count = 0;
+	for (c = 1; c < 256; c++) {
+		if (is_first[c])
+			dfa->first_chars[first_count++] = c;
+	}
+	dfa->first_chars[first_count] = '\0';
+
+	dfa->transitions = g_new0(guint32, states_max * classes);
+	dfa->found_words = g_new0(PurpleTrieRecord*, states_max * sources);
+	dfa->found_states = g_new0(guint32, states_max * sources);
+	dfa->states_count = 1;
+
+	/* Build the goto function. As the root is never a child of any other
+	 * state, zero means "no transition" for now. */
+	for (src = 0; src < sources; src++) {
+		PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(tries[src]);
+
+		for (it = priv->records; it != NULL; it = it->next) {
+			const guchar *word = (const guchar *)it->rec->word;
+			guint32 state = 0;
+
+			for (i = 0; word[i] != '\0'; i++) {
+				guint32 *next = &dfa->transitions[
+					state * classes +
+					dfa->char_class[word[i]]];
+
+				if (*next == 0)
+					*next = dfa->states_count++;
+				state = *next;
+			}
+
+			dfa->found_words[state * sources + src] = it->rec;
+			dfa->found_states[state * sources + src] = state;
+		}
+	}
+
+	/* Fill the missing transitions with the failure ones, in the
+	 * breadth-first order, so the shorter suffixes are already done. */
+	dfa->fail = fail = g_new0(guint32, dfa->states_count);
+	queue = g_new(guint32, dfa->states_count);
+	head = tail = 0;
+	for (c = 1; c < classes; c++) {
+		guint32 child = dfa->transitions[c];
+
+		if (child != 0)
+			queue[tail++] = child;
+	}
+	while (head < tail) {
+		guint32 state = queue[head++];
+		guint32 *row = &dfa->transitions[state * classes];
+		const guint32 *fail_row = &dfa->transitions[fail[state] * classes];
+
+		for (src = 0; src < sources; src++) {
+			guint own = state * sources + src;
+			guint inherited = fail[state] * sources + src;
+
+			if (dfa->found_words[own] != NULL)
+				continue;
+			dfa->found_words[own] = dfa->found_words[inherited];
+			dfa->found_states[own] = dfa->found_states[inherited];
+		}
+
+		for (c = 1; c < classes; c++) {
+			if (row[c] != 0) {
+				fail[row[c]] = fail_row[c];
+				queue[tail++] = row[c];
+			} else
+				row[c] = fail_row[c];
+		}
+	}
+	g_free(queue);
+
+	if (dfa->states_count < states_max) {
+		dfa->transitions = g_renew(guint32, dfa->transitions,
+			dfa->states_count * classes);
+		dfa->found_words = g_renew(PurpleTrieRecord*,
+			dfa->found_words, dfa->states_count * sources);
+		dfa->found_states = g_renew(guint32,
+			dfa->found_states, dfa->states_count * sources);
+	}
+
+	return dfa;
+}
+
+static inline guint32
+purple_trie_dfa_advance(const PurpleTrieDfa *dfa, guint32 state,
+	const guchar character)
+{
+	return dfa->transitions[state * dfa->classes_count +
+		dfa->char_class[character]];
+}
+
+/* Returns the number of leading characters of src, that can be skipped
+ * without changing the state, when the automaton is in the root state. */
+static inline gsize
+purple_trie_dfa_skip(const PurpleTrieDfa *dfa, const gchar *src)
+{
+	/* strcspn is vectorized in every libc we care about. */
+	return strcspn(src, dfa->first_chars);
+}
+
+/* Returns the longest word of a given source, that is a suffix of the state
+ * and is not longer than max_len. */
+static inline PurpleTrieRecord *
+purple_trie_dfa_found_word(const PurpleTrieDfa *dfa, guint32 state,
+	guint src, gsize max_len)
+{
+	guint sources = dfa->sources_count;
+	guint32 word_state = dfa->found_states[state * sources + src];
+
+	while (word_state != 0 &&
+		dfa->found_words[word_state * sources + src]->word_len > max_len)
+	{
+		word_state = dfa->found_states[
+			dfa->fail[word_state] * sources + src];
+	}
+
+	if (word_state == 0)
+		return NULL;
+	return dfa->found_words[word_state * sources + src];
+}
+
+/*******************************************************************************
+ * Merged automatons
+ ******************************************************************************/
+
+static gboolean
+purple_trie_dfa_built_from(const PurpleTrieDfa *dfa, const GSList *tries,
+	gboolean *is_outdated)
+{
+	gboolean outdated = FALSE;
+	guint src;
+
+	*is_outdated = FALSE;
+	for (src = 0; src < dfa->sources_count; src++, tries = tries->next) {
+		PurpleTriePrivate *priv;
+
+		if (tries == NULL)
+			return FALSE;
+		priv = PURPLE_TRIE_GET_PRIVATE(tries->data);
+		if (dfa->source_serials[src] != priv->serial)
+			return FALSE;
+		if (dfa->source_generations[src] != priv->generation)
+			outdated = TRUE;
+	}
+
+	if (tries != NULL)
+		return FALSE;
+
+	*is_outdated = outdated;
+	return !outdated;
+}
+
+/* Returns an automaton merged from all tries on the list, in their order.
+ * It's cached within the first trie, until any of the tries is modified. */
+static const PurpleTrieDfa *
+purple_trie_dfa_get_merged(const GSList *tries, guint tries_count)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(tries->data);
+	PurpleTrie **tries_array;
+	PurpleTrieDfa *dfa;
+	GList *it, *next;
+	guint src;
+
+	for (it = priv->merged_cache.head; it != NULL; it = next) {
+		gboolean is_outdated;
+
+		next = it->next;
+		dfa = it->data;
+
+		if (purple_trie_dfa_built_from(dfa, tries, &is_outdated)) {
+			g_queue_unlink(&priv->merged_cache, it);
+			g_queue_push_head_link(&priv->merged_cache, it);
+			return dfa;
+		}
+
+		/* The same set of tries, but some of them were modified. */
+		if (is_outdated) {
+			purple_trie_dfa_free(dfa);
+			g_queue_delete_link(&priv->merged_cache, it);
+		}
+	}
+
+	tries_array = g_new(PurpleTrie*, tries_count);
+	for (src = 0; src < tries_count; src++, tries = tries->next)
+		tries_array[src] = tries->data;
+
+	dfa = purple_trie_dfa_new(tries_array, tries_count);
+	dfa->source_serials = g_new(guint, tries_count);
+	dfa->source_generations = g_new(guint, tries_count);
+	for (src = 0; src < tries_count; src++) {
+		PurpleTriePrivate *src_priv =
+			PURPLE_TRIE_GET_PRIVATE(tries_array[src]);
+
+		dfa->source_serials[src] = src_priv->serial;
+		dfa->source_generations[src] = src_priv->generation;
+	}
+	g_free(tries_array);
+
+	g_queue_push_head(&priv->merged_cache, dfa);
+	if (priv->merged_cache.length > PURPLE_TRIE_MERGED_CACHE_SIZE)
+		purple_trie_dfa_free(g_queue_pop_tail(&priv->merged_cache));
+
+	return dfa;
+}
+
 /*******************************************************************************
  * Searching
  ******************************************************************************/
 
+static void
+purple_trie_machine_init(PurpleTrieMachine *m, PurpleTrie *trie)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+
+	if (priv->compiled) {
+		if (priv->dfa == NULL)
+			priv->dfa = purple_trie_dfa_new(&trie, 1);
+		m->dfa = priv->dfa;
+		m->dfa_state = 0;
+		m->state = m->root_state = NULL;
+	} else {
+		purple_trie_states_build(trie);
+		m->dfa = NULL;
+		m->state = m->root_state = priv->root_state;
+	}
+
+	m->reset_on_match = priv->reset_on_match;
+}
+
+static inline void
+purple_trie_machine_reset(PurpleTrieMachine *m)
+{
+	m->state = m->root_state;
+	m->dfa_state = 0;
+}
+
+static inline gboolean
+purple_trie_machine_is_reset(PurpleTrieMachine *m)
+{
+	if (m->dfa)
+		return m->dfa_state == 0;
+	return m->state == m->root_state;
+}
+
+static inline PurpleTrieRecord *
+purple_trie_machine_found_word(PurpleTrieMachine *m)
+{
+	if (m->dfa)
+		return m->dfa->found_words[m->dfa_state];
+	return m->state->found_word;
+}
+
 static void
 purple_trie_advance(PurpleTrieMachine *m, const guchar character)
 {
+	if (m->dfa) {
+		m->dfa_state = purple_trie_dfa_advance(m->dfa, m->dfa_state,
+			character);
+		return;
+	}
+
 	/* change state after processing a character */
 	while (TRUE) {
 		/* Perfect fit - next character is the same, as the child of the
@@ -422,20 +1000,22 @@ purple_trie_advance(PurpleTrieMachine *m, const guchar character)
 static gboolean
 purple_trie_replace_do_replacement(PurpleTrieMachine *m, GString *out)
 {
+	PurpleTrieRecord *found_word;
 	gboolean was_replaced = FALSE;
 	gsize str_old_len;
 
 	/* if we reached a "found" state, let's process it */
-	if (!m->state->found_word)
+	found_word = purple_trie_machine_found_word(m);
+	if (!found_word)
 		return FALSE;
 
 	/* let's get back to the beginning of the word */
-	g_assert(out->len >= m->state->found_word->word_len - 1);
+	g_assert(out->len >= found_word->word_len - 1);
 	str_old_len = out->len;
-	out->len -= m->state->found_word->word_len - 1;
+	out->len -= found_word->word_len - 1;
 
-	was_replaced = m->replace_cb(out, m->state->found_word->word,
-		m->state->found_word->data, m->user_data);
+	was_replaced = m->replace_cb(out, found_word->word,
+		found_word->data, m->user_data);
 
 	/* output was untouched, revert to the previous position */
 	if (!was_replaced)
@@ -443,7 +1023,7 @@ purple_trie_replace_do_replacement(PurpleTrieMachine *m, GString *out)
 
 	/* XXX */
 	if (was_replaced || m->reset_on_match)
-		m->state = m->root_state;
+		purple_trie_machine_reset(m);
 
 	return was_replaced;
 }
@@ -451,21 +1031,23 @@ purple_trie_replace_do_replacement(PurpleTrieMachine *m, GString *out)
 static gboolean
 purple_trie_find_do_discovery(PurpleTrieMachine *m)
 {
+	PurpleTrieRecord *found_word;
 	gboolean was_accepted;
 
 	/* if we reached a "found" state, let's process it */
-	if (!m->state->found_word)
+	found_word = purple_trie_machine_found_word(m);
+	if (!found_word)
 		return FALSE;
 
 	if (m->find_cb) {
-		was_accepted = m->find_cb(m->state->found_word->word,
-			m->state->found_word->data, m->user_data);
+		was_accepted = m->find_cb(found_word->word,
+			found_word->data, m->user_data);
 	} else {
 		was_accepted = TRUE;
 	}
 
 	if (was_accepted && m->reset_on_match)
-		m->state = m->root_state;
+		purple_trie_machine_reset(m);
 
 	return was_accepted;
 }
@@ -485,20 +1067,29 @@ purple_trie_replace(PurpleTrie *trie, const gchar *src,
 	g_return_val_if_fail(replace_cb != NULL, g_strdup(src));
 	g_return_val_if_fail(priv != NULL, NULL);
 
-	purple_trie_states_build(trie);
-
-	machine.state = priv->root_state;
-	machine.root_state = priv->root_state;
-	machine.reset_on_match = priv->reset_on_match;
+	purple_trie_machine_init(&machine, trie);
 	machine.replace_cb = replace_cb;
 	machine.user_data = user_data;
 
 	out = g_string_new(NULL);
 	i = 0;
 	while (src[i] != '\0') {
-		guchar character = src[i++];
+		guchar character;
 		gboolean was_replaced;
 
+		/* Copy everything, that can't start a word, at once. */
+		if (machine.dfa && purple_trie_machine_is_reset(&machine)) {
+			gsize skip = purple_trie_dfa_skip(machine.dfa, src + i);
+
+			if (skip > 0) {
+				g_string_append_len(out, src + i, skip);
+				i += skip;
+				if (src[i] == '\0')
+					break;
+			}
+		}
+
+		character = src[i++];
 		purple_trie_advance(&machine, character);
 		was_replaced = purple_trie_replace_do_replacement(&machine, out);
 
@@ -511,12 +1102,21 @@ purple_trie_replace(PurpleTrie *trie, const gchar *src,
 	return g_string_free(out, FALSE);
 }
 
+/* Emulates running a separate search machine for every trie on the list,
+ * but scans the text only once, using a merged automaton. The machine of
+ * a single trie may be reset while others are not, so we keep the position
+ * of the last reset for every one of them and accept only those of its words,
+ * that start after it. */
 gchar *
 purple_trie_multi_replace(const GSList *tries, const gchar *src,
 	PurpleTrieReplaceCb replace_cb, gpointer user_data)
 {
-	guint tries_count, m_idx;
-	PurpleTrieMachine *machines;
+	const PurpleTrieDfa *dfa;
+	guint tries_count, t_idx;
+	gboolean *reset_on_match;
+	gsize *reset_pos;
+	const GSList *it;
+	guint32 state;
 	GString *out;
 	gsize i;
 
@@ -529,40 +1129,69 @@ purple_trie_multi_replace(const GSList *tries, const gchar *src,
 	if (tries_count == 0)
 		return g_strdup(src);
 
-	/* Initialize all machines. */
-	machines = g_new(PurpleTrieMachine, tries_count);
-	for (i = 0; i < tries_count; i++, tries = tries->next) {
-		PurpleTrie *trie = tries->data;
-		PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+	reset_on_match = g_new(gboolean, tries_count);
+	for (it = tries, t_idx = 0; it != NULL; it = it->next, t_idx++) {
+		PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(it->data);
 
 		if (priv == NULL) {
 			g_warn_if_reached();
-			g_free(machines);
+			g_free(reset_on_match);
 			return NULL;
 		}
 
-		purple_trie_states_build(trie);
-
-		machines[i].state = priv->root_state;
-		machines[i].root_state = priv->root_state;
-		machines[i].reset_on_match = priv->reset_on_match;
-		machines[i].replace_cb = replace_cb;
-		machines[i].user_data = user_data;
+		reset_on_match[t_idx] = priv->reset_on_match;
 	}
+	reset_pos = g_new0(gsize, tries_count);
+
+	dfa = purple_trie_dfa_get_merged(tries, tries_count);
 
 	out = g_string_new(NULL);
+	state = 0;
 	i = 0;
 	while (src[i] != '\0') {
-		guchar character = src[i++];
+		guchar character;
 		gboolean was_replaced = FALSE;
 
-		/* Advance every machine and possibly perform a replacement. */
-		for (m_idx = 0; m_idx < tries_count; m_idx++) {
-			purple_trie_advance(&machines[m_idx], character);
-			if (was_replaced)
+		/* Copy everything, that can't start a word, at once. */
+		if (state == 0) {
+			gsize skip = purple_trie_dfa_skip(dfa, src + i);
+
+			if (skip > 0) {
+				g_string_append_len(out, src + i, skip);
+				i += skip;
+				if (src[i] == '\0')
+					break;
+			}
+		}
+
+		character = src[i++];
+		state = purple_trie_dfa_advance(dfa, state, character);
+
+		/* Try words from every trie, in order of their priority. */
+		for (t_idx = 0; t_idx < tries_count; t_idx++) {
+			PurpleTrieRecord *found_word;
+			gsize str_old_len;
+
+			found_word = purple_trie_dfa_found_word(dfa, state,
+				t_idx, i - reset_pos[t_idx]);
+			if (found_word == NULL)
 				continue;
-			was_replaced = purple_trie_replace_do_replacement(
-				&machines[m_idx], out);
+
+			/* let's get back to the beginning of the word */
+			g_assert(out->len >= found_word->word_len - 1);
+			str_old_len = out->len;
+			out->len -= found_word->word_len - 1;
+
+			was_replaced = replace_cb(out, found_word->word,
+				found_word->data, user_data);
+			if (was_replaced)
+				break;
+
+			/* output was untouched, revert to the previous
+			 * position */
+			out->len = str_old_len;
+			if (reset_on_match[t_idx])
+				reset_pos[t_idx] = i;
 		}
 
 		/* We skipped a character without finding any records,
@@ -571,15 +1200,12 @@ purple_trie_multi_replace(const GSList *tries, const gchar *src,
 			g_string_append_c(out, character);
 
 		/* If we replaced a word, reset _all_ machines */
-		if (was_replaced) {
-			for (m_idx = 0; m_idx < tries_count; m_idx++) {
-				machines[m_idx].state =
-					machines[m_idx].root_state;
-			}
-		}
+		if (was_replaced)
+			state = 0;
 	}
 
-	g_free(machines);
+	g_free(reset_pos);
+	g_free(reset_on_match);
 	return g_string_free(out, FALSE);
 }
 
@@ -597,19 +1223,22 @@ purple_trie_find(PurpleTrie *trie, const gchar *src,
 
 	g_return_val_if_fail(priv != NULL, 0);
 
-	purple_trie_states_build(trie);
-
-	machine.state = priv->root_state;
-	machine.root_state = priv->root_state;
-	machine.reset_on_match = priv->reset_on_match;
+	purple_trie_machine_init(&machine, trie);
 	machine.find_cb = find_cb;
 	machine.user_data = user_data;
 
 	i = 0;
 	while (src[i] != '\0') {
-		guchar character = src[i++];
+		guchar character;
 		gboolean was_found;
 
+		if (machine.dfa && purple_trie_machine_is_reset(&machine)) {
+			i += purple_trie_dfa_skip(machine.dfa, src + i);
+			if (src[i] == '\0')
+				break;
+		}
+
+		character = src[i++];
 		purple_trie_advance(&machine, character);
 
 		was_found = purple_trie_find_do_discovery(&machine);
@@ -621,13 +1250,18 @@ purple_trie_find(PurpleTrie *trie, const gchar *src,
 	return found_count;
 }
 
+/* See purple_trie_multi_replace. */
 gulong
 purple_trie_multi_find(const GSList *tries, const gchar *src,
 	PurpleTrieFindCb find_cb, gpointer user_data)
 {
-	guint tries_count, m_idx;
-	PurpleTrieMachine *machines;
+	const PurpleTrieDfa *dfa;
+	guint tries_count, t_idx;
+	gboolean *reset_on_match, reset_all = TRUE;
+	gsize *reset_pos;
+	const GSList *it;
 	gulong found_count = 0;
+	guint32 state;
 	gsize i;
 
 	if (src == NULL)
@@ -637,59 +1271,75 @@ purple_trie_multi_find(const GSList *tries, const gchar *src,
 	if (tries_count == 0)
 		return 0;
 
-	/* Initialize all machines. */
-	machines = g_new(PurpleTrieMachine, tries_count);
-	for (i = 0; i < tries_count; i++, tries = tries->next) {
-		PurpleTrie *trie = tries->data;
-		PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+	reset_on_match = g_new(gboolean, tries_count);
+	for (it = tries, t_idx = 0; it != NULL; it = it->next, t_idx++) {
+		PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(it->data);
 
 		if (priv == NULL) {
 			g_warn_if_reached();
-			g_free(machines);
+			g_free(reset_on_match);
 			return 0;
 		}
 
-		purple_trie_states_build(trie);
-
-		machines[i].state = priv->root_state;
-		machines[i].root_state = priv->root_state;
-		machines[i].reset_on_match = priv->reset_on_match;
-		machines[i].find_cb = find_cb;
-		machines[i].user_data = user_data;
+		reset_on_match[t_idx] = priv->reset_on_match;
+		if (!priv->reset_on_match)
+			reset_all = FALSE;
 	}
+	reset_pos = g_new0(gsize, tries_count);
 
+	dfa = purple_trie_dfa_get_merged(tries, tries_count);
+
+	state = 0;
 	i = 0;
 	while (src[i] != '\0') {
-		guchar character = src[i++];
 		gboolean was_found = FALSE;
 
-		/* Advance every machine and possibly perform a replacement. */
-		for (m_idx = 0; m_idx < tries_count; m_idx++) {
-			purple_trie_advance(&machines[m_idx], character);
-			if (was_found)
+		if (state == 0) {
+			i += purple_trie_dfa_skip(dfa, src + i);
+			if (src[i] == '\0')
+				break;
+		}
+
+		state = purple_trie_dfa_advance(dfa, state, src[i++]);
+
+		for (t_idx = 0; t_idx < tries_count; t_idx++) {
+			PurpleTrieRecord *found_word;
+
+			found_word = purple_trie_dfa_found_word(dfa, state,
+				t_idx, i - reset_pos[t_idx]);
+			if (found_word == NULL)
 				continue;
-			was_found =
-				purple_trie_find_do_discovery(&machines[m_idx]);
-			if (was_found)
+
+			if (find_cb) {
+				was_found = find_cb(found_word->word,
+					found_word->data, user_data);
+			} else
+				was_found = TRUE;
+
+			if (was_found) {
 				found_count++;
+				break;
+			}
 		}
 
-		/* If we replaced a word, reset _all_ machines */
-		if (was_found) {
-			for (m_idx = 0; m_idx < tries_count; m_idx++) {
-				if (!machines[m_idx].reset_on_match)
-					continue;
-				machines[m_idx].state =
-					machines[m_idx].root_state;
-			}
+		if (!was_found)
+			continue;
+
+		/* If we found a word, reset all machines, that should be
+		 * reset on match. */
+		if (reset_all)
+			state = 0;
+		for (t_idx = 0; t_idx < tries_count; t_idx++) {
+			if (reset_on_match[t_idx])
+				reset_pos[t_idx] = i;
 		}
 	}
 
-	g_free(machines);
+	g_free(reset_pos);
+	g_free(reset_on_match);
 	return found_count;
 }
 
-
 /*******************************************************************************
  * Records
  ******************************************************************************/
@@ -709,10 +1359,10 @@ purple_trie_add(PurpleTrie *trie, const gchar *word, gpointer data)
 		return FALSE;
 	}
 
-	/* Every change in a trie invalidates longest_suffix map.
-	 * These prefixes could be updated instead of cleaning the whole graph.
-	 */
-	purple_trie_states_cleanup(trie);
+	/* The compiled form is always rebuilt from scratch. */
+	purple_trie_dfa_free(priv->dfa);
+	priv->dfa = NULL;
+	priv->generation++;
 
 	rec = purple_memory_pool_alloc(priv->records_obj_mempool,
 		sizeof(PurpleTrieRecord), sizeof(gpointer));
@@ -721,6 +1371,10 @@ purple_trie_add(PurpleTrie *trie, const gchar *word, gpointer data)
 	g_assert(rec->word_len > 0);
 	rec->data = data;
 
+	/* The states are patched in place, if they were built already. */
+	if (priv->root_state != NULL && !purple_trie_states_insert(trie, rec))
+		purple_trie_states_cleanup(trie);
+
 	priv->records_total_size += rec->word_len;
 	priv->records = purple_record_list_prepend(priv->records_obj_mempool,
 		priv->records, rec);
@@ -744,7 +1398,12 @@ purple_trie_remove(PurpleTrie *trie, const gchar *word)
 		return;
 
 	/* see purple_trie_add */
-	purple_trie_states_cleanup(trie);
+	purple_trie_dfa_free(priv->dfa);
+	priv->dfa = NULL;
+	priv->generation++;
+
+	if (priv->root_state != NULL)
+		purple_trie_states_remove(trie, it->rec);
 
 	priv->records_total_size -= it->rec->word_len;
 	priv->records = purple_record_list_remove(priv->records, it);
@@ -753,6 +1412,10 @@ purple_trie_remove(PurpleTrie *trie, const gchar *word)
 	purple_memory_pool_free(priv->records_str_mempool, it->rec->word);
 	purple_memory_pool_free(priv->records_obj_mempool, it->rec);
 	purple_memory_pool_free(priv->records_obj_mempool, it);
+
+	/* Rebuild the states, when they are mostly unused. */
+	if (priv->states_unused_size > priv->records_total_size)
+		purple_trie_states_cleanup(trie);
 }
 
 guint
@@ -791,6 +1454,31 @@ purple_trie_set_reset_on_match(PurpleTrie *trie, gboolean reset)
 	g_object_notify_by_pspec(G_OBJECT(trie), properties[PROP_RESET_ON_MATCH]);
 }
 
+gboolean
+purple_trie_get_compiled(PurpleTrie *trie)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+
+	g_return_val_if_fail(priv, FALSE);
+
+	return priv->compiled;
+}
+
+void
+purple_trie_set_compiled(PurpleTrie *trie, gboolean compiled)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+
+	g_return_if_fail(priv);
+
+	if (priv->compiled == compiled)
+		return;
+
+	priv->compiled = compiled;
+	purple_trie_states_cleanup(trie);
+	g_object_notify_by_pspec(G_OBJECT(trie), properties[PROP_COMPILED]);
+}
+
 /*******************************************************************************
  * Object stuff
  ******************************************************************************/
@@ -810,10 +1498,16 @@ purple_trie_init(GTypeInstance *instance, gpointer klass)
 	priv->records_obj_mempool = purple_memory_pool_new();
 	priv->records_str_mempool = purple_memory_pool_new();
 	priv->states_mempool = purple_memory_pool_new();
+	purple_memory_pool_set_recycle(priv->records_obj_mempool, TRUE);
+	purple_memory_pool_set_recycle(priv->records_str_mempool, TRUE);
+	purple_memory_pool_set_recycle(priv->states_mempool, TRUE);
 	purple_memory_pool_set_block_size(priv->states_mempool,
 		PURPLE_TRIE_STATES_SMALL_POOL_BLOCK_SIZE);
 
 	priv->records_map = g_hash_table_new(g_str_hash, g_str_equal);
+
+	priv->serial = ++last_serial;
+	g_queue_init(&priv->merged_cache);
 }
 
 static void
@@ -821,6 +1515,9 @@ purple_trie_finalize(GObject *obj)
 {
 	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(obj);
 
+	purple_trie_dfa_free(priv->dfa);
+	while (!g_queue_is_empty(&priv->merged_cache))
+		purple_trie_dfa_free(g_queue_pop_head(&priv->merged_cache));
 	g_hash_table_destroy(priv->records_map);
 	g_object_unref(priv->records_obj_mempool);
 	g_object_unref(priv->records_str_mempool);
@@ -840,6 +1537,9 @@ purple_trie_get_property(GObject *obj, guint param_id, GValue *value,
 		case PROP_RESET_ON_MATCH:
 			g_value_set_boolean(value, priv->reset_on_match);
 			break;
+		case PROP_COMPILED:
+			g_value_set_boolean(value, priv->compiled);
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 	}
@@ -856,6 +1556,10 @@ purple_trie_set_property(GObject *obj, guint param_id,
 		case PROP_RESET_ON_MATCH:
 			priv->reset_on_match = g_value_get_boolean(value);
 			break;
+		case PROP_COMPILED:
+			purple_trie_set_compiled(trie,
+				g_value_get_boolean(value));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 	}
@@ -883,6 +1587,14 @@ purple_trie_class_init(PurpleTrieClass *klass)
 		"you perform only find operations.", TRUE,
 		G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
 
+	properties[PROP_COMPILED] = g_param_spec_boolean("compiled",
+		"Compiled", "Determines, if the trie should be compiled into "
+		"a dense state table before searching. It makes searches "
+		"considerably faster at the cost of a longer rebuild after "
+		"every modification, so it's best suited for dictionaries, "
+		"that rarely change.", FALSE,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
+
 	g_object_class_install_properties(obj_class, PROP_LAST, properties);
 }
 
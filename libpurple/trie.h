@@ -34,19 +34,23 @@
  * within multiple source texts (or a single, big one).
  *
  * It's preparation time is <literal>O(p)</literal>, where <literal>p</literal>
- * is the total length of searched phrases. In current implementation, the
- * internal structure is invalidated after every modification of the
- * #PurpleTrie's contents, so it's not efficient to do alternating modifications
- * and searches. Search time does not depend on patterns being stored within
+ * is the total length of searched phrases. Once prepared, the internal
+ * structure is updated in place on every modification of the #PurpleTrie's
+ * contents, touching only the altered word's branch and the nodes, that have
+ * it as a suffix. Search time does not depend on patterns being stored within
  * a trie and is always <literal>O(n)</literal>, where <literal>n</literal> is
  * the size of a text.
  *
  * Its main drawback is a significant memory usage - every internal trie node
  * needs about 1kB of memory on 32-bit machine and 2kB on 64-bit. Fortunately,
  * the trie grows slower when more words (with common prefixes) are added.
- * We could avoid invalidating the whole tree when altering it, but it would
- * require figuring out, how to update <literal>longest_suffix</literal> fields
- * in satisfying time.
+ *
+ * For dictionaries, that are searched much more often than modified, the trie
+ * may be switched to a compiled mode (see #PurpleTrie:compiled). In this mode,
+ * all words are frozen into a single state table with only as many columns as
+ * there are distinct characters used in the words. It takes much less memory
+ * and every character of the text is processed with a single table lookup.
+ * Parts of the text, that can't start any word, are skipped at once.
  */
 
 #include <glib-object.h>
@@ -180,6 +184,32 @@ purple_trie_get_reset_on_match(PurpleTrie *trie);
 void
 purple_trie_set_reset_on_match(PurpleTrie *trie, gboolean reset);
 
+/**
+ * purple_trie_get_compiled:
+ * @trie: the trie.
+ *
+ * Checks, if the trie is searched using its compiled form.
+ *
+ * Returns: %TRUE, if the trie is compiled, %FALSE otherwise.
+ */
+gboolean
+purple_trie_get_compiled(PurpleTrie *trie);
+
+/**
+ * purple_trie_set_compiled:
+ * @trie: the trie.
+ * @compiled: %TRUE, if trie should be compiled, %FALSE otherwise.
+ *
+ * Enables or disables the compiled mode. A compiled trie is built into a dense
+ * state table on the occasion of the next search. Searching it is
+ * significantly faster, but every modification requires a full rebuild,
+ * so it's intended for tries, that are rarely modified.
+ *
+ * The results of all searches are the same in both modes.
+ */
+void
+purple_trie_set_compiled(PurpleTrie *trie, gboolean compiled);
+
 /**
  * purple_trie_add:
  * @trie: the trie.
@@ -189,10 +219,10 @@ purple_trie_set_reset_on_match(PurpleTrie *trie, gboolean reset);
  * Adds a word to the trie. Current implementation doesn't allow for duplicates,
  * so please avoid adding those.
  *
- * Please note, that altering a trie invalidates its internal structure, so by
- * the occasion of next search, it will be rebuilt. It's done in
- * <literal>O(n)</literal>, where n is the total length of strings
- * in #PurpleTrie.
+ * If the trie's internal structure is already built, it's updated in place,
+ * which usually takes time proportional to the length of @word. A compiled
+ * trie (see #PurpleTrie:compiled) is rebuilt from scratch by the occasion
+ * of next search.
  *
  * Returns: %TRUE if succeeded, %FALSE otherwise.
  */
@@ -208,8 +238,9 @@ purple_trie_add(PurpleTrie *trie, const gchar *word, gpointer data);
  * free allocated memory (that will be freed when destroying the whole
  * collection), so use it wisely. See #purple_memory_pool_free.
  *
- * Please note, that altering a trie invalidates its internal structure.
- * See #purple_trie_add.
+ * The trie's internal structure is updated in place, see #purple_trie_add.
+ * When removed words make up a large part of it, it's rebuilt from scratch
+ * by the occasion of next search.
  */
 void
 purple_trie_remove(PurpleTrie *trie, const gchar *word);
@@ -256,6 +287,12 @@ purple_trie_replace(PurpleTrie *trie, const gchar *src,
  * Different #GSList's can be combined to possess common parts, so you can create
  * a "tree of tries".
  *
+ * All tries are merged into a single automaton, so @src is scanned only once,
+ * regardless of the number of tries. The merged automaton is cached within
+ * the first trie on the list and rebuilt after any of the tries is modified.
+ * Thus, it's best to put the trie, that is most likely to be shared between
+ * different lists, on the first place.
+ *
  * Returns: resulting string. Must be #g_free'd when you are done using it.
  */
 gchar *
@@ -295,6 +332,8 @@ purple_trie_find(PurpleTrie *trie, const gchar *src,
  * Different #GSList's can be combined to possess common parts, so you can create
  * a "tree of tries".
  *
+ * See #purple_trie_multi_replace for the notes on merging tries.
+ *
  * Returns: the number of found words.
  */
 gulong
@@ -44,6 +44,14 @@ static char *user_dir = NULL;
 static JsonNode *escape_js_node = NULL;
 static JsonGenerator *escape_js_gen = NULL;
 
+/* The number of names kept by each normalization cache. */
+#define NORMALIZE_CACHE_SIZE 4096
+
+/* PurpleAccount* (or NULL) => NormalizeCache* */
+static GHashTable *normalize_caches = NULL;
+static guint64 normalize_cache_hits = 0;
+static guint64 normalize_cache_misses = 0;
+
 PurpleMenuAction *
 purple_menu_action_new(const char *label, PurpleCallback callback, gpointer data,
                      GList *children)
@@ -161,6 +169,11 @@ purple_util_uninit(void)
 
 	g_object_unref(escape_js_gen);
 	escape_js_gen = NULL;
+
+	if (normalize_caches != NULL) {
+		g_hash_table_destroy(normalize_caches);
+		normalize_caches = NULL;
+	}
 }
 
 /**************************************************************************
@@ -3476,15 +3489,110 @@ purple_strequal(const gchar *left, const gchar *right)
 	return (g_strcmp0(left, right) == 0);
 }
 
-const char *
-purple_normalize(const PurpleAccount *account, const char *str)
+/*
+ * A bounded cache of normalized names for one account.  The LRU queue holds
+ * the entries, most recently used first, and the hash table maps the raw
+ * names to their links in it.
+ */
+typedef struct {
+	PurpleAccount *account;
+	GHashTable *names;
+	GQueue lru;
+} NormalizeCache;
+
+typedef struct {
+	char *str;
+	char *normalized;
+} NormalizeCacheEntry;
+
+static void
+normalize_cache_entry_free(NormalizeCacheEntry *entry)
+{
+	g_free(entry->str);
+	g_free(entry->normalized);
+	g_slice_free(NormalizeCacheEntry, entry);
+}
+
+static void
+normalize_cache_clear(NormalizeCache *cache)
+{
+	NormalizeCacheEntry *entry;
+
+	g_hash_table_remove_all(cache->names);
+	while ((entry = g_queue_pop_head(&cache->lru)) != NULL)
+		normalize_cache_entry_free(entry);
+}
+
+static void
+normalize_cache_connection_changed(GObject *account, GParamSpec *pspec,
+		NormalizeCache *cache)
+{
+	/* Protocols may normalize differently without a connection. */
+	normalize_cache_clear(cache);
+}
+
+static void
+normalize_cache_account_finalized(gpointer unused, GObject *account)
+{
+	NormalizeCache *cache = g_hash_table_lookup(normalize_caches, account);
+
+	/* Signal handlers and weak references are gone already. */
+	cache->account = NULL;
+	g_hash_table_remove(normalize_caches, account);
+}
+
+static void
+normalize_cache_free(NormalizeCache *cache)
+{
+	if (cache->account != NULL) {
+		g_signal_handlers_disconnect_by_func(cache->account,
+				normalize_cache_connection_changed, cache);
+		g_object_weak_unref(G_OBJECT(cache->account),
+				normalize_cache_account_finalized, NULL);
+	}
+
+	normalize_cache_clear(cache);
+	g_hash_table_destroy(cache->names);
+	g_slice_free(NormalizeCache, cache);
+}
+
+static NormalizeCache *
+normalize_cache_get(const PurpleAccount *account)
+{
+	NormalizeCache *cache;
+
+	if (normalize_caches == NULL) {
+		normalize_caches = g_hash_table_new_full(g_direct_hash,
+				g_direct_equal, NULL, (GDestroyNotify)normalize_cache_free);
+	}
+
+	cache = g_hash_table_lookup(normalize_caches, account);
+	if (cache != NULL)
+		return cache;
+
+	cache = g_slice_new0(NormalizeCache);
+	cache->account = (PurpleAccount *)account;
+	cache->names = g_hash_table_new(g_str_hash, g_str_equal);
+	g_queue_init(&cache->lru);
+
+	if (account != NULL) {
+		g_signal_connect(cache->account, "notify::connection",
+				G_CALLBACK(normalize_cache_connection_changed), cache);
+		g_object_weak_ref(G_OBJECT(cache->account),
+				normalize_cache_account_finalized, NULL);
+	}
+
+	g_hash_table_insert(normalize_caches, cache->account, cache);
+
+	return cache;
+}
+
+static const char *
+normalize_uncached(const PurpleAccount *account, const char *str)
 {
 	const char *ret = NULL;
 	static char buf[BUF_LEN];
 
-	/* This should prevent a crash if purple_normalize gets called with NULL str, see #10115 */
-	g_return_val_if_fail(str != NULL, "");
-
 	if (account != NULL)
 	{
 		PurpleProtocol *protocol =
@@ -3508,6 +3616,67 @@ purple_normalize(const PurpleAccount *account, const char *str)
 	return ret;
 }
 
+const char *
+purple_normalize(const PurpleAccount *account, const char *str)
+{
+	NormalizeCache *cache;
+	NormalizeCacheEntry *entry;
+	GList *link;
+
+	/* This should prevent a crash if purple_normalize gets called with NULL str, see #10115 */
+	g_return_val_if_fail(str != NULL, "");
+
+	cache = normalize_cache_get(account);
+
+	link = g_hash_table_lookup(cache->names, str);
+	if (link != NULL) {
+		normalize_cache_hits++;
+		g_queue_unlink(&cache->lru, link);
+		g_queue_push_head_link(&cache->lru, link);
+		return ((NormalizeCacheEntry *)link->data)->normalized;
+	}
+
+	normalize_cache_misses++;
+
+	entry = g_slice_new(NormalizeCacheEntry);
+	entry->str = g_strdup(str);
+	entry->normalized = g_strdup(normalize_uncached(account, str));
+	g_queue_push_head(&cache->lru, entry);
+	g_hash_table_insert(cache->names, entry->str, cache->lru.head);
+
+	/* The new entry is at the head, so it's never the one evicted. */
+	if (cache->lru.length > NORMALIZE_CACHE_SIZE) {
+		NormalizeCacheEntry *old = g_queue_pop_tail(&cache->lru);
+
+		g_hash_table_remove(cache->names, old->str);
+		normalize_cache_entry_free(old);
+	}
+
+	return entry->normalized;
+}
+
+void
+purple_normalize_invalidate(const PurpleAccount *account)
+{
+	NormalizeCache *cache;
+
+	if (normalize_caches == NULL)
+		return;
+
+	cache = g_hash_table_lookup(normalize_caches, account);
+	if (cache != NULL)
+		normalize_cache_clear(cache);
+}
+
+void
+purple_normalize_get_cache_stats(guint64 *hits, guint64 *misses)
+{
+	if (hits != NULL)
+		*hits = normalize_cache_hits;
+	if (misses != NULL)
+		*misses = normalize_cache_misses;
+}
+
 /*
  * You probably don't want to call this directly, it is
  * mainly for use as a protocol callback function.  See the
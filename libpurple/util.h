@@ -965,15 +965,37 @@ gboolean purple_strequal(const gchar *left, const gchar *right);
  *
  * Normalizes a string, so that it is suitable for comparison.
  *
- * The returned string will point to a static buffer, so if the
- * string is intended to be kept long-term, you <emphasis>must</emphasis>
- * g_strdup() it. Also, calling normalize() twice in the same line
- * will lead to problems.
+ * The results are cached for each account.  Protocols whose normalization
+ * changes, other than when the account's connection does, must call
+ * purple_normalize_invalidate().
  *
- * Returns: A pointer to the normalized version stored in a static buffer.
+ * Returns: The normalized version of the string.  It belongs to the cache
+ *          and is only guaranteed to stay valid until the next call to
+ *          purple_normalize() or purple_normalize_invalidate(), so copy it
+ *          if you need to keep it.
  */
 const char *purple_normalize(const PurpleAccount *account, const char *str);
 
+/**
+ * purple_normalize_invalidate:
+ * @account:  The account, or %NULL.
+ *
+ * Forgets the names of an account cached by purple_normalize(), because
+ * they may normalize differently now.
+ */
+void purple_normalize_invalidate(const PurpleAccount *account);
+
+/**
+ * purple_normalize_get_cache_stats:
+ * @hits:   (out) (optional): Return location for the number of names
+ *          purple_normalize() found in its cache.
+ * @misses: (out) (optional): Return location for the number of names it had
+ *          to normalize.
+ *
+ * Gets the statistics of the purple_normalize() cache.
+ */
+void purple_normalize_get_cache_stats(guint64 *hits, guint64 *misses);
+
 /**
  * purple_normalize_nocase:
  * @account:  The account the string belongs to.
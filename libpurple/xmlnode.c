@@ -91,6 +91,81 @@ purple_xmlnode_new_child(PurpleXmlNode *parent, const char *name)
 	return node;
 }
 
+/* Nodes with at least this many tag children get their children indexed by
+ * name the first time a lookup has to walk past all of them. */
+#define PURPLE_XMLNODE_INDEX_MIN_CHILDREN 32
+
+/* Adds child at the end of the index of its parent. The keys of the index
+ * are the names of the first child in each list, so they live as long as
+ * the list does. */
+static void
+purple_xmlnode_index_add(GHashTable *index, PurpleXmlNode *child)
+{
+	GPtrArray *twins = g_hash_table_lookup(index, child->name);
+
+	if (twins == NULL) {
+		twins = g_ptr_array_new();
+		g_hash_table_insert(index, child->name, twins);
+	}
+	g_ptr_array_add(twins, child);
+}
+
+/* Takes child out of the index of its parent. If the list was keyed by the
+ * name of child, the next child in it takes over the key. */
+static void
+purple_xmlnode_index_remove(GHashTable *index, PurpleXmlNode *child)
+{
+	gpointer key, value;
+	GPtrArray *twins;
+
+	if (!g_hash_table_lookup_extended(index, child->name, &key, &value))
+		return;
+
+	twins = value;
+	if (!g_ptr_array_remove(twins, child))
+		return;
+
+	if (twins->len == 0) {
+		g_hash_table_remove(index, key);
+	} else if (key == child->name) {
+		PurpleXmlNode *next = g_ptr_array_index(twins, 0);
+
+		g_hash_table_steal(index, key);
+		g_hash_table_insert(index, next->name, twins);
+	}
+}
+
+static void
+purple_xmlnode_index_free_twins(gpointer twins)
+{
+	g_ptr_array_free(twins, TRUE);
+}
+
+static GHashTable *
+purple_xmlnode_index_build(PurpleXmlNode *parent)
+{
+	PurpleXmlNode *x;
+
+	parent->child_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+			NULL, purple_xmlnode_index_free_twins);
+
+	for (x = parent->child; x; x = x->next) {
+		if (x->type == PURPLE_XMLNODE_TYPE_TAG)
+			purple_xmlnode_index_add(parent->child_index, x);
+	}
+
+	return parent->child_index;
+}
+
+static void
+purple_xmlnode_index_drop(PurpleXmlNode *parent)
+{
+	if (parent->child_index != NULL) {
+		g_hash_table_destroy(parent->child_index);
+		parent->child_index = NULL;
+	}
+}
+
 void
 purple_xmlnode_insert_child(PurpleXmlNode *parent, PurpleXmlNode *child)
 {
@@ -106,6 +181,112 @@ purple_xmlnode_insert_child(PurpleXmlNode *parent, PurpleXmlNode *child)
 	}
 
 	parent->lastchild = child;
+
+	if (parent->child_index != NULL && child->type == PURPLE_XMLNODE_TYPE_TAG)
+		purple_xmlnode_index_add(parent->child_index, child);
+}
+
+void
+purple_xmlnode_unlink(PurpleXmlNode *node)
+{
+	PurpleXmlNode *parent, *prev = NULL, *x;
+
+	g_return_if_fail(node != NULL);
+
+	parent = node->parent;
+	if (parent == NULL)
+		return;
+
+	for (x = parent->child; x != NULL && x != node; x = x->next)
+		prev = x;
+
+	if (x != NULL) {
+		if (prev != NULL)
+			prev->next = node->next;
+		else
+			parent->child = node->next;
+		if (parent->lastchild == node)
+			parent->lastchild = prev;
+	}
+
+	if (parent->child_index != NULL && node->type == PURPLE_XMLNODE_TYPE_TAG)
+		purple_xmlnode_index_remove(parent->child_index, node);
+
+	node->parent = NULL;
+	node->next = NULL;
+}
+
+/* Puts node in the index of parent in the place of old. */
+static void
+purple_xmlnode_index_replace(PurpleXmlNode *parent, PurpleXmlNode *old,
+		PurpleXmlNode *node)
+{
+	gpointer key, value;
+	GPtrArray *twins;
+	guint i;
+
+	/* A tag named otherwise would have to be put among its twins, which
+	 * takes a walk of the children anyway. The index is rebuilt on the
+	 * next lookup that needs it. */
+	if (old->type != PURPLE_XMLNODE_TYPE_TAG ||
+			node->type != PURPLE_XMLNODE_TYPE_TAG ||
+			!purple_strequal(old->name, node->name) ||
+			!g_hash_table_lookup_extended(parent->child_index, old->name,
+				&key, &value)) {
+		if (old->type == PURPLE_XMLNODE_TYPE_TAG ||
+				node->type == PURPLE_XMLNODE_TYPE_TAG)
+			purple_xmlnode_index_drop(parent);
+		return;
+	}
+
+	twins = value;
+	for (i = 0; i < twins->len; i++) {
+		if (g_ptr_array_index(twins, i) == old)
+			break;
+	}
+	if (i == twins->len) {
+		purple_xmlnode_index_drop(parent);
+		return;
+	}
+
+	g_ptr_array_index(twins, i) = node;
+	if (key == old->name) {
+		g_hash_table_steal(parent->child_index, key);
+		g_hash_table_insert(parent->child_index, node->name, twins);
+	}
+}
+
+void
+purple_xmlnode_replace(PurpleXmlNode *old, PurpleXmlNode *node)
+{
+	PurpleXmlNode *parent, *prev = NULL, *x;
+
+	g_return_if_fail(old != NULL);
+	g_return_if_fail(node != NULL);
+	g_return_if_fail(node->parent == NULL);
+
+	parent = old->parent;
+	if (parent == NULL)
+		return;
+
+	for (x = parent->child; x != NULL && x != old; x = x->next)
+		prev = x;
+	g_return_if_fail(x != NULL);
+
+	node->parent = parent;
+	node->next = old->next;
+	if (prev != NULL)
+		prev->next = node;
+	else
+		parent->child = node;
+	if (parent->lastchild == old)
+		parent->lastchild = node;
+
+	if (parent->child_index != NULL)
+		purple_xmlnode_index_replace(parent, old, node);
+
+	old->parent = NULL;
+	old->next = NULL;
 }
 
 void
@@ -380,23 +561,10 @@ purple_xmlnode_free(PurpleXmlNode *node)
 	g_return_if_fail(node != NULL);
 
 	/* if we're part of a tree, remove ourselves from the tree first */
-	if(NULL != node->parent) {
-		if(node->parent->child == node) {
-			node->parent->child = node->next;
-			if (node->parent->lastchild == node)
-				node->parent->lastchild = node->next;
-		} else {
-			PurpleXmlNode *prev = node->parent->child;
-			while(prev && prev->next != node) {
-				prev = prev->next;
-			}
-			if(prev) {
-				prev->next = node->next;
-				if (node->parent->lastchild == node)
-					node->parent->lastchild = prev;
-			}
-		}
-	}
+	purple_xmlnode_unlink(node);
+
+	/* our children are going away in order, so the index is no use */
+	purple_xmlnode_index_drop(node);
 
 	/* now free our children */
 	x = node->child;
@@ -425,37 +593,157 @@ purple_xmlnode_get_child(const PurpleXmlNode *parent, const char *name)
 	return purple_xmlnode_get_child_with_namespace(parent, name, NULL);
 }
 
+/* Whether x is a tag named by the len bytes at name, in ns if that's set. */
+static inline gboolean
+purple_xmlnode_child_matches(const PurpleXmlNode *x, const char *name,
+		gsize len, const char *ns)
+{
+	/* XXX: Is it correct to ignore the namespace for the match if none was specified? */
+	return x->type == PURPLE_XMLNODE_TYPE_TAG &&
+			strncmp(x->name, name, len) == 0 && x->name[len] == '\0' &&
+			(ns == NULL || purple_strequal(ns, x->xmlns));
+}
+
+static PurpleXmlNode *
+purple_xmlnode_index_lookup(GHashTable *index, const char *name, gsize len,
+		const char *ns)
+{
+	char buf[64], *key = buf;
+	GPtrArray *twins;
+	guint i;
+
+	if (name[len] == '\0')
+		key = (char *)name;
+	else if (len < sizeof(buf)) {
+		memcpy(buf, name, len);
+		buf[len] = '\0';
+	} else
+		key = g_strndup(name, len);
+
+	twins = g_hash_table_lookup(index, key);
+
+	if (key != buf && key != name)
+		g_free(key);
+
+	if (twins == NULL)
+		return NULL;
+
+	for (i = 0; i < twins->len; i++) {
+		PurpleXmlNode *x = g_ptr_array_index(twins, i);
+		if (ns == NULL || purple_strequal(ns, x->xmlns))
+			return x;
+	}
+
+	return NULL;
+}
+
+/* Finds the first child of parent named by the len bytes at name. Wide nodes
+ * are indexed the first time a lookup misses in their first
+ * PURPLE_XMLNODE_INDEX_MIN_CHILDREN tags, so that repeated lookups in, say, a
+ * roster push don't walk thousands of <item/>s each time. */
+static PurpleXmlNode *
+purple_xmlnode_find_child(const PurpleXmlNode *parent, const char *name,
+		gsize len, const char *ns)
+{
+	PurpleXmlNode *x;
+	guint tags = 0;
+
+	if (parent->child_index != NULL)
+		return purple_xmlnode_index_lookup(parent->child_index, name, len, ns);
+
+	for (x = parent->child; x; x = x->next) {
+		if (purple_xmlnode_child_matches(x, name, len, ns))
+			return x;
+		if (x->type == PURPLE_XMLNODE_TYPE_TAG &&
+				++tags == PURPLE_XMLNODE_INDEX_MIN_CHILDREN)
+			break;
+	}
+
+	if (x == NULL)
+		return NULL;
+
+	/* The index is only a cache of the children, so building it doesn't
+	 * really change parent. */
+	return purple_xmlnode_index_lookup(
+			purple_xmlnode_index_build((PurpleXmlNode *)parent), name, len, ns);
+}
+
 PurpleXmlNode *
 purple_xmlnode_get_child_with_namespace(const PurpleXmlNode *parent, const char *name, const char *ns)
 {
-	PurpleXmlNode *x, *ret = NULL;
-	char **names;
-	char *parent_name, *child_name;
+	PurpleXmlNode *ret;
+	const char *slash;
 
 	g_return_val_if_fail(parent != NULL, NULL);
 	g_return_val_if_fail(name != NULL, NULL);
 
-	names = g_strsplit(name, "/", 2);
-	parent_name = names[0];
-	child_name = names[1];
+	slash = strchr(name, '/');
+	if (slash == NULL)
+		return purple_xmlnode_find_child(parent, name, strlen(name), ns);
 
-	for(x = parent->child; x; x = x->next) {
-		/* XXX: Is it correct to ignore the namespace for the match if none was specified? */
-		const char *xmlns = NULL;
-		if(ns)
-			xmlns = purple_xmlnode_get_namespace(x);
+	ret = purple_xmlnode_find_child(parent, name, slash - name, ns);
+	if (ret == NULL)
+		return NULL;
 
-		if(x->type == PURPLE_XMLNODE_TYPE_TAG && purple_strequal(parent_name, x->name)
-				&& purple_strequal(ns, xmlns)) {
-			ret = x;
-			break;
-		}
-	}
+	return purple_xmlnode_get_child(ret, slash + 1);
+}
+
+struct _PurpleXmlPath
+{
+	char *xmlns;
+	guint steps;
+	char **names;
+	gsize *lengths;
+};
+
+PurpleXmlPath *
+purple_xmlnode_path_new(const char *path, const char *xmlns)
+{
+	PurpleXmlPath *ret;
+	guint i;
+
+	g_return_val_if_fail(path != NULL && *path != '\0', NULL);
+
+	ret = g_new0(PurpleXmlPath, 1);
+	ret->xmlns = g_strdup(xmlns);
+	ret->names = g_strsplit(path, "/", -1);
+	ret->steps = g_strv_length(ret->names);
+	ret->lengths = g_new(gsize, ret->steps);
 
-	if(child_name && ret)
-		ret = purple_xmlnode_get_child(ret, child_name);
+	for (i = 0; i < ret->steps; i++)
+		ret->lengths[i] = strlen(ret->names[i]);
+
+	return ret;
+}
+
+void
+purple_xmlnode_path_free(PurpleXmlPath *path)
+{
+	if (path == NULL)
+		return;
+
+	g_free(path->xmlns);
+	g_strfreev(path->names);
+	g_free(path->lengths);
+	g_free(path);
+}
+
+PurpleXmlNode *
+purple_xmlnode_path_get(const PurpleXmlPath *path, const PurpleXmlNode *node)
+{
+	PurpleXmlNode *ret = (PurpleXmlNode *)node;
+	guint i;
+
+	g_return_val_if_fail(path != NULL, NULL);
+	g_return_val_if_fail(node != NULL, NULL);
+
+	/* Like purple_xmlnode_get_child_with_namespace(), the namespace only
+	 * applies to the first step. */
+	for (i = 0; i < path->steps && ret != NULL; i++) {
+		ret = purple_xmlnode_find_child(ret, path->names[i],
+				path->lengths[i], i == 0 ? path->xmlns : NULL);
+	}
 
-	g_strfreev(names);
 	return ret;
 }
 
@@ -494,6 +782,75 @@ purple_xmlnode_get_data_unescaped(const PurpleXmlNode *node)
 	return unescaped;
 }
 
+/* Appends text to str, escaped like g_markup_escape_text() does, without
+ * allocating a temporary string. */
+static void
+purple_xmlnode_append_escaped(GString *str, const char *text, gssize len)
+{
+	const guchar *p, *run, *end;
+
+	if (len < 0)
+		len = strlen(text);
+
+	p = run = (const guchar *)text;
+	end = p + len;
+
+	while (p < end) {
+		const char *entity = NULL;
+		guint ctrl = 0;
+		gsize skip = 1;
+
+		switch (*p) {
+			case '&':
+				entity = "&amp;";
+				break;
+			case '<':
+				entity = "&lt;";
+				break;
+			case '>':
+				entity = "&gt;";
+				break;
+			case '\'':
+				entity = "&apos;";
+				break;
+			case '"':
+				entity = "&quot;";
+				break;
+			case '\t':
+			case '\n':
+			case '\r':
+				break;
+			case 0xc2:
+				/* C1 control characters, except for NEL. */
+				if (p + 1 < end && p[1] >= 0x80 && p[1] <= 0x9f &&
+						p[1] != 0x85) {
+					ctrl = p[1];
+					skip = 2;
+				}
+				break;
+			default:
+				if ((*p >= 0x01 && *p < 0x20) || *p == 0x7f)
+					ctrl = *p;
+				break;
+		}
+
+		if (entity == NULL && ctrl == 0) {
+			p++;
+			continue;
+		}
+
+		g_string_append_len(str, (const char *)run, p - run);
+		if (entity != NULL)
+			g_string_append(str, entity);
+		else
+			g_string_append_printf(str, "&#x%x;", ctrl);
+		p += skip;
+		run = p;
+	}
+
+	g_string_append_len(str, (const char *)run, p - run);
+}
+
 static void
 purple_xmlnode_to_str_foreach_append_ns(const char *key, const char *value,
 	GString *buf)
@@ -505,30 +862,35 @@ purple_xmlnode_to_str_foreach_append_ns(const char *key, const char *value,
 	}
 }
 
-static char *
-purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean formatting, int depth)
+static void
+purple_xmlnode_append_name(GString *text, const char *prefix, const char *name)
+{
+	if (prefix) {
+		g_string_append(text, prefix);
+		g_string_append_c(text, ':');
+	}
+	purple_xmlnode_append_escaped(text, name, -1);
+}
+
+/* Writes the whole tree into text, so serializing it copies every byte
+ * once. */
+static void
+purple_xmlnode_to_str_helper(const PurpleXmlNode *node, GString *text, gboolean formatting, int depth)
 {
-	GString *text = g_string_new("");
 	const char *prefix;
 	const PurpleXmlNode *c;
-	char *node_name, *esc, *esc2, *tab = NULL;
 	gboolean need_end = FALSE, pretty = formatting;
+	int i;
 
-	g_return_val_if_fail(node != NULL, NULL);
-
-	if(pretty && depth) {
-		tab = g_strnfill(depth, '\t');
-		text = g_string_append(text, tab);
+	if(pretty) {
+		for (i = 0; i < depth; i++)
+			g_string_append_c(text, '\t');
 	}
 
-	node_name = g_markup_escape_text(node->name, -1);
 	prefix = purple_xmlnode_get_prefix(node);
 
-	if (prefix) {
-		g_string_append_printf(text, "<%s:%s", prefix, node_name);
-	} else {
-		g_string_append_printf(text, "<%s", node_name);
-	}
+	g_string_append_c(text, '<');
+	purple_xmlnode_append_name(text, prefix, node->name);
 
 	if (node->namespace_map) {
 		g_hash_table_foreach(node->namespace_map,
@@ -546,24 +908,20 @@ purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean forma
 			parent_xmlns = purple_xmlnode_get_default_namespace(node->parent);
 		if (!purple_strequal(xmlns, parent_xmlns))
 		{
-			char *escaped_xmlns = g_markup_escape_text(xmlns, -1);
-			g_string_append_printf(text, " xmlns='%s'", escaped_xmlns);
-			g_free(escaped_xmlns);
+			g_string_append(text, " xmlns='");
+			purple_xmlnode_append_escaped(text, xmlns, -1);
+			g_string_append_c(text, '\'');
 		}
 	}
 	for(c = node->child; c; c = c->next)
 	{
 		if(c->type == PURPLE_XMLNODE_TYPE_ATTRIB) {
-			const char *aprefix = purple_xmlnode_get_prefix(c);
-			esc = g_markup_escape_text(c->name, -1);
-			esc2 = g_markup_escape_text(c->data, -1);
-			if (aprefix) {
-				g_string_append_printf(text, " %s:%s='%s'", aprefix, esc, esc2);
-			} else {
-				g_string_append_printf(text, " %s='%s'", esc, esc2);
-			}
-			g_free(esc);
-			g_free(esc2);
+			g_string_append_c(text, ' ');
+			purple_xmlnode_append_name(text, purple_xmlnode_get_prefix(c),
+				c->name);
+			g_string_append(text, "='");
+			purple_xmlnode_append_escaped(text, c->data, -1);
+			g_string_append_c(text, '\'');
 		} else if(c->type == PURPLE_XMLNODE_TYPE_TAG || c->type == PURPLE_XMLNODE_TYPE_DATA) {
 			if(c->type == PURPLE_XMLNODE_TYPE_DATA)
 				pretty = FALSE;
@@ -572,65 +930,73 @@ purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean forma
 	}
 
 	if(need_end) {
-		g_string_append_printf(text, ">%s", pretty ? NEWLINE_S : "");
+		g_string_append_c(text, '>');
+		if (pretty)
+			g_string_append(text, NEWLINE_S);
 
 		for(c = node->child; c; c = c->next)
 		{
 			if(c->type == PURPLE_XMLNODE_TYPE_TAG) {
-				int esc_len;
-				esc = purple_xmlnode_to_str_helper(c, &esc_len, pretty, depth+1);
-				text = g_string_append_len(text, esc, esc_len);
-				g_free(esc);
+				purple_xmlnode_to_str_helper(c, text, pretty, depth+1);
 			} else if(c->type == PURPLE_XMLNODE_TYPE_DATA && c->data_sz > 0) {
-				esc = g_markup_escape_text(c->data, c->data_sz);
-				text = g_string_append(text, esc);
-				g_free(esc);
+				purple_xmlnode_append_escaped(text, c->data, c->data_sz);
 			}
 		}
 
-		if(tab && pretty)
-			text = g_string_append(text, tab);
-		if (prefix) {
-			g_string_append_printf(text, "</%s:%s>%s", prefix, node_name, formatting ? NEWLINE_S : "");
-		} else {
-			g_string_append_printf(text, "</%s>%s", node_name, formatting ? NEWLINE_S : "");
+		if(pretty) {
+			for (i = 0; i < depth; i++)
+				g_string_append_c(text, '\t');
 		}
+		g_string_append(text, "</");
+		purple_xmlnode_append_name(text, prefix, node->name);
+		g_string_append_c(text, '>');
 	} else {
-		g_string_append_printf(text, "/>%s", formatting ? NEWLINE_S : "");
+		g_string_append(text, "/>");
 	}
 
-	g_free(node_name);
-
-	g_free(tab);
+	if (formatting)
+		g_string_append(text, NEWLINE_S);
+}
 
-	if(len)
-		*len = text->len;
+void
+purple_xmlnode_append_to_string(const PurpleXmlNode *node, GString *str)
+{
+	g_return_if_fail(node != NULL);
+	g_return_if_fail(str != NULL);
 
-	return g_string_free(text, FALSE);
+	purple_xmlnode_to_str_helper(node, str, FALSE, 0);
 }
 
 char *
 purple_xmlnode_to_str(const PurpleXmlNode *node, int *len)
 {
-	return purple_xmlnode_to_str_helper(node, len, FALSE, 0);
+	GString *text;
+
+	g_return_val_if_fail(node != NULL, NULL);
+
+	text = g_string_sized_new(256);
+	purple_xmlnode_to_str_helper(node, text, FALSE, 0);
+
+	if(len)
+		*len = text->len;
+
+	return g_string_free(text, FALSE);
 }
 
 char *
 purple_xmlnode_to_formatted_str(const PurpleXmlNode *node, int *len)
 {
-	char *xml, *xml_with_declaration;
+	GString *text;
 
 	g_return_val_if_fail(node != NULL, NULL);
 
-	xml = purple_xmlnode_to_str_helper(node, len, TRUE, 0);
-	xml_with_declaration =
-		g_strdup_printf("<?xml version='1.0' encoding='UTF-8' ?>" NEWLINE_S NEWLINE_S "%s", xml);
-	g_free(xml);
+	text = g_string_new("<?xml version='1.0' encoding='UTF-8' ?>" NEWLINE_S NEWLINE_S);
+	purple_xmlnode_to_str_helper(node, text, TRUE, 0);
 
 	if (len)
-		*len += sizeof("<?xml version='1.0' encoding='UTF-8' ?>" NEWLINE_S NEWLINE_S) - 1;
+		*len = text->len;
 
-	return xml_with_declaration;
+	return g_string_free(text, FALSE);
 }
 
 struct _xmlnode_parser_data {
@@ -62,6 +62,11 @@ typedef enum
  * @next:          The next node or %NULL.
  * @prefix:        The namespace prefix if any.
  * @namespace_map: The namespace map.
+ * @child_index:   The tag children by name, built the first time a lookup
+ *                 has to walk a wide node.  Code changing the children must
+ *                 go through purple_xmlnode_insert_child(),
+ *                 purple_xmlnode_unlink() and purple_xmlnode_replace(),
+ *                 which keep it up to date.
  *
  * An PurpleXmlNode.
  */
@@ -79,8 +84,17 @@ struct _PurpleXmlNode
 	PurpleXmlNode *next;
 	char *prefix;
 	GHashTable *namespace_map;
+	GHashTable *child_index;
 };
 
+/**
+ * PurpleXmlPath:
+ *
+ * A path of child names, compiled once by purple_xmlnode_path_new() to be
+ * looked up in many nodes.
+ */
+typedef struct _PurpleXmlPath PurpleXmlPath;
+
 G_BEGIN_DECLS
 
 /**
@@ -120,6 +134,25 @@ PurpleXmlNode *purple_xmlnode_new_child(PurpleXmlNode *parent, const char *name)
  */
 void purple_xmlnode_insert_child(PurpleXmlNode *parent, PurpleXmlNode *child);
 
+/**
+ * purple_xmlnode_unlink:
+ * @node: The node to take out of its parent.
+ *
+ * Takes a node out of its parent without freeing it.  Does nothing if the
+ * node has no parent.
+ */
+void purple_xmlnode_unlink(PurpleXmlNode *node);
+
+/**
+ * purple_xmlnode_replace:
+ * @old:  The node to replace.
+ * @node: The node to put in its place, which must not have a parent.
+ *
+ * Puts a node in the place of another one, and takes the other one out of
+ * its parent without freeing it.  Does nothing if @old has no parent.
+ */
+void purple_xmlnode_replace(PurpleXmlNode *old, PurpleXmlNode *node);
+
 /**
  * purple_xmlnode_get_child:
  * @parent: The parent node.
@@ -143,6 +176,38 @@ PurpleXmlNode *purple_xmlnode_get_child(const PurpleXmlNode *parent, const char
  */
 PurpleXmlNode *purple_xmlnode_get_child_with_namespace(const PurpleXmlNode *parent, const char *name, const char *xmlns);
 
+/**
+ * purple_xmlnode_path_new:
+ * @path:  The child names, separated by '/', such as "query/item".
+ * @xmlns: The namespace of the first child, or %NULL for any.
+ *
+ * Compiles a path for purple_xmlnode_path_get(), so that code looking up
+ * the same children in every stanza splits the path only once.
+ *
+ * Returns: The new path.  Free it with purple_xmlnode_path_free().
+ */
+PurpleXmlPath *purple_xmlnode_path_new(const char *path, const char *xmlns);
+
+/**
+ * purple_xmlnode_path_free:
+ * @path: The path to free.
+ *
+ * Frees a path compiled by purple_xmlnode_path_new().
+ */
+void purple_xmlnode_path_free(PurpleXmlPath *path);
+
+/**
+ * purple_xmlnode_path_get:
+ * @path: The compiled path.
+ * @node: The node to look the path up in.
+ *
+ * Gets the node at the end of a path, the same way
+ * purple_xmlnode_get_child_with_namespace() does, without allocating.
+ *
+ * Returns: The node or NULL.
+ */
+PurpleXmlNode *purple_xmlnode_path_get(const PurpleXmlPath *path, const PurpleXmlNode *node);
+
 /**
  * purple_xmlnode_get_next_twin:
  * @node: The node of a twin to find.
@@ -359,6 +424,17 @@ PurpleXmlNode *purple_xmlnode_get_parent(const PurpleXmlNode *child);
  */
 char *purple_xmlnode_to_str(const PurpleXmlNode *node, int *len);
 
+/**
+ * purple_xmlnode_append_to_string:
+ * @node: The starting node to output.
+ * @str:  The string to append to.
+ *
+ * Appends the node to a string, as xml. The result is the same as
+ * purple_xmlnode_to_str(), but a string can be reused to serialize many
+ * nodes without allocating.
+ */
+void purple_xmlnode_append_to_string(const PurpleXmlNode *node, GString *str);
+
 /**
  * purple_xmlnode_to_formatted_str:
  * @node: The starting node to output.
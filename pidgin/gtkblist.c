@@ -143,6 +143,10 @@ static GdkVisibilityState gtk_blist_visibility = GDK_VISIBILITY_UNOBSCURED;
 static gboolean gtk_blist_focused = FALSE;
 static gboolean editing_blist = FALSE;
 
+/* The buddies whose update is put off until their presence batch has been
+ * delivered, PurpleBlistNode* => itself. */
+static GHashTable *batch_update_buddies = NULL;
+
 static GList *pidgin_blist_sort_methods = NULL;
 static struct _PidginBlistSortMethod *current_sort_method = NULL;
 static void sort_method_none(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter);
@@ -152,6 +156,8 @@ static void sort_method_status(PurpleBlistNode *node, PurpleBuddyList *blist, Gt
 static void sort_method_log_activity(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter);
 static guint sort_merge_id;
 static GtkActionGroup *sort_action_group = NULL;
+/* The last contact or chat placed by sort_place() or sort_place_last() */
+static PurpleBlistNode *sort_placed_node = NULL;
 
 static PidginBuddyList *gtkblist = NULL;
 
@@ -162,8 +168,11 @@ static void pidgin_blist_selection_changed(GtkTreeSelection *selection, gpointer
 static void pidgin_blist_update(PurpleBuddyList *list, PurpleBlistNode *node);
 static void pidgin_blist_update_group(PurpleBuddyList *list, PurpleBlistNode *node);
 static void pidgin_blist_update_contact(PurpleBuddyList *list, PurpleBlistNode *node);
+static void pidgin_blist_update_contact_row(PurpleBuddyList *list, PurpleBlistNode *cnode);
+static void pidgin_blist_update_buddy_row(PurpleBuddyList *list, PurpleBlistNode *node);
 static char *pidgin_get_tooltip_text(PurpleBlistNode *node, gboolean full);
 static gboolean get_iter_from_node(PurpleBlistNode *node, GtkTreeIter *iter);
+static void sort_forget(PurpleBlistNode *node);
 static gboolean buddy_is_displayable(PurpleBuddy *buddy);
 static void redo_buddy_list(PurpleBuddyList *list, gboolean remove, gboolean rerender);
 static void pidgin_blist_collapse_contact_cb(GtkWidget *w, PurpleBlistNode *node);
@@ -176,6 +185,9 @@ typedef enum {
 	PIDGIN_BLIST_CHAT_HAS_PENDING_MESSAGE_WITH_NICK	 =  1 << 1,  /* Whether there's a pending message in a chat that mentions our nick */
 } PidginBlistNodeFlags;
 
+/* Whether node goes before the sibling n. */
+typedef gboolean (*SortBeforeFunc)(PurpleBlistNode *node, PurpleBlistNode *n);
+
 typedef struct _pidgin_blist_node {
 	GtkTreeRowReference *row;
 	gboolean contact_expanded;
@@ -185,6 +197,27 @@ typedef struct _pidgin_blist_node {
 		PurpleConversation *conv;
 		PidginBlistNodeFlags flags;
 	} conv;
+	/* What the sort methods compared the node by when they last placed
+	 * it, so that placing its siblings doesn't work them out again. */
+	struct {
+		char *name;       /* The name key was made from. */
+		char *key;        /* Collation key of the casefolded name. */
+		gint activity;    /* Log activity score. */
+		gboolean has_activity;
+		gboolean has_presence;
+		gboolean present; /* Whether it has a priority buddy. */
+		gboolean online;  /* The presence of the priority buddy. */
+		gint score;
+		time_t idle;
+		/* For a group, its contacts and chats in the order of the tree,
+		 * and what sort_place() compared them with. */
+		GSequence *children;
+		SortBeforeFunc children_before;
+		GtkTreeStore *children_model;
+		/* For a contact or chat, its place in children and its row. */
+		GSequenceIter *link;
+		GtkTreeIter iter;
+	} sort;
 } PidginBlistNode;
 
 /***************************************************
@@ -4514,6 +4547,7 @@ static void pidgin_blist_hide_node(PurpleBuddyList *list, PurpleBlistNode *node,
 
 	if(gtkblist->selected_node == node)
 		gtkblist->selected_node = NULL;
+	sort_forget(node);
 	if (get_iter_from_node(node, &iter)) {
 		gtk_tree_store_remove(gtkblist->treemodel, &iter);
 		if(update && (PURPLE_IS_CONTACT(node) ||
@@ -6197,6 +6231,9 @@ static void pidgin_blist_remove(PurpleBuddyList *list, PurpleBlistNode *node)
 
 	purple_request_close_with_handle(node);
 
+	if (batch_update_buddies != NULL)
+		g_hash_table_remove(batch_update_buddies, node);
+
 	pidgin_blist_hide_node(list, node, TRUE);
 
 	if(node->parent)
@@ -6216,6 +6253,9 @@ static void pidgin_blist_remove(PurpleBuddyList *list, PurpleBlistNode *node)
 			g_source_remove(gtknode->recent_signonoff_timer);
 
 		purple_signals_disconnect_by_handle(gtknode);
+		sort_forget(node);
+		g_free(gtknode->sort.name);
+		g_free(gtknode->sort.key);
 		g_free(gtknode);
 		purple_blist_node_set_ui_data(node, NULL);
 	}
@@ -6277,18 +6317,23 @@ static gboolean insert_node(PurpleBuddyList *list, PurpleBlistNode *node, GtkTre
 	if(get_iter_from_node(node, &cur))
 		curptr = &cur;
 
+	/* The sort methods keep their keys in it */
+	if(gtknode == NULL) {
+		pidgin_blist_new_node(node);
+		gtknode = purple_blist_node_get_ui_data(node);
+	}
+
 	if(PURPLE_IS_CONTACT(node) || PURPLE_IS_CHAT(node)) {
+		sort_placed_node = NULL;
 		current_sort_method->func(node, list, parent_iter, curptr, iter);
+		/* The other sort methods don't keep the sorted children */
+		if (sort_placed_node != node)
+			sort_forget(node->parent);
 	} else {
 		sort_method_none(node, list, parent_iter, curptr, iter);
 	}
 
-	if(gtknode != NULL) {
-		gtk_tree_row_reference_free(gtknode->row);
-	} else {
-		pidgin_blist_new_node(node);
-		gtknode = purple_blist_node_get_ui_data(node);
-	}
+	gtk_tree_row_reference_free(gtknode->row);
 
 	newpath = gtk_tree_model_get_path(GTK_TREE_MODEL(gtkblist->treemodel),
 			iter);
@@ -6604,10 +6649,6 @@ static void buddy_node(PurpleBuddy *buddy, GtkTreeIter *iter, PurpleBlistNode *n
 static void pidgin_blist_update_contact(PurpleBuddyList *list, PurpleBlistNode *node)
 {
 	PurpleBlistNode *cnode;
-	PurpleContact *contact;
-	PurpleBuddy *buddy;
-	gboolean biglist = purple_prefs_get_bool(PIDGIN_PREFS_ROOT "/blist/show_buddy_icons");
-	struct _pidgin_blist_node *gtknode;
 
 	if (editing_blist)
 		return;
@@ -6625,6 +6666,20 @@ static void pidgin_blist_update_contact(PurpleBuddyList *list, PurpleBlistNode *
 	else
 		pidgin_blist_update_group(list, cnode->parent);
 
+	pidgin_blist_update_contact_row(list, cnode);
+}
+
+/* Updates the row of a contact, but not its group. */
+static void pidgin_blist_update_contact_row(PurpleBuddyList *list, PurpleBlistNode *cnode)
+{
+	PurpleContact *contact;
+	PurpleBuddy *buddy;
+	gboolean biglist = purple_prefs_get_bool(PIDGIN_PREFS_ROOT "/blist/show_buddy_icons");
+	struct _pidgin_blist_node *gtknode;
+
+	if (editing_blist)
+		return;
+
 	contact = (PurpleContact*)cnode;
 	buddy = purple_contact_get_priority_buddy(contact);
 
@@ -6699,19 +6754,23 @@ static void pidgin_blist_update_contact(PurpleBuddyList *list, PurpleBlistNode *
 
 static void pidgin_blist_update_buddy(PurpleBuddyList *list, PurpleBlistNode *node, gboolean status_change)
 {
-	PurpleBuddy *buddy;
-	struct _pidgin_blist_node *gtkparentnode;
-
 	g_return_if_fail(PURPLE_IS_BUDDY(node));
 
 	if (node->parent == NULL)
 		return;
 
-	buddy = (PurpleBuddy*)node;
-
 	/* First things first, update the contact */
 	pidgin_blist_update_contact(list, node);
 
+	pidgin_blist_update_buddy_row(list, node);
+}
+
+/* Updates the row of a buddy, but not its contact. */
+static void pidgin_blist_update_buddy_row(PurpleBuddyList *list, PurpleBlistNode *node)
+{
+	PurpleBuddy *buddy = (PurpleBuddy*)node;
+	struct _pidgin_blist_node *gtkparentnode;
+
 	gtkparentnode = purple_blist_node_get_ui_data(node->parent);
 
 	if (gtkparentnode->contact_expanded && buddy_is_displayable(buddy))
@@ -6855,9 +6914,16 @@ static void pidgin_blist_update(PurpleBuddyList *list, PurpleBlistNode *node)
 		pidgin_blist_update_group(list, node);
 	else if (PURPLE_IS_CONTACT(node))
 		pidgin_blist_update_contact(list, node);
-	else if (PURPLE_IS_BUDDY(node))
-		pidgin_blist_update_buddy(list, node, TRUE);
-	else if (PURPLE_IS_CHAT(node))
+	else if (PURPLE_IS_BUDDY(node)) {
+		/* buddies_status_changed_cb() updates them all at once */
+		if (purple_blist_presence_batch_is_committing()) {
+			if (batch_update_buddies == NULL)
+				batch_update_buddies = g_hash_table_new(g_direct_hash, g_direct_equal);
+			g_hash_table_add(batch_update_buddies, node);
+		} else {
+			pidgin_blist_update_buddy(list, node, TRUE);
+		}
+	} else if (PURPLE_IS_CHAT(node))
 		pidgin_blist_update_chat(list, node);
 }
 
@@ -6886,6 +6952,10 @@ static void pidgin_blist_destroy(PurpleBuddyList *list)
 	gtkblist->refresh_timer = 0;
 	gtkblist->timeout = 0;
 	gtkblist->drag_timeout = 0;
+	if (batch_update_buddies != NULL) {
+		g_hash_table_destroy(batch_update_buddies);
+		batch_update_buddies = NULL;
+	}
 	gtkblist->window = gtkblist->vbox = gtkblist->treeview = NULL;
 	g_object_unref(G_OBJECT(gtkblist->treemodel));
 	gtkblist->treemodel = NULL;
@@ -7496,6 +7566,68 @@ static void buddy_signonoff_cb(PurpleBuddy *buddy)
 			(GSourceFunc)buddy_signonoff_timeout_cb, buddy);
 }
 
+/*
+ * Updates the buddies of a presence batch.  Every group and contact is
+ * updated, and so placed by the sort method, once for the whole batch
+ * instead of once for each of its buddies.
+ */
+static void
+buddies_status_changed_cb(GList *buddies)
+{
+	PurpleBuddyList *list = purple_blist_get_buddy_list();
+	GHashTable *pending = batch_update_buddies;
+	GHashTable *groups, *contacts;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	batch_update_buddies = NULL;
+	if (pending == NULL)
+		return;
+
+	if (!gtkblist || !gtkblist->treeview) {
+		g_hash_table_destroy(pending);
+		return;
+	}
+
+	/* PurpleGroup* => a buddy in it, a displayable one if there is one */
+	groups = g_hash_table_new(g_direct_hash, g_direct_equal);
+	contacts = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	g_hash_table_iter_init(&iter, pending);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		PurpleBlistNode *node = key;
+		PurpleBuddy *shown;
+
+		if (node->parent == NULL)
+			continue;
+
+		shown = g_hash_table_lookup(groups, node->parent->parent);
+		if (shown == NULL || !buddy_is_displayable(shown))
+			g_hash_table_insert(groups, node->parent->parent, node);
+		g_hash_table_add(contacts, node->parent);
+	}
+
+	g_hash_table_iter_init(&iter, groups);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		pidgin_blist_update_group(list, value);
+
+	g_hash_table_iter_init(&iter, contacts);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+		pidgin_blist_update_contact_row(list, key);
+
+	g_hash_table_iter_init(&iter, pending);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		PurpleBlistNode *node = key;
+
+		if (node->parent != NULL)
+			pidgin_blist_update_buddy_row(list, node);
+	}
+
+	g_hash_table_destroy(groups);
+	g_hash_table_destroy(contacts);
+	g_hash_table_destroy(pending);
+}
+
 void
 pidgin_blist_set_theme(PidginBlistTheme *theme)
 {
@@ -7580,6 +7712,8 @@ void pidgin_blist_init(void)
 			gtk_blist_handle, PURPLE_CALLBACK(buddy_signonoff_cb), NULL);
 	purple_signal_connect(purple_blist_get_handle(), "buddy-privacy-changed",
 			gtk_blist_handle, PURPLE_CALLBACK(pidgin_blist_update_privacy_cb), NULL);
+	purple_signal_connect(purple_blist_get_handle(), "buddies-status-changed",
+			gtk_blist_handle, PURPLE_CALLBACK(buddies_status_changed_cb), NULL);
 
 	purple_signal_connect_priority(purple_connections_get_handle(), "autojoin",
 	                               gtk_blist_handle, PURPLE_CALLBACK(autojoin_cb),
@@ -7684,233 +7818,393 @@ static void sort_method_none(PurpleBlistNode *node, PurpleBuddyList *blist, GtkT
 			sibling ? &sibling_iter : NULL);
 }
 
-static void sort_method_alphabetical(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+/* Returns the collation key of the name node is sorted by, or NULL if it has
+ * none. Unless refresh is set, this is the key node was last placed with. */
+static const char *
+sort_key_name(PurpleBlistNode *node, gboolean refresh)
 {
-	GtkTreeIter more_z;
+	struct _pidgin_blist_node *gtknode = purple_blist_node_get_ui_data(node);
+	const char *name;
 
-	const char *my_name;
+	if (!refresh && gtknode->sort.key != NULL)
+		return gtknode->sort.key;
 
-	if(PURPLE_IS_CONTACT(node)) {
-		my_name = purple_contact_get_alias((PurpleContact*)node);
-	} else if(PURPLE_IS_CHAT(node)) {
-		my_name = purple_chat_get_name((PurpleChat*)node);
-	} else {
-		sort_method_none(node, blist, groupiter, cur, iter);
-		return;
+	if (PURPLE_IS_CONTACT(node))
+		name = purple_contact_get_alias((PurpleContact*)node);
+	else if (PURPLE_IS_CHAT(node))
+		name = purple_chat_get_name((PurpleChat*)node);
+	else
+		name = NULL;
+
+	if (name == NULL) {
+		g_free(gtknode->sort.name);
+		g_free(gtknode->sort.key);
+		gtknode->sort.name = gtknode->sort.key = NULL;
+	} else if (gtknode->sort.key == NULL || !purple_strequal(name, gtknode->sort.name)) {
+		g_free(gtknode->sort.name);
+		g_free(gtknode->sort.key);
+		gtknode->sort.name = g_strdup(name);
+		if (g_utf8_validate(name, -1, NULL)) {
+			char *folded = g_utf8_casefold(name, -1);
+			gtknode->sort.key = g_utf8_collate_key(folded, -1);
+			g_free(folded);
+		} else {
+			gtknode->sort.key = g_strdup(name);
+		}
 	}
 
-	if (!gtk_tree_model_iter_children(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, &groupiter)) {
-		gtk_tree_store_insert(gtkblist->treemodel, iter, &groupiter, 0);
+	return gtknode->sort.key;
+}
+
+/* Compares names like purple_utf8_strcasecmp() does. */
+static int
+sort_key_compare(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return (a != NULL) - (b != NULL);
+
+	return strcmp(a, b);
+}
+
+/* Returns the log activity score of a contact. Unless refresh is set, this is
+ * the score it was last placed with. */
+static gint
+sort_key_activity(PurpleBlistNode *node, gboolean refresh)
+{
+	struct _pidgin_blist_node *gtknode = purple_blist_node_get_ui_data(node);
+	PurpleBlistNode *n;
+
+	if (!refresh && gtknode->sort.has_activity)
+		return gtknode->sort.activity;
+
+	gtknode->sort.activity = 0;
+	for (n = node->child; n; n = n->next) {
+		PurpleBuddy *buddy = (PurpleBuddy*)n;
+		gtknode->sort.activity += purple_log_get_activity_score(PURPLE_LOG_IM,
+				purple_buddy_get_name(buddy), purple_buddy_get_account(buddy));
+	}
+	gtknode->sort.has_activity = TRUE;
+
+	return gtknode->sort.activity;
+}
+
+/* Caches how available the priority buddy of a contact is, the way
+ * purple_buddy_presence_compare() compares it. Unless refresh is set, this
+ * is the presence the contact was last placed with. */
+static void
+sort_key_presence(PurpleBlistNode *node, gboolean refresh)
+{
+	struct _pidgin_blist_node *gtknode = purple_blist_node_get_ui_data(node);
+	PurpleBuddy *buddy;
+	PurplePresence *presence = NULL;
+
+	if (!refresh && gtknode->sort.has_presence)
 		return;
+
+	buddy = purple_contact_get_priority_buddy((PurpleContact*)node);
+	if (buddy != NULL)
+		presence = purple_buddy_get_presence(buddy);
+
+	gtknode->sort.has_presence = TRUE;
+	gtknode->sort.present = (presence != NULL);
+	if (presence != NULL) {
+		gtknode->sort.online = purple_presence_is_online(presence);
+		gtknode->sort.score = purple_buddy_presence_get_score(
+				PURPLE_BUDDY_PRESENCE(presence));
+		gtknode->sort.idle = purple_presence_get_idle_time(presence);
 	}
+}
 
-	do {
-		PurpleBlistNode *n;
-		const char *this_name;
-		int cmp;
+/* Compares the cached presences of two contacts, like
+ * purple_buddy_presence_compare() does. */
+static gint
+sort_key_presence_compare(PurpleBlistNode *a, PurpleBlistNode *b,
+		int idle_time_score)
+{
+	struct _pidgin_blist_node *gtka = purple_blist_node_get_ui_data(a);
+	struct _pidgin_blist_node *gtkb = purple_blist_node_get_ui_data(b);
+	int score_a, score_b;
 
-		gtk_tree_model_get(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, NODE_COLUMN, &n, -1);
+	sort_key_presence(a, FALSE);
+	sort_key_presence(b, FALSE);
 
-		if(PURPLE_IS_CONTACT(n)) {
-			this_name = purple_contact_get_alias((PurpleContact*)n);
-		} else if(PURPLE_IS_CHAT(n)) {
-			this_name = purple_chat_get_name((PurpleChat*)n);
-		} else {
-			this_name = NULL;
-		}
+	if (!gtka->sort.present || !gtkb->sort.present)
+		return gtkb->sort.present - gtka->sort.present;
 
-		cmp = purple_utf8_strcasecmp(my_name, this_name);
+	if (gtka->sort.online != gtkb->sort.online)
+		return gtka->sort.online ? -1 : 1;
 
-		if(this_name && (cmp < 0 || (cmp == 0 && node < n))) {
-			if(cur) {
-				gtk_tree_store_move_before(gtkblist->treemodel, cur, &more_z);
-				*iter = *cur;
-				return;
-			} else {
-				gtk_tree_store_insert_before(gtkblist->treemodel, iter,
-						&groupiter, &more_z);
-				return;
-			}
-		}
-	} while (gtk_tree_model_iter_next (GTK_TREE_MODEL(gtkblist->treemodel), &more_z));
+	/* The one which has been idle for longer gets the idle time score. */
+	score_a = gtka->sort.score;
+	score_b = gtkb->sort.score;
+	if (gtka->sort.idle < gtkb->sort.idle)
+		score_a += idle_time_score;
+	else if (gtka->sort.idle > gtkb->sort.idle)
+		score_b += idle_time_score;
 
-	if(cur) {
-		gtk_tree_store_move_before(gtkblist->treemodel, cur, NULL);
-		*iter = *cur;
+	if (score_a != score_b)
+		return score_a > score_b ? -1 : 1;
+
+	return 0;
+}
+
+/* Takes node out of the sorted children of its group, and drops its own
+ * sorted children, for sort_place() to collect them again. */
+static void
+sort_forget(PurpleBlistNode *node)
+{
+	struct _pidgin_blist_node *gtknode;
+	GSequenceIter *link;
+
+	if (node == NULL || (gtknode = purple_blist_node_get_ui_data(node)) == NULL)
 		return;
-	} else {
-		gtk_tree_store_append(gtkblist->treemodel, iter, &groupiter);
+
+	if (gtknode->sort.link != NULL) {
+		g_sequence_remove(gtknode->sort.link);
+		gtknode->sort.link = NULL;
+	}
+
+	if (gtknode->sort.children == NULL)
 		return;
+
+	for (link = g_sequence_get_begin_iter(gtknode->sort.children);
+			!g_sequence_iter_is_end(link); link = g_sequence_iter_next(link)) {
+		struct _pidgin_blist_node *gtkchild =
+				purple_blist_node_get_ui_data(g_sequence_get(link));
+
+		gtkchild->sort.link = NULL;
 	}
+	g_sequence_free(gtknode->sort.children);
+	gtknode->sort.children = NULL;
 }
 
-static void sort_method_status(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+/* Returns the contacts and chats of the group gnode, sorted with before.
+ * They are collected from the tree when they were placed with another
+ * function, or in another tree. */
+static GSequence *
+sort_children_get(PurpleBlistNode *gnode, GtkTreeIter *groupiter,
+		SortBeforeFunc before)
 {
-	GtkTreeIter more_z;
+	struct _pidgin_blist_node *gtkgroup = purple_blist_node_get_ui_data(gnode);
+	GtkTreeModel *model = GTK_TREE_MODEL(gtkblist->treemodel);
+	GtkTreeIter iter;
 
-	PurpleBuddy *my_buddy, *this_buddy;
+	if (gtkgroup->sort.children != NULL &&
+			gtkgroup->sort.children_before == before &&
+			gtkgroup->sort.children_model == gtkblist->treemodel)
+		return gtkgroup->sort.children;
 
-	if(PURPLE_IS_CONTACT(node)) {
-		my_buddy = purple_contact_get_priority_buddy((PurpleContact*)node);
-	} else if(PURPLE_IS_CHAT(node)) {
-		if (cur != NULL) {
-			*iter = *cur;
-			return;
-		}
+	sort_forget(gnode);
+	gtkgroup->sort.children = g_sequence_new(NULL);
+	gtkgroup->sort.children_before = before;
+	gtkgroup->sort.children_model = gtkblist->treemodel;
 
-		gtk_tree_store_append(gtkblist->treemodel, iter, &groupiter);
-		return;
-	} else {
-		sort_method_alphabetical(node, blist, groupiter, cur, iter);
-		return;
+	if (gtk_tree_model_iter_children(model, &iter, groupiter)) {
+		do {
+			PurpleBlistNode *child;
+			struct _pidgin_blist_node *gtkchild;
+
+			gtk_tree_model_get(model, &iter, NODE_COLUMN, &child, -1);
+			gtkchild = purple_blist_node_get_ui_data(child);
+			/* Left over from another tree */
+			if (gtkchild->sort.link != NULL)
+				g_sequence_remove(gtkchild->sort.link);
+			gtkchild->sort.iter = iter;
+			gtkchild->sort.link = g_sequence_append(gtkgroup->sort.children,
+					child);
+		} while (gtk_tree_model_iter_next(model, &iter));
 	}
 
+	return gtkgroup->sort.children;
+}
 
-	if (!gtk_tree_model_iter_children(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, &groupiter)) {
-		gtk_tree_store_insert(gtkblist->treemodel, iter, &groupiter, 0);
-		return;
+static gint
+sort_children_compare(gconstpointer n, gconstpointer node, gpointer before)
+{
+	return ((SortBeforeFunc)before)((PurpleBlistNode *)node,
+			(PurpleBlistNode *)n) ? 1 : -1;
+}
+
+/* Records that node was put at iter, before the child at next. */
+static void
+sort_children_insert(PurpleBlistNode *node, GtkTreeIter *iter,
+		GSequenceIter *next)
+{
+	struct _pidgin_blist_node *gtknode = purple_blist_node_get_ui_data(node);
+
+	gtknode->sort.iter = *iter;
+	gtknode->sort.link = g_sequence_insert_before(next, node);
+	sort_placed_node = node;
+}
+
+/* Puts node before the first child of groupiter that it goes before, or at
+ * the end. The group keeps its children in a sequence, in the order they
+ * were placed in, so that the place is found by bisection without walking
+ * the tree. */
+static void
+sort_place(PurpleBlistNode *node, GtkTreeIter groupiter, GtkTreeIter *cur,
+		GtkTreeIter *iter, SortBeforeFunc before)
+{
+	struct _pidgin_blist_node *gtknode = purple_blist_node_get_ui_data(node);
+	GSequence *children;
+	GSequenceIter *next;
+
+	children = sort_children_get(node->parent, &groupiter, before);
+
+	/* The node itself doesn't count when it's being moved */
+	if (gtknode->sort.link != NULL) {
+		g_sequence_remove(gtknode->sort.link);
+		gtknode->sort.link = NULL;
 	}
 
-	do {
-		PurpleBlistNode *n;
-		gint name_cmp;
-		gint presence_cmp;
+	next = g_sequence_search(children, node, sort_children_compare, before);
 
-		gtk_tree_model_get(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, NODE_COLUMN, &n, -1);
+	if (!g_sequence_iter_is_end(next)) {
+		struct _pidgin_blist_node *gtknext =
+				purple_blist_node_get_ui_data(g_sequence_get(next));
+		GtkTreeIter *more_z = &gtknext->sort.iter;
 
-		if(PURPLE_IS_CONTACT(n)) {
-			this_buddy = purple_contact_get_priority_buddy((PurpleContact*)n);
+		if (cur != NULL) {
+			gtk_tree_store_move_before(gtkblist->treemodel, cur, more_z);
+			*iter = *cur;
+		} else {
+			gtk_tree_store_insert_before(gtkblist->treemodel, iter,
+					&groupiter, more_z);
+		}
+	} else {
+		if (cur != NULL) {
+			gtk_tree_store_move_before(gtkblist->treemodel, cur, NULL);
+			*iter = *cur;
 		} else {
-			this_buddy = NULL;
+			gtk_tree_store_append(gtkblist->treemodel, iter, &groupiter);
 		}
+	}
 
-		name_cmp = purple_utf8_strcasecmp(
-			purple_contact_get_alias(purple_buddy_get_contact(my_buddy)),
-			(this_buddy
-			 ? purple_contact_get_alias(purple_buddy_get_contact(this_buddy))
-			 : NULL));
+	sort_children_insert(node, iter, next);
+}
 
-		presence_cmp = purple_buddy_presence_compare(
-			PURPLE_BUDDY_PRESENCE(purple_buddy_get_presence(my_buddy)),
-			this_buddy ? PURPLE_BUDDY_PRESENCE(purple_buddy_get_presence(this_buddy)) : NULL);
+/* Leaves node where it is, or puts it at the end of groupiter, for the
+ * children the sort methods don't compare. */
+static void
+sort_place_last(PurpleBlistNode *node, GtkTreeIter groupiter, GtkTreeIter *cur,
+		GtkTreeIter *iter, SortBeforeFunc before)
+{
+	struct _pidgin_blist_node *gtknode = purple_blist_node_get_ui_data(node);
+	GSequence *children;
 
-		if (this_buddy == NULL ||
-			(presence_cmp < 0 ||
-			 (presence_cmp == 0 &&
-			  (name_cmp < 0 || (name_cmp == 0 && node < n)))))
-		{
-			if (cur != NULL)
-			{
-				gtk_tree_store_move_before(gtkblist->treemodel, cur, &more_z);
-				*iter = *cur;
-				return;
-			}
-			else
-			{
-				gtk_tree_store_insert_before(gtkblist->treemodel, iter,
-											 &groupiter, &more_z);
-				return;
-			}
-		}
+	children = sort_children_get(node->parent, &groupiter, before);
+
+	if (cur != NULL && gtknode->sort.link != NULL) {
+		*iter = *cur;
+		sort_placed_node = node;
+		return;
 	}
-	while (gtk_tree_model_iter_next(GTK_TREE_MODEL(gtkblist->treemodel),
-									&more_z));
 
-	if (cur) {
+	if (cur != NULL) {
 		gtk_tree_store_move_before(gtkblist->treemodel, cur, NULL);
 		*iter = *cur;
-		return;
 	} else {
 		gtk_tree_store_append(gtkblist->treemodel, iter, &groupiter);
-		return;
 	}
+
+	sort_children_insert(node, iter, g_sequence_get_end_iter(children));
 }
 
-static void sort_method_log_activity(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+static gboolean
+sort_alphabetical_before(PurpleBlistNode *node, PurpleBlistNode *n)
 {
-	GtkTreeIter more_z;
+	const char *this_key = sort_key_name(n, FALSE);
+	int cmp;
 
-	int activity_score = 0, this_log_activity_score = 0;
-	const char *buddy_name, *this_buddy_name;
+	if (this_key == NULL)
+		return FALSE;
 
-	if(cur && (gtk_tree_model_iter_n_children(GTK_TREE_MODEL(gtkblist->treemodel), &groupiter) == 1)) {
-		*iter = *cur;
-		return;
-	}
+	cmp = sort_key_compare(sort_key_name(node, FALSE), this_key);
 
-	if(PURPLE_IS_CONTACT(node)) {
-		PurpleBlistNode *n;
-		PurpleBuddy *buddy;
-		for (n = node->child; n; n = n->next) {
-			buddy = (PurpleBuddy*)n;
-			activity_score += purple_log_get_activity_score(PURPLE_LOG_IM, purple_buddy_get_name(buddy), purple_buddy_get_account(buddy));
-		}
-		buddy_name = purple_contact_get_alias((PurpleContact*)node);
-	} else if(PURPLE_IS_CHAT(node)) {
-		/* we don't have a reliable way of getting the log filename
-		 * from the chat info in the blist, yet */
-		if (cur != NULL) {
-			*iter = *cur;
-			return;
-		}
+	return cmp < 0 || (cmp == 0 && node < n);
+}
 
-		gtk_tree_store_append(gtkblist->treemodel, iter, &groupiter);
-		return;
-	} else {
+static void sort_method_alphabetical(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+{
+	if(!PURPLE_IS_CONTACT(node) && !PURPLE_IS_CHAT(node)) {
 		sort_method_none(node, blist, groupiter, cur, iter);
 		return;
 	}
 
+	sort_key_name(node, TRUE);
+	sort_place(node, groupiter, cur, iter, sort_alphabetical_before);
+}
+
+/* Set by sort_method_status() for the comparisons of one placement. */
+static int sort_idle_time_score = 0;
+
+static gboolean
+sort_status_before(PurpleBlistNode *node, PurpleBlistNode *n)
+{
+	gint name_cmp, presence_cmp;
+
+	if (!PURPLE_IS_CONTACT(n))
+		return TRUE;
+
+	presence_cmp = sort_key_presence_compare(node, n, sort_idle_time_score);
+	if (presence_cmp != 0)
+		return presence_cmp < 0;
+
+	name_cmp = sort_key_compare(sort_key_name(node, FALSE), sort_key_name(n, FALSE));
 
-	if (!gtk_tree_model_iter_children(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, &groupiter)) {
-		gtk_tree_store_insert(gtkblist->treemodel, iter, &groupiter, 0);
+	return name_cmp < 0 || (name_cmp == 0 && node < n);
+}
+
+static void sort_method_status(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+{
+	if(PURPLE_IS_CHAT(node)) {
+		sort_place_last(node, groupiter, cur, iter, sort_status_before);
+		return;
+	} else if(!PURPLE_IS_CONTACT(node)) {
+		sort_method_alphabetical(node, blist, groupiter, cur, iter);
 		return;
 	}
 
-	do {
-		PurpleBlistNode *n;
-		PurpleBlistNode *n2;
-		PurpleBuddy *buddy;
-		int cmp;
+	sort_key_name(node, TRUE);
+	sort_key_presence(node, TRUE);
+	sort_idle_time_score =
+			purple_prefs_get_int("/purple/status/scores/idle_time");
+	sort_place(node, groupiter, cur, iter, sort_status_before);
+}
 
-		gtk_tree_model_get(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, NODE_COLUMN, &n, -1);
-		this_log_activity_score = 0;
+static gboolean
+sort_log_activity_before(PurpleBlistNode *node, PurpleBlistNode *n)
+{
+	gint activity_score, this_log_activity_score, cmp;
 
-		if(PURPLE_IS_CONTACT(n)) {
-			for (n2 = n->child; n2; n2 = n2->next) {
-				buddy = (PurpleBuddy*)n2;
-				this_log_activity_score += purple_log_get_activity_score(PURPLE_LOG_IM, purple_buddy_get_name(buddy), purple_buddy_get_account(buddy));
-			}
-			this_buddy_name = purple_contact_get_alias((PurpleContact*)n);
-		} else {
-			this_buddy_name = NULL;
-		}
+	if (!PURPLE_IS_CONTACT(n))
+		return TRUE;
 
-		cmp = purple_utf8_strcasecmp(buddy_name, this_buddy_name);
+	activity_score = sort_key_activity(node, FALSE);
+	this_log_activity_score = sort_key_activity(n, FALSE);
+	if (activity_score != this_log_activity_score)
+		return activity_score > this_log_activity_score;
 
-		if (!PURPLE_IS_CONTACT(n) || activity_score > this_log_activity_score ||
-				((activity_score == this_log_activity_score) &&
-				 (cmp < 0 || (cmp == 0 && node < n)))) {
-			if (cur != NULL) {
-				gtk_tree_store_move_before(gtkblist->treemodel, cur, &more_z);
-				*iter = *cur;
-				return;
-			} else {
-				gtk_tree_store_insert_before(gtkblist->treemodel, iter,
-						&groupiter, &more_z);
-				return;
-			}
-		}
-	} while (gtk_tree_model_iter_next (GTK_TREE_MODEL(gtkblist->treemodel), &more_z));
+	cmp = sort_key_compare(sort_key_name(node, FALSE), sort_key_name(n, FALSE));
 
-	if (cur != NULL) {
-		gtk_tree_store_move_before(gtkblist->treemodel, cur, NULL);
-		*iter = *cur;
+	return cmp < 0 || (cmp == 0 && node < n);
+}
+
+static void sort_method_log_activity(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+{
+	if(PURPLE_IS_CHAT(node)) {
+		/* we don't have a reliable way of getting the log filename
+		 * from the chat info in the blist, yet */
+		sort_place_last(node, groupiter, cur, iter, sort_log_activity_before);
 		return;
-	} else {
-		gtk_tree_store_append(gtkblist->treemodel, iter, &groupiter);
+	} else if(!PURPLE_IS_CONTACT(node)) {
+		sort_method_none(node, blist, groupiter, cur, iter);
 		return;
 	}
+
+	sort_key_name(node, TRUE);
+	sort_key_activity(node, TRUE);
+	sort_place(node, groupiter, cur, iter, sort_log_activity_before);
 }
 
 static void
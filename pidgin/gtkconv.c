@@ -186,6 +186,12 @@ static PurpleTheme *default_conv_theme = NULL;
 
 static GRegex *image_store_tag_re = NULL;
 
+/* IDs of the signals emitted for every displayed message. */
+static gulong displaying_im_msg_signal = 0;
+static gulong displayed_im_msg_signal = 0;
+static gulong displaying_chat_msg_signal = 0;
+static gulong displayed_chat_msg_signal = 0;
+
 static gboolean update_send_to_selection(PidginConvWindow *win);
 static void generate_send_to_items(PidginConvWindow *win);
 
@@ -4336,19 +4342,17 @@ deleting_chat_user_cb(PurpleChatUser *cb)
 	}
 }
 
-static void
-add_chat_user_common(PurpleChatConversation *chat, PurpleChatUser *cb, const char *old_name)
+/* Adds the row of a chat user to ls, leaving it to the caller to point the
+ * user at it. */
+static gboolean
+add_chat_user_row(PurpleChatConversation *chat, GtkListStore *ls,
+		PurpleChatUser *cb, const char *old_name, GtkTreeIter *iter)
 {
 	PidginConversation *gtkconv;
 	PurpleConversation *conv;
-	PidginChatPane *gtkchat;
 	PurpleConnection *gc;
 	PurpleProtocol *protocol;
-	GtkTreeModel *tm;
-	GtkListStore *ls;
-	GtkTreePath *newpath;
 	const char *stock;
-	GtkTreeIter iter;
 	gboolean is_me = FALSE;
 	gboolean is_buddy;
 	const gchar *name, *alias;
@@ -4362,14 +4366,10 @@ add_chat_user_common(PurpleChatConversation *chat, PurpleChatUser *cb, const cha
 
 	conv    = PURPLE_CONVERSATION(chat);
 	gtkconv = PIDGIN_CONVERSATION(conv);
-	gtkchat = gtkconv->u.chat;
 	gc      = purple_conversation_get_connection(conv);
 
 	if (!gc || !(protocol = purple_connection_get_protocol(gc)))
-		return;
-
-	tm = gtk_tree_view_get_model(GTK_TREE_VIEW(gtkchat->list));
-	ls = GTK_LIST_STORE(tm);
+		return FALSE;
 
 	stock = get_chat_user_status_icon(chat, name, flags);
 
@@ -4399,7 +4399,7 @@ add_chat_user_common(PurpleChatConversation *chat, PurpleChatUser *cb, const cha
 		color = (GdkRGBA*)get_nick_color(gtkconv, name);
 	}
 
-	gtk_list_store_insert_with_values(ls, &iter,
+	gtk_list_store_insert_with_values(ls, iter,
 /*
 * The GTK docs are mute about the effects of the "row" value for performance.
 * X-Chat hardcodes their value to 0 (prepend) and -1 (append), so we will too.
@@ -4417,20 +4417,39 @@ add_chat_user_common(PurpleChatConversation *chat, PurpleChatUser *cb, const cha
 			CHAT_USERS_WEIGHT_COLUMN, is_buddy ? PANGO_WEIGHT_BOLD : PANGO_WEIGHT_NORMAL,
 			-1);
 
+#if 0
+	if (is_me && color)
+		gdk_rgba_free(color);
+#endif
+	g_free(alias_key);
+
+	return TRUE;
+}
+
+static void
+set_chat_user_row(PurpleChatUser *cb, GtkTreeModel *tm, GtkTreeIter *iter)
+{
+	GtkTreePath *newpath;
+
 	if (purple_chat_user_get_ui_data(cb)) {
 		GtkTreeRowReference *ref = purple_chat_user_get_ui_data(cb);
 		gtk_tree_row_reference_free(ref);
 	}
 
-	newpath = gtk_tree_model_get_path(tm, &iter);
+	newpath = gtk_tree_model_get_path(tm, iter);
 	purple_chat_user_set_ui_data(cb, gtk_tree_row_reference_new(tm, newpath));
 	gtk_tree_path_free(newpath);
+}
 
-#if 0
-	if (is_me && color)
-		gdk_rgba_free(color);
-#endif
-	g_free(alias_key);
+static void
+add_chat_user_common(PurpleChatConversation *chat, PurpleChatUser *cb, const char *old_name)
+{
+	PidginChatPane *gtkchat = PIDGIN_CONVERSATION(PURPLE_CONVERSATION(chat))->u.chat;
+	GtkTreeModel *tm = gtk_tree_view_get_model(GTK_TREE_VIEW(gtkchat->list));
+	GtkTreeIter iter;
+
+	if (add_chat_user_row(chat, GTK_LIST_STORE(tm), cb, old_name, &iter))
+		set_chat_user_row(cb, tm, &iter);
 }
 
 /*
@@ -6794,9 +6813,8 @@ pidgin_conv_write_conv(PurpleConversation *conv, PurpleMessage *pmsg)
 	else
 		displaying = purple_markup_linkify(purple_message_get_contents(pmsg));
 
-	plugin_return = GPOINTER_TO_INT(purple_signal_emit_return_1(
-		pidgin_conversations_get_handle(),
-		(PURPLE_IS_IM_CONVERSATION(conv) ? "displaying-im-msg" : "displaying-chat-msg"),
+	plugin_return = GPOINTER_TO_INT(purple_signal_emit_return_1_by_id(
+		(PURPLE_IS_IM_CONVERSATION(conv) ? displaying_im_msg_signal : displaying_chat_msg_signal),
 		conv, pmsg));
 	if (plugin_return)
 	{
@@ -7117,8 +7135,8 @@ pidgin_conv_write_conv(PurpleConversation *conv, PurpleMessage *pmsg)
 		}
 	}
 
-	purple_signal_emit(pidgin_conversations_get_handle(),
-		(PURPLE_IS_IM_CONVERSATION(conv) ? "displayed-im-msg" : "displayed-chat-msg"),
+	purple_signal_emit_by_id(
+		(PURPLE_IS_IM_CONVERSATION(conv) ? displayed_im_msg_signal : displayed_chat_msg_signal),
 		conv, pmsg);
 	g_free(displaying);
 	update_typing_message(gtkconv, NULL);
@@ -7155,7 +7173,10 @@ pidgin_conv_chat_add_users(PurpleChatConversation *chat, GList *cbuddies, gboole
 	PidginConversation *gtkconv;
 	PidginChatPane *gtkchat;
 	GtkListStore *ls;
-	GList *l;
+	GList *l, *added;
+	GArray *rows;
+	gboolean detach;
+	guint i, n;
 
 	char tmp[BUF_LONG];
 	int num_users;
@@ -7174,13 +7195,29 @@ pidgin_conv_chat_add_users(PurpleChatConversation *chat, GList *cbuddies, gboole
 
 	ls = GTK_LIST_STORE(gtk_tree_view_get_model(GTK_TREE_VIEW(gtkchat->list)));
 
+	/* Joining a big room adds thousands of users at once. Take the model
+	 * out of the view so it doesn't update for each of them, add them
+	 * unsorted, sort once, and only then make the row references, which
+	 * GTK+ would otherwise update on every insertion. */
+	n = g_list_length(cbuddies);
+	detach = n > 100;
+	if (detach) {
+		g_object_ref(ls);
+		gtk_tree_view_set_model(GTK_TREE_VIEW(gtkchat->list), NULL);
+	}
+
 	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(ls),  GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
 										 GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID);
 
-	l = cbuddies;
-	while (l != NULL) {
-		add_chat_user_common(chat, (PurpleChatUser *)l->data, NULL);
-		l = l->next;
+	rows = g_array_sized_new(FALSE, FALSE, sizeof(GtkTreeIter), n);
+	added = NULL;
+	for (l = cbuddies; l != NULL; l = l->next) {
+		GtkTreeIter iter;
+
+		if (add_chat_user_row(chat, ls, l->data, NULL, &iter)) {
+			g_array_append_val(rows, iter);
+			added = g_list_prepend(added, l->data);
+		}
 	}
 
 	/* Currently GTK+ maintains our sorted list after it's in the tree.
@@ -7188,6 +7225,18 @@ pidgin_conv_chat_add_users(PurpleChatConversation *chat, GList *cbuddies, gboole
 	 */
 	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(ls),  CHAT_USERS_ALIAS_KEY_COLUMN,
 										 GTK_SORT_ASCENDING);
+
+	/* List store iters persist across sorting */
+	added = g_list_reverse(added);
+	for (i = 0, l = added; l != NULL; i++, l = l->next)
+		set_chat_user_row(l->data, GTK_TREE_MODEL(ls), &g_array_index(rows, GtkTreeIter, i));
+	g_list_free(added);
+	g_array_free(rows, TRUE);
+
+	if (detach) {
+		gtk_tree_view_set_model(GTK_TREE_VIEW(gtkchat->list), GTK_TREE_MODEL(ls));
+		g_object_unref(ls);
+	}
 }
 
 static void
@@ -8849,19 +8898,19 @@ pidgin_conversations_init(void)
 #endif
 	                     G_TYPE_BOOLEAN);
 
-	purple_signal_register(handle, "displaying-im-msg",
+	displaying_im_msg_signal = purple_signal_register(handle, "displaying-im-msg",
 		purple_marshal_BOOLEAN__POINTER_POINTER,
 		G_TYPE_BOOLEAN, 2, PURPLE_TYPE_CONVERSATION, PURPLE_TYPE_MESSAGE);
 
-	purple_signal_register(handle, "displayed-im-msg",
+	displayed_im_msg_signal = purple_signal_register(handle, "displayed-im-msg",
 		purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE, 2,
 		PURPLE_TYPE_CONVERSATION, PURPLE_TYPE_MESSAGE);
 
-	purple_signal_register(handle, "displaying-chat-msg",
+	displaying_chat_msg_signal = purple_signal_register(handle, "displaying-chat-msg",
 		purple_marshal_BOOLEAN__POINTER_POINTER,
 		G_TYPE_BOOLEAN, 2, PURPLE_TYPE_CONVERSATION, PURPLE_TYPE_MESSAGE);
 
-	purple_signal_register(handle, "displayed-chat-msg",
+	displayed_chat_msg_signal = purple_signal_register(handle, "displayed-chat-msg",
 		purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE, 2,
 		PURPLE_TYPE_CONVERSATION, PURPLE_TYPE_MESSAGE);
 
@@ -121,7 +121,7 @@ static gchar *log_get_date(PurpleLog *log)
 static void search_cb(GtkWidget *button, PidginLogViewer *lv)
 {
 	const char *search_term = gtk_entry_get_text(GTK_ENTRY(lv->entry));
-	GList *logs;
+	GList *results, *l;
 
 	if (!(*search_term)) {
 		/* reset the tree */
@@ -149,21 +149,20 @@ static void search_cb(GtkWidget *button, PidginLogViewer *lv)
 	gtk_tree_store_clear(lv->treestore);
 	webkit_web_view_open(WEBKIT_WEB_VIEW(lv->web_view), "about:blank"); /* clear the view */
 
-	for (logs = lv->logs; logs != NULL; logs = logs->next) {
-		char *read = purple_log_read((PurpleLog*)logs->data, NULL);
-		if (read && *read && purple_strcasestr(read, search_term)) {
-			GtkTreeIter iter;
-			PurpleLog *log = logs->data;
-			gchar *log_date = log_get_date(log);
-
-			gtk_tree_store_append (lv->treestore, &iter, NULL);
-			gtk_tree_store_set(lv->treestore, &iter,
-					   0, log_date,
-					   1, log, -1);
-			g_free(log_date);
-		}
-		g_free(read);
+	results = purple_log_search(lv->logs, search_term);
+	for (l = results; l != NULL; l = l->next) {
+		PurpleLogSearchResult *result = l->data;
+		GtkTreeIter iter;
+		gchar *log_date = log_get_date(result->log);
+
+		gtk_tree_store_append (lv->treestore, &iter, NULL);
+		gtk_tree_store_set(lv->treestore, &iter,
+				   0, log_date,
+				   1, result->log, -1);
+		g_free(log_date);
+		purple_log_search_result_free(result);
 	}
+	g_list_free(results);
 
 	select_first_log(lv);
 	pidgin_clear_cursor(lv->window);
@@ -682,6 +681,8 @@ static PidginLogViewer *display_log_viewer(struct log_viewer_hash_t *ht, GList *
 	hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, PIDGIN_HIG_BOX_SPACE);
 	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
 	lv->entry = gtk_entry_new();
+	gtk_widget_set_tooltip_text(lv->entry,
+		_("Find the logs with words starting with each of these words"));
 	gtk_box_pack_start(GTK_BOX(hbox), lv->entry, TRUE, TRUE, 0);
 	find_button = gtk_button_new_from_stock(GTK_STOCK_FIND);
 	gtk_box_pack_start(GTK_BOX(hbox), find_button, FALSE, FALSE, 0);
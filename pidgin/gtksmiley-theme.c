@@ -498,6 +498,10 @@ pidgin_smiley_theme_activate_impl(PurpleSmileyTheme *theme)
 				g_object_unref(smiley);
 			}
 		}
+
+		/* Theme smileys don't change once loaded. */
+		purple_trie_set_compiled(
+			purple_smiley_list_get_trie(proto_smileys), TRUE);
 	}
 
 	pidgin_smiley_theme_index_free(index);
@@ -44,6 +44,7 @@
 #define MAX_SCROLL_TIME 0.4 /* seconds */
 #define SCROLL_DELAY 33 /* milliseconds */
 #define PIDGIN_WEBVIEW_MAX_PROCESS_TIME 100000 /* microseconds */
+#define PIDGIN_WEBVIEW_MAX_APPEND_BATCH 262144 /* bytes */
 
 #define PIDGIN_WEBVIEW_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE((obj), PIDGIN_TYPE_WEBVIEW, PidginWebViewPriv))
@@ -97,6 +98,7 @@ typedef struct _PidginWebViewPriv {
 	gboolean is_loading;
 	GQueue *load_queue;
 	guint loader;
+	guint append_limit;
 
 	/* Scroll adjustments */
 	GtkAdjustment *vadj;
@@ -260,6 +262,26 @@ webview_resource_get_loaded(WebKitWebView *web_view, const gchar *uri)
 	return g_hash_table_lookup(globally_loaded_images, uri);
 }
 
+/* Removes the oldest nodes of body, so that it keeps at most limit. */
+static void
+trim_appended_html(WebKitDOMHTMLElement *body, guint limit)
+{
+	WebKitDOMNodeList *children;
+	gulong count;
+
+	children = webkit_dom_node_get_child_nodes(WEBKIT_DOM_NODE(body));
+	count = webkit_dom_node_list_get_length(children);
+	g_object_unref(children);
+
+	for (; count > limit; count--) {
+		WebKitDOMNode *first = webkit_dom_node_get_first_child(WEBKIT_DOM_NODE(body));
+
+		if (first == NULL)
+			break;
+		webkit_dom_node_remove_child(WEBKIT_DOM_NODE(body), first, NULL);
+	}
+}
+
 static void
 process_load_queue_element(PidginWebView *webview)
 {
@@ -287,8 +309,49 @@ process_load_queue_element(PidginWebView *webview)
 				                 1.5*gtk_adjustment_get_page_size(priv->vadj)));
 			}
 
-			webkit_dom_html_element_insert_adjacent_html(body, "beforeend",
-			                                             str, NULL);
+			/* Busy chats and log replays queue up many appends at once.
+			 * Each one is parsed on its own, so that markup left open by
+			 * one can't swallow the next, but in a detached container.
+			 * The run is then added to the document in one go, for one
+			 * layout instead of one each. */
+			if (!g_queue_is_empty(priv->load_queue) &&
+			    GPOINTER_TO_INT(g_queue_peek_head(priv->load_queue)) == LOAD_HTML) {
+				WebKitDOMHTMLElement *container;
+				WebKitDOMDocumentFragment *fragment;
+				WebKitDOMNode *child;
+				gsize len = 0;
+
+				container = WEBKIT_DOM_HTML_ELEMENT(
+					webkit_dom_document_create_element(doc, "div", NULL));
+				fragment = webkit_dom_document_create_document_fragment(doc);
+
+				for (;;) {
+					webkit_dom_html_element_insert_adjacent_html(container,
+					                                             "beforeend",
+					                                             str, NULL);
+					while ((child = webkit_dom_node_get_first_child(
+					                WEBKIT_DOM_NODE(container))) != NULL) {
+						webkit_dom_node_append_child(WEBKIT_DOM_NODE(fragment),
+						                             child, NULL);
+					}
+					len += strlen(str);
+					g_free(str);
+
+					if (g_queue_is_empty(priv->load_queue) ||
+					    GPOINTER_TO_INT(g_queue_peek_head(priv->load_queue)) != LOAD_HTML ||
+					    len >= PIDGIN_WEBVIEW_MAX_APPEND_BATCH)
+						break;
+					g_queue_pop_head(priv->load_queue);
+					str = g_queue_pop_head(priv->load_queue);
+				}
+				str = NULL;
+
+				webkit_dom_node_append_child(WEBKIT_DOM_NODE(body),
+				                             WEBKIT_DOM_NODE(fragment), NULL);
+			} else {
+				webkit_dom_html_element_insert_adjacent_html(body, "beforeend",
+				                                             str, NULL);
+			}
 
 			range = webkit_dom_document_create_range(doc);
 			if (start) {
@@ -316,6 +379,9 @@ process_load_queue_element(PidginWebView *webview)
 
 			g_signal_emit(webview, signals[HTML_APPENDED], 0, range);
 
+			if (priv->append_limit > 0)
+				trim_appended_html(body, priv->append_limit);
+
 			break;
 
 		case LOAD_JS:
@@ -1600,6 +1666,17 @@ pidgin_webview_append_html(PidginWebView *webview, const char *html)
 		priv->loader = g_idle_add((GSourceFunc)process_load_queue, webview);
 }
 
+void
+pidgin_webview_set_append_limit(PidginWebView *webview, guint limit)
+{
+	PidginWebViewPriv *priv;
+
+	g_return_if_fail(webview != NULL);
+
+	priv = PIDGIN_WEBVIEW_GET_PRIVATE(webview);
+	priv->append_limit = limit;
+}
+
 void
 pidgin_webview_set_vadjustment(PidginWebView *webview, GtkAdjustment *vadj)
 {
@@ -139,6 +139,18 @@ GtkWidget *pidgin_webview_new(gboolean editable);
  */
 void pidgin_webview_append_html(PidginWebView *webview, const char *markup);
 
+/**
+ * pidgin_webview_set_append_limit:
+ * @webview: The PidginWebView object
+ * @limit:   The most top-level nodes to keep in the body, or 0 for no limit
+ *
+ * Limits how much appended html is kept.  After each append, the oldest
+ * nodes of the body are removed until at most @limit are left, so that a
+ * long-lived view takes constant memory and appending to it doesn't slow
+ * down.
+ */
+void pidgin_webview_set_append_limit(PidginWebView *webview, guint limit);
+
 /**
  * pidgin_webview_load_html_string:
  * @webview: The PidginWebView object
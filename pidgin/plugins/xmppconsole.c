@@ -782,6 +782,8 @@ create_console(PurplePluginAction *action)
 	g_signal_connect(G_OBJECT(console->dropdown), "changed", G_CALLBACK(dropdown_changed_cb), NULL);
 
 	console->webview = pidgin_webview_new(FALSE);
+	/* Only keep the last stanzas, the console can stay open for days */
+	pidgin_webview_set_append_limit(PIDGIN_WEBVIEW(console->webview), 1000);
 	pidgin_webview_load_html_string(PIDGIN_WEBVIEW(console->webview), EMPTY_HTML);
 	if (console->count == 0) {
 		char *tmp = g_strdup_printf("<div class=info>%s</div>",